@@ -65,6 +65,7 @@
 #include <wsutil/privileges.h>
 #include <version_info.h>
 #include <wiretap/wtap_opttypes.h>
+#include <wiretap/wtap_index.h>
 
 #ifdef HAVE_PLUGINS
 #include <wsutil/plugins.h>
@@ -89,6 +90,9 @@
 #define INVALID_OPTION 1
 #define BAD_FLAG 1
 
+/* Long options without a short equivalent */
+#define LONGOPT_WRITE_INDEX (65536+1)
+
 /*
  * By default capinfos now continues processing
  * the next filename if and when wiretap detects
@@ -147,6 +151,8 @@ static gboolean cap_order          = TRUE;  /* Report if packets are in chronolo
 
 static gboolean cap_file_hashes    = TRUE;  /* Calculate file hashes */
 
+static gboolean write_index        = FALSE; /* Write a record index for each file */
+
 // Strongest to weakest
 #define HASH_SIZE_SHA256 32
 #define HASH_SIZE_RMD160 20
@@ -1074,6 +1080,7 @@ process_cap_file(wtap *wth, const char *filename)
   order_t               order = IN_ORDER;
   guint                 i;
   wtapng_iface_descriptions_t *idb_info;
+  wtap_index_t         *rec_index = NULL;
 
   g_assert(wth != NULL);
   g_assert(filename != NULL);
@@ -1101,9 +1108,18 @@ process_cap_file(wtap *wth, const char *filename)
   g_free(idb_info);
   idb_info = NULL;
 
+  if (write_index) {
+    rec_index = wtap_index_new(wth);
+    if (rec_index == NULL)
+      fprintf(stderr, "capinfos: \"%s\" is compressed; not writing an index for it.\n",
+              filename);
+  }
+
   /* Tally up data that we need to parse through the file to find */
   while (wtap_read(wth, &err, &err_info, &data_offset))  {
     rec = wtap_get_rec(wth);
+    if (rec_index != NULL)
+      wtap_index_append(rec_index, data_offset, rec);
     if (rec->presence_flags & WTAP_HAS_TS) {
       prev_time = cur_time;
       cur_time = rec->ts;
@@ -1211,6 +1227,18 @@ process_cap_file(wtap *wth, const char *filename)
   g_free(idb_info);
   idb_info = NULL;
 
+  if (rec_index != NULL) {
+    int index_err;
+
+    if (err == 0 && !wtap_index_write(rec_index, wth, filename, &index_err)) {
+      fprintf(stderr,
+          "capinfos: Can't write the index file for \"%s\": %s.\n",
+          filename, g_strerror(index_err));
+      status = 1;
+    }
+    wtap_index_free(rec_index);
+  }
+
   if (err != 0) {
     fprintf(stderr,
         "capinfos: An error occurred after reading %u packets from \"%s\".\n",
@@ -1358,6 +1386,8 @@ print_usage(FILE *output)
   fprintf(output, "  -C cancel processing if file open fails (default is to continue)\n");
   fprintf(output, "  -A generate all infos (default)\n");
   fprintf(output, "  -K disable displaying the capture comment\n");
+  fprintf(output, "  --write-index write an index next to each file, so that Wireshark\n");
+  fprintf(output, "                and sharkd can open it without reading all of it\n");
   fprintf(output, "\n");
   fprintf(output, "Options are processed from left to right order with later options superceding\n");
   fprintf(output, "or adding to earlier options.\n");
@@ -1411,6 +1441,7 @@ main(int argc, char *argv[])
   static const struct option long_options[] = {
       {"help", no_argument, NULL, 'h'},
       {"version", no_argument, NULL, 'v'},
+      {"write-index", no_argument, NULL, LONGOPT_WRITE_INDEX},
       {0, 0, 0, 0 }
   };
 
@@ -1564,6 +1595,10 @@ main(int argc, char *argv[])
         cap_comment = FALSE;
         break;
 
+      case LONGOPT_WRITE_INDEX:
+        write_index = TRUE;
+        break;
+
       case 'F':
         if (report_all_infos) disable_all_infos();
         cap_file_more_info = TRUE;
@@ -148,6 +148,9 @@ typedef struct _chop_t {
 /* Table of user comments */
 GTree *frames_user_comments = NULL;
 
+/* Long options without a short equivalent */
+#define LONGOPT_COMPRESS (65536+1)
+
 #define MAX_SELECTIONS 512
 static struct select_item     selectfrm[MAX_SELECTIONS];
 static guint                  max_selected              = 0;
@@ -158,6 +161,7 @@ static int                    out_file_type_subtype     = WTAP_FILE_TYPE_SUBTYPE
 static int                    out_file_type_subtype     = WTAP_FILE_TYPE_SUBTYPE_PCAP; /* default to pcap     */
 #endif
 static int                    out_frame_type            = -2; /* Leave frame type alone */
+static wtap_compression_type  out_compression_type      = WTAP_UNCOMPRESSED;
 static int                    verbose                   = 0;  /* Not so verbose         */
 static struct time_adjustment time_adj                  = {{0, 0}, 0}; /* no adjustment */
 static nstime_t               relative_time_window      = {0, 0}; /* de-dup time window */
@@ -809,6 +813,8 @@ print_usage(FILE *output)
     fprintf(output, "  -T <encap type>        set the output file encapsulation type; default is the\n");
     fprintf(output, "                         same as the input file. An empty \"-T\" option will\n");
     fprintf(output, "                         list the encapsulation types.\n");
+    fprintf(output, "  --compress <type>      compress the output file(s) with the given\n");
+    fprintf(output, "                         compression type.\n");
     fprintf(output, "\n");
     fprintf(output, "Miscellaneous:\n");
     fprintf(output, "  -h                     display this help and exit.\n");
@@ -885,6 +891,18 @@ list_encap_types(FILE *stream) {
     g_free(encaps);
 }
 
+static void
+list_output_compression_types(FILE *stream) {
+    GSList *compression_types, *type;
+
+    fprintf(stream, "editcap: The available output compression types for the \"--compress\" flag are:\n");
+    compression_types = wtap_get_all_compression_type_names_list();
+    for (type = compression_types; type != NULL; type = g_slist_next(type)) {
+        fprintf(stream, "    %s\n", (const char *)type->data);
+    }
+    g_slist_free(compression_types);
+}
+
 static int
 framenum_compare(gconstpointer a, gconstpointer b, gpointer user_data _U_)
 {
@@ -930,11 +948,11 @@ editcap_dump_open(const char *filename, guint32 snaplen,
   if (strcmp(filename, "-") == 0) {
     /* Write to the standard output. */
     pdh = wtap_dump_open_stdout_ng(out_file_type_subtype, out_frame_type,
-                                   snaplen, FALSE /* compressed */,
+                                   snaplen, out_compression_type,
                                    shb_hdrs, idb_inf, nrb_hdrs, write_err);
   } else {
     pdh = wtap_dump_open_ng(filename, out_file_type_subtype, out_frame_type,
-                            snaplen, FALSE /* compressed */,
+                            snaplen, out_compression_type,
                             shb_hdrs, idb_inf, nrb_hdrs, write_err);
   }
   return pdh;
@@ -952,6 +970,7 @@ main(int argc, char *argv[])
     int           opt;
     static const struct option long_options[] = {
         {"novlan", no_argument, NULL, 0x8100},
+        {"compress", required_argument, NULL, LONGOPT_COMPRESS},
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'V'},
         {0, 0, 0, 0 }
@@ -1043,6 +1062,17 @@ main(int argc, char *argv[])
             break;
         }
 
+        case LONGOPT_COMPRESS:
+            out_compression_type = wtap_name_to_compression_type(optarg);
+            if (!wtap_can_write_compression_type(out_compression_type)) {
+                fprintf(stderr, "editcap: \"%s\" isn't a valid output compression type\n\n",
+                        optarg);
+                list_output_compression_types(stderr);
+                ret = INVALID_OPTION;
+                goto clean_exit;
+            }
+            break;
+
         case 'a':
         {
             guint frame_number;
@@ -107,29 +107,26 @@
 #define ENAME_ENTERPRISES "enterprises.tsv"
 
 #define HASHETHSIZE      2048
-#define HASHHOSTSIZE     2048
 #define HASHIPXNETSIZE    256
-#define SUBNETLENGTHSIZE   32  /*1-32 inc.*/
 
-/* hash table used for IPv4 lookup */
-
-#define HASH_IPV4_ADDRESS(addr) (g_htonl(addr) & (HASHHOSTSIZE - 1))
-
-
-typedef struct sub_net_hashipv4 {
-    guint             addr;
-    /* XXX: No longer needed?*/
-    guint8            flags;          /* B0 dummy_entry, B1 resolve, B2 If the address is used in the trace */
-    struct sub_net_hashipv4   *next;
-    gchar             name[MAXNAMELEN];
-} sub_net_hashipv4_t;
+/*
+ * Subnets are kept in a path-compressed binary trie, one for IPv4 and one
+ * for IPv6, so that the longest matching prefix is found in a single walk
+ * from the root instead of by probing a hash table per prefix length.
+ * Each node holds a prefix (bits past prefix_len are zero) and, if a subnet
+ * ends there, its name; nodes without a name only exist as branch points.
+ */
+typedef struct subnet_trie_node {
+    struct subnet_trie_node *child[2];
+    const gchar      *name;           /* Interned; NULL for branch points */
+    guint8            prefix_len;     /* Significant bits of prefix */
+    guint8            prefix[1];      /* Sized to the address length */
+} subnet_trie_node_t;
 
-/* Array of entries of subnets of different lengths */
 typedef struct {
-    gsize        mask_length;      /*1-32*/
-    guint32      mask;             /* e.g. 255.255.255.*/
-    sub_net_hashipv4_t** subnet_addresses; /* Hash table of subnet addresses */
-} subnet_length_entry_t;
+    subnet_trie_node_t *root;
+    guint               addr_len;     /* In bytes */
+} subnet_trie_t;
 
 
 /* hash table used for IPX network lookup */
@@ -232,8 +229,21 @@ static wmem_map_t *eth_hashtable = NULL;
 static wmem_map_t *serv_port_hashtable = NULL;
 static GHashTable *enterprises_hashtable = NULL;
 
-static subnet_length_entry_t subnet_length_entries[SUBNETLENGTHSIZE]; /* Ordered array of entries */
-static gboolean have_subnet_entry = FALSE;
+static subnet_trie_t subnet_ipv4_trie = { NULL, 4 };
+static subnet_trie_t subnet_ipv6_trie = { NULL, 16 };
+
+/*
+ * Names from the hosts files are kept in compact address -> name maps and
+ * only copied into ipv4_hash_table/ipv6_hash_table when an address is
+ * actually looked up. The names themselves, like subnet names, are interned
+ * in resolved_name_table so that aliases of the same host share storage.
+ * The files are read the first time a name is needed, not when the capture
+ * file is opened; pending_hosts_files holds the paths until then.
+ */
+static wmem_map_t *hosts_ipv4_table = NULL;
+static wmem_map_t *hosts_ipv6_table = NULL;
+static wmem_map_t *resolved_name_table = NULL;
+static GPtrArray* pending_hosts_files = NULL;
 
 static gboolean new_resolved_objects = FALSE;
 
@@ -561,7 +571,10 @@ fgetline(char **buf, int *size, FILE *fp)
  *  Local function definitions
  */
 static subnet_entry_t subnet_lookup(const guint32 addr);
-static void subnet_entry_set(guint32 subnet_addr, const guint8 mask_length, const gchar* name);
+static subnet_entry_t subnet_lookup6(const ws_in6_addr *addr);
+static void subnet_entry_set(subnet_trie_t *trie, const guint8 *subnet_addr, const guint8 mask_length, const gchar* name);
+static gboolean hosts_lookup_ipv4(hashipv4_t *tp);
+static gboolean hosts_lookup_ipv6(hashipv6_t *tp);
 
 
 static void
@@ -954,13 +967,38 @@ fill_dummy_ip4(const guint addr, hashipv4_t* volatile tp)
 }
 
 
-/* Fill in an IP6 structure with the string form of the address.
+/* Fill in an IP6 structure with info from subnets file or just with the
+ * string form of the address.
  */
 static void
 fill_dummy_ip6(hashipv6_t* volatile tp)
 {
+    subnet_entry_t subnet_entry;
+
     /* Overwrite if we get async DNS reply */
-    g_strlcpy(tp->name, tp->ip6, MAXNAMELEN);
+
+    /* Do we have a subnet for this address? */
+    subnet_entry = subnet_lookup6((const ws_in6_addr *)tp->addr);
+    if (NULL != subnet_entry.name) {
+        /* Print name, then the 16-bit groups that are not totally masked,
+         * each preceded by ':', with the subnet bits cleared.
+         */
+        gchar buffer[WS_INET6_ADDRSTRLEN];
+        gchar *paddr = buffer;
+        gsize i;
+
+        buffer[0] = '\0';
+        for (i = subnet_entry.mask_length / 16; i < 8; i++) {
+            guint16 group = pntoh16(&tp->addr[i * 2]);
+
+            if (i == subnet_entry.mask_length / 16 && subnet_entry.mask_length % 16)
+                group &= 0xffff >> (subnet_entry.mask_length % 16);
+            paddr += g_snprintf(paddr, (gulong)(sizeof(buffer) - (paddr - buffer)), ":%x", group);
+        }
+        g_snprintf(tp->name, MAXNAMELEN, "%s%s", subnet_entry.name, buffer);
+    } else {
+        g_strlcpy(tp->name, tp->ip6, MAXNAMELEN);
+    }
 }
 
 #ifdef HAVE_C_ARES
@@ -1031,6 +1069,9 @@ host_lookup(const guint addr)
     if (!gbl_resolv_flags.network_name)
         return tp;
 
+    if (hosts_lookup_ipv4(tp))
+        return tp;
+
     if (gbl_resolv_flags.use_external_net_name_resolver) {
         tp->flags |= TRIED_RESOLVE_ADDRESS;
 
@@ -1108,6 +1149,9 @@ host_lookup6(const ws_in6_addr *addr)
     if (!gbl_resolv_flags.network_name)
         return tp;
 
+    if (hosts_lookup_ipv6(tp))
+        return tp;
+
     if (gbl_resolv_flags.use_external_net_name_resolver) {
         tp->flags |= TRIED_RESOLVE_ADDRESS;
 
@@ -2098,6 +2142,22 @@ vlan_name_lookup(const guint id)
 } /* vlan_name_lookup */
 /* VLAN END */
 
+/*
+ * Return the shared copy of a host or subnet name, adding it if needed.
+ */
+static const gchar *
+resolved_name_intern(const gchar *name)
+{
+    gchar *interned;
+
+    interned = (gchar *)wmem_map_lookup(resolved_name_table, name);
+    if (!interned) {
+        interned = wmem_strdup(wmem_epan_scope(), name);
+        wmem_map_insert(resolved_name_table, interned, interned);
+    }
+    return interned;
+}
+
 static gboolean
 read_hosts_file (const char *hostspath, gboolean store_entries)
 {
@@ -2140,10 +2200,16 @@ read_hosts_file (const char *hostspath, gboolean store_entries)
 
         entry_found = TRUE;
         if (store_entries) {
+            /* Later entries override earlier ones, as they always have */
             if (is_ipv6) {
-                add_ipv6_name(&host_addr.ip6_addr, cp);
+                gpointer addr_key;
+
+                if (!wmem_map_lookup_extended(hosts_ipv6_table, &host_addr.ip6_addr, (const void **)&addr_key, NULL)) {
+                    addr_key = wmem_memdup(wmem_epan_scope(), &host_addr.ip6_addr, sizeof(ws_in6_addr));
+                }
+                wmem_map_insert(hosts_ipv6_table, addr_key, (gpointer)resolved_name_intern(cp));
             } else {
-                add_ipv4_name(host_addr.ip4_addr, cp);
+                wmem_map_insert(hosts_ipv4_table, GUINT_TO_POINTER(host_addr.ip4_addr), (gpointer)resolved_name_intern(cp));
             }
         }
     }
@@ -2153,6 +2219,80 @@ read_hosts_file (const char *hostspath, gboolean store_entries)
     return entry_found ? TRUE : FALSE;
 } /* read_hosts_file */
 
+/*
+ * Queue a hosts file to be read the first time a host name is needed.
+ * The file is only opened here so that a missing or unreadable file is
+ * still reported when the capture file is opened.
+ */
+static void
+queue_hosts_file(const char *hostspath, gboolean report_failure)
+{
+    FILE *hf;
+
+    if ((hf = ws_fopen(hostspath, "r")) == NULL) {
+        if (report_failure && errno != ENOENT) {
+            report_open_failure(hostspath, errno, FALSE);
+        }
+        return;
+    }
+    fclose(hf);
+
+    if (!pending_hosts_files)
+        pending_hosts_files = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(pending_hosts_files, g_strdup(hostspath));
+}
+
+static void
+load_pending_hosts_files(void)
+{
+    GPtrArray *hosts_files = pending_hosts_files;
+    guint i;
+
+    if (!hosts_files)
+        return;
+
+    pending_hosts_files = NULL;
+    for (i = 0; i < hosts_files->len; i++) {
+        read_hosts_file((const char *) g_ptr_array_index(hosts_files, i), TRUE);
+    }
+    g_ptr_array_free(hosts_files, TRUE);
+}
+
+/*
+ * If the hosts files have a name for this address, give it to the entry.
+ */
+static gboolean
+hosts_lookup_ipv4(hashipv4_t *tp)
+{
+    const gchar *name;
+
+    load_pending_hosts_files();
+
+    name = (const gchar *)wmem_map_lookup(hosts_ipv4_table, GUINT_TO_POINTER(tp->addr));
+    if (!name)
+        return FALSE;
+
+    g_strlcpy(tp->name, name, MAXNAMELEN);
+    tp->flags |= TRIED_RESOLVE_ADDRESS|NAME_RESOLVED;
+    return TRUE;
+}
+
+static gboolean
+hosts_lookup_ipv6(hashipv6_t *tp)
+{
+    const gchar *name;
+
+    load_pending_hosts_files();
+
+    name = (const gchar *)wmem_map_lookup(hosts_ipv6_table, tp->addr);
+    if (!name)
+        return FALSE;
+
+    g_strlcpy(tp->name, name, MAXNAMELEN);
+    tp->flags |= TRIED_RESOLVE_ADDRESS|NAME_RESOLVED;
+    return TRUE;
+}
+
 gboolean
 add_hosts_file (const char *hosts_file)
 {
@@ -2260,15 +2400,13 @@ get_addrinfo_list(void)
  * <line> = <comment> | <entry> | <whitespace>
  * <comment> = <whitespace>#<any>
  * <entry> = <subnet_definition> <whitespace> <subnet_name> [<comment>|<whitespace><any>]
- * <subnet_definition> = <ipv4_address> / <subnet_mask_length>
- * <ipv4_address> is a full address; it will be masked to get the subnet-ID.
- * <subnet_mask_length> is a decimal 1-31
+ * <subnet_definition> = <ip_address> / <subnet_mask_length>
+ * <ip_address> is a full IPv4 or IPv6 address; it will be masked to get the subnet-ID.
+ * <subnet_mask_length> is a decimal 1-32 for IPv4 or 1-128 for IPv6
  * <subnet_name> is a string containing no whitespace.
  * <whitespace> = (space | tab)+
  * Any malformed entries are ignored.
  * Any trailing data after the subnet_name is ignored.
- *
- * XXX Support IPv6
  */
 static gboolean
 read_subnets_file (const char *subnetspath)
@@ -2277,7 +2415,11 @@ read_subnets_file (const char *subnetspath)
     char *line = NULL;
     int size = 0;
     gchar *cp, *cp2;
-    guint32 host_addr; /* IPv4 ONLY */
+    union {
+        guint32 ip4_addr;
+        ws_in6_addr ip6_addr;
+    } host_addr;
+    subnet_trie_t *trie;
     guint8 mask_length;
 
     if ((hf = ws_fopen(subnetspath, "r")) == NULL)
@@ -2291,7 +2433,7 @@ read_subnets_file (const char *subnetspath)
             continue; /* no tokens in the line */
 
 
-        /* Expected format is <IP4 address>/<subnet length> */
+        /* Expected format is <IP address>/<subnet length> */
         cp2 = strchr(cp, '/');
         if (NULL == cp2) {
             /* No length */
@@ -2300,19 +2442,23 @@ read_subnets_file (const char *subnetspath)
         *cp2 = '\0'; /* Cut token */
         ++cp2    ;
 
-        /* Check if this is a valid IPv4 address */
-        if (!str_to_ip(cp, &host_addr)) {
+        /* Check if this is a valid IPv6 or IPv4 address */
+        if (ws_inet_pton6(cp, &host_addr.ip6_addr)) {
+            trie = &subnet_ipv6_trie;
+        } else if (str_to_ip(cp, &host_addr.ip4_addr)) {
+            trie = &subnet_ipv4_trie;
+        } else {
             continue; /* no */
         }
 
-        if (!ws_strtou8(cp2, NULL, &mask_length) || mask_length == 0 || mask_length > 32) {
+        if (!ws_strtou8(cp2, NULL, &mask_length) || mask_length == 0 || mask_length > trie->addr_len * 8) {
             continue; /* invalid mask length */
         }
 
         if ((cp = strtok(NULL, " \t")) == NULL)
             continue; /* no subnet name */
 
-        subnet_entry_set(host_addr, mask_length, cp);
+        subnet_entry_set(trie, (const guint8 *)&host_addr, mask_length, cp);
     }
     wmem_free(wmem_epan_scope(), line);
 
@@ -2320,45 +2466,94 @@ read_subnets_file (const char *subnetspath)
     return TRUE;
 } /* read_subnets_file */
 
-static subnet_entry_t
-subnet_lookup(const guint32 addr)
+static inline guint
+subnet_trie_bit(const guint8 *key, guint bit)
 {
-    subnet_entry_t subnet_entry;
-    guint32 i;
+    return (key[bit / 8] >> (7 - bit % 8)) & 1;
+}
 
-    /* Search mask lengths linearly, longest first */
+/* Number of leading bits, at most max_bits, that a and b have in common. */
+static guint
+subnet_trie_common_bits(const guint8 *a, const guint8 *b, guint max_bits)
+{
+    guint bits = 0;
+    guint i;
 
-    i = SUBNETLENGTHSIZE;
-    while(have_subnet_entry && i > 0) {
-        guint32 masked_addr;
-        subnet_length_entry_t* length_entry;
+    for (i = 0; bits < max_bits; i++, bits += 8) {
+        guint8 diff = a[i] ^ b[i];
 
-        /* Note that we run from 31 (length 32)  to 0 (length 1)  */
-        --i;
-        g_assert(i < SUBNETLENGTHSIZE);
+        if (diff) {
+            while (!(diff & 0x80)) {
+                diff <<= 1;
+                bits++;
+            }
+            break;
+        }
+    }
 
+    return MIN(bits, max_bits);
+}
 
-        length_entry = &subnet_length_entries[i];
+static subnet_trie_node_t *
+subnet_trie_node_new(const subnet_trie_t *trie, const guint8 *key, guint prefix_len, const gchar *name)
+{
+    subnet_trie_node_t *node;
 
-        if (NULL != length_entry->subnet_addresses) {
-            sub_net_hashipv4_t * tp;
-            guint32 hash_idx;
+    node = (subnet_trie_node_t *)wmem_alloc0(wmem_epan_scope(), G_STRUCT_OFFSET(subnet_trie_node_t, prefix) + trie->addr_len);
+    node->name = name;
+    node->prefix_len = (guint8)prefix_len;
+    memcpy(node->prefix, key, (prefix_len + 7) / 8);
+    if (prefix_len % 8) {
+        node->prefix[prefix_len / 8] &= (guint8)(0xff << (8 - prefix_len % 8));
+    }
 
-            masked_addr = addr & length_entry->mask;
-            hash_idx = HASH_IPV4_ADDRESS(masked_addr);
+    return node;
+}
 
-            tp = length_entry->subnet_addresses[hash_idx];
-            while(tp != NULL && tp->addr != masked_addr) {
-                tp = tp->next;
-            }
+static void
+subnet_trie_free(subnet_trie_node_t *node)
+{
+    if (node == NULL)
+        return;
 
-            if (NULL != tp) {
-                subnet_entry.mask = length_entry->mask;
-                subnet_entry.mask_length = i + 1; /* Length is offset + 1 */
-                subnet_entry.name = tp->name;
-                return subnet_entry;
-            }
+    subnet_trie_free(node->child[0]);
+    subnet_trie_free(node->child[1]);
+    wmem_free(wmem_epan_scope(), node);
+}
+
+/* Return the node of the longest subnet containing addr, or NULL. */
+static const subnet_trie_node_t *
+subnet_trie_lookup(const subnet_trie_t *trie, const guint8 *addr)
+{
+    const subnet_trie_node_t *node = trie->root;
+    const subnet_trie_node_t *best = NULL;
+
+    while (node != NULL &&
+           subnet_trie_common_bits(node->prefix, addr, node->prefix_len) == node->prefix_len) {
+        if (node->name != NULL) {
+            best = node;
         }
+        if (node->prefix_len == trie->addr_len * 8) {
+            break;
+        }
+        node = node->child[subnet_trie_bit(addr, node->prefix_len)];
+    }
+
+    return best;
+}
+
+static subnet_entry_t
+subnet_lookup(const guint32 addr)
+{
+    subnet_entry_t subnet_entry;
+    const subnet_trie_node_t *node;
+
+    node = subnet_trie_lookup(&subnet_ipv4_trie, (const guint8 *)&addr);
+    if (NULL != node) {
+        subnet_entry.mask = g_htonl(ip_get_subnet_mask(node->prefix_len));
+        subnet_entry.mask_length = node->prefix_len;
+        subnet_entry.name = node->name;
+        return subnet_entry;
     }
 
     subnet_entry.mask = 0;
@@ -2368,66 +2563,70 @@ subnet_lookup(const guint32 addr)
     return subnet_entry;
 }
 
+/* As subnet_lookup(), but mask is not filled in; check name instead. */
+static subnet_entry_t
+subnet_lookup6(const ws_in6_addr *addr)
+{
+    subnet_entry_t subnet_entry;
+    const subnet_trie_node_t *node;
+
+    node = subnet_trie_lookup(&subnet_ipv6_trie, addr->bytes);
+
+    subnet_entry.mask = 0;
+    subnet_entry.mask_length = node ? node->prefix_len : 0;
+    subnet_entry.name = node ? node->name : NULL;
+
+    return subnet_entry;
+}
+
 /* Add a subnet-definition - name pair to the set.
  * The definition is taken by masking the address passed in with the mask of the
  * given length.
  */
 static void
-subnet_entry_set(guint32 subnet_addr, const guint8 mask_length, const gchar* name)
+subnet_entry_set(subnet_trie_t *trie, const guint8 *subnet_addr, const guint8 mask_length, const gchar* name)
 {
-    subnet_length_entry_t* entry;
-    sub_net_hashipv4_t * tp;
-    gsize hash_idx;
+    subnet_trie_node_t **link = &trie->root;
+    subnet_trie_node_t *node, *branch;
+    guint common;
 
-    g_assert(mask_length > 0 && mask_length <= 32);
+    g_assert(mask_length > 0 && mask_length <= trie->addr_len * 8);
 
-    entry = &subnet_length_entries[mask_length - 1];
+    name = resolved_name_intern(name);
 
-    subnet_addr &= entry->mask;
+    while ((node = *link) != NULL) {
+        common = subnet_trie_common_bits(node->prefix, subnet_addr, MIN(node->prefix_len, mask_length));
 
-    hash_idx = HASH_IPV4_ADDRESS(subnet_addr);
-
-    if (NULL == entry->subnet_addresses) {
-        entry->subnet_addresses = (sub_net_hashipv4_t**)wmem_alloc0(wmem_epan_scope(), sizeof(sub_net_hashipv4_t*) * HASHHOSTSIZE);
-    }
-
-    if (NULL != (tp = entry->subnet_addresses[hash_idx])) {
-        sub_net_hashipv4_t * new_tp;
-
-        while (tp->next) {
-            if (tp->addr == subnet_addr) {
+        if (common == node->prefix_len) {
+            if (common == mask_length) {
+                /* This subnet, or a branch point that now becomes it */
+                if (node->name == NULL) {
+                    node->name = name;
+                }
                 return; /* XXX provide warning that an address was repeated? */
-            } else {
-                tp = tp->next;
             }
+            link = &node->child[subnet_trie_bit(subnet_addr, common)];
+            continue;
         }
 
-        new_tp = wmem_new(wmem_epan_scope(), sub_net_hashipv4_t);
-        tp->next = new_tp;
-        tp = new_tp;
-    } else {
-        tp = entry->subnet_addresses[hash_idx] = wmem_new(wmem_epan_scope(), sub_net_hashipv4_t);
+        /* The new subnet contains this node or diverges from it at bit common */
+        branch = subnet_trie_node_new(trie, subnet_addr, common, common == mask_length ? name : NULL);
+        branch->child[subnet_trie_bit(node->prefix, common)] = node;
+        if (common < mask_length) {
+            branch->child[subnet_trie_bit(subnet_addr, common)] =
+                subnet_trie_node_new(trie, subnet_addr, mask_length, name);
+        }
+        *link = branch;
+        return;
     }
 
-    tp->next = NULL;
-    tp->addr = subnet_addr;
-    g_strlcpy(tp->name, name, MAXNAMELEN); /* This is longer than subnet names can actually be */
-    have_subnet_entry = TRUE;
+    *link = subnet_trie_node_new(trie, subnet_addr, mask_length, name);
 }
 
 static void
 subnet_name_lookup_init(void)
 {
     gchar* subnetspath;
-    guint32 i;
-
-    for(i = 0; i < SUBNETLENGTHSIZE; ++i) {
-        guint32 length = i + 1;
-
-        subnet_length_entries[i].subnet_addresses  = NULL;
-        subnet_length_entries[i].mask_length  = length;
-        subnet_length_entries[i].mask = g_htonl(ip_get_subnet_mask(length));
-    }
 
     /* Check profile directory before personal configuration */
     subnetspath = get_persconffile_path(ENAME_SUBNETS, TRUE);
@@ -2905,6 +3104,15 @@ host_name_lookup_init(void)
     g_assert(ipv6_hash_table == NULL);
     ipv6_hash_table = wmem_map_new(wmem_epan_scope(), ipv6_oat_hash, ipv6_equal);
 
+    g_assert(hosts_ipv4_table == NULL);
+    hosts_ipv4_table = wmem_map_new_flat(wmem_epan_scope(), g_direct_hash, g_direct_equal);
+
+    g_assert(hosts_ipv6_table == NULL);
+    hosts_ipv6_table = wmem_map_new_flat(wmem_epan_scope(), ipv6_oat_hash, ipv6_equal);
+
+    g_assert(resolved_name_table == NULL);
+    resolved_name_table = wmem_map_new_flat(wmem_epan_scope(), g_str_hash, g_str_equal);
+
 #ifdef HAVE_C_ARES
     g_assert(async_dns_queue_head == NULL);
     async_dns_queue_head = wmem_list_new(wmem_epan_scope());
@@ -2921,18 +3129,14 @@ host_name_lookup_init(void)
      */
     if (!gbl_resolv_flags.load_hosts_file_from_profile_only) {
         hostspath = get_datafile_path(ENAME_HOSTS);
-        if (!read_hosts_file(hostspath, TRUE) && errno != ENOENT) {
-            report_open_failure(hostspath, errno, FALSE);
-        }
+        queue_hosts_file(hostspath, TRUE);
         g_free(hostspath);
     }
     /*
      * Load the user's hosts file no matter what, if they have one.
      */
     hostspath = get_persconffile_path(ENAME_HOSTS, TRUE);
-    if (!read_hosts_file(hostspath, TRUE) && errno != ENOENT) {
-        report_open_failure(hostspath, errno, FALSE);
-    }
+    queue_hosts_file(hostspath, TRUE);
     g_free(hostspath);
 #ifdef HAVE_C_ARES
 #ifdef CARES_HAVE_ARES_LIBRARY_INIT
@@ -2949,7 +3153,7 @@ host_name_lookup_init(void)
 
     if (extra_hosts_files && !gbl_resolv_flags.load_hosts_file_from_profile_only) {
         for (i = 0; i < extra_hosts_files->len; i++) {
-            read_hosts_file((const char *) g_ptr_array_index(extra_hosts_files, i), TRUE);
+            queue_hosts_file((const char *) g_ptr_array_index(extra_hosts_files, i), FALSE);
         }
     }
 
@@ -2963,31 +3167,26 @@ host_name_lookup_init(void)
 void
 host_name_lookup_cleanup(void)
 {
-    guint32 i, j;
-    sub_net_hashipv4_t *entry, *next_entry;
-
     _host_name_lookup_cleanup();
 
     ipxnet_hash_table = NULL;
     ipv4_hash_table = NULL;
     ipv6_hash_table = NULL;
     ss7pc_hash_table = NULL;
+    hosts_ipv4_table = NULL;
+    hosts_ipv6_table = NULL;
 
-    for(i = 0; i < SUBNETLENGTHSIZE; ++i) {
-        if (subnet_length_entries[i].subnet_addresses != NULL) {
-            for (j = 0; j < HASHHOSTSIZE; j++) {
-                for (entry = subnet_length_entries[i].subnet_addresses[j];
-                     entry != NULL; entry = next_entry) {
-                    next_entry = entry->next;
-                    wmem_free(wmem_epan_scope(), entry);
-                }
-            }
-            wmem_free(wmem_epan_scope(), subnet_length_entries[i].subnet_addresses);
-            subnet_length_entries[i].subnet_addresses = NULL;
-        }
+    if (pending_hosts_files) {
+        g_ptr_array_free(pending_hosts_files, TRUE);
+        pending_hosts_files = NULL;
     }
 
-    have_subnet_entry = FALSE;
+    subnet_trie_free(subnet_ipv4_trie.root);
+    subnet_ipv4_trie.root = NULL;
+    subnet_trie_free(subnet_ipv6_trie.root);
+    subnet_ipv6_trie.root = NULL;
+
+    resolved_name_table = NULL;
     new_resolved_objects = FALSE;
 }
 
@@ -3448,15 +3647,55 @@ get_vlan_hash_table(void)
         return vlan_hash_table;
 }
 
+/*
+ * Copy the hosts file entries that haven't been looked up yet into the
+ * host tables, so that callers listing them see every known name.
+ */
+static void
+hosts_ipv4_to_hash_table(gpointer key, gpointer value _U_, gpointer user_data _U_)
+{
+    hashipv4_t *tp = (hashipv4_t *)wmem_map_lookup(ipv4_hash_table, key);
+
+    if (!tp) {
+        tp = new_ipv4(GPOINTER_TO_UINT(key));
+        wmem_map_insert(ipv4_hash_table, key, tp);
+    } else if (tp->flags & TRIED_OR_RESOLVED_MASK) {
+        return;
+    }
+    hosts_lookup_ipv4(tp);
+}
+
+static void
+hosts_ipv6_to_hash_table(gpointer key, gpointer value _U_, gpointer user_data _U_)
+{
+    hashipv6_t *tp = (hashipv6_t *)wmem_map_lookup(ipv6_hash_table, key);
+
+    if (!tp) {
+        tp = new_ipv6((const ws_in6_addr *)key);
+        wmem_map_insert(ipv6_hash_table, key, tp);
+    } else if (tp->flags & TRIED_OR_RESOLVED_MASK) {
+        return;
+    }
+    hosts_lookup_ipv6(tp);
+}
+
 wmem_map_t *
 get_ipv4_hash_table(void)
 {
+        if (hosts_ipv4_table) {
+            load_pending_hosts_files();
+            wmem_map_foreach(hosts_ipv4_table, hosts_ipv4_to_hash_table, NULL);
+        }
         return ipv4_hash_table;
 }
 
 wmem_map_t *
 get_ipv6_hash_table(void)
 {
+        if (hosts_ipv6_table) {
+            load_pending_hosts_files();
+            wmem_map_foreach(hosts_ipv6_table, hosts_ipv6_to_hash_table, NULL);
+        }
         return ipv6_hash_table;
 }
 /* Initialize all the address resolution subsystems in this file */
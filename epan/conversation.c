@@ -62,6 +62,300 @@ static wmem_map_t *conversation_hashtable_no_port2 = NULL;
  */
 static wmem_map_t *conversation_hashtable_no_addr2_or_port2 = NULL;
 
+/*
+ * Open-addressed index for exact conversations between two IPv4 or two
+ * IPv6 endpoints.
+ *
+ * Those make up nearly all of the conversations created by TCP and UDP,
+ * and looking them up through conversation_hashtable_exact means hashing
+ * both addresses byte by byte and chasing a bucket chain plus the
+ * separately allocated address data of every key on it.  Here the key is
+ * packed into fixed-width words stored inline in the slot, so a lookup
+ * normally costs one hash and a single probe.
+ *
+ * The index holds the head of each conversation chain, exactly like
+ * conversation_hashtable_exact does for the key of that chain; it is
+ * authoritative for lookups of packable keys.  conversation_hashtable_exact
+ * is still updated for every conversation so that it can be walked by
+ * get_conversation_hashtable_exact().
+ *
+ * Slots are allocated in file scope and forgotten when file scope is freed.
+ * Removal uses backward-shift deletion, so no tombstones are needed.
+ */
+typedef struct {
+	guint32 addr1[4];
+	guint32 addr2[4];
+	guint32 port1;
+	guint32 port2;
+	guint32 type;		/* endpoint type << 8 | address type */
+} conversation_packed_key_t;
+
+typedef struct {
+	conversation_packed_key_t key;
+	guint32 hash;
+	conversation_t *chain_head;	/* NULL if the slot is empty */
+} conversation_index_slot_t;
+
+typedef struct {
+	conversation_index_slot_t *slots;
+	guint32 capacity;		/* always a power of two */
+	guint32 count;
+} conversation_index_t;
+
+#define CONVERSATION_INDEX_MIN_CAPACITY	1024
+
+static conversation_index_t conversation_index_exact;
+
+/*
+ * Pack a key if both of its addresses are IPv4 or both are IPv6.
+ */
+static gboolean
+conversation_pack_key(const address *addr1, const address *addr2,
+    const endpoint_type etype, const guint32 port1, const guint32 port2,
+    conversation_packed_key_t *pk)
+{
+	if (addr1 == NULL || addr2 == NULL || addr1->type != addr2->type)
+		return FALSE;
+
+	switch (addr1->type) {
+
+	case AT_IPv4:
+		if (addr1->len != 4 || addr2->len != 4)
+			return FALSE;
+		memset(pk, 0, sizeof(*pk));
+		memcpy(pk->addr1, addr1->data, 4);
+		memcpy(pk->addr2, addr2->data, 4);
+		break;
+
+	case AT_IPv6:
+		if (addr1->len != 16 || addr2->len != 16)
+			return FALSE;
+		memcpy(pk->addr1, addr1->data, 16);
+		memcpy(pk->addr2, addr2->data, 16);
+		break;
+
+	default:
+		return FALSE;
+	}
+
+	pk->port1 = port1;
+	pk->port2 = port2;
+	pk->type = ((guint32)etype << 8) | (guint32)addr1->type;
+	return TRUE;
+}
+
+static inline guint32
+conversation_packed_mix(guint32 h, guint32 w)
+{
+	w *= 0xcc9e2d51;
+	w = (w << 15) | (w >> 17);
+	w *= 0x1b873593;
+	h ^= w;
+	h = (h << 13) | (h >> 19);
+	return h * 5 + 0xe6546b64;
+}
+
+static guint32
+conversation_packed_hash(const conversation_packed_key_t *pk)
+{
+	guint32 h = pk->type;
+
+	h = conversation_packed_mix(h, pk->port1 | (pk->port2 << 16));
+	h = conversation_packed_mix(h, pk->addr1[0]);
+	h = conversation_packed_mix(h, pk->addr2[0]);
+	if ((pk->type & 0xff) == AT_IPv6) {
+		h = conversation_packed_mix(h, pk->addr1[1]);
+		h = conversation_packed_mix(h, pk->addr1[2]);
+		h = conversation_packed_mix(h, pk->addr1[3]);
+		h = conversation_packed_mix(h, pk->addr2[1]);
+		h = conversation_packed_mix(h, pk->addr2[2]);
+		h = conversation_packed_mix(h, pk->addr2[3]);
+	}
+	if ((pk->port1 | pk->port2) > 0xffff)
+		h = conversation_packed_mix(h, (pk->port1 >> 16) | (pk->port2 & 0xffff0000));
+
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+static inline gboolean
+conversation_packed_equal(const conversation_packed_key_t *a, const conversation_packed_key_t *b)
+{
+	return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+/*
+ * Return the slot holding the key, or the empty slot where it would go.
+ */
+static conversation_index_slot_t *
+conversation_index_probe(const conversation_index_t *idx, const conversation_packed_key_t *pk,
+    const guint32 hash)
+{
+	guint32 mask = idx->capacity - 1;
+	guint32 i = hash & mask;
+	conversation_index_slot_t *slot;
+
+	for (;;) {
+		slot = &idx->slots[i];
+		if (slot->chain_head == NULL)
+			return slot;
+		if (slot->hash == hash && conversation_packed_equal(&slot->key, pk))
+			return slot;
+		i = (i + 1) & mask;
+	}
+}
+
+static void
+conversation_index_grow(conversation_index_t *idx)
+{
+	conversation_index_slot_t *old_slots = idx->slots;
+	guint32 old_capacity = idx->capacity;
+	guint32 i;
+
+	idx->capacity = old_capacity ? old_capacity * 2 : CONVERSATION_INDEX_MIN_CAPACITY;
+	idx->slots = (conversation_index_slot_t *)wmem_alloc0(wmem_file_scope(),
+	    idx->capacity * sizeof(conversation_index_slot_t));
+
+	for (i = 0; i < old_capacity; i++) {
+		if (old_slots[i].chain_head != NULL) {
+			*conversation_index_probe(idx, &old_slots[i].key, old_slots[i].hash) = old_slots[i];
+		}
+	}
+
+	wmem_free(wmem_file_scope(), old_slots);
+}
+
+static conversation_t *
+conversation_index_lookup(const conversation_index_t *idx, const conversation_packed_key_t *pk)
+{
+	guint32 hash;
+	conversation_index_slot_t *slot;
+
+	if (idx->count == 0)
+		return NULL;
+
+	hash = conversation_packed_hash(pk);
+	slot = &idx->slots[hash & (idx->capacity - 1)];
+	/* Fast path: the key is in its home slot. */
+	if (slot->chain_head == NULL ||
+	    (slot->hash == hash && conversation_packed_equal(&slot->key, pk)))
+		return slot->chain_head;
+
+	return conversation_index_probe(idx, pk, hash)->chain_head;
+}
+
+/*
+ * Make conv the chain head for the key, adding the key if it isn't there.
+ */
+static void
+conversation_index_insert(conversation_index_t *idx, const conversation_packed_key_t *pk,
+    conversation_t *conv)
+{
+	guint32 hash;
+	conversation_index_slot_t *slot;
+
+	/* Keep the load factor below 3/4. */
+	if ((idx->count + 1) * 4 > idx->capacity * 3)
+		conversation_index_grow(idx);
+
+	hash = conversation_packed_hash(pk);
+	slot = conversation_index_probe(idx, pk, hash);
+	if (slot->chain_head == NULL) {
+		slot->key = *pk;
+		slot->hash = hash;
+		idx->count++;
+	}
+	slot->chain_head = conv;
+}
+
+static void
+conversation_index_remove(conversation_index_t *idx, const conversation_packed_key_t *pk)
+{
+	guint32 mask, i, j, home;
+	conversation_index_slot_t *slot;
+
+	if (idx->count == 0)
+		return;
+
+	slot = conversation_index_probe(idx, pk, conversation_packed_hash(pk));
+	if (slot->chain_head == NULL)
+		return;
+
+	/*
+	 * Shift later members of the probe sequence back into the hole
+	 * unless that would move them in front of their home slot.
+	 */
+	mask = idx->capacity - 1;
+	i = (guint32)(slot - idx->slots);
+	for (j = (i + 1) & mask; idx->slots[j].chain_head != NULL; j = (j + 1) & mask) {
+		home = idx->slots[j].hash & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			idx->slots[i] = idx->slots[j];
+			i = j;
+		}
+	}
+	idx->slots[i].chain_head = NULL;
+	idx->count--;
+}
+
+static gboolean
+conversation_index_reset_cb(wmem_allocator_t *allocator _U_, wmem_cb_event_t event _U_,
+    void *user_data)
+{
+	conversation_index_t *idx = (conversation_index_t *)user_data;
+
+	idx->slots = NULL;
+	idx->capacity = 0;
+	idx->count = 0;
+
+	return TRUE;
+}
+
+/*
+ * Chain head operations on one of the conversation hash tables, going
+ * through conversation_index_exact for packable exact keys.
+ */
+static conversation_t *
+conversation_chain_lookup(wmem_map_t *hashtable, const conversation_key_t key)
+{
+	conversation_packed_key_t pk;
+
+	if (hashtable == conversation_hashtable_exact &&
+	    conversation_pack_key(&key->addr1, &key->addr2, key->etype, key->port1, key->port2, &pk))
+		return conversation_index_lookup(&conversation_index_exact, &pk);
+
+	return (conversation_t *)wmem_map_lookup(hashtable, key);
+}
+
+static void
+conversation_chain_set_head(wmem_map_t *hashtable, conversation_t *conv)
+{
+	conversation_packed_key_t pk;
+	conversation_key_t key = conv->key_ptr;
+
+	if (hashtable == conversation_hashtable_exact &&
+	    conversation_pack_key(&key->addr1, &key->addr2, key->etype, key->port1, key->port2, &pk))
+		conversation_index_insert(&conversation_index_exact, &pk, conv);
+
+	wmem_map_insert(hashtable, key, conv);
+}
+
+static void
+conversation_chain_steal(wmem_map_t *hashtable, const conversation_key_t key)
+{
+	conversation_packed_key_t pk;
+
+	if (hashtable == conversation_hashtable_exact &&
+	    conversation_pack_key(&key->addr1, &key->addr2, key->etype, key->port1, key->port2, &pk))
+		conversation_index_remove(&conversation_index_exact, &pk);
+
+	wmem_map_steal(hashtable, key);
+}
+
 
 static guint32 new_index;
 
@@ -468,6 +762,8 @@ conversation_init(void)
 	conversation_hashtable_no_addr2_or_port2 =
 	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_no_addr2_or_port2,
 	      conversation_match_no_addr2_or_port2);
+	wmem_register_callback(wmem_file_scope(), conversation_index_reset_cb,
+	    &conversation_index_exact);
 
 }
 
@@ -493,13 +789,13 @@ conversation_insert_into_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 {
 	conversation_t *chain_head, *chain_tail, *cur, *prev;
 
-	chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
+	chain_head = conversation_chain_lookup(hashtable, conv->key_ptr);
 
 	if (NULL==chain_head) {
 		/* New entry */
 		conv->next = NULL;
 		conv->last = conv;
-		wmem_map_insert(hashtable, conv->key_ptr, conv);
+		conversation_chain_set_head(hashtable, conv);
 		DPRINT(("created a new conversation chain"));
 	}
 	else {
@@ -528,7 +824,7 @@ conversation_insert_into_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 				conv->next = chain_head;
 				conv->last = chain_tail;
 				chain_head->last = NULL;
-				wmem_map_insert(hashtable, conv->key_ptr, conv);
+				conversation_chain_set_head(hashtable, conv);
 			}
 			else {
 				/* Inserting into the middle of the chain */
@@ -549,7 +845,7 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 {
 	conversation_t *chain_head, *cur, *prev;
 
-	chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
+	chain_head = conversation_chain_lookup(hashtable, conv->key_ptr);
 
 	if (conv == chain_head) {
 		/* We are currently the front of the chain */
@@ -558,7 +854,7 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 			 * update next pointer, but do not call
 			 * wmem_map_remove() either because the conv data
 			 * will be re-inserted. */
-			wmem_map_steal(hashtable, conv->key_ptr);
+			conversation_chain_steal(hashtable, conv->key_ptr);
 		}
 		else {
 			/* Update the head of the chain */
@@ -570,7 +866,7 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 			else
 				chain_head->latest_found = conv->latest_found;
 
-			wmem_map_insert(hashtable, chain_head->key_ptr, chain_head);
+			conversation_chain_set_head(hashtable, chain_head);
 		}
 	}
 	else {
@@ -783,7 +1079,7 @@ conversation_lookup_hashtable(wmem_map_t *hashtable, const guint32 frame_num, co
 	key.port1 = port1;
 	key.port2 = port2;
 
-	chain_head = (conversation_t *)wmem_map_lookup(hashtable, &key);
+	chain_head = conversation_chain_lookup(hashtable, &key);
 
 	if (chain_head && (chain_head->setup_frame <= frame_num)) {
 		match = chain_head;
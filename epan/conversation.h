@@ -114,7 +114,7 @@ WS_DLL_PUBLIC guint32 conversation_key_port2(const conversation_key_t key);
 /**
  * Create a new hash tables for conversations.
  */
-extern void conversation_init(void);
+WS_DLL_PUBLIC void conversation_init(void);
 
 /**
  * Initialize some variables every time a file is loaded or re-loaded.
@@ -232,8 +232,8 @@ try_conversation_dissector_by_id(const endpoint_type etype, const guint32 id, tv
 
 /* These routines are used to set undefined values for a conversation */
 
-extern void conversation_set_port2(conversation_t *conv, const guint32 port);
-extern void conversation_set_addr2(conversation_t *conv, const address *addr);
+WS_DLL_PUBLIC void conversation_set_port2(conversation_t *conv, const guint32 port);
+WS_DLL_PUBLIC void conversation_set_addr2(conversation_t *conv, const address *addr);
 
 WS_DLL_PUBLIC
 wmem_map_t *get_conversation_hashtable_exact(void);
@@ -0,0 +1,208 @@
+/* conversation_test.c
+ * Conversation table tests
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+
+#include "conversation.h"
+#include "wmem/wmem.h"
+
+/* Number of flows used by "conversation_test -m perf". */
+#define CONV_PERF_FLOWS (10 * 1000 * 1000)
+
+static void
+make_ipv4_flow(guint32 n, guint32 *a, guint32 *b, guint32 *port_a, guint32 *port_b)
+{
+    /* 10.x.y.z <-> 192.168.0.0/16, spread over ports so keys differ in every word. */
+    *a = g_htonl(0x0a000000 | (n & 0x00ffffff));
+    *b = g_htonl(0xc0a80000 | ((n >> 8) & 0xffff));
+    *port_a = 1024 + (n % 60000);
+    *port_b = 80 + (n >> 24);
+}
+
+static void
+conversation_test_exact_ipv4(void)
+{
+    static const guint8 src[] = {10, 0, 0, 1}, dst[] = {10, 0, 0, 2};
+    address a, b;
+    conversation_t *conv, *conv2;
+
+    set_address(&a, AT_IPv4, 4, src);
+    set_address(&b, AT_IPv4, 4, dst);
+
+    g_assert(find_conversation(1, &a, &b, ENDPOINT_TCP, 1234, 80, 0) == NULL);
+
+    conv = conversation_new(1, &a, &b, ENDPOINT_TCP, 1234, 80, 0);
+    g_assert(conv != NULL);
+
+    /* Both directions find the same conversation. */
+    g_assert(find_conversation(1, &a, &b, ENDPOINT_TCP, 1234, 80, 0) == conv);
+    g_assert(find_conversation(5, &b, &a, ENDPOINT_TCP, 80, 1234, 0) == conv);
+
+    /* Differing port, endpoint type or frame must not match. */
+    g_assert(find_conversation(1, &a, &b, ENDPOINT_TCP, 1235, 80, 0) == NULL);
+    g_assert(find_conversation(1, &a, &b, ENDPOINT_UDP, 1234, 80, 0) == NULL);
+    g_assert(find_conversation(0, &a, &b, ENDPOINT_TCP, 1234, 80, 0) == NULL);
+
+    /* A later conversation on the same key is chained after the first. */
+    conv2 = conversation_new(10, &a, &b, ENDPOINT_TCP, 1234, 80, 0);
+    g_assert(find_conversation(9, &a, &b, ENDPOINT_TCP, 1234, 80, 0) == conv);
+    g_assert(find_conversation(10, &a, &b, ENDPOINT_TCP, 1234, 80, 0) == conv2);
+    g_assert(find_conversation(3, &a, &b, ENDPOINT_TCP, 1234, 80, 0) == conv);
+}
+
+static void
+conversation_test_exact_ipv6(void)
+{
+    static const guint8 src[16] = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+    static const guint8 dst[16] = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2};
+    static const guint8 dst4[] = {32, 1, 13, 184};
+    address a, b, b4;
+    conversation_t *conv;
+
+    set_address(&a, AT_IPv6, 16, src);
+    set_address(&b, AT_IPv6, 16, dst);
+    set_address(&b4, AT_IPv4, 4, dst4);
+
+    conv = conversation_new(1, &a, &b, ENDPOINT_UDP, 53, 5353, 0);
+    g_assert(find_conversation(1, &a, &b, ENDPOINT_UDP, 53, 5353, 0) == conv);
+    g_assert(find_conversation(1, &b, &a, ENDPOINT_UDP, 5353, 53, 0) == conv);
+    g_assert(find_conversation(1, &a, &b4, ENDPOINT_UDP, 53, 5353, 0) == NULL);
+
+    /* Mixed address families go through the generic hash table. */
+    conv = conversation_new(1, &a, &b4, ENDPOINT_UDP, 53, 5353, 0);
+    g_assert(find_conversation(1, &a, &b4, ENDPOINT_UDP, 53, 5353, 0) == conv);
+}
+
+static void
+conversation_test_set_port2(void)
+{
+    static const guint8 src[] = {10, 1, 0, 1}, dst[] = {10, 1, 0, 2};
+    address a, b;
+    conversation_t *conv;
+
+    set_address(&a, AT_IPv4, 4, src);
+    set_address(&b, AT_IPv4, 4, dst);
+
+    conv = conversation_new(1, &a, &b, ENDPOINT_TCP, 20, 0, NO_PORT2);
+    g_assert(find_conversation(1, &a, &b, ENDPOINT_TCP, 20, 3000, 0) == conv);
+
+    conversation_set_port2(conv, 3000);
+    g_assert(conversation_key_port2(conv->key_ptr) == 3000);
+    g_assert(find_conversation(1, &a, &b, ENDPOINT_TCP, 20, 3000, 0) == conv);
+    g_assert(find_conversation(1, &b, &a, ENDPOINT_TCP, 3000, 20, 0) == conv);
+    g_assert(find_conversation(1, &a, &b, ENDPOINT_TCP, 20, 3001, 0) == NULL);
+}
+
+static void
+conversation_test_many_flows(void)
+{
+    const guint32 count = 200000;
+    conversation_t **convs = g_new(conversation_t *, count);
+    guint32 i, ip_a, ip_b, port_a, port_b;
+    address a, b;
+
+    for (i = 0; i < count; i++) {
+        make_ipv4_flow(i, &ip_a, &ip_b, &port_a, &port_b);
+        set_address(&a, AT_IPv4, 4, &ip_a);
+        set_address(&b, AT_IPv4, 4, &ip_b);
+        convs[i] = conversation_new(i + 1, &a, &b, ENDPOINT_TCP, port_a, port_b, 0);
+    }
+
+    for (i = 0; i < count; i++) {
+        make_ipv4_flow(i, &ip_a, &ip_b, &port_a, &port_b);
+        set_address(&a, AT_IPv4, 4, &ip_a);
+        set_address(&b, AT_IPv4, 4, &ip_b);
+        g_assert(find_conversation(count, &b, &a, ENDPOINT_TCP, port_b, port_a, 0) == convs[i]);
+    }
+
+    g_free(convs);
+}
+
+/* NOTE: You have to run "conversation_test -m perf --verbose" to see results. */
+static void
+conversation_test_lookup_perf(void)
+{
+    const guint32 count = CONV_PERF_FLOWS;
+    guint32 i, n, ip_a, ip_b, port_a, port_b, found = 0;
+    address a, b;
+    gint64 start;
+    double elapsed;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < count; i++) {
+        make_ipv4_flow(i, &ip_a, &ip_b, &port_a, &port_b);
+        set_address(&a, AT_IPv4, 4, &ip_a);
+        set_address(&b, AT_IPv4, 4, &ip_b);
+        conversation_new(i + 1, &a, &b, ENDPOINT_TCP, port_a, port_b, 0);
+    }
+    elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+    g_test_minimized_result(elapsed, "conversation_new, %u flows: %.3f s", count, elapsed);
+
+    /* Look flows up in a scattered order, half of them in the reverse direction. */
+    start = g_get_monotonic_time();
+    for (i = 0, n = 0; i < count; i++, n = (n + 2654435761U) % count) {
+        make_ipv4_flow(n, &ip_a, &ip_b, &port_a, &port_b);
+        set_address(&a, AT_IPv4, 4, &ip_a);
+        set_address(&b, AT_IPv4, 4, &ip_b);
+        if (n & 1) {
+            found += find_conversation(count, &b, &a, ENDPOINT_TCP, port_b, port_a, 0) != NULL;
+        } else {
+            found += find_conversation(count, &a, &b, ENDPOINT_TCP, port_a, port_b, 0) != NULL;
+        }
+    }
+    elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+    g_assert(found == count);
+    g_test_maximized_result(count / elapsed, "find_conversation, %u flows: %.0f lookups/s", count, count / elapsed);
+}
+
+int
+main(int argc, char **argv)
+{
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/conversation/exact/ipv4", conversation_test_exact_ipv4);
+    g_test_add_func("/conversation/exact/ipv6", conversation_test_exact_ipv6);
+    g_test_add_func("/conversation/set_port2",  conversation_test_set_port2);
+    g_test_add_func("/conversation/many_flows", conversation_test_many_flows);
+
+    if (g_test_perf()) {
+        g_test_add_func("/conversation/lookup_perf", conversation_test_lookup_perf);
+    }
+
+    wmem_init();
+    wmem_init_scopes();
+    conversation_init();
+    wmem_enter_file_scope();
+    result = g_test_run();
+    wmem_leave_file_scope();
+    wmem_cleanup_scopes();
+    wmem_cleanup();
+
+    return result;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
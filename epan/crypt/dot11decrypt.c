@@ -121,6 +121,8 @@ static INT Dot11DecryptRsnaPwd2PskStep(
  * It calculates the passphrase-to-PSK mapping reccomanded for use with
  * RSNAs. This implementation uses the PBKDF2 method defined in the RFC
  * 2898.
+ * The result is cached in the context, as the derivation is expensive.
+ * @param ctx [IN] pointer to the current context
  * @param passphrase [IN] pointer to a password (sequence of between 8 and
  * 63 ASCII encoded characters)
  * @param ssid [IN] pointer to the SSID string encoded in max 32 ASCII
@@ -130,6 +132,7 @@ static INT Dot11DecryptRsnaPwd2PskStep(
  * Described in 802.11i-2004, page 165
  */
 static INT Dot11DecryptRsnaPwd2Psk(
+    PDOT11DECRYPT_CONTEXT ctx,
     const CHAR *passphrase,
     const CHAR *ssid,
     const size_t ssidLength,
@@ -188,19 +191,28 @@ static INT Dot11DecryptRsnaMicCheck(
  * @param id [IN] id of the association (composed by BSSID and MAC of
  * the station)
  * @return
- * - index of the Security Association structure if found
- * - -1, if the specified addresses pair BSSID-STA MAC has not been found
+ * - pointer to the Security Association structure if found
+ * - NULL, if the specified addresses pair BSSID-STA MAC has not been found
  */
-static INT Dot11DecryptGetSa(
+static PDOT11DECRYPT_SEC_ASSOCIATION Dot11DecryptGetSa(
     PDOT11DECRYPT_CONTEXT ctx,
     DOT11DECRYPT_SEC_ASSOCIATION_ID *id)
     ;
 
-static INT Dot11DecryptStoreSa(
+static PDOT11DECRYPT_SEC_ASSOCIATION Dot11DecryptStoreSa(
     PDOT11DECRYPT_CONTEXT ctx,
     DOT11DECRYPT_SEC_ASSOCIATION_ID *id)
     ;
 
+static guint Dot11DecryptSaIdHash(
+    gconstpointer key)
+    ;
+
+static gboolean Dot11DecryptSaIdEqual(
+    gconstpointer a,
+    gconstpointer b)
+    ;
+
 static INT Dot11DecryptGetSaAddress(
     const DOT11DECRYPT_MAC_FRAME_ADDR4 *frame,
     DOT11DECRYPT_SEC_ASSOCIATION_ID *id)
@@ -473,17 +485,14 @@ Dot11DecryptGetSaPtr(
     PDOT11DECRYPT_CONTEXT ctx,
     DOT11DECRYPT_SEC_ASSOCIATION_ID *id)
 {
-    int sa_index;
+    PDOT11DECRYPT_SEC_ASSOCIATION sa;
 
     /* search for a cached Security Association for supplied BSSID and STA MAC  */
-    if ((sa_index=Dot11DecryptGetSa(ctx, id))==-1) {
+    if ((sa=Dot11DecryptGetSa(ctx, id))==NULL) {
         /* create a new Security Association if it doesn't currently exist      */
-        if ((sa_index=Dot11DecryptStoreSa(ctx, id))==-1) {
-            return NULL;
-        }
+        sa=Dot11DecryptStoreSa(ctx, id);
     }
-    /* get the Security Association structure   */
-    return &ctx->sa[sa_index];
+    return sa;
 }
 
 static INT Dot11DecryptScanForKeys(
@@ -941,7 +950,7 @@ INT Dot11DecryptSetKeys(
         if (Dot11DecryptValidateKey(keys+i)==TRUE) {
             if (keys[i].KeyType==DOT11DECRYPT_KEY_TYPE_WPA_PWD) {
                 DOT11DECRYPT_DEBUG_PRINT_LINE("Dot11DecryptSetKeys", "Set a WPA-PWD key", DOT11DECRYPT_DEBUG_LEVEL_4);
-                Dot11DecryptRsnaPwd2Psk(keys[i].UserPwd.Passphrase, keys[i].UserPwd.Ssid, keys[i].UserPwd.SsidLen, keys[i].KeyData.Wpa.Psk);
+                Dot11DecryptRsnaPwd2Psk(ctx, keys[i].UserPwd.Passphrase, keys[i].UserPwd.Ssid, keys[i].UserPwd.SsidLen, keys[i].KeyData.Wpa.Psk);
             }
 #ifdef DOT11DECRYPT_DEBUG
             else if (keys[i].KeyType==DOT11DECRYPT_KEY_TYPE_WPA_PMK) {
@@ -994,16 +1003,23 @@ Dot11DecryptRecurseCleanSA(
     }
 }
 
+static void
+Dot11DecryptFreeSa(
+    gpointer data)
+{
+    PDOT11DECRYPT_SEC_ASSOCIATION sa = (PDOT11DECRYPT_SEC_ASSOCIATION)data;
+
+    Dot11DecryptRecurseCleanSA(sa);
+    g_free(sa);
+}
+
 static void
 Dot11DecryptCleanSecAssoc(
     PDOT11DECRYPT_CONTEXT ctx)
 {
-    PDOT11DECRYPT_SEC_ASSOCIATION psa;
-    int i;
-
-    for (psa = ctx->sa, i = 0; i < DOT11DECRYPT_MAX_SEC_ASSOCIATIONS_NR; i++, psa++) {
-        /* To iterate is human, to recurse, divine */
-        Dot11DecryptRecurseCleanSA(psa);
+    if (ctx->sa != NULL) {
+        g_hash_table_destroy(ctx->sa);
+        ctx->sa = NULL;
     }
 }
 
@@ -1069,12 +1085,11 @@ INT Dot11DecryptInitContext(
 
     Dot11DecryptCleanKeys(ctx);
 
-    ctx->first_free_index=0;
-    ctx->index=-1;
-    ctx->sa_index=-1;
     ctx->pkt_ssid_len = 0;
 
-    memset(ctx->sa, 0, DOT11DECRYPT_MAX_SEC_ASSOCIATIONS_NR * sizeof(DOT11DECRYPT_SEC_ASSOCIATION));
+    /* the PSK cache depends on nothing else, so it's kept across resets */
+    Dot11DecryptCleanSecAssoc(ctx);
+    ctx->sa = g_hash_table_new_full(Dot11DecryptSaIdHash, Dot11DecryptSaIdEqual, NULL, Dot11DecryptFreeSa);
 
     DOT11DECRYPT_DEBUG_PRINT_LINE("Dot11DecryptInitContext", "Context initialized!", DOT11DECRYPT_DEBUG_LEVEL_5);
     DOT11DECRYPT_DEBUG_TRACE_END("Dot11DecryptInitContext");
@@ -1095,9 +1110,10 @@ INT Dot11DecryptDestroyContext(
     Dot11DecryptCleanKeys(ctx);
     Dot11DecryptCleanSecAssoc(ctx);
 
-    ctx->first_free_index=0;
-    ctx->index=-1;
-    ctx->sa_index=-1;
+    if (ctx->psk_cache != NULL) {
+        g_hash_table_destroy(ctx->psk_cache);
+        ctx->psk_cache = NULL;
+    }
 
     DOT11DECRYPT_DEBUG_PRINT_LINE("Dot11DecryptDestroyContext", "Context destroyed!", DOT11DECRYPT_DEBUG_LEVEL_5);
     DOT11DECRYPT_DEBUG_TRACE_END("Dot11DecryptDestroyContext");
@@ -1468,7 +1484,7 @@ Dot11DecryptRsna4WHandshake(
                         memcpy(&pkt_key, tmp_key, sizeof(pkt_key));
                         memcpy(&pkt_key.UserPwd.Ssid, ctx->pkt_ssid, ctx->pkt_ssid_len);
                          pkt_key.UserPwd.SsidLen = ctx->pkt_ssid_len;
-                        Dot11DecryptRsnaPwd2Psk(pkt_key.UserPwd.Passphrase, pkt_key.UserPwd.Ssid,
+                        Dot11DecryptRsnaPwd2Psk(ctx, pkt_key.UserPwd.Passphrase, pkt_key.UserPwd.Ssid,
                             pkt_key.UserPwd.SsidLen, pkt_key.KeyData.Wpa.Psk);
                         tmp_pkt_key = &pkt_key;
                     } else {
@@ -1685,77 +1701,62 @@ Dot11DecryptValidateKey(
     return ret;
 }
 
-static INT
+static guint
+Dot11DecryptSaIdHash(
+    gconstpointer key)
+{
+    const UCHAR *id = (const UCHAR *)key;
+    guint hash = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(DOT11DECRYPT_SEC_ASSOCIATION_ID); i++)
+        hash = hash * 31 + id[i];
+    return hash;
+}
+
+static gboolean
+Dot11DecryptSaIdEqual(
+    gconstpointer a,
+    gconstpointer b)
+{
+    return memcmp(a, b, sizeof(DOT11DECRYPT_SEC_ASSOCIATION_ID)) == 0;
+}
+
+static PDOT11DECRYPT_SEC_ASSOCIATION
 Dot11DecryptGetSa(
     PDOT11DECRYPT_CONTEXT ctx,
     DOT11DECRYPT_SEC_ASSOCIATION_ID *id)
 {
-    INT sa_index;
-    if (ctx->sa_index!=-1) {
-        /* at least one association was stored                               */
-        /* search for the association from sa_index to 0 (most recent added) */
-        for (sa_index=ctx->sa_index; sa_index>=0; sa_index--) {
-            if (ctx->sa[sa_index].used) {
-                if (memcmp(id, &(ctx->sa[sa_index].saId), sizeof(DOT11DECRYPT_SEC_ASSOCIATION_ID))==0) {
-                    ctx->index=sa_index;
-                    return sa_index;
-                }
-            }
-        }
-    }
+    if (ctx->sa == NULL)
+        return NULL;
 
-    return -1;
+    return (PDOT11DECRYPT_SEC_ASSOCIATION)g_hash_table_lookup(ctx->sa, id);
 }
 
-static INT
+static PDOT11DECRYPT_SEC_ASSOCIATION
 Dot11DecryptStoreSa(
     PDOT11DECRYPT_CONTEXT ctx,
     DOT11DECRYPT_SEC_ASSOCIATION_ID *id)
 {
-    INT last_free;
-    if (ctx->first_free_index>=DOT11DECRYPT_MAX_SEC_ASSOCIATIONS_NR) {
-        /* there is no empty space available. FAILURE */
-        return -1;
-    }
-    if (ctx->sa[ctx->first_free_index].used) {
-        /* last addition was in the middle of the array (and the first_free_index was just incremented by 1)   */
-        /* search for a free space from the first_free_index to DOT11DECRYPT_STA_INFOS_NR (to avoid free blocks in */
-        /*              the middle)                                                                            */
-        for (last_free=ctx->first_free_index; last_free<DOT11DECRYPT_MAX_SEC_ASSOCIATIONS_NR; last_free++)
-            if (!ctx->sa[last_free].used)
-                break;
-
-        if (last_free>=DOT11DECRYPT_MAX_SEC_ASSOCIATIONS_NR) {
-            /* there is no empty space available. FAILURE */
-            return -1;
-        }
+    PDOT11DECRYPT_SEC_ASSOCIATION sa;
 
-        /* store first free space index */
-        ctx->first_free_index=last_free;
+    if (ctx->sa == NULL) {
+        /* the context hasn't been initialized. FAILURE */
+        return NULL;
     }
 
-    /* use this info */
-    ctx->index=ctx->first_free_index;
-
-    /* reset the info structure */
-    memset(ctx->sa+ctx->index, 0, sizeof(DOT11DECRYPT_SEC_ASSOCIATION));
-
-    ctx->sa[ctx->index].used=1;
+    sa = g_new0(DOT11DECRYPT_SEC_ASSOCIATION, 1);
+    sa->used=1;
 
     /* set the info structure */
-    memcpy(&(ctx->sa[ctx->index].saId), id, sizeof(DOT11DECRYPT_SEC_ASSOCIATION_ID));
-
-    /* increment by 1 the first_free_index (heuristic) */
-    ctx->first_free_index++;
+    memcpy(&(sa->saId), id, sizeof(DOT11DECRYPT_SEC_ASSOCIATION_ID));
 
-    /* set the sa_index if the added index is greater the the sa_index */
-    if (ctx->index > ctx->sa_index)
-        ctx->sa_index=ctx->index;
+    /* the key is the saId in the structure itself, which never changes */
+    g_hash_table_insert(ctx->sa, &(sa->saId), sa);
 
-    return ctx->index;
+    return sa;
 }
 
-
 static INT
 Dot11DecryptGetSaAddress(
     const DOT11DECRYPT_MAC_FRAME_ADDR4 *frame,
@@ -1973,16 +1974,35 @@ Dot11DecryptRsnaPwd2PskStep(
 
 static INT
 Dot11DecryptRsnaPwd2Psk(
+    PDOT11DECRYPT_CONTEXT ctx,
     const CHAR *passphrase,
     const CHAR *ssid,
     const size_t ssidLength,
     UCHAR *output)
 {
     UCHAR m_output[40] = { 0 };
-    GByteArray *pp_ba = g_byte_array_new();
+    GByteArray *pp_ba;
+    GByteArray *cache_ba;
+    GBytes *cache_key;
+    const UCHAR *cached;
+
+    /* the cache key is the passphrase, including its NUL, then the SSID */
+    cache_ba = g_byte_array_new();
+    g_byte_array_append(cache_ba, (const guint8 *)passphrase, (guint)strlen(passphrase) + 1);
+    g_byte_array_append(cache_ba, (const guint8 *)ssid, (guint)ssidLength);
+    cache_key = g_byte_array_free_to_bytes(cache_ba);
+
+    if (ctx->psk_cache != NULL &&
+        (cached = (const UCHAR *)g_hash_table_lookup(ctx->psk_cache, cache_key)) != NULL) {
+        memcpy(output, cached, DOT11DECRYPT_WPA_PSK_LEN);
+        g_bytes_unref(cache_key);
+        return 0;
+    }
 
+    pp_ba = g_byte_array_new();
     if (!uri_str_to_bytes(passphrase, pp_ba)) {
         g_byte_array_free(pp_ba, TRUE);
+        g_bytes_unref(cache_key);
         return 0;
     }
 
@@ -1992,6 +2012,14 @@ Dot11DecryptRsnaPwd2Psk(
     memcpy(output, m_output, DOT11DECRYPT_WPA_PSK_LEN);
     g_byte_array_free(pp_ba, TRUE);
 
+    if (ctx->psk_cache == NULL) {
+        ctx->psk_cache = g_hash_table_new_full(g_bytes_hash, g_bytes_equal,
+            (GDestroyNotify)g_bytes_unref, g_free);
+    } else if (g_hash_table_size(ctx->psk_cache) >= DOT11DECRYPT_MAX_PSK_CACHE_NR) {
+        g_hash_table_remove_all(ctx->psk_cache);
+    }
+    g_hash_table_insert(ctx->psk_cache, cache_key, g_memdup(m_output, DOT11DECRYPT_WPA_PSK_LEN));
+
     return 0;
 }
 
@@ -32,7 +32,7 @@
 #define	DOT11DECRYPT_RET_SUCCESS_HANDSHAKE  	 -1
 
 #define	DOT11DECRYPT_MAX_KEYS_NR	        	 64
-#define	DOT11DECRYPT_MAX_SEC_ASSOCIATIONS_NR	256
+#define	DOT11DECRYPT_MAX_PSK_CACHE_NR		256
 
 /*	Decryption algorithms fields size definition (bytes)		*/
 #define	DOT11DECRYPT_WPA_NONCE_LEN		         32
@@ -127,16 +127,17 @@ typedef struct _DOT11DECRYPT_SEC_ASSOCIATION {
 } DOT11DECRYPT_SEC_ASSOCIATION, *PDOT11DECRYPT_SEC_ASSOCIATION;
 
 typedef struct _DOT11DECRYPT_CONTEXT {
-	DOT11DECRYPT_SEC_ASSOCIATION sa[DOT11DECRYPT_MAX_SEC_ASSOCIATIONS_NR];
-	INT sa_index;
+	/* Security associations, keyed by their saId (BSSID and STA) */
+	GHashTable *sa;
 	DOT11DECRYPT_KEY_ITEM keys[DOT11DECRYPT_MAX_KEYS_NR];
 	size_t keys_nr;
 
         CHAR pkt_ssid[DOT11DECRYPT_WPA_SSID_MAX_LEN];
         size_t pkt_ssid_len;
 
-	INT index;
-	INT first_free_index;
+	/* PSKs derived from passphrases, keyed by passphrase and SSID, as
+	 * the derivation is expensive; at most DOT11DECRYPT_MAX_PSK_CACHE_NR */
+	GHashTable *psk_cache;
 } DOT11DECRYPT_CONTEXT, *PDOT11DECRYPT_CONTEXT;
 
 /************************************************************************/
@@ -24,6 +24,8 @@ struct epan_dfilter {
 	GList		**registers;
 	gboolean	*attempted_load;
 	gboolean	*owns_memory;
+	guint		*loaded_registers;	/* registers set in the current run */
+	guint		num_loaded_registers;
 	int		*interesting_fields;
 	int		num_interesting_fields;
 	GPtrArray	*deprecated;
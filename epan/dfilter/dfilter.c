@@ -150,6 +150,7 @@ dfilter_free(dfilter_t *df)
 	g_free(df->registers);
 	g_free(df->attempted_load);
 	g_free(df->owns_memory);
+	g_free(df->loaded_registers);
 	g_free(df);
 }
 
@@ -351,6 +352,8 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 		dfilter->registers = g_new0(GList*, dfilter->max_registers);
 		dfilter->attempted_load = g_new0(gboolean, dfilter->max_registers);
 		dfilter->owns_memory = g_new0(gboolean, dfilter->max_registers);
+		dfilter->loaded_registers = g_new(guint, dfilter->num_registers);
+		dfilter->num_loaded_registers = 0;
 
 		/* Initialize constants */
 		dfvm_init_const(dfilter);
@@ -12,6 +12,312 @@
 
 #include <ftypes/ftypes-int.h>
 
+/*
+ * Sets for the "in" operator.
+ *
+ * Every element is kept as the original (lower, upper) fvalue pair, so
+ * that any value can still be compared against the elements one by one.
+ * In addition, elements whose ftype allows it are indexed, so that most
+ * lookups don't have to look at every element:
+ *
+ *  - integers and IPv4 addresses (including CIDR blocks, and ranges
+ *    whose bounds are plain addresses) become a sorted array of
+ *    non-overlapping intervals, searched with a binary search;
+ *
+ *  - strings become a hash table.
+ *
+ * Elements that can't be indexed (ranges of strings, for example) are
+ * checked one by one after the index lookup fails.
+ */
+typedef enum {
+	SET_KEY_NONE,
+	SET_KEY_UNSIGNED,	/* uinteger */
+	SET_KEY_SIGNED,		/* sinteger */
+	SET_KEY_UNSIGNED64,	/* uinteger64 */
+	SET_KEY_SIGNED64,	/* sinteger64 */
+	SET_KEY_IPV4,		/* ipv4 */
+	SET_KEY_STRING		/* string */
+} set_key_kind_t;
+
+typedef struct {
+	guint64	lower;
+	guint64	upper;
+} set_interval_t;
+
+struct _dfvm_set {
+	set_key_kind_t	kind;
+	GPtrArray	*elements;	/* (lower, upper) pairs, upper may be NULL */
+	GPtrArray	*unindexed;	/* pairs that aren't in the index */
+	GArray		*intervals;	/* set_interval_t, sorted by lower bound */
+	GHashTable	*strings;
+};
+
+static set_key_kind_t
+set_key_kind(ftenum_t ftype)
+{
+	switch (ftype) {
+		case FT_CHAR:
+		case FT_UINT8:
+		case FT_UINT16:
+		case FT_UINT24:
+		case FT_UINT32:
+		case FT_FRAMENUM:
+		case FT_IPXNET:
+			return SET_KEY_UNSIGNED;
+		case FT_INT8:
+		case FT_INT16:
+		case FT_INT24:
+		case FT_INT32:
+			return SET_KEY_SIGNED;
+		case FT_UINT40:
+		case FT_UINT48:
+		case FT_UINT56:
+		case FT_UINT64:
+		case FT_EUI64:
+			return SET_KEY_UNSIGNED64;
+		case FT_INT40:
+		case FT_INT48:
+		case FT_INT56:
+		case FT_INT64:
+			return SET_KEY_SIGNED64;
+		case FT_IPv4:
+			return SET_KEY_IPV4;
+		case FT_STRING:
+		case FT_STRINGZ:
+		case FT_UINT_STRING:
+		case FT_STRINGZPAD:
+			return SET_KEY_STRING;
+		default:
+			return SET_KEY_NONE;
+	}
+}
+
+/* Flipping the sign bit maps signed values onto unsigned ones in the
+ * same order. */
+#define SIGNED_KEY(v)	((guint64)(gint64)(v) ^ G_GUINT64_CONSTANT(0x8000000000000000))
+
+/* Gets the interval of keys matched by a value; FALSE if the value
+ * can't be looked up in the interval index. */
+static gboolean
+set_key_interval(set_key_kind_t kind, fvalue_t *fv, guint64 *lower, guint64 *upper)
+{
+	if (set_key_kind(fvalue_type_ftenum(fv)) != kind)
+		return FALSE;
+
+	switch (kind) {
+		case SET_KEY_UNSIGNED:
+			*lower = *upper = fv->value.uinteger;
+			return TRUE;
+		case SET_KEY_SIGNED:
+			*lower = *upper = SIGNED_KEY(fv->value.sinteger);
+			return TRUE;
+		case SET_KEY_UNSIGNED64:
+			*lower = *upper = fv->value.uinteger64;
+			return TRUE;
+		case SET_KEY_SIGNED64:
+			*lower = *upper = SIGNED_KEY(fv->value.sinteger64);
+			return TRUE;
+		case SET_KEY_IPV4:
+			/* A CIDR block is equal to every address in it. */
+			*lower = fv->value.ipv4.addr & fv->value.ipv4.nmask;
+			*upper = *lower | (~fv->value.ipv4.nmask & 0xffffffff);
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+gboolean
+dfvm_set_supports_ftype(ftenum_t ftype)
+{
+	return set_key_kind(ftype) != SET_KEY_NONE;
+}
+
+dfvm_set_t*
+dfvm_set_new(ftenum_t ftype)
+{
+	dfvm_set_t	*set;
+
+	set = g_new0(dfvm_set_t, 1);
+	set->kind = set_key_kind(ftype);
+	set->elements = g_ptr_array_new();
+	set->unindexed = g_ptr_array_new();
+	if (set->kind == SET_KEY_STRING)
+		set->strings = g_hash_table_new(g_str_hash, g_str_equal);
+	else
+		set->intervals = g_array_new(FALSE, FALSE, sizeof(set_interval_t));
+	return set;
+}
+
+void
+dfvm_set_add(dfvm_set_t *set, fvalue_t *lower, fvalue_t *upper)
+{
+	set_interval_t	iv;
+	guint64		dummy;
+	gboolean	indexed = FALSE;
+
+	g_ptr_array_add(set->elements, lower);
+	g_ptr_array_add(set->elements, upper);
+
+	if (set->kind == SET_KEY_STRING) {
+		if (!upper && set_key_kind(fvalue_type_ftenum(lower)) == SET_KEY_STRING) {
+			g_hash_table_insert(set->strings, lower->value.string, lower);
+			indexed = TRUE;
+		}
+	}
+	else if (!upper) {
+		indexed = set_key_interval(set->kind, lower, &iv.lower, &iv.upper);
+		if (indexed)
+			g_array_append_val(set->intervals, iv);
+	}
+	else if (set->kind != SET_KEY_IPV4 ||
+	    (lower->value.ipv4.nmask == 0xffffffff && upper->value.ipv4.nmask == 0xffffffff)) {
+		/* Range bounds on masked IPv4 addresses are compared with
+		 * the mask applied, so only plain addresses can be indexed. */
+		indexed = set_key_interval(set->kind, lower, &iv.lower, &dummy) &&
+			set_key_interval(set->kind, upper, &dummy, &iv.upper);
+		if (indexed && iv.lower <= iv.upper)
+			g_array_append_val(set->intervals, iv);
+	}
+
+	if (!indexed) {
+		g_ptr_array_add(set->unindexed, lower);
+		g_ptr_array_add(set->unindexed, upper);
+	}
+}
+
+static gint
+set_interval_cmp(gconstpointer a, gconstpointer b)
+{
+	const set_interval_t *iv_a = (const set_interval_t *)a;
+	const set_interval_t *iv_b = (const set_interval_t *)b;
+
+	if (iv_a->lower < iv_b->lower)
+		return -1;
+	return iv_a->lower > iv_b->lower;
+}
+
+void
+dfvm_set_finish(dfvm_set_t *set)
+{
+	set_interval_t	*iv, *last;
+	guint		i, n;
+
+	if (!set->intervals || set->intervals->len == 0)
+		return;
+
+	/* Sort, then merge overlapping and adjacent intervals. */
+	g_array_sort(set->intervals, set_interval_cmp);
+	iv = (set_interval_t *)(void *)set->intervals->data;
+	last = &iv[0];
+	n = 1;
+	for (i = 1; i < set->intervals->len; i++) {
+		if (last->upper == G_MAXUINT64 || iv[i].lower <= last->upper + 1) {
+			if (iv[i].upper > last->upper)
+				last->upper = iv[i].upper;
+		}
+		else {
+			last = &iv[n++];
+			*last = iv[i];
+		}
+	}
+	g_array_set_size(set->intervals, n);
+}
+
+static void
+dfvm_set_free(dfvm_set_t *set)
+{
+	guint	i;
+
+	for (i = 0; i < set->elements->len; i++) {
+		fvalue_t *fv = (fvalue_t *)g_ptr_array_index(set->elements, i);
+		if (fv) {
+			FVALUE_FREE(fv);
+		}
+	}
+	g_ptr_array_free(set->elements, TRUE);
+	g_ptr_array_free(set->unindexed, TRUE);
+	if (set->intervals)
+		g_array_free(set->intervals, TRUE);
+	if (set->strings)
+		g_hash_table_destroy(set->strings);
+	g_free(set);
+}
+
+/* Compares a value with each of a list of (lower, upper) pairs. */
+static gboolean
+set_elements_match(GPtrArray *elements, fvalue_t *fv)
+{
+	guint		i;
+	fvalue_t	*lower, *upper;
+
+	for (i = 0; i < elements->len; i += 2) {
+		lower = (fvalue_t *)g_ptr_array_index(elements, i);
+		upper = (fvalue_t *)g_ptr_array_index(elements, i + 1);
+		if (upper) {
+			if (fvalue_ge(fv, lower) && fvalue_le(fv, upper))
+				return TRUE;
+		}
+		else if (fvalue_eq(fv, lower)) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static gboolean
+set_contains(dfvm_set_t *set, fvalue_t *fv)
+{
+	set_interval_t	*iv;
+	guint64		key, dummy;
+	guint		lo, hi, mid;
+
+	if (set->strings) {
+		if (set_key_kind(fvalue_type_ftenum(fv)) != SET_KEY_STRING)
+			return set_elements_match(set->elements, fv);
+		if (g_hash_table_lookup(set->strings, fv->value.string))
+			return TRUE;
+		return set_elements_match(set->unindexed, fv);
+	}
+
+	/* Only plain addresses can be looked up; a masked address in the
+	 * tree is equal to any address in its block. */
+	if ((set->kind == SET_KEY_IPV4 && fvalue_type_ftenum(fv) == FT_IPv4 &&
+	     fv->value.ipv4.nmask != 0xffffffff) ||
+	    !set_key_interval(set->kind, fv, &key, &dummy))
+		return set_elements_match(set->elements, fv);
+
+	/* Find the last interval starting at or before the key. */
+	iv = (set_interval_t *)(void *)set->intervals->data;
+	lo = 0;
+	hi = set->intervals->len;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (iv[mid].lower <= key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo > 0 && key <= iv[lo - 1].upper)
+		return TRUE;
+
+	return set_elements_match(set->unindexed, fv);
+}
+
+static gboolean
+any_in_set(dfilter_t *df, int reg, dfvm_set_t *set)
+{
+	GList	*list = df->registers[reg];
+
+	while (list) {
+		if (set_contains(set, (fvalue_t *)list->data)) {
+			return TRUE;
+		}
+		list = g_list_next(list);
+	}
+	return FALSE;
+}
+
 dfvm_insn_t*
 dfvm_insn_new(dfvm_opcode_t op)
 {
@@ -36,6 +342,9 @@ dfvm_value_free(dfvm_value_t *v)
 		case DRANGE:
 			drange_free(v->value.drange);
 			break;
+		case FVALUE_SET:
+			dfvm_set_free(v->value.set);
+			break;
 		default:
 			/* nothing */
 			;
@@ -119,6 +428,7 @@ dfvm_dump(FILE *f, dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case ANY_IN_SET:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
@@ -259,6 +569,22 @@ dfvm_dump(FILE *f, dfilter_t *df)
 					arg3->value.numeric);
 				break;
 
+			case ANY_IN_SET:
+				fprintf(f, "%05d ANY_IN_SET\treg#%u in set of %u elements",
+					id, arg1->value.numeric,
+					arg2->value.set->elements->len / 2);
+				if (arg2->value.set->strings) {
+					fprintf(f, " (%u hashed",
+						g_hash_table_size(arg2->value.set->strings));
+				}
+				else {
+					fprintf(f, " (%u intervals",
+						arg2->value.set->intervals->len);
+				}
+				fprintf(f, ", %u unindexed)\n",
+					arg2->value.set->unindexed->len / 2);
+				break;
+
 			case NOT:
 				fprintf(f, "%05d NOT\n", id);
 				break;
@@ -284,6 +610,16 @@ dfvm_dump(FILE *f, dfilter_t *df)
 	}
 }
 
+/* Remember that a (non-constant) register has been set in this run of
+ * the dfilter, so that free_register_overhead only has to clear the
+ * registers that were actually used, rather than every register.
+ * Each register is set at most once per run. */
+static inline void
+mark_register_loaded(dfilter_t *df, int reg)
+{
+	df->loaded_registers[df->num_loaded_registers++] = reg;
+}
+
 /* Reads a field from the proto_tree and loads the fvalues into a register,
  * if that field has not already been read. */
 static gboolean
@@ -306,6 +642,7 @@ read_tree(dfilter_t *df, proto_tree *tree, header_field_info *hfinfo, int reg)
 	}
 
 	df->attempted_load[reg] = TRUE;
+	mark_register_loaded(df, reg);
 
 	while (hfinfo) {
 		finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
@@ -413,19 +750,21 @@ free_owned_register(gpointer data, gpointer user_data _U_)
 static void
 free_register_overhead(dfilter_t* df)
 {
-	guint i;
-
-	for (i = 0; i < df->num_registers; i++) {
-		df->attempted_load[i] = FALSE;
-		if (df->registers[i]) {
-			if (df->owns_memory[i]) {
-				g_list_foreach(df->registers[i], free_owned_register, NULL);
-				df->owns_memory[i] = FALSE;
+	guint i, reg;
+
+	for (i = 0; i < df->num_loaded_registers; i++) {
+		reg = df->loaded_registers[i];
+		df->attempted_load[reg] = FALSE;
+		if (df->registers[reg]) {
+			if (df->owns_memory[reg]) {
+				g_list_foreach(df->registers[reg], free_owned_register, NULL);
+				df->owns_memory[reg] = FALSE;
 			}
-			g_list_free(df->registers[i]);
-			df->registers[i] = NULL;
+			g_list_free(df->registers[reg]);
+			df->registers[reg] = NULL;
 		}
 	}
+	df->num_loaded_registers = 0;
 }
 
 /* Takes the list of fvalue_t's in a register, uses fvalue_slice()
@@ -454,6 +793,7 @@ mk_range(dfilter_t *df, int from_reg, int to_reg, drange_t *d_range)
 
 	df->registers[to_reg] = to_list;
 	df->owns_memory[to_reg] = TRUE;
+	mark_register_loaded(df, to_reg);
 }
 
 
@@ -474,6 +814,11 @@ dfvm_apply(dfilter_t *df, proto_tree *tree)
 
 	g_assert(tree);
 
+	/* Clean up after a previous run that didn't get to RETURN. */
+	if (df->num_loaded_registers > 0) {
+		free_register_overhead(df);
+	}
+
 	length = df->insns->len;
 
 	for (id = 0; id < length; id++) {
@@ -518,6 +863,7 @@ dfvm_apply(dfilter_t *df, proto_tree *tree)
 						&df->registers[arg2->value.numeric]);
 				// functions create a new value, so own it.
 				df->owns_memory[arg2->value.numeric] = TRUE;
+				mark_register_loaded(df, arg2->value.numeric);
 				break;
 
 			case MK_RANGE:
@@ -579,6 +925,11 @@ dfvm_apply(dfilter_t *df, proto_tree *tree)
 						arg3->value.numeric);
 				break;
 
+			case ANY_IN_SET:
+				accum = any_in_set(df, arg1->value.numeric,
+						arg2->value.set);
+				break;
+
 			case NOT:
 				accum = !accum;
 				break;
@@ -654,6 +1005,7 @@ dfvm_init_const(dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case ANY_IN_SET:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
@@ -23,9 +23,13 @@ typedef enum {
 	REGISTER,
 	INTEGER,
 	DRANGE,
-	FUNCTION_DEF
+	FUNCTION_DEF,
+	FVALUE_SET
 } dfvm_value_type_t;
 
+/* A set of constant values and value ranges, for the "in" operator. */
+typedef struct _dfvm_set dfvm_set_t;
+
 typedef struct {
 	dfvm_value_type_t	type;
 
@@ -35,6 +39,7 @@ typedef struct {
 		drange_t		*drange;
 		header_field_info	*hfinfo;
         df_func_def_t   *funcdef;
+		dfvm_set_t		*set;
 	} value;
 
 } dfvm_value_t;
@@ -60,7 +65,8 @@ typedef enum {
 	ANY_MATCHES,
 	MK_RANGE,
 	CALL_FUNCTION,
-	ANY_IN_RANGE
+	ANY_IN_RANGE,
+	ANY_IN_SET
 
 } dfvm_opcode_t;
 
@@ -82,6 +88,23 @@ dfvm_insn_free(dfvm_insn_t *insn);
 dfvm_value_t*
 dfvm_value_new(dfvm_value_type_t type);
 
+/* Returns TRUE if values of this type can be looked up in a dfvm_set_t
+ * faster than by comparing them with each element in turn. */
+gboolean
+dfvm_set_supports_ftype(ftenum_t ftype);
+
+dfvm_set_t*
+dfvm_set_new(ftenum_t ftype);
+
+/* Adds an element to the set; upper is NULL unless the element is a
+ * range.  The set takes ownership of the fvalues. */
+void
+dfvm_set_add(dfvm_set_t *set, fvalue_t *lower, fvalue_t *upper);
+
+/* Builds the lookup structures once all elements have been added. */
+void
+dfvm_set_finish(dfvm_set_t *set);
+
 void
 dfvm_dump(FILE *f, dfilter_t *df);
 
@@ -287,6 +287,84 @@ fixup_jumps(gpointer data, gpointer user_data)
 	}
 }
 
+/* Returns TRUE if a set on the RHS of the in operator can be compiled
+ * into a single ANY_IN_SET instruction: the LHS has to be a field whose
+ * values can be indexed, and all the elements have to be constants. */
+static gboolean
+can_gen_relation_in_set(stnode_t *st_arg1, stnode_t *st_arg2)
+{
+	header_field_info	*hfinfo;
+	GSList			*nodelist;
+
+	if (stnode_type_id(st_arg1) != STTYPE_FIELD)
+		return FALSE;
+
+	/* All the fields with this name have to be indexable. */
+	hfinfo = (header_field_info*)stnode_data(st_arg1);
+	while (hfinfo->same_name_prev_id != -1) {
+		hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+	}
+	for (; hfinfo; hfinfo = hfinfo->same_name_next) {
+		if (!dfvm_set_supports_ftype(hfinfo->type))
+			return FALSE;
+	}
+
+	for (nodelist = (GSList*)stnode_data(st_arg2); nodelist; nodelist = g_slist_next(nodelist)) {
+		if (nodelist->data && stnode_type_id((stnode_t*)nodelist->data) != STTYPE_FVALUE)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Generate the code for the in operator with a set of constants, as
+ * a lookup in a precompiled set rather than a comparison per element. */
+static void
+gen_relation_in_set(dfwork_t *dfw, stnode_t *st_arg1, stnode_t *st_arg2)
+{
+	dfvm_insn_t	*insn;
+	dfvm_value_t	*val1, *val2;
+	dfvm_value_t	*jmp1 = NULL;
+	int		reg1;
+	stnode_t	*node1, *node2;
+	GSList		*nodelist;
+	dfvm_set_t	*set;
+
+	/* Create code for the LHS of the relation */
+	reg1 = gen_entity(dfw, st_arg1, &jmp1);
+
+	/* The set takes over the constants on the RHS. */
+	set = dfvm_set_new(((header_field_info*)stnode_data(st_arg1))->type);
+	nodelist = (GSList*)stnode_data(st_arg2);
+	while (nodelist) {
+		node1 = (stnode_t*)nodelist->data;
+		nodelist = g_slist_next(nodelist);
+		node2 = (stnode_t*)nodelist->data;
+		nodelist = g_slist_next(nodelist);
+
+		dfvm_set_add(set, (fvalue_t *)stnode_data(node1),
+			node2 ? (fvalue_t *)stnode_data(node2) : NULL);
+	}
+	dfvm_set_finish(set);
+
+	insn = dfvm_insn_new(ANY_IN_SET);
+	val1 = dfvm_value_new(REGISTER);
+	val1->value.numeric = reg1;
+	val2 = dfvm_value_new(FVALUE_SET);
+	val2->value.set = set;
+	insn->arg1 = val1;
+	insn->arg2 = val2;
+	dfw_append_insn(dfw, insn);
+
+	/* Jump here if the LHS entity was not present */
+	if (jmp1) {
+		jmp1->value.numeric = dfw->next_insn_id;
+	}
+
+	/* Clean up */
+	nodelist = (GSList*)stnode_data(st_arg2);
+	set_nodelist_free(nodelist);
+}
+
 /* Generate the code for the in operator.  It behaves much like an OR-ed
  * series of == tests, but without the redundant existence checks. */
 static void
@@ -300,6 +378,11 @@ gen_relation_in(dfwork_t *dfw, stnode_t *st_arg1, stnode_t *st_arg2)
 	GSList		*nodelist;
 	GSList		*jumplist = NULL;
 
+	if (can_gen_relation_in_set(st_arg1, st_arg2)) {
+		gen_relation_in_set(dfw, st_arg1, st_arg2);
+		return;
+	}
+
 	/* Create code for the LHS of the relation */
 	reg1 = gen_entity(dfw, st_arg1, &jmp1);
 
@@ -521,6 +604,188 @@ gen_test(dfwork_t *dfw, stnode_t *st_node)
 	}
 }
 
+/* Collects the "field == constant" tests of an "or" tree, if all of its
+ * leaves are such tests for the same field. */
+static gboolean
+collect_eq_chain(stnode_t *st_node, header_field_info **p_hfinfo, GSList **p_leaves)
+{
+	test_op_t		st_op;
+	stnode_t		*st_arg1, *st_arg2, *st_field;
+	header_field_info	*hfinfo;
+
+	sttype_test_get(st_node, &st_op, &st_arg1, &st_arg2);
+
+	if (st_op == TEST_OP_OR) {
+		return collect_eq_chain(st_arg1, p_hfinfo, p_leaves) &&
+			collect_eq_chain(st_arg2, p_hfinfo, p_leaves);
+	}
+	if (st_op != TEST_OP_EQ)
+		return FALSE;
+
+	if (stnode_type_id(st_arg1) == STTYPE_FIELD && stnode_type_id(st_arg2) == STTYPE_FVALUE)
+		st_field = st_arg1;
+	else if (stnode_type_id(st_arg1) == STTYPE_FVALUE && stnode_type_id(st_arg2) == STTYPE_FIELD)
+		st_field = st_arg2;
+	else
+		return FALSE;
+
+	hfinfo = (header_field_info*)stnode_data(st_field);
+	while (hfinfo->same_name_prev_id != -1) {
+		hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+	}
+	if (*p_hfinfo == NULL)
+		*p_hfinfo = hfinfo;
+	else if (*p_hfinfo != hfinfo)
+		return FALSE;
+
+	*p_leaves = g_slist_prepend(*p_leaves, st_node);
+	return TRUE;
+}
+
+/* "f == a || f == b || ..." is the same test as "f in {a b ...}", and
+ * the latter can be compiled into a single set lookup, so rewrite "or"
+ * trees of equality tests on one field into set membership tests. */
+static void
+fold_eq_chains(stnode_t *st_node)
+{
+	test_op_t		st_op;
+	stnode_t		*st_arg1, *st_arg2, *st_field = NULL;
+	stnode_t		*leaf_arg1, *leaf_arg2;
+	header_field_info	*hfinfo = NULL;
+	GSList			*leaves = NULL, *leaf, *nodelist = NULL;
+
+	sttype_test_get(st_node, &st_op, &st_arg1, &st_arg2);
+
+	switch (st_op) {
+		case TEST_OP_NOT:
+			fold_eq_chains(st_arg1);
+			return;
+		case TEST_OP_AND:
+			fold_eq_chains(st_arg1);
+			fold_eq_chains(st_arg2);
+			return;
+		case TEST_OP_OR:
+			break;
+		default:
+			return;
+	}
+
+	if (!collect_eq_chain(st_node, &hfinfo, &leaves) ||
+	    !dfvm_set_supports_ftype(hfinfo->type)) {
+		g_slist_free(leaves);
+		fold_eq_chains(st_arg1);
+		fold_eq_chains(st_arg2);
+		return;
+	}
+
+	/* The leaves were collected in reverse order, so prepending
+	 * (value, NULL) pairs builds the set in the original order.
+	 * Take the operands away from the tests, so that freeing the
+	 * "or" tree leaves them alone. */
+	for (leaf = leaves; leaf; leaf = g_slist_next(leaf)) {
+		sttype_test_get((stnode_t*)leaf->data, &st_op, &leaf_arg1, &leaf_arg2);
+		sttype_test_set2_args((stnode_t*)leaf->data, NULL, NULL);
+		if (stnode_type_id(leaf_arg1) == STTYPE_FIELD) {
+			nodelist = g_slist_prepend(nodelist, NULL);
+			nodelist = g_slist_prepend(nodelist, leaf_arg2);
+			if (st_field)
+				stnode_free(st_field);
+			st_field = leaf_arg1;
+		}
+		else {
+			nodelist = g_slist_prepend(nodelist, NULL);
+			nodelist = g_slist_prepend(nodelist, leaf_arg1);
+			if (st_field)
+				stnode_free(st_field);
+			st_field = leaf_arg2;
+		}
+	}
+	g_slist_free(leaves);
+
+	stnode_free(st_arg1);
+	stnode_free(st_arg2);
+	sttype_test_set2(st_node, TEST_OP_IN, st_field,
+		stnode_new(STTYPE_SET, nodelist));
+}
+
+/* Rough relative cost of loading an entity into a register. */
+static int
+entity_cost(stnode_t *st_arg)
+{
+	GSList	*params;
+	int	cost;
+
+	switch (stnode_type_id(st_arg)) {
+		case STTYPE_FIELD:
+			/* READ_TREE, which is cached per run */
+			return 2;
+		case STTYPE_RANGE:
+			return entity_cost(sttype_range_entity(st_arg)) + 2;
+		case STTYPE_FUNCTION:
+			cost = 4;
+			for (params = sttype_function_params(st_arg); params; params = params->next) {
+				cost += entity_cost((stnode_t *)params->data);
+			}
+			return cost;
+		default:
+			/* Constants are loaded once, when the filter is compiled. */
+			return 0;
+	}
+}
+
+/* Rough relative cost of evaluating a test other than "not", "and"
+ * and "or". */
+static int
+test_cost(test_op_t st_op, stnode_t *st_arg1, stnode_t *st_arg2)
+{
+	switch (st_op) {
+		case TEST_OP_EXISTS:
+			return 1;
+		case TEST_OP_CONTAINS:
+			return entity_cost(st_arg1) + entity_cost(st_arg2) + 4;
+		case TEST_OP_MATCHES:
+			return entity_cost(st_arg1) + entity_cost(st_arg2) + 16;
+		case TEST_OP_IN:
+			/* A single lookup for an indexed set, otherwise one
+			 * comparison per (lower, upper) pair in the set. */
+			if (can_gen_relation_in_set(st_arg1, st_arg2))
+				return entity_cost(st_arg1) + 2;
+			return entity_cost(st_arg1) +
+				g_slist_length((GSList*)stnode_data(st_arg2)) / 2;
+		default:
+			return entity_cost(st_arg1) + entity_cost(st_arg2) + 1;
+	}
+}
+
+/* Tests have no side effects, so the operands of "and" and "or" can be
+ * evaluated in either order.  Put the cheaper one first, so that the
+ * more expensive one is skipped whenever the cheaper one decides the
+ * result.  Returns the estimated cost of the test. */
+static int
+optimize(stnode_t *st_node)
+{
+	test_op_t	st_op;
+	stnode_t	*st_arg1, *st_arg2;
+	int		cost1, cost2;
+
+	sttype_test_get(st_node, &st_op, &st_arg1, &st_arg2);
+
+	switch (st_op) {
+		case TEST_OP_NOT:
+			return optimize(st_arg1) + 1;
+		case TEST_OP_AND:
+		case TEST_OP_OR:
+			cost1 = optimize(st_arg1);
+			cost2 = optimize(st_arg2);
+			if (cost2 < cost1) {
+				sttype_test_set2_args(st_node, st_arg2, st_arg1);
+			}
+			return cost1 + cost2;
+		default:
+			return test_cost(st_op, st_arg1, st_arg2);
+	}
+}
+
 static void
 gencode(dfwork_t *dfw, stnode_t *st_node)
 {
@@ -549,6 +814,10 @@ dfw_gencode(dfwork_t *dfw)
 	dfw->consts = g_ptr_array_new();
 	dfw->loaded_fields = g_hash_table_new(g_direct_hash, g_direct_equal);
 	dfw->interesting_fields = g_hash_table_new(g_direct_hash, g_direct_equal);
+	if (stnode_type_id(dfw->st_root) == STTYPE_TEST) {
+		fold_eq_chains(dfw->st_root);
+		optimize(dfw->st_root);
+	}
 	gencode(dfw, dfw->st_root);
 	dfw_append_insn(dfw, dfvm_insn_new(RETURN));
 
@@ -457,7 +457,7 @@ dissect_frame(tvbuff_t *tvb, packet_info *pinfo, proto_tree *parent_tree, void*
 								  (long) pinfo->abs_ts.nsecs);
 			}
 			item = proto_tree_add_time(fh_tree, hf_frame_shift_offset, tvb,
-					    0, 0, &(pinfo->fd->shift_offset));
+					    0, 0, epan_get_shift_offset(pinfo->epan, pinfo->fd));
 			PROTO_ITEM_SET_GENERATED(item);
 
 			if (generate_epoch_time) {
@@ -1863,8 +1863,6 @@ static gboolean from_hex(StringInfo* out, const char* in, gsize hex_len) {
 
 /* libgcrypt wrappers for HMAC/message digest operations {{{ */
 /* hmac abstraction layer */
-#define SSL_HMAC gcry_md_hd_t
-
 static inline gint
 ssl_hmac_init(SSL_HMAC* md, const void * key, gint len, gint algo)
 {
@@ -1899,6 +1897,11 @@ ssl_hmac_final(SSL_HMAC* md, guchar* data, guint* datalen)
     *datalen = len;
 }
 static inline void
+ssl_hmac_reset(SSL_HMAC* md)
+{
+    gcry_md_reset(*(md));
+}
+static inline void
 ssl_hmac_cleanup(SSL_HMAC* md)
 {
     gcry_md_close(*(md));
@@ -3013,6 +3016,8 @@ ssl_decoder_destroy_cb(wmem_allocator_t *allocator _U_, wmem_cb_event_t event _U
 
     if (dec->evp)
         ssl_cipher_cleanup(&dec->evp);
+    if (dec->mac_hd)
+        ssl_hmac_cleanup(&dec->mac_hd);
 
 #ifdef HAVE_ZLIB
     if (dec->decomp != NULL && dec->decomp->compression == 1 /* DEFLATE */)
@@ -3091,8 +3096,9 @@ ssl_decrypt_pre_master_secret(SslDecryptSession *ssl_session,
 #endif /* HAVE_LIBGNUTLS */
 
 static gboolean
-ssl_restore_master_key(SslDecryptSession *ssl, const char *label,
-                       gboolean is_pre_master, GHashTable *ht, StringInfo *key);
+ssl_restore_master_key(SslDecryptSession *ssl, const ssl_master_key_map_t *mk_map,
+                       const char *label, gboolean is_pre_master,
+                       GHashTable *ht, StringInfo *key);
 
 gboolean
 ssl_generate_pre_master_secret(SslDecryptSession *ssl_session,
@@ -3116,8 +3122,8 @@ ssl_generate_pre_master_secret(SslDecryptSession *ssl_session,
     }
 
     /* check to see if the PMS was provided to us*/
-    if (ssl_restore_master_key(ssl_session, "Unencrypted pre-master secret", TRUE,
-           mk_map->pms, &ssl_session->client_random)) {
+    if (ssl_restore_master_key(ssl_session, mk_map, "Unencrypted pre-master secret",
+           TRUE, mk_map->pms, &ssl_session->client_random)) {
         return TRUE;
     }
 
@@ -3227,7 +3233,7 @@ ssl_generate_pre_master_secret(SslDecryptSession *ssl_session,
         /* try to find the pre-master secret from the encrypted one. The
          * ssl key logfile stores only the first 8 bytes, so truncate it */
         encrypted_pre_master.data_len = 8;
-        if (ssl_restore_master_key(ssl_session, "Encrypted pre-master secret",
+        if (ssl_restore_master_key(ssl_session, mk_map, "Encrypted pre-master secret",
             TRUE, mk_map->pre_master, &encrypted_pre_master))
             return TRUE;
     }
@@ -3701,21 +3707,41 @@ ssl_decrypt_pre_master_secret(SslDecryptSession*ssl_session,
 
 /* Decryption integrity check {{{ */
 
+/* Returns the HMAC context of the decoder, keyed with its MAC key. It is
+ * created for the first record and only reset for later records, such that
+ * the key is not processed again for every record. */
+static SSL_HMAC *
+ssl_decoder_get_hmac(SslDecoder *decoder)
+{
+    gint md;
+
+    if (decoder->mac_hd) {
+        ssl_hmac_reset(&decoder->mac_hd);
+        return &decoder->mac_hd;
+    }
+
+    md=ssl_get_digest_by_name(ssl_cipher_suite_dig(decoder->cipher_suite)->name);
+    ssl_debug_printf("%s mac type:%s md %d\n", G_STRFUNC,
+        ssl_cipher_suite_dig(decoder->cipher_suite)->name, md);
+
+    if (ssl_hmac_init(&decoder->mac_hd,decoder->mac_key.data,decoder->mac_key.data_len,md) != 0) {
+        decoder->mac_hd = NULL;
+        return NULL;
+    }
+    return &decoder->mac_hd;
+}
+
 static gint
 tls_check_mac(SslDecoder*decoder, gint ct, gint ver, guint8* data,
         guint32 datalen, guint8* mac)
 {
-    SSL_HMAC hm;
-    gint     md;
+    SSL_HMAC *hm;
     guint32  len;
     guint8   buf[DIGEST_MAX_SIZE];
     gint16   temp;
 
-    md=ssl_get_digest_by_name(ssl_cipher_suite_dig(decoder->cipher_suite)->name);
-    ssl_debug_printf("tls_check_mac mac type:%s md %d\n",
-        ssl_cipher_suite_dig(decoder->cipher_suite)->name, md);
-
-    if (ssl_hmac_init(&hm,decoder->mac_key.data,decoder->mac_key.data_len,md) != 0)
+    hm = ssl_decoder_get_hmac(decoder);
+    if (!hm)
         return -1;
 
     /* hash sequence number */
@@ -3723,28 +3749,27 @@ tls_check_mac(SslDecoder*decoder, gint ct, gint ver, guint8* data,
 
     decoder->seq++;
 
-    ssl_hmac_update(&hm,buf,8);
+    ssl_hmac_update(hm,buf,8);
 
     /* hash content type */
     buf[0]=ct;
-    ssl_hmac_update(&hm,buf,1);
+    ssl_hmac_update(hm,buf,1);
 
     /* hash version,data length and data*/
     /* *((gint16*)buf) = g_htons(ver); */
     temp = g_htons(ver);
     memcpy(buf, &temp, 2);
-    ssl_hmac_update(&hm,buf,2);
+    ssl_hmac_update(hm,buf,2);
 
     /* *((gint16*)buf) = g_htons(datalen); */
     temp = g_htons(datalen);
     memcpy(buf, &temp, 2);
-    ssl_hmac_update(&hm,buf,2);
-    ssl_hmac_update(&hm,data,datalen);
+    ssl_hmac_update(hm,buf,2);
+    ssl_hmac_update(hm,data,datalen);
 
     /* get digest and digest len*/
     len = sizeof(buf);
-    ssl_hmac_final(&hm,buf,&len);
-    ssl_hmac_cleanup(&hm);
+    ssl_hmac_final(hm,buf,&len);
     ssl_print_data("Mac", buf, len);
     if(memcmp(mac,buf,len))
         return -1;
@@ -3820,17 +3845,13 @@ static gint
 dtls_check_mac(SslDecoder*decoder, gint ct,int ver, guint8* data,
         guint32 datalen, guint8* mac)
 {
-    SSL_HMAC hm;
-    gint     md;
+    SSL_HMAC *hm;
     guint32  len;
     guint8   buf[DIGEST_MAX_SIZE];
     gint16   temp;
 
-    md=ssl_get_digest_by_name(ssl_cipher_suite_dig(decoder->cipher_suite)->name);
-    ssl_debug_printf("dtls_check_mac mac type:%s md %d\n",
-        ssl_cipher_suite_dig(decoder->cipher_suite)->name, md);
-
-    if (ssl_hmac_init(&hm,decoder->mac_key.data,decoder->mac_key.data_len,md) != 0)
+    hm = ssl_decoder_get_hmac(decoder);
+    if (!hm)
         return -1;
     ssl_debug_printf("dtls_check_mac seq: %" G_GUINT64_FORMAT " epoch: %d\n",decoder->seq,decoder->epoch);
     /* hash sequence number */
@@ -3838,25 +3859,24 @@ dtls_check_mac(SslDecoder*decoder, gint ct,int ver, guint8* data,
     buf[0]=decoder->epoch>>8;
     buf[1]=(guint8)decoder->epoch;
 
-    ssl_hmac_update(&hm,buf,8);
+    ssl_hmac_update(hm,buf,8);
 
     /* hash content type */
     buf[0]=ct;
-    ssl_hmac_update(&hm,buf,1);
+    ssl_hmac_update(hm,buf,1);
 
     /* hash version,data length and data */
     temp = g_htons(ver);
     memcpy(buf, &temp, 2);
-    ssl_hmac_update(&hm,buf,2);
+    ssl_hmac_update(hm,buf,2);
 
     temp = g_htons(datalen);
     memcpy(buf, &temp, 2);
-    ssl_hmac_update(&hm,buf,2);
-    ssl_hmac_update(&hm,data,datalen);
+    ssl_hmac_update(hm,buf,2);
+    ssl_hmac_update(hm,data,datalen);
     /* get digest and digest len */
     len = sizeof(buf);
-    ssl_hmac_final(&hm,buf,&len);
-    ssl_hmac_cleanup(&hm);
+    ssl_hmac_final(hm,buf,&len);
     ssl_print_data("Mac", buf, len);
     if(memcmp(mac,buf,len))
         return -1;
@@ -4077,7 +4097,12 @@ tls_decrypt_aead_record(SslDecryptSession *ssl, SslDecoder *decoder,
 
 /* Record decryption glue based on security parameters {{{ */
 /* Assume that we are called only for a non-NULL decoder which also means that
- * we have a non-NULL decoder->cipher_suite. */
+ * we have a non-NULL decoder->cipher_suite.
+ *
+ * Records are decrypted one at a time as their packets are dissected, not in
+ * batches per flow: the decoder, key and sequence number for the next record
+ * depend on this one, which may be a ChangeCipherSpec or KeyUpdate or may fail
+ * to decrypt, and the later records may not have been reassembled yet. */
 int
 ssl_decrypt_record(SslDecryptSession *ssl, SslDecoder *decoder, guint8 ct, guint16 record_version,
         gboolean ignore_mac_failed,
@@ -4650,6 +4675,13 @@ ssl_packet_from_server(SslSession *session, dissector_table_t table, packet_info
  */
 void
 ssl_add_record_info(gint proto, packet_info *pinfo, const guchar *data, gint data_len, gint record_id, SslFlow *flow, ContentType type, guint8 curr_layer_num_ssl)
+{
+    ssl_add_record_info_owned(proto, pinfo, (guchar *)wmem_memdup(wmem_file_scope(), data, data_len),
+                              data_len, record_id, flow, type, curr_layer_num_ssl);
+}
+
+void
+ssl_add_record_info_owned(gint proto, packet_info *pinfo, guchar *data, gint data_len, gint record_id, SslFlow *flow, ContentType type, guint8 curr_layer_num_ssl)
 {
     SslRecordInfo* rec, **prec;
     SslPacketInfo* pi;
@@ -4664,7 +4696,7 @@ ssl_add_record_info(gint proto, packet_info *pinfo, const guchar *data, gint dat
     }
 
     rec = wmem_new(wmem_file_scope(), SslRecordInfo);
-    rec->plain_data = (guchar *)wmem_memdup(wmem_file_scope(), data, data_len);
+    rec->plain_data = data;
     rec->data_len = data_len;
     rec->id = record_id;
     rec->type = type;
@@ -4726,6 +4758,7 @@ ssl_common_init(ssl_master_key_map_t *mk_map,
     mk_map->tls13_server_appdata = g_hash_table_new(ssl_hash, ssl_equal);
     mk_map->tls13_early_exporter = g_hash_table_new(ssl_hash, ssl_equal);
     mk_map->tls13_exporter = g_hash_table_new(ssl_hash, ssl_equal);
+    mk_map->keylog_index = NULL;
     ssl_data_alloc(decrypted_data, 32);
     ssl_data_alloc(compressed_data, 32);
 }
@@ -4746,6 +4779,10 @@ ssl_common_cleanup(ssl_master_key_map_t *mk_map, FILE **ssl_keylog_file,
     g_hash_table_destroy(mk_map->tls13_server_appdata);
     g_hash_table_destroy(mk_map->tls13_early_exporter);
     g_hash_table_destroy(mk_map->tls13_exporter);
+    if (mk_map->keylog_index) {
+        g_mapped_file_unref(mk_map->keylog_index);
+        mk_map->keylog_index = NULL;
+    }
 
     g_free(decrypted_data->data);
     g_free(compressed_data->data);
@@ -4885,10 +4922,29 @@ ssl_save_master_key(const char *label, GHashTable *ht, StringInfo *key,
     ssl_print_string("stored (pre-)master secret", master_secret);
 }
 
+static StringInfo *
+ssl_keylog_index_lookup(const ssl_master_key_map_t *mk_map, GHashTable *ht,
+                        const StringInfo *key);
+
+/** look up a secret in the cache, falling back to the keylog index */
+StringInfo *
+ssl_master_key_lookup(const ssl_master_key_map_t *mk_map, GHashTable *ht,
+                      const StringInfo *key)
+{
+    StringInfo *ms;
+
+    ms = (StringInfo *)g_hash_table_lookup(ht, key);
+    if (!ms && mk_map->keylog_index) {
+        ms = ssl_keylog_index_lookup(mk_map, ht, key);
+    }
+    return ms;
+}
+
 /** restore a (pre-)master secret given some key in the cache */
 static gboolean
-ssl_restore_master_key(SslDecryptSession *ssl, const char *label,
-                       gboolean is_pre_master, GHashTable *ht, StringInfo *key)
+ssl_restore_master_key(SslDecryptSession *ssl, const ssl_master_key_map_t *mk_map,
+                       const char *label, gboolean is_pre_master,
+                       GHashTable *ht, StringInfo *key)
 {
     StringInfo *ms;
 
@@ -4898,7 +4954,7 @@ ssl_restore_master_key(SslDecryptSession *ssl, const char *label,
         return FALSE;
     }
 
-    ms = (StringInfo *)g_hash_table_lookup(ht, key);
+    ms = ssl_master_key_lookup(mk_map, ht, key);
     if (!ms) {
         ssl_debug_printf("%s can't find %smaster secret by %s\n", G_STRFUNC,
                          is_pre_master ? "pre-" : "", label);
@@ -4953,12 +5009,12 @@ ssl_finalize_decryption(SslDecryptSession *ssl, ssl_master_key_map_t *mk_map)
      * from pre-master secret). If missing, try to pick a master key from cache
      * (an earlier packet in the capture or key logfile). */
     if (!(ssl->state & (SSL_MASTER_SECRET | SSL_PRE_MASTER_SECRET)) &&
-        !ssl_restore_master_key(ssl, "Session ID", FALSE,
+        !ssl_restore_master_key(ssl, mk_map, "Session ID", FALSE,
                                 mk_map->session, &ssl->session_id) &&
         (!ssl->session.is_session_resumed ||
-         !ssl_restore_master_key(ssl, "Session Ticket", FALSE,
+         !ssl_restore_master_key(ssl, mk_map, "Session Ticket", FALSE,
                                  mk_map->tickets, &ssl->session_ticket)) &&
-        !ssl_restore_master_key(ssl, "Client Random", FALSE,
+        !ssl_restore_master_key(ssl, mk_map, "Client Random", FALSE,
                                 mk_map->crandom, &ssl->client_random)) {
         if (ssl->cipher_suite->enc != ENC_NULL) {
             /* how unfortunate, the master secret could not be found */
@@ -5038,7 +5094,7 @@ tls13_load_secret(SslDecryptSession *ssl, ssl_master_key_map_t *mk_map,
     ssl_debug_printf("%s transitioning to new key, old state 0x%02x\n", G_STRFUNC, ssl->state);
     ssl->state &= ~(SSL_MASTER_SECRET | SSL_PRE_MASTER_SECRET | SSL_HAVE_SESSION_KEY);
 
-    StringInfo *secret = (StringInfo *)g_hash_table_lookup(key_map, &ssl->client_random);
+    StringInfo *secret = ssl_master_key_lookup(mk_map, key_map, &ssl->client_random);
     if (!secret) {
         ssl_debug_printf("%s Cannot find %s, decryption impossible\n", G_STRFUNC, label);
         /* Disable decryption, the keys are invalid. */
@@ -5189,6 +5245,7 @@ static gboolean
 file_needs_reopen(FILE *fp, const char *filename)
 {
     ws_statb64 open_stat, current_stat;
+    gint64 pos;
 
     /* consider a file deleted when stat fails for either file,
      * or when the residing device / inode has changed. */
@@ -5200,9 +5257,200 @@ file_needs_reopen(FILE *fp, const char *filename)
     /* Note: on Windows, ino may be 0. Existing files cannot be deleted on
      * Windows, but hopefully the size is a good indicator when a file got
      * removed and recreated */
-    return  open_stat.st_dev != current_stat.st_dev ||
-            open_stat.st_ino != current_stat.st_ino ||
-            open_stat.st_size > current_stat.st_size;
+    if (open_stat.st_dev != current_stat.st_dev ||
+        open_stat.st_ino != current_stat.st_ino ||
+        open_stat.st_size > current_stat.st_size)
+        return TRUE;
+
+    /* a file truncated in place (e.g. "copytruncate" log rotation) keeps its
+     * inode, but the read position is then beyond its end. */
+    pos = ws_ftell64(fp);
+    return pos > 0 && pos > (gint64)current_stat.st_size;
+}
+
+/*
+ * Binary keylog index, created with tools/make-tls-keylog-index.py. It only
+ * holds secrets that are keyed by Client Random and is looked up on demand
+ * (instead of being loaded) such that its size does not affect startup time.
+ * All integers are big-endian.
+ *
+ *   header:  magic (8), version (4), number of entries (4)
+ *   entry:   Client Random (32), type (1), reserved (1), secret length (2),
+ *            secret offset from the start of the file (8)
+ *
+ * Entries directly follow the header and are sorted by Client Random and
+ * type, secrets follow the entries.
+ */
+#define SSL_KEYLOG_INDEX_MAGIC          "\x89WSKLIX\n"
+#define SSL_KEYLOG_INDEX_MAGIC_LEN      8
+#define SSL_KEYLOG_INDEX_VERSION        1
+#define SSL_KEYLOG_INDEX_HEADER_LEN     16
+#define SSL_KEYLOG_INDEX_ENTRY_LEN      44
+#define SSL_KEYLOG_INDEX_KEY_LEN        33  /* Client Random and type */
+
+/* Secret types in the keylog index. */
+#define SSL_KEYLOG_INDEX_CLIENT_RANDOM                  1
+#define SSL_KEYLOG_INDEX_PMS_CLIENT_RANDOM              2
+#define SSL_KEYLOG_INDEX_CLIENT_EARLY_TRAFFIC_SECRET    3
+#define SSL_KEYLOG_INDEX_CLIENT_HANDSHAKE_TRAFFIC_SECRET 4
+#define SSL_KEYLOG_INDEX_SERVER_HANDSHAKE_TRAFFIC_SECRET 5
+#define SSL_KEYLOG_INDEX_CLIENT_TRAFFIC_SECRET_0        6
+#define SSL_KEYLOG_INDEX_SERVER_TRAFFIC_SECRET_0        7
+#define SSL_KEYLOG_INDEX_EARLY_EXPORTER_SECRET          8
+#define SSL_KEYLOG_INDEX_EXPORTER_SECRET                9
+
+static guint8
+ssl_keylog_index_type(const ssl_master_key_map_t *mk_map, GHashTable *ht)
+{
+    if (ht == mk_map->crandom)
+        return SSL_KEYLOG_INDEX_CLIENT_RANDOM;
+    if (ht == mk_map->pms)
+        return SSL_KEYLOG_INDEX_PMS_CLIENT_RANDOM;
+    if (ht == mk_map->tls13_client_early)
+        return SSL_KEYLOG_INDEX_CLIENT_EARLY_TRAFFIC_SECRET;
+    if (ht == mk_map->tls13_client_handshake)
+        return SSL_KEYLOG_INDEX_CLIENT_HANDSHAKE_TRAFFIC_SECRET;
+    if (ht == mk_map->tls13_server_handshake)
+        return SSL_KEYLOG_INDEX_SERVER_HANDSHAKE_TRAFFIC_SECRET;
+    if (ht == mk_map->tls13_client_appdata)
+        return SSL_KEYLOG_INDEX_CLIENT_TRAFFIC_SECRET_0;
+    if (ht == mk_map->tls13_server_appdata)
+        return SSL_KEYLOG_INDEX_SERVER_TRAFFIC_SECRET_0;
+    if (ht == mk_map->tls13_early_exporter)
+        return SSL_KEYLOG_INDEX_EARLY_EXPORTER_SECRET;
+    if (ht == mk_map->tls13_exporter)
+        return SSL_KEYLOG_INDEX_EXPORTER_SECRET;
+    /* Session IDs, tickets and encrypted pre-master secrets are not indexed. */
+    return 0;
+}
+
+/* Returns TRUE if the opened keylog file is a binary index. */
+static gboolean
+ssl_keylog_is_index(FILE *fp)
+{
+    char magic[SSL_KEYLOG_INDEX_MAGIC_LEN];
+    gboolean is_index;
+
+    is_index = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+               memcmp(magic, SSL_KEYLOG_INDEX_MAGIC, sizeof(magic)) == 0;
+    rewind(fp);
+    return is_index;
+}
+
+/* Maps the keylog index and validates its header. */
+static GMappedFile *
+ssl_keylog_index_open(const gchar *filename)
+{
+    GMappedFile *index;
+    GError *gerr = NULL;
+    const guint8 *contents;
+    gsize length;
+    guint32 version, entries_nr;
+
+    index = g_mapped_file_new(filename, FALSE, &gerr);
+    if (!index) {
+        ssl_debug_printf("%s failed to map keylog index: %s\n", G_STRFUNC,
+                         gerr->message);
+        g_error_free(gerr);
+        return NULL;
+    }
+
+    contents = (const guint8 *)g_mapped_file_get_contents(index);
+    length = g_mapped_file_get_length(index);
+    if (length < SSL_KEYLOG_INDEX_HEADER_LEN ||
+        memcmp(contents, SSL_KEYLOG_INDEX_MAGIC, SSL_KEYLOG_INDEX_MAGIC_LEN) != 0) {
+        ssl_debug_printf("%s keylog index has no valid header\n", G_STRFUNC);
+        g_mapped_file_unref(index);
+        return NULL;
+    }
+    version = pntoh32(contents + 8);
+    entries_nr = pntoh32(contents + 12);
+    if (version != SSL_KEYLOG_INDEX_VERSION) {
+        ssl_debug_printf("%s unsupported keylog index version %u\n", G_STRFUNC,
+                         version);
+        g_mapped_file_unref(index);
+        return NULL;
+    }
+    if ((guint64)entries_nr * SSL_KEYLOG_INDEX_ENTRY_LEN >
+        length - SSL_KEYLOG_INDEX_HEADER_LEN) {
+        ssl_debug_printf("%s keylog index is truncated\n", G_STRFUNC);
+        g_mapped_file_unref(index);
+        return NULL;
+    }
+
+    ssl_debug_printf("%s mapped keylog index with %u entries\n", G_STRFUNC,
+                     entries_nr);
+    return index;
+}
+
+/* Finds the secret for a Client Random in the keylog index by a binary search
+ * and adds it to the cache, such that further lookups need not search. */
+static StringInfo *
+ssl_keylog_index_lookup(const ssl_master_key_map_t *mk_map, GHashTable *ht,
+                        const StringInfo *key)
+{
+    const guint8 *contents, *entry;
+    gsize length;
+    guint8 search_key[SSL_KEYLOG_INDEX_KEY_LEN];
+    guint32 low, high, mid;
+    guint16 secret_len;
+    guint64 secret_offset;
+    StringInfo key_info, secret_info;
+    StringInfo *secret;
+    int cmp;
+
+    if (key->data_len != 32) {
+        return NULL;
+    }
+    search_key[32] = ssl_keylog_index_type(mk_map, ht);
+    if (!search_key[32]) {
+        return NULL;
+    }
+    memcpy(search_key, key->data, 32);
+
+    contents = (const guint8 *)g_mapped_file_get_contents(mk_map->keylog_index);
+    length = g_mapped_file_get_length(mk_map->keylog_index);
+
+    /* The number of entries was validated when the index was opened. */
+    low = 0;
+    high = pntoh32(contents + 12);
+    entry = NULL;
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        entry = contents + SSL_KEYLOG_INDEX_HEADER_LEN +
+                (gsize)mid * SSL_KEYLOG_INDEX_ENTRY_LEN;
+        cmp = memcmp(search_key, entry, SSL_KEYLOG_INDEX_KEY_LEN);
+        if (cmp == 0) {
+            break;
+        } else if (cmp < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+        entry = NULL;
+    }
+    if (!entry) {
+        return NULL;
+    }
+
+    secret_len = pntoh16(entry + 34);
+    secret_offset = pntoh64(entry + 36);
+    if (secret_len == 0 || secret_offset > length ||
+        secret_len > length - secret_offset) {
+        ssl_debug_printf("%s keylog index entry has an invalid secret\n",
+                         G_STRFUNC);
+        return NULL;
+    }
+
+    key_info.data = (guchar *)search_key;
+    key_info.data_len = 32;
+    secret_info.data = (guchar *)(contents + secret_offset);
+    secret_info.data_len = secret_len;
+    secret = ssl_data_clone(&secret_info);
+    g_hash_table_insert(ht, ssl_data_clone(&key_info), secret);
+    ssl_debug_printf("%s found secret of type %u in keylog index\n", G_STRFUNC,
+                     search_key[32]);
+    return secret;
 }
 
 typedef struct ssl_master_key_match_group {
@@ -5212,7 +5460,7 @@ typedef struct ssl_master_key_match_group {
 
 void
 ssl_load_keyfile(const gchar *ssl_keylog_filename, FILE **keylog_file,
-                 const ssl_master_key_map_t *mk_map)
+                 ssl_master_key_map_t *mk_map)
 {
     unsigned i;
     GRegex *regex;
@@ -5274,6 +5522,12 @@ ssl_load_keyfile(const gchar *ssl_keylog_filename, FILE **keylog_file,
      *     Where yyyy is the secret (hex-encoded) derived from the early,
      *     handshake or master secrets. (This format is introduced with TLS 1.3
      *     and supported by BoringSSL, OpenSSL, etc. See bug 12779.)
+     *
+     * Alternatively, the file can be a binary index of the secrets that are
+     * keyed by Client Random, see ssl_keylog_index_lookup.
+     *
+     * The file is kept open between calls, so only lines that were appended
+     * since the last call are parsed.
      */
     regex = ssl_compile_keyfile_regex();
     if (!regex)
@@ -5286,6 +5540,10 @@ ssl_load_keyfile(const gchar *ssl_keylog_filename, FILE **keylog_file,
         ssl_debug_printf("%s file got deleted, trying to re-open\n", G_STRFUNC);
         fclose(*keylog_file);
         *keylog_file = NULL;
+        if (mk_map->keylog_index) {
+            g_mapped_file_unref(mk_map->keylog_index);
+            mk_map->keylog_index = NULL;
+        }
     }
 
     if (*keylog_file == NULL) {
@@ -5294,18 +5552,38 @@ ssl_load_keyfile(const gchar *ssl_keylog_filename, FILE **keylog_file,
             ssl_debug_printf("%s failed to open SSL keylog\n", G_STRFUNC);
             return;
         }
+        if (ssl_keylog_is_index(*keylog_file)) {
+            mk_map->keylog_index = ssl_keylog_index_open(ssl_keylog_filename);
+            if (!mk_map->keylog_index) {
+                /* do not parse an unusable index as text. */
+                fclose(*keylog_file);
+                *keylog_file = NULL;
+                return;
+            }
+        }
+    }
+
+    if (mk_map->keylog_index) {
+        /* secrets are looked up in the index when needed. */
+        return;
     }
 
     for (;;) {
         char buf[512], *line;
-        gsize bytes_read;
+        gsize bytes_read, line_len;
+        gboolean unterminated;
         GMatchInfo *mi;
 
         line = fgets(buf, sizeof(buf), *keylog_file);
         if (!line)
             break;
 
-        bytes_read = strlen(line);
+        bytes_read = line_len = strlen(line);
+        /* The last line may lack its newline because it is still being
+         * written, or just because the file doesn't end with one. Parse it
+         * anyway, and again in the next call in case it has grown. */
+        unterminated = bytes_read > 0 && line[bytes_read - 1] != '\n' &&
+            feof(*keylog_file);
         /* fgets includes the \n at the end of the line. */
         if (bytes_read > 0 && line[bytes_read - 1] == '\n') {
             line[bytes_read - 1] = 0;
@@ -5365,6 +5643,12 @@ ssl_load_keyfile(const gchar *ssl_keylog_filename, FILE **keylog_file,
         }
         /* always free match info even if there is no match. */
         g_match_info_free(mi);
+
+        if (unterminated) {
+            ssl_debug_printf("  unterminated keylog line, reading it again next time\n");
+            ws_fseek64(*keylog_file, -(gint64)line_len, SEEK_CUR);
+            break;
+        }
     }
 }
 /** SSL keylog file handling. }}} */
@@ -8785,7 +9069,10 @@ ssl_common_register_options(module_t *module, ssl_common_options_t *options)
              "<MS> = The Master-Secret (MS)\n"
              "<CRAND> = The Client's random number from the ClientHello message\n"
              "\n"
-             "(All fields are in hex notation)",
+             "(All fields are in hex notation)\n"
+             "\n"
+             "For large key log files, an index created with\n"
+             "tools/make-tls-keylog-index.py can be used instead.",
              &(options->keylog_filename), FALSE);
 }
 
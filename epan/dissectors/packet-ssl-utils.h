@@ -30,6 +30,7 @@
 
 /* TODO inline this now that Libgcrypt is mandatory? */
 #define SSL_CIPHER_CTX gcry_cipher_hd_t
+#define SSL_HMAC gcry_md_hd_t
 #define SSL_DECRYPT_DEBUG
 
 
@@ -347,6 +348,7 @@ typedef struct _SslDecoder {
     StringInfo mac_key; /* for block and stream ciphers */
     StringInfo write_iv; /* for AEAD ciphers (at least GCM, CCM) */
     SSL_CIPHER_CTX evp;
+    SSL_HMAC mac_hd; /**< HMAC keyed with mac_key, reset for every record. */
     SslDecompress *decomp;
     guint64 seq;    /**< Implicit (TLS) or explicit (DTLS) record sequence number. */
     guint16 epoch;
@@ -519,6 +521,10 @@ typedef struct {
     GHashTable *tls13_server_appdata;
     GHashTable *tls13_early_exporter;
     GHashTable *tls13_exporter;
+
+    /* Binary keylog index (see tools/make-tls-keylog-index.py), consulted
+     * when a Client Random is missing from the above tables. */
+    GMappedFile *keylog_index;
 } ssl_master_key_map_t;
 
 gint ssl_get_keyex_alg(gint cipher);
@@ -674,6 +680,11 @@ ssl_packet_from_server(SslSession *session, dissector_table_t table, packet_info
 extern void
 ssl_add_record_info(gint proto, packet_info *pinfo, const guchar *data, gint data_len, gint record_id, SslFlow *flow, ContentType type, guint8 curr_layer_num_ssl);
 
+/* Like ssl_add_record_info, but takes ownership of data (which must be
+ * allocated in wmem_file_scope) instead of copying it. */
+extern void
+ssl_add_record_info_owned(gint proto, packet_info *pinfo, guchar *data, gint data_len, gint record_id, SslFlow *flow, ContentType type, guint8 curr_layer_num_ssl);
+
 /* search in packet data for the specified id; return a newly created tvb for the associated data */
 extern tvbuff_t*
 ssl_get_record_info(tvbuff_t *parent_tvb, gint proto, packet_info *pinfo, gint record_id, guint8 curr_layer_num_ssl, SslRecordInfo **matched_record);
@@ -686,10 +697,18 @@ extern void
 ssl_common_cleanup(ssl_master_key_map_t *master_key_map, FILE **ssl_keylog_file,
                    StringInfo *decrypted_data, StringInfo *compressed_data);
 
-/* tries to update the secrets cache from the given filename */
+/* looks up a secret by key in one of the tables of mk_map, falling back to the
+ * keylog index if any. */
+extern StringInfo *
+ssl_master_key_lookup(const ssl_master_key_map_t *mk_map, GHashTable *ht,
+                      const StringInfo *key);
+
+/* tries to update the secrets cache from the given filename. Only lines
+ * appended since the previous call are read. If the file is a binary keylog
+ * index, it is mapped instead and looked up on demand. */
 extern void
 ssl_load_keyfile(const gchar *ssl_keylog_filename, FILE **keylog_file,
-                 const ssl_master_key_map_t *mk_map);
+                 ssl_master_key_map_t *mk_map);
 
 /* parse ssl related preferences (private keys and ports association strings) */
 extern void
@@ -976,14 +976,21 @@ dissect_ssl_heur(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data
     return dissect_ssl(tvb, pinfo, tree, data);
 }
 
+/**
+ * Saves the decrypted record. If "data_is_owned" is set, "data" was allocated
+ * in wmem_file_scope for this record and is taken over instead of copied.
+ */
 static void
 tls_save_decrypted_record(packet_info *pinfo, gint record_id, SslDecryptSession *ssl, guint8 content_type,
-                          SslDecoder *decoder, gboolean allow_fragments, guint8 curr_layer_num_ssl)
+                          SslDecoder *decoder, gboolean allow_fragments, guint8 curr_layer_num_ssl,
+                          guchar *data, guint plain_len, gboolean data_is_owned)
 {
-    const guchar *data = ssl_decrypted_data.data;
-    guint datalen = ssl_decrypted_data_avail;
+    guint datalen = plain_len;
 
     if (datalen == 0) {
+        if (data_is_owned) {
+            wmem_free(wmem_file_scope(), data);
+        }
         return;
     }
 
@@ -995,14 +1002,20 @@ tls_save_decrypted_record(packet_info *pinfo, gint record_id, SslDecryptSession
         while (datalen > 0 && data[datalen - 1] == 0) {
             datalen--;
         }
-        ssl_debug_printf("%s found %d padding bytes\n", G_STRFUNC, ssl_decrypted_data_avail - datalen);
+        ssl_debug_printf("%s found %d padding bytes\n", G_STRFUNC, plain_len - datalen);
         if (datalen == 0) {
             ssl_debug_printf("%s there is no room for content type!\n", G_STRFUNC);
+            if (data_is_owned) {
+                wmem_free(wmem_file_scope(), data);
+            }
             return;
         }
         content_type = data[--datalen];
         if (datalen == 0) {
             /* XXX should we remember that the decrypted contents was zero-length? */
+            if (data_is_owned) {
+                wmem_free(wmem_file_scope(), data);
+            }
             return;
         }
     }
@@ -1010,14 +1023,18 @@ tls_save_decrypted_record(packet_info *pinfo, gint record_id, SslDecryptSession
     /* In TLS 1.3 only Handshake and Application Data can be fragmented.
      * Alert messages MUST NOT be fragmented across records, so do not
      * bother maintaining a flow for those. */
-    ssl_add_record_info(proto_ssl, pinfo, data, datalen, record_id,
-            allow_fragments ? decoder->flow : NULL, (ContentType)content_type, curr_layer_num_ssl);
+    if (data_is_owned) {
+        ssl_add_record_info_owned(proto_ssl, pinfo, data, datalen, record_id,
+                allow_fragments ? decoder->flow : NULL, (ContentType)content_type, curr_layer_num_ssl);
+    } else {
+        ssl_add_record_info(proto_ssl, pinfo, data, datalen, record_id,
+                allow_fragments ? decoder->flow : NULL, (ContentType)content_type, curr_layer_num_ssl);
+    }
 }
 
 /**
  * Try to decrypt the record and update the internal cipher state.
- * On success, the decrypted data will be available in "ssl_decrypted_data" of
- * length "ssl_decrypted_data_avail".
+ * On success, the decrypted data is saved as record info of this packet.
  */
 static gboolean
 decrypt_ssl3_record(tvbuff_t *tvb, packet_info *pinfo, guint32 offset, SslDecryptSession *ssl,
@@ -1029,6 +1046,7 @@ decrypt_ssl3_record(tvbuff_t *tvb, packet_info *pinfo, guint32 offset, SslDecryp
     StringInfo *data_for_iv;
     gint        data_for_iv_len;
     SslDecoder *decoder;
+    StringInfo  plain_data, *out_str;
 
     /* if we can decrypt and decryption was a success
      * add decrypted data to this packet info */
@@ -1056,12 +1074,23 @@ decrypt_ssl3_record(tvbuff_t *tvb, packet_info *pinfo, guint32 offset, SslDecryp
         return FALSE;
     }
 
+    /* Without compression, the plaintext is not larger than the record and
+     * can be decrypted directly into the storage that is kept for the record.
+     * Otherwise the shared buffer is used and the result copied. */
+    if (decoder->compression == 0) {
+        plain_data.data = (guchar *)wmem_alloc(wmem_file_scope(), record_length);
+        plain_data.data_len = record_length;
+        out_str = &plain_data;
+    } else {
+        out_str = &ssl_decrypted_data;
+    }
+
     /* run decryption and add decrypted payload to protocol data, if decryption
      * is successful*/
-    ssl_decrypted_data_avail = ssl_decrypted_data.data_len;
+    ssl_decrypted_data_avail = out_str->data_len;
     success = ssl_decrypt_record(ssl, decoder, content_type, record_version, ssl_ignore_mac_failed,
                            tvb_get_ptr(tvb, offset, record_length), record_length,
-                           &ssl_compressed_data, &ssl_decrypted_data, &ssl_decrypted_data_avail) == 0;
+                           &ssl_compressed_data, out_str, &ssl_decrypted_data_avail) == 0;
     /*  */
     if (!success) {
         /* save data to update IV if valid session key is obtained later */
@@ -1070,7 +1099,10 @@ decrypt_ssl3_record(tvbuff_t *tvb, packet_info *pinfo, guint32 offset, SslDecryp
         ssl_data_set(data_for_iv, (const guchar*)tvb_get_ptr(tvb, offset + record_length - data_for_iv_len, data_for_iv_len), data_for_iv_len);
     }
     if (success) {
-        tls_save_decrypted_record(pinfo, tvb_raw_offset(tvb)+offset, ssl, content_type, decoder, allow_fragments, curr_layer_num_ssl);
+        tls_save_decrypted_record(pinfo, tvb_raw_offset(tvb)+offset, ssl, content_type, decoder, allow_fragments, curr_layer_num_ssl,
+                                  out_str->data, ssl_decrypted_data_avail, out_str == &plain_data);
+    } else if (out_str == &plain_data) {
+        wmem_free(wmem_file_scope(), plain_data.data);
     }
     return success;
 }
@@ -1102,7 +1134,8 @@ decrypt_tls13_early_data(tvbuff_t *tvb, packet_info *pinfo, guint32 offset,
                                      tvb_get_ptr(tvb, offset, record_length), record_length,
                                      &ssl_compressed_data, &ssl_decrypted_data, &ssl_decrypted_data_avail) == 0;
         if (success) {
-            tls_save_decrypted_record(pinfo, tvb_raw_offset(tvb)+offset, ssl, SSL_ID_APP_DATA, ssl->client, TRUE, curr_layer_num_ssl);
+            tls_save_decrypted_record(pinfo, tvb_raw_offset(tvb)+offset, ssl, SSL_ID_APP_DATA, ssl->client, TRUE, curr_layer_num_ssl,
+                                      ssl_decrypted_data.data, ssl_decrypted_data_avail, FALSE);
         } else {
             ssl_debug_printf("early data decryption failed, end of early data?\n");
         }
@@ -1141,7 +1174,8 @@ decrypt_tls13_early_data(tvbuff_t *tvb, packet_info *pinfo, guint32 offset,
                                      &ssl_compressed_data, &ssl_decrypted_data, &ssl_decrypted_data_avail) == 0;
         if (success) {
             ssl_debug_printf("Early data decryption succeeded, cipher = %#x\n", cipher);
-            tls_save_decrypted_record(pinfo, tvb_raw_offset(tvb)+offset, ssl, SSL_ID_APP_DATA, ssl->client, TRUE, curr_layer_num_ssl);
+            tls_save_decrypted_record(pinfo, tvb_raw_offset(tvb)+offset, ssl, SSL_ID_APP_DATA, ssl->client, TRUE, curr_layer_num_ssl,
+                                      ssl_decrypted_data.data, ssl_decrypted_data_avail, FALSE);
             break;
         }
     }
@@ -3998,7 +4032,7 @@ tls13_exporter(packet_info *pinfo, gboolean is_early,
     ssl_load_keyfile(ssl_options.keylog_filename, &ssl_keylog_file, &ssl_master_key_map);
     key_map = is_early ? ssl_master_key_map.tls13_early_exporter
                        : ssl_master_key_map.tls13_exporter;
-    secret = (StringInfo *)g_hash_table_lookup(key_map, &ssl_session->client_random);
+    secret = ssl_master_key_lookup(&ssl_master_key_map, key_map, &ssl_session->client_random);
     if (!secret) {
         return FALSE;
     }
@@ -1436,7 +1436,8 @@ init_tcp_conversation_data(packet_info *pinfo)
         tcpd->flow2.process_info = wmem_new0(wmem_file_scope(), struct tcp_process_info_t);
     }
 
-    tcpd->acked_table=wmem_tree_new(wmem_file_scope());
+    tcpd->acked_table=wmem_map_new_flat(wmem_file_scope(), g_direct_hash, g_direct_equal);
+    tcpd->acked_extra_table=NULL;
     tcpd->ts_first.secs=pinfo->abs_ts.secs;
     tcpd->ts_first.nsecs=pinfo->abs_ts.nsecs;
     nstime_set_zero(&tcpd->ts_mru_syn);
@@ -1802,35 +1803,117 @@ pdu_store_window_scale_option(guint8 ws, struct tcp_analysis *tcpd)
         tcpd->fwd->win_scale=ws;
 }
 
+/* Returns the rarely needed part of the analysis of ta, or NULL if it
+ * hasn't got one.
+ */
+static struct tcp_acked_extra *
+tcp_analyze_lookup_acked_extra(struct tcp_analysis *tcpd, struct tcp_acked *ta)
+{
+    if (!ta->has_extra) {
+        return NULL;
+    }
+    return (struct tcp_acked_extra *)wmem_map_lookup(tcpd->acked_extra_table, ta);
+}
+
+/* Returns the rarely needed part of the analysis of ta, creating it if
+ * need be.
+ */
+static struct tcp_acked_extra *
+tcp_analyze_new_acked_extra(struct tcp_analysis *tcpd, struct tcp_acked *ta)
+{
+    struct tcp_acked_extra *extra;
+
+    if (ta->has_extra) {
+        return (struct tcp_acked_extra *)wmem_map_lookup(tcpd->acked_extra_table, ta);
+    }
+    if (!tcpd->acked_extra_table) {
+        tcpd->acked_extra_table = wmem_map_new(wmem_file_scope(), g_direct_hash, g_direct_equal);
+    }
+    extra = wmem_new0(wmem_file_scope(), struct tcp_acked_extra);
+    wmem_map_insert(tcpd->acked_extra_table, ta, extra);
+    ta->has_extra = 1;
+    return extra;
+}
+
 /* when this function returns, it will (if createflag) populate the ta pointer.
  */
 static void
 tcp_analyze_get_acked_struct(guint32 frame, guint32 seq, guint32 ack, gboolean createflag, struct tcp_analysis *tcpd)
 {
+    struct tcp_acked *first, *ta;
+    struct tcp_acked_extra *extra = NULL;
 
-    wmem_tree_key_t key[4];
-
-    key[0].length = 1;
-    key[0].key = &frame;
+    if (!tcpd) {
+        return;
+    }
 
-    key[1].length = 1;
-    key[1].key = &seq;
+    /* A frame almost never has more than one segment of a conversation,
+     * so the map is keyed by frame alone and the others, if any, are
+     * chained off the first one through their extra parts.
+     */
+    first = (struct tcp_acked *)wmem_map_lookup(tcpd->acked_table, GUINT_TO_POINTER(frame));
+    for (ta = first; ta; ta = extra ? extra->next : NULL) {
+        if (ta->seq == seq && ta->ack == ack) {
+            break;
+        }
+        extra = tcp_analyze_lookup_acked_extra(tcpd, ta);
+    }
+    if((!ta) && createflag) {
+        ta = wmem_new0(wmem_file_scope(), struct tcp_acked);
+        ta->seq = seq;
+        ta->ack = ack;
+        if (first) {
+            extra = tcp_analyze_new_acked_extra(tcpd, first);
+            if (extra->next) {
+                tcp_analyze_new_acked_extra(tcpd, ta)->next = extra->next;
+            }
+            extra->next = ta;
+        } else {
+            wmem_map_insert(tcpd->acked_table, GUINT_TO_POINTER(frame), ta);
+        }
+    }
+    tcpd->ta = ta;
+}
 
-    key[2].length = 1;
-    key[2].key = &ack;
+/* Returns the rarely needed part of the analysis of the current segment,
+ * which must already have a ta.
+ */
+static struct tcp_acked_extra *
+tcp_analyze_get_acked_extra(struct tcp_analysis *tcpd)
+{
+    return tcp_analyze_new_acked_extra(tcpd, tcpd->ta);
+}
 
-    key[3].length = 0;
-    key[3].key = NULL;
+/* The i'th oldest segment in a flow's ring buffer of unacked segments */
+#define TCP_UNACKED_SEGMENT(info, i) \
+    (&(info)->segments[((info)->segment_first + (i)) % (info)->segment_alloc])
 
-    if (!tcpd) {
-        return;
-    }
+/* Adds a segment to a flow's unacked segments, making room for it if
+ * necessary; the caller makes sure there are fewer than
+ * TCP_MAX_UNACKED_SEGMENTS of them.
+ */
+static tcp_unacked_t *
+tcp_unacked_segment_add(tcp_analyze_seq_flow_info_t *info)
+{
+    if (info->segment_count == info->segment_alloc) {
+        tcp_unacked_t *segments;
+        guint16 i, alloc;
 
-    tcpd->ta = (struct tcp_acked *)wmem_tree_lookup32_array(tcpd->acked_table, key);
-    if((!tcpd->ta) && createflag) {
-        tcpd->ta = wmem_new0(wmem_file_scope(), struct tcp_acked);
-        wmem_tree_insert32_array(tcpd->acked_table, key, (void *)tcpd->ta);
+        alloc = info->segment_alloc ? info->segment_alloc * 2 : 8;
+        if (alloc > TCP_MAX_UNACKED_SEGMENTS) {
+            alloc = TCP_MAX_UNACKED_SEGMENTS;
+        }
+        segments = wmem_alloc_array(wmem_file_scope(), tcp_unacked_t, alloc);
+        for (i = 0; i < info->segment_count; i++) {
+            segments[i] = *TCP_UNACKED_SEGMENT(info, i);
+        }
+        wmem_free(wmem_file_scope(), info->segments);
+        info->segments = segments;
+        info->segment_first = 0;
+        info->segment_alloc = alloc;
     }
+    info->segment_count++;
+    return TCP_UNACKED_SEGMENT(info, info->segment_count - 1);
 }
 
 
@@ -1839,7 +1922,8 @@ tcp_analyze_get_acked_struct(guint32 frame, guint32 seq, guint32 ack, gboolean c
  * rev contains a list of all segments received but not yet ACKed in the
  *     opposite direction to the current segment.
  *
- * New segments are always added to the head of the fwd/rev lists.
+ * New segments are always added to the end of the fwd/rev ring buffers,
+ * and they're searched newest first.
  *
  * Changes below should be synced with ChAdvTCPAnalysis in the User's
  * Guide: docbook/wsug_src/WSUG_chapter_advanced.asciidoc
@@ -1847,19 +1931,25 @@ tcp_analyze_get_acked_struct(guint32 frame, guint32 seq, guint32 ack, gboolean c
 static void
 tcp_analyze_sequence_number(packet_info *pinfo, guint32 seq, guint32 ack, guint32 seglen, guint16 flags, guint32 window, struct tcp_analysis *tcpd)
 {
+    tcp_analyze_seq_flow_info_t *rev_info;
     tcp_unacked_t *ual=NULL;
-    tcp_unacked_t *prevual=NULL;
     guint32 nextseq;
+    guint16 i, keep_from;
     int ackcount;
+    nstime_t delta;
 
 #if 0
     printf("\nanalyze_sequence numbers   frame:%u\n",pinfo->num);
     printf("FWD list lastflags:0x%04x base_seq:%u: nextseq:%u lastack:%u\n",tcpd->fwd->lastsegmentflags,tcpd->fwd->base_seq,tcpd->fwd->tcp_analyze_seq_info->nextseq,tcpd->rev->tcp_analyze_seq_info->lastack);
-    for(ual=tcpd->fwd->tcp_analyze_seq_info->segments; ual; ual=ual->next)
+    for(i=tcpd->fwd->tcp_analyze_seq_info->segment_count; i-- > 0; ) {
+            ual=TCP_UNACKED_SEGMENT(tcpd->fwd->tcp_analyze_seq_info, i);
             printf("Frame:%d Seq:%u Nextseq:%u\n",ual->frame,ual->seq,ual->nextseq);
+    }
     printf("REV list lastflags:0x%04x base_seq:%u nextseq:%u lastack:%u\n",tcpd->rev->lastsegmentflags,tcpd->rev->base_seq,tcpd->rev->tcp_analyze_seq_info->nextseq,tcpd->fwd->tcp_analyze_seq_info->lastack);
-    for(ual=tcpd->rev->tcp_analyze_seq_info->segments; ual; ual=ual->next)
+    for(i=tcpd->rev->tcp_analyze_seq_info->segment_count; i-- > 0; ) {
+            ual=TCP_UNACKED_SEGMENT(tcpd->rev->tcp_analyze_seq_info, i);
             printf("Frame:%d Seq:%u Nextseq:%u\n",ual->frame,ual->seq,ual->nextseq);
+    }
 #endif
 
     if (!tcpd) {
@@ -2060,8 +2150,8 @@ tcp_analyze_sequence_number(packet_info *pinfo, guint32 seq, guint32 ack, guint3
             tcp_analyze_get_acked_struct(pinfo->num, seq, ack, TRUE, tcpd);
         }
         tcpd->ta->flags|=TCP_A_DUPLICATE_ACK;
-        tcpd->ta->dupack_num=tcpd->fwd->tcp_analyze_seq_info->dupacknum;
-        tcpd->ta->dupack_frame=tcpd->fwd->tcp_analyze_seq_info->lastnondupack;
+        tcp_analyze_get_acked_extra(tcpd)->dupack_num=tcpd->fwd->tcp_analyze_seq_info->dupacknum;
+        tcp_analyze_get_acked_extra(tcpd)->dupack_frame=tcpd->fwd->tcp_analyze_seq_info->lastnondupack;
     }
 
 
@@ -2178,8 +2268,8 @@ finished_fwd:
                 tcp_analyze_get_acked_struct(pinfo->num, seq, ack, TRUE, tcpd);
             }
             tcpd->ta->flags|=TCP_A_RETRANSMISSION;
-            nstime_delta(&tcpd->ta->rto_ts, &pinfo->abs_ts, &tcpd->fwd->tcp_analyze_seq_info->nextseqtime);
-            tcpd->ta->rto_frame=tcpd->fwd->tcp_analyze_seq_info->nextseqframe;
+            nstime_delta(&tcp_analyze_get_acked_extra(tcpd)->rto_ts, &pinfo->abs_ts, &tcpd->fwd->tcp_analyze_seq_info->nextseqtime);
+            tcp_analyze_get_acked_extra(tcpd)->rto_frame=tcpd->fwd->tcp_analyze_seq_info->nextseqframe;
         }
     }
 
@@ -2190,10 +2280,7 @@ finished_checking_retransmission_type:
         /* Add this new sequence number to the fwd list.  But only if there
          * aren't "too many" unacked segments (e.g., we're not seeing the ACKs).
          */
-        ual = wmem_new(wmem_file_scope(), tcp_unacked_t);
-        ual->next=tcpd->fwd->tcp_analyze_seq_info->segments;
-        tcpd->fwd->tcp_analyze_seq_info->segments=ual;
-        tcpd->fwd->tcp_analyze_seq_info->segment_count++;
+        ual = tcp_unacked_segment_add(tcpd->fwd->tcp_analyze_seq_info);
         ual->frame=pinfo->num;
         ual->seq=seq;
         ual->ts=pinfo->abs_ts;
@@ -2247,34 +2334,38 @@ finished_checking_retransmission_type:
 
 
     /* remove all segments this ACKs and we don't need to keep around any more
+     * (working from the newest, and moving the ones we keep up to close the gaps)
      */
     ackcount=0;
-    prevual = NULL;
-    ual = tcpd->rev->tcp_analyze_seq_info->segments;
-    while(ual) {
-        tcp_unacked_t *tmpual;
+    rev_info = tcpd->rev->tcp_analyze_seq_info;
+    keep_from = rev_info->segment_count;
+    for (i = rev_info->segment_count; i-- > 0; ) {
+        ual = TCP_UNACKED_SEGMENT(rev_info, i);
 
         /* If this ack matches the segment, process accordingly */
         if(ack==ual->nextseq) {
             tcp_analyze_get_acked_struct(pinfo->num, seq, ack, TRUE, tcpd);
             tcpd->ta->frame_acked=ual->frame;
-            nstime_delta(&tcpd->ta->ts, &pinfo->abs_ts, &ual->ts);
+            nstime_delta(&delta, &pinfo->abs_ts, &ual->ts);
+            tcpd->ta->ack_rtt_secs = (gint32)CLAMP(delta.secs, G_MININT32, G_MAXINT32);
+            tcpd->ta->ack_rtt_nsecs = delta.nsecs;
         }
         /* If this acknowledges part of the segment, adjust the segment info for the acked part */
         else if (GT_SEQ(ack, ual->seq) && LE_SEQ(ack, ual->nextseq)) {
             ual->seq = ack;
-            continue;
         }
+
         /* If this acknowledges a segment prior to this one, leave this segment alone and move on */
-        else if (GT_SEQ(ual->nextseq,ack)) {
-            prevual = ual;
-            ual = ual->next;
+        if (ack!=ual->nextseq && GT_SEQ(ual->nextseq,ack)) {
+            keep_from--;
+            if (keep_from != i) {
+                *TCP_UNACKED_SEGMENT(rev_info, keep_from) = *ual;
+            }
             continue;
         }
 
         /* This segment is old, or an exact match.  Delete the segment from the list */
         ackcount++;
-        tmpual=ual->next;
 
         if (tcpd->rev->scps_capable) {
           /* Track largest segment successfully sent for SNACK analysis*/
@@ -2282,35 +2373,30 @@ finished_checking_retransmission_type:
             tcpd->fwd->maxsizeacked = (ual->nextseq - ual->seq);
           }
         }
-
-        if (!prevual) {
-            tcpd->rev->tcp_analyze_seq_info->segments = tmpual;
-        }
-        else{
-            prevual->next = tmpual;
-        }
-        wmem_free(wmem_file_scope(), ual);
-        ual = tmpual;
-        tcpd->rev->tcp_analyze_seq_info->segment_count--;
+    }
+    if (keep_from) {
+        rev_info->segment_first = (rev_info->segment_first + keep_from) % rev_info->segment_alloc;
+        rev_info->segment_count -= keep_from;
     }
 
     /* how many bytes of data are there in flight after this frame
      * was sent
      */
-    ual=tcpd->fwd->tcp_analyze_seq_info->segments;
-    if (tcp_track_bytes_in_flight && seglen!=0 && ual && tcpd->fwd->valid_bif) {
+    if (tcp_track_bytes_in_flight && seglen!=0 && tcpd->fwd->tcp_analyze_seq_info->segment_count && tcpd->fwd->valid_bif) {
+        tcp_analyze_seq_flow_info_t *fwd_info = tcpd->fwd->tcp_analyze_seq_info;
         guint32 first_seq, last_seq, in_flight;
 
+        ual = TCP_UNACKED_SEGMENT(fwd_info, fwd_info->segment_count - 1);
         first_seq = ual->seq - tcpd->fwd->base_seq;
         last_seq = ual->nextseq - tcpd->fwd->base_seq;
-        while (ual) {
+        for (i = fwd_info->segment_count; i-- > 0; ) {
+            ual = TCP_UNACKED_SEGMENT(fwd_info, i);
             if ((ual->nextseq-tcpd->fwd->base_seq)>last_seq) {
                 last_seq = ual->nextseq-tcpd->fwd->base_seq;
             }
             if ((ual->seq-tcpd->fwd->base_seq)<first_seq) {
                 first_seq = ual->seq-tcpd->fwd->base_seq;
             }
-            ual = ual->next;
         }
         in_flight = last_seq-first_seq;
 
@@ -2349,7 +2435,8 @@ static void
 tcp_sequence_number_analysis_print_retransmission(packet_info * pinfo,
                           tvbuff_t * tvb,
                           proto_tree * flags_tree, proto_item * flags_item,
-                          struct tcp_acked *ta
+                          struct tcp_acked *ta,
+                          struct tcp_acked_extra *extra
                           )
 {
     /* TCP Retransmission */
@@ -2358,12 +2445,12 @@ tcp_sequence_number_analysis_print_retransmission(packet_info * pinfo,
 
         col_prepend_fence_fstr(pinfo->cinfo, COL_INFO, "[TCP Retransmission] ");
 
-        if (ta->rto_ts.secs || ta->rto_ts.nsecs) {
+        if (extra && (extra->rto_ts.secs || extra->rto_ts.nsecs)) {
             flags_item = proto_tree_add_time(flags_tree, hf_tcp_analysis_rto,
-                                             tvb, 0, 0, &ta->rto_ts);
+                                             tvb, 0, 0, &extra->rto_ts);
             PROTO_ITEM_SET_GENERATED(flags_item);
             flags_item=proto_tree_add_uint(flags_tree, hf_tcp_analysis_rto_frame,
-                                           tvb, 0, 0, ta->rto_frame);
+                                           tvb, 0, 0, extra->rto_frame);
             PROTO_ITEM_SET_GENERATED(flags_item);
         }
     }
@@ -2469,13 +2556,14 @@ tcp_sequence_number_analysis_print_duplicate(packet_info * pinfo,
                           tvbuff_t * tvb,
                           proto_tree * flags_tree,
                           struct tcp_acked *ta,
+                          struct tcp_acked_extra *extra,
                           proto_tree * tree
                         )
 {
     proto_item * flags_item;
 
     /* TCP Duplicate ACK */
-    if (ta->dupack_num) {
+    if (extra && extra->dupack_num) {
         if (ta->flags & TCP_A_DUPLICATE_ACK ) {
             flags_item=proto_tree_add_none_format(flags_tree,
                                                   hf_tcp_analysis_duplicate_ack,
@@ -2485,18 +2573,18 @@ tcp_sequence_number_analysis_print_duplicate(packet_info * pinfo,
             PROTO_ITEM_SET_GENERATED(flags_item);
             col_prepend_fence_fstr(pinfo->cinfo, COL_INFO,
                                    "[TCP Dup ACK %u#%u] ",
-                                   ta->dupack_frame,
-                                   ta->dupack_num
+                                   extra->dupack_frame,
+                                   extra->dupack_num
                 );
 
         }
         flags_item=proto_tree_add_uint(tree, hf_tcp_analysis_duplicate_ack_num,
-                                       tvb, 0, 0, ta->dupack_num);
+                                       tvb, 0, 0, extra->dupack_num);
         PROTO_ITEM_SET_GENERATED(flags_item);
         flags_item=proto_tree_add_uint(tree, hf_tcp_analysis_duplicate_ack_frame,
-                                       tvb, 0, 0, ta->dupack_frame);
+                                       tvb, 0, 0, extra->dupack_frame);
         PROTO_ITEM_SET_GENERATED(flags_item);
-        expert_add_info_format(pinfo, flags_item, &ei_tcp_analysis_duplicate_ack, "Duplicate ACK (#%u)", ta->dupack_num);
+        expert_add_info_format(pinfo, flags_item, &ei_tcp_analysis_duplicate_ack, "Duplicate ACK (#%u)", extra->dupack_num);
     }
 }
 
@@ -2867,9 +2955,11 @@ tcp_print_sequence_number_analysis(packet_info *pinfo, tvbuff_t *tvb, proto_tree
                           struct tcp_analysis *tcpd, guint32 seq, guint32 ack)
 {
     struct tcp_acked *ta = NULL;
+    struct tcp_acked_extra *extra;
     proto_item *item;
     proto_tree *tree;
     proto_tree *flags_tree=NULL;
+    nstime_t ack_rtt;
 
     if (!tcpd) {
         return;
@@ -2881,6 +2971,7 @@ tcp_print_sequence_number_analysis(packet_info *pinfo, tvbuff_t *tvb, proto_tree
     if(!ta) {
         return;
     }
+    extra=tcp_analyze_lookup_acked_extra(tcpd, ta);
 
     item=proto_tree_add_item(parent_tree, hf_tcp_analysis, tvb, 0, 0, ENC_NA);
     PROTO_ITEM_SET_GENERATED(item);
@@ -2894,9 +2985,11 @@ tcp_print_sequence_number_analysis(packet_info *pinfo, tvbuff_t *tvb, proto_tree
             PROTO_ITEM_SET_GENERATED(item);
 
         /* only display RTT if we actually have something we are acking */
-        if( ta->ts.secs || ta->ts.nsecs ) {
+        if( ta->ack_rtt_secs || ta->ack_rtt_nsecs ) {
+            ack_rtt.secs = ta->ack_rtt_secs;
+            ack_rtt.nsecs = ta->ack_rtt_nsecs;
             item = proto_tree_add_time(tree, hf_tcp_analysis_ack_rtt,
-            tvb, 0, 0, &ta->ts);
+            tvb, 0, 0, &ack_rtt);
                 PROTO_ITEM_SET_GENERATED(item);
         }
     }
@@ -2921,7 +3014,7 @@ tcp_print_sequence_number_analysis(packet_info *pinfo, tvbuff_t *tvb, proto_tree
         tcp_sequence_number_analysis_print_reused(pinfo, item, ta);
 
         /* print results for retransmission and out-of-order segments */
-        tcp_sequence_number_analysis_print_retransmission(pinfo, tvb, flags_tree, item, ta);
+        tcp_sequence_number_analysis_print_retransmission(pinfo, tvb, flags_tree, item, ta, extra);
 
         /* print results for lost tcp segments */
         tcp_sequence_number_analysis_print_lost(pinfo, item, ta);
@@ -2933,7 +3026,7 @@ tcp_print_sequence_number_analysis(packet_info *pinfo, tvbuff_t *tvb, proto_tree
         tcp_sequence_number_analysis_print_keepalive(pinfo, item, ta);
 
         /* print results for tcp duplicate acks */
-        tcp_sequence_number_analysis_print_duplicate(pinfo, tvb, flags_tree, ta, tree);
+        tcp_sequence_number_analysis_print_duplicate(pinfo, tvb, flags_tree, ta, extra, tree);
 
         /* print results for tcp zero window  */
         tcp_sequence_number_analysis_print_zero_window(pinfo, item, ta);
@@ -142,26 +142,44 @@ tcp_dissect_pdus(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree,
 extern struct tcp_multisegment_pdu *
 pdu_store_sequencenumber_of_next_pdu(packet_info *pinfo, guint32 seq, guint32 nxtpdu, wmem_tree_t *multisegment_pdus);
 
+/* A segment for which we haven't seen an ACK yet; these are kept in a ring
+ * buffer per flow, see tcp_analyze_seq_flow_info_t.
+ */
 typedef struct _tcp_unacked_t {
-	struct _tcp_unacked_t *next;
 	guint32 frame;
 	guint32	seq;
 	guint32	nextseq;
 	nstime_t ts;
 } tcp_unacked_t;
 
-struct tcp_acked {
-	guint32 frame_acked;
-	nstime_t ts;
-
+/* The parts of the analysis of a segment that only retransmissions,
+ * duplicate ACKs and extra segments in the same frame have, so that the
+ * other segments don't pay for them.
+ */
+struct tcp_acked_extra {
+	struct tcp_acked *next;	/* Another segment in the same frame */
 	guint32  rto_frame;
 	nstime_t rto_ts;	/* Time since previous packet for
 				   retransmissions. */
-	guint16 flags; /* see TCP_A_* in packet-tcp.c */
 	guint32 dupack_num;	/* dup ack number */
 	guint32 dupack_frame;	/* dup ack to frame # */
+};
+
+/* One of these is kept for every analysed segment, so it's packed into
+ * 32 bytes: the ACK RTT is kept as two 32-bit halves rather than an
+ * nstime_t, and everything else is in a struct tcp_acked_extra.
+ */
+struct tcp_acked {
+	guint32 seq;
+	guint32 ack;
+
+	guint32 frame_acked;
+	gint32  ack_rtt_secs;
+	gint32  ack_rtt_nsecs;
 	guint32 bytes_in_flight; /* number of bytes in flight */
 	guint32 push_bytes_sent; /* bytes since the last PSH flag */
+	guint32 flags : 16;	/* see TCP_A_* in packet-tcp.c */
+	guint32 has_extra : 1;	/* there's a tcp_acked_extra for it */
 };
 
 /* One instance of this structure is created for each pdu that spans across
@@ -282,8 +300,10 @@ typedef enum {
  * is enabled, so save the memory when it isn't
  */
 typedef struct tcp_analyze_seq_flow_info_t {
-	tcp_unacked_t *segments;/* List of segments for which we haven't seen an ACK */
+	tcp_unacked_t *segments;/* Ring buffer of segments for which we haven't seen an ACK, oldest first */
+	guint16 segment_first;	/* Index in segments of the oldest one */
 	guint16 segment_count;	/* How many unacked segments we're currently storing */
+	guint16 segment_alloc;	/* How many segments there's room for */
     guint32 lastack;	/* Last seen ack for the reverse flow */
 	nstime_t lastacktime;	/* Time of the last ack packet */
 	guint32 lastnondupack;	/* frame number of last seen non dupack */
@@ -395,10 +415,14 @@ struct tcp_analysis {
 	 * similar
 	 */
 	struct tcp_acked *ta;
-	/* This structure contains a tree containing all the various ta's
-	 * keyed by frame number.
+	/* This map contains all the various ta's keyed by frame number; any
+	 * other segments in the same frame are chained off the first one.
+	 */
+	wmem_map_t	*acked_table;
+	/* This map contains the tcp_acked_extra of the ta's that have one,
+	 * keyed by the ta; it's only created when it's first needed.
 	 */
-	wmem_tree_t	*acked_table;
+	wmem_map_t	*acked_extra_table;
 
 	/* Remember the timestamp of the first frame seen in this tcp
 	 * conversation to be able to calculate a relative time compared
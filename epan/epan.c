@@ -319,6 +319,7 @@ epan_cleanup(void)
 	packet_cleanup();
 	prefs_cleanup();
 	proto_cleanup();
+	value_string_cleanup();
 
 	conversation_filters_cleanup();
 	reassembly_table_cleanup();
@@ -401,6 +402,17 @@ epan_get_interface_description(const epan_t *session, guint32 interface_id)
 	return NULL;
 }
 
+const nstime_t *
+epan_get_shift_offset(const epan_t *session, const frame_data *fd)
+{
+	static const nstime_t zero_offset = { 0, 0 };
+
+	if (fd->flags.has_shift_offset && session->funcs.get_shift_offset)
+		return session->funcs.get_shift_offset(session->prov, fd);
+
+	return &zero_offset;
+}
+
 const nstime_t *
 epan_get_frame_ts(const epan_t *session, guint32 frame_num)
 {
@@ -762,6 +774,14 @@ epan_get_compiled_version_info(GString *str)
 	g_string_append(str, "without LZ4");
 #endif /* HAVE_LZ4 */
 
+	/* Zstandard */
+	g_string_append(str, ", ");
+#ifdef HAVE_ZSTD
+	g_string_append(str, "with Zstandard");
+#else
+	g_string_append(str, "without Zstandard");
+#endif /* HAVE_ZSTD */
+
 	/* Snappy */
 	g_string_append(str, ", ");
 #ifdef HAVE_SNAPPY
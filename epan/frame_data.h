@@ -47,7 +47,21 @@ typedef enum {
 
 /** The frame number is the ordinal number of the frame in the capture, so
    it's 1-origin.  In various contexts, 0 as a frame number means "frame
-   number unknown". */
+   number unknown".
+
+   Everything below is still stored in every frame_data; only the time
+   shift offset lives in a sparse side store (see frame_data_sequence.h).
+   The rest stays because callers hold and modify frame_data pointers
+   from frame_data_sequence_find(), so a frame has to be one addressable
+   struct, and because these fields are used on every pass:
+   - num, pkt_len, cap_len, file_off and tsprec are needed to re-read
+     the record with wtap_seek_read();
+   - abs_ts, cum_bytes, frame_ref_num and prev_dis_num feed the time
+     and byte columns and are recomputed whenever the display filter
+     or time references change;
+   - pfd is written by dissectors on the first pass and read back on
+     every later one, so it can't be rebuilt lazily;
+   - flags and color_filter are read for every row the packet list draws. */
 struct _color_filter; /* Forward */
 DIAG_OFF_PEDANTIC
 typedef struct _frame_data {
@@ -72,12 +86,12 @@ typedef struct _frame_data {
     unsigned int has_phdr_comment : 1; /** 1 = there's comment for this packet */
     unsigned int has_user_comment : 1; /** 1 = user set (also deleted) comment for this packet */
     unsigned int need_colorize  : 1; /**< 1 = need to (re-)calculate packet color */
+    unsigned int has_shift_offset : 1; /**< 1 = time stamp has been shifted, see frame_data_sequence_get_shift_offset() */
   } flags;
 
   const struct _color_filter *color_filter;  /**< Per-packet matching color_filter_t object */
 
   nstime_t     abs_ts;       /**< Absolute timestamp */
-  nstime_t     shift_offset; /**< How much the abs_tm of the frame is shifted */
   guint32      frame_ref_num; /**< Previous reference frame (0 if this is one) */
   guint32      prev_dis_num; /**< Previous displayed frame (0 if first one) */
 } frame_data;
@@ -94,7 +108,7 @@ WS_DLL_PUBLIC void frame_data_init(frame_data *fdata, guint32 num,
                 const wtap_rec *rec, gint64 offset,
                 guint32 cum_bytes);
 
-extern void frame_delta_abs_time(const struct epan_session *epan, const frame_data *fdata,
+WS_DLL_PUBLIC void frame_delta_abs_time(const struct epan_session *epan, const frame_data *fdata,
                 guint32 prev_num, nstime_t *delta);
 /**
  * Sets the frame data struct values before dissection.
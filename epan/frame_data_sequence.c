@@ -32,8 +32,17 @@
 struct _frame_data_sequence {
   guint32      count;           /* Total number of frames */
   void        *ptree_root;      /* Pointer to the root node */
+  GPtrArray   *shift_offsets;   /* Time shift offsets, see below */
 };
 
+/*
+ * Time shift offsets are only set when the user shifts time stamps,
+ * so rather than having a field in every frame_data, they're kept in
+ * arrays of NODES_PER_LEVEL offsets, one per leaf node's worth of
+ * frames, allocated the first time an offset in that range is set.
+ */
+static const nstime_t zero_shift_offset = { 0, 0 };
+
 /*
  * For a given frame number, calculate the indices into a level 3
  * node, a level 2 node, a level 1 node, and a leaf node.
@@ -55,6 +64,7 @@ new_frame_data_sequence(void)
   fds = (frame_data_sequence *)g_malloc(sizeof *fds);
   fds->count = 0;
   fds->ptree_root = NULL;
+  fds->shift_offsets = NULL;
   return fds;
 }
 
@@ -224,6 +234,71 @@ frame_data_sequence_find(frame_data_sequence *fds, guint32 num)
   return &leaf[LEAF_INDEX(num)];
 }
 
+/*
+ * Get the time shift offset for the specified frame number; if the
+ * frame's time stamp hasn't been shifted, that's zero.
+ */
+const nstime_t *
+frame_data_sequence_get_shift_offset(frame_data_sequence *fds, guint32 num)
+{
+  nstime_t *offsets;
+
+  if (num == 0 || fds->shift_offsets == NULL)
+    return &zero_shift_offset;
+
+  num--;
+  if ((num >> LOG2_NODES_PER_LEVEL) >= fds->shift_offsets->len)
+    return &zero_shift_offset;
+
+  offsets = (nstime_t *)g_ptr_array_index(fds->shift_offsets, num >> LOG2_NODES_PER_LEVEL);
+  if (offsets == NULL)
+    return &zero_shift_offset;
+  return &offsets[LEAF_INDEX(num)];
+}
+
+/*
+ * Set the time shift offset for the specified frame number, and
+ * record in its frame_data whether it has one.
+ */
+void
+frame_data_sequence_set_shift_offset(frame_data_sequence *fds, guint32 num,
+    const nstime_t *offset)
+{
+  frame_data *fdata;
+  nstime_t *offsets;
+  guint chunk;
+
+  fdata = frame_data_sequence_find(fds, num);
+  if (fdata == NULL)
+    return;
+
+  if (offset->secs == 0 && offset->nsecs == 0) {
+    /* Nothing to allocate; just clear any offset we have. */
+    if (fdata->flags.has_shift_offset) {
+      num--;
+      offsets = (nstime_t *)g_ptr_array_index(fds->shift_offsets, num >> LOG2_NODES_PER_LEVEL);
+      nstime_set_zero(&offsets[LEAF_INDEX(num)]);
+      fdata->flags.has_shift_offset = 0;
+    }
+    return;
+  }
+
+  if (fds->shift_offsets == NULL)
+    fds->shift_offsets = g_ptr_array_new_with_free_func(g_free);
+
+  num--;
+  chunk = num >> LOG2_NODES_PER_LEVEL;
+  if (chunk >= fds->shift_offsets->len)
+    g_ptr_array_set_size(fds->shift_offsets, chunk + 1);
+  offsets = (nstime_t *)g_ptr_array_index(fds->shift_offsets, chunk);
+  if (offsets == NULL) {
+    offsets = g_new0(nstime_t, NODES_PER_LEVEL);
+    g_ptr_array_index(fds->shift_offsets, chunk) = offsets;
+  }
+  offsets[LEAF_INDEX(num)] = *offset;
+  fdata->flags.has_shift_offset = 1;
+}
+
 /* recursively frees a frame_data radix level */
 static void
 free_frame_data_array(void *array, guint count, guint level, gboolean last)
@@ -307,6 +382,10 @@ free_frame_data_sequence(frame_data_sequence *fds)
     free_frame_data_array(fds->ptree_root, fds->count, levels, TRUE);
   }
 
+  if (fds->shift_offsets != NULL) {
+    g_ptr_array_free(fds->shift_offsets, TRUE);
+  }
+
   /* free the header struct */
   g_free(fds);
 }
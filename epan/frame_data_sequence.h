@@ -28,6 +28,20 @@ WS_DLL_PUBLIC frame_data *frame_data_sequence_add(frame_data_sequence *fds,
 WS_DLL_PUBLIC frame_data *frame_data_sequence_find(frame_data_sequence *fds,
     guint32 num);
 
+/*
+ * Get the amount by which the time stamp of the specified frame number
+ * has been shifted; that's zero if it hasn't been shifted.
+ */
+WS_DLL_PUBLIC const nstime_t *frame_data_sequence_get_shift_offset(
+    frame_data_sequence *fds, guint32 num);
+
+/*
+ * Set the amount by which the time stamp of the specified frame number
+ * has been shifted.  This doesn't change the frame's time stamp.
+ */
+WS_DLL_PUBLIC void frame_data_sequence_set_shift_offset(
+    frame_data_sequence *fds, guint32 num, const nstime_t *offset);
+
 /*
  * Free a frame_data_sequence and all the frame_data structures in it.
  */
@@ -34,6 +34,7 @@ static mmdb_lookup_t mmdb_not_found;
 #include <wsutil/filesystem.h>
 #include <wsutil/ws_pipe.h>
 #include <wsutil/strtoi.h>
+#include <wsutil/pint.h>
 
 // To do:
 // - Add RBL lookups? Along with the "is this a spammer" information that most RBL databases
@@ -134,6 +135,523 @@ static void init_lookup(mmdb_lookup_t *lookup) {
     *lookup = empty_lookup;
 }
 
+/*
+ * In-process lookups. The databases are mapped and searched directly
+ * according to the MaxMind DB file format specification
+ * (https://maxmind.github.io/MaxMind-DB/), which avoids the round trip to
+ * mmdbresolve and returns results immediately. libmaxminddb is not used
+ * since its license is not compatible with the GPL-2.
+ */
+
+#define MMDB_METADATA_MARKER        "\xab\xcd\xefMaxMind.com"
+#define MMDB_METADATA_MARKER_LEN    14
+#define MMDB_METADATA_MAX_SIZE      (128 * 1024)
+#define MMDB_DATA_SEPARATOR_LEN     16
+#define MMDB_MAX_DEPTH              32
+
+/* Data field types */
+#define MMDB_TYPE_EXTENDED  0
+#define MMDB_TYPE_POINTER   1
+#define MMDB_TYPE_UTF8      2
+#define MMDB_TYPE_DOUBLE    3
+#define MMDB_TYPE_UINT16    5
+#define MMDB_TYPE_UINT32    6
+#define MMDB_TYPE_MAP       7
+#define MMDB_TYPE_INT32     8
+#define MMDB_TYPE_UINT64    9
+#define MMDB_TYPE_ARRAY     11
+#define MMDB_TYPE_BOOLEAN   14
+#define MMDB_TYPE_FLOAT     15
+
+typedef struct _mmdb_reader_t {
+    GMappedFile *mapped;
+    const guint8 *tree;         // Binary search tree
+    const guint8 *data;         // Data section
+    gsize data_len;
+    guint32 node_count;
+    guint record_size;          // Bits per record: 24, 28 or 32
+    guint node_size;            // Bytes per node
+    guint32 ipv4_start;         // Node of ::/96 in IPv6 trees
+    guint ip_version;
+} mmdb_reader_t;
+
+// A decoded data field. Pointers are followed, "next" is the offset after
+// the field as it was encountered.
+typedef struct {
+    guint type;
+    guint32 size;               // Length, number of entries or boolean value
+    gsize pos;                  // Offset of the payload
+    gsize next;
+} mmdb_field_t;
+
+static GPtrArray *mmdb_readers; // mmdb_reader_t *, NULL if not opened yet
+
+// Bounded cache of in-process lookup results. IPv4 addresses are stored as
+// IPv4-mapped IPv6 addresses, so both share the cache.
+#define MMDB_CACHE_SIZE 65536
+
+typedef struct _mmdb_cache_entry_t {
+    ws_in6_addr addr;
+    const mmdb_lookup_t *result;
+    GList *lru_link;            // Link in mmdb_cache_lru
+} mmdb_cache_entry_t;
+
+static GHashTable *mmdb_cache;  // ws_in6_addr -> mmdb_cache_entry_t
+static GQueue mmdb_cache_lru = G_QUEUE_INIT; // Least recently used first
+
+// Interned lookup results, referenced by the cache entries.
+static wmem_map_t *mmdb_lookup_chunk;
+
+static gboolean mmdb_in_process;
+// The value of mmdb_in_process when mmdbresolve was last (not) started.
+static gboolean mmdb_resolve_in_process;
+
+static gboolean
+mmdb_decode_field(const guint8 *data, gsize data_len, gsize offset, mmdb_field_t *field)
+{
+    guint ctrl, type, size_len;
+    guint32 size;
+
+    if (offset >= data_len) return FALSE;
+    ctrl = data[offset++];
+    type = ctrl >> 5;
+
+    if (type == MMDB_TYPE_POINTER) {
+        guint ptr_len = ((ctrl >> 3) & 0x3) + 1;
+        guint32 ptr;
+
+        if (ptr_len > data_len - offset) return FALSE;
+        switch (ptr_len) {
+        case 1:
+            ptr = ((ctrl & 0x7) << 8) | data[offset];
+            break;
+        case 2:
+            ptr = (((ctrl & 0x7) << 16) | pntoh16(data + offset)) + 2048;
+            break;
+        case 3:
+            ptr = (((ctrl & 0x7) << 24) | pntoh24(data + offset)) + 526336;
+            break;
+        default:
+            ptr = pntoh32(data + offset);
+            break;
+        }
+        // A pointer must not point to another pointer.
+        if (ptr >= data_len || data[ptr] >> 5 == MMDB_TYPE_POINTER) return FALSE;
+        if (!mmdb_decode_field(data, data_len, ptr, field)) return FALSE;
+        field->next = offset + ptr_len;
+        return TRUE;
+    }
+
+    if (type == MMDB_TYPE_EXTENDED) {
+        if (offset >= data_len) return FALSE;
+        type = 7 + data[offset++];
+    }
+
+    size = ctrl & 0x1f;
+    size_len = size > 28 ? size - 28 : 0;
+    if (size_len > data_len - offset) return FALSE;
+    switch (size_len) {
+    case 1:
+        size = 29 + data[offset];
+        break;
+    case 2:
+        size = 285 + pntoh16(data + offset);
+        break;
+    case 3:
+        size = 65821 + pntoh24(data + offset);
+        break;
+    }
+    offset += size_len;
+
+    field->type = type;
+    field->size = size;
+    field->pos = offset;
+    if (type == MMDB_TYPE_MAP || type == MMDB_TYPE_ARRAY || type == MMDB_TYPE_BOOLEAN) {
+        // The contents of containers are skipped by mmdb_skip_field.
+        field->next = offset;
+    } else {
+        if (size > data_len - offset) return FALSE;
+        field->next = offset + size;
+    }
+    return TRUE;
+}
+
+// Returns the offset after the field at "offset", including all of its
+// entries.
+static gboolean
+mmdb_skip_field(const guint8 *data, gsize data_len, gsize offset, guint depth, gsize *next)
+{
+    mmdb_field_t field;
+    guint32 entries;
+
+    if (depth > MMDB_MAX_DEPTH) return FALSE;
+    if (!mmdb_decode_field(data, data_len, offset, &field)) return FALSE;
+    if (data[offset] >> 5 == MMDB_TYPE_POINTER ||
+            (field.type != MMDB_TYPE_MAP && field.type != MMDB_TYPE_ARRAY)) {
+        // Scalar, or a container that is stored elsewhere.
+        *next = field.next;
+        return TRUE;
+    }
+
+    entries = field.type == MMDB_TYPE_MAP ? field.size * 2 : field.size;
+    offset = field.pos;
+    for (guint32 i = 0; i < entries; i++) {
+        if (!mmdb_skip_field(data, data_len, offset, depth + 1, &offset)) return FALSE;
+    }
+    *next = offset;
+    return TRUE;
+}
+
+// Follows a path of map keys starting at the field at "offset".
+static gboolean
+mmdb_find_field(const guint8 *data, gsize data_len, gsize offset, const char **path, mmdb_field_t *field)
+{
+    for (; *path; path++) {
+        size_t key_len = strlen(*path);
+        gboolean found = FALSE;
+
+        if (!mmdb_decode_field(data, data_len, offset, field) || field->type != MMDB_TYPE_MAP) {
+            return FALSE;
+        }
+        offset = field->pos;
+        for (guint32 i = 0; i < field->size && !found; i++) {
+            mmdb_field_t key;
+
+            if (!mmdb_decode_field(data, data_len, offset, &key) || key.type != MMDB_TYPE_UTF8) {
+                return FALSE;
+            }
+            offset = key.next;
+            if (key.size == key_len && memcmp(data + key.pos, *path, key_len) == 0) {
+                found = TRUE;
+            } else if (!mmdb_skip_field(data, data_len, offset, 0, &offset)) {
+                return FALSE;
+            }
+        }
+        if (!found) {
+            return FALSE;
+        }
+    }
+    return mmdb_decode_field(data, data_len, offset, field);
+}
+
+static gboolean
+mmdb_field_get_uint(const guint8 *data, const mmdb_field_t *field, guint64 *value)
+{
+    switch (field->type) {
+    case MMDB_TYPE_UINT16:
+    case MMDB_TYPE_UINT32:
+    case MMDB_TYPE_INT32:
+    case MMDB_TYPE_UINT64:
+        if (field->size > 8) return FALSE;
+        *value = 0;
+        for (guint32 i = 0; i < field->size; i++) {
+            *value = (*value << 8) | data[field->pos + i];
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean
+mmdb_field_get_double(const guint8 *data, const mmdb_field_t *field, double *value)
+{
+    if (field->type == MMDB_TYPE_DOUBLE && field->size == 8) {
+        union { guint64 u; double d; } conv;
+        conv.u = pntoh64(data + field->pos);
+        *value = conv.d;
+        return TRUE;
+    } else if (field->type == MMDB_TYPE_FLOAT && field->size == 4) {
+        union { guint32 u; float f; } conv;
+        conv.u = pntoh32(data + field->pos);
+        *value = conv.f;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static const char *
+mmdb_field_get_string(const guint8 *data, const mmdb_field_t *field)
+{
+    if (field->type != MMDB_TYPE_UTF8) return NULL;
+
+    char *str = g_strndup((const char *) data + field->pos, field->size);
+    const char *chunk = chunkify_string(str);
+    g_free(str);
+    return chunk;
+}
+
+static guint32
+mmdb_read_record(const mmdb_reader_t *reader, guint32 node, guint bit)
+{
+    const guint8 *rec = reader->tree + (gsize) node * reader->node_size;
+
+    switch (reader->record_size) {
+    case 24:
+        return pntoh24(rec + bit * 3);
+    case 28:
+        if (bit) {
+            return ((guint32) (rec[3] & 0x0f) << 24) | pntoh24(rec + 4);
+        }
+        return ((guint32) (rec[3] & 0xf0) << 20) | pntoh24(rec);
+    default:
+        return pntoh32(rec + bit * 4);
+    }
+}
+
+// Walks the search tree and returns the data section offset of the entry
+// for the address.
+static gboolean
+mmdb_reader_search(const mmdb_reader_t *reader, guint32 node, const guint8 *addr, guint bits, gsize *offset)
+{
+    for (guint i = 0; i < bits && node < reader->node_count; i++) {
+        node = mmdb_read_record(reader, node, (addr[i >> 3] >> (7 - (i & 7))) & 1);
+    }
+    if (node <= reader->node_count) {
+        // Not found (or a corrupt tree that is deeper than the address).
+        return FALSE;
+    }
+    *offset = node - reader->node_count - MMDB_DATA_SEPARATOR_LEN;
+    return *offset < reader->data_len;
+}
+
+static mmdb_reader_t *
+mmdb_reader_open(const char *path)
+{
+    GMappedFile *mapped = g_mapped_file_new(path, FALSE, NULL);
+    if (!mapped) {
+        MMDB_DEBUG("can't map %s", path);
+        return NULL;
+    }
+
+    const guint8 *contents = (const guint8 *) g_mapped_file_get_contents(mapped);
+    gsize len = g_mapped_file_get_length(mapped);
+
+    // The metadata follows the last marker within the last 128 KiB.
+    gsize search_start = len > MMDB_METADATA_MAX_SIZE ? len - MMDB_METADATA_MAX_SIZE : 0;
+    const guint8 *marker = NULL;
+    for (gsize i = len >= MMDB_METADATA_MARKER_LEN ? len - MMDB_METADATA_MARKER_LEN + 1 : 0; i > search_start; i--) {
+        if (memcmp(contents + i - 1, MMDB_METADATA_MARKER, MMDB_METADATA_MARKER_LEN) == 0) {
+            marker = contents + i - 1;
+            break;
+        }
+    }
+    if (!marker) {
+        MMDB_DEBUG("no metadata in %s", path);
+        g_mapped_file_unref(mapped);
+        return NULL;
+    }
+
+    const guint8 *metadata = marker + MMDB_METADATA_MARKER_LEN;
+    gsize metadata_len = len - (gsize) (metadata - contents);
+    static const char *node_count_key[] = { "node_count", NULL };
+    static const char *record_size_key[] = { "record_size", NULL };
+    static const char *ip_version_key[] = { "ip_version", NULL };
+    mmdb_field_t field;
+    guint64 node_count, record_size, ip_version;
+
+    if (!mmdb_find_field(metadata, metadata_len, 0, node_count_key, &field) ||
+            !mmdb_field_get_uint(metadata, &field, &node_count) ||
+            !mmdb_find_field(metadata, metadata_len, 0, record_size_key, &field) ||
+            !mmdb_field_get_uint(metadata, &field, &record_size) ||
+            !mmdb_find_field(metadata, metadata_len, 0, ip_version_key, &field) ||
+            !mmdb_field_get_uint(metadata, &field, &ip_version) ||
+            (record_size != 24 && record_size != 28 && record_size != 32) ||
+            (ip_version != 4 && ip_version != 6) ||
+            node_count > G_MAXUINT32 ||
+            node_count * record_size / 4 + MMDB_DATA_SEPARATOR_LEN > (guint64) (marker - contents)) {
+        MMDB_DEBUG("invalid metadata in %s", path);
+        g_mapped_file_unref(mapped);
+        return NULL;
+    }
+
+    mmdb_reader_t *reader = g_new0(mmdb_reader_t, 1);
+    reader->mapped = mapped;
+    reader->node_count = (guint32) node_count;
+    reader->record_size = (guint) record_size;
+    reader->node_size = reader->record_size / 4;
+    reader->ip_version = (guint) ip_version;
+    reader->tree = contents;
+    reader->data = contents + (gsize) node_count * reader->node_size + MMDB_DATA_SEPARATOR_LEN;
+    reader->data_len = (gsize) (marker - reader->data);
+
+    // IPv4 addresses are found under ::/96 in IPv6 trees.
+    reader->ipv4_start = 0;
+    if (reader->ip_version == 6) {
+        for (guint i = 0; i < 96 && reader->ipv4_start < reader->node_count; i++) {
+            reader->ipv4_start = mmdb_read_record(reader, reader->ipv4_start, 0);
+        }
+    }
+
+    MMDB_DEBUG("opened %s: %u nodes, %u bit records, IPv%u", path, reader->node_count, reader->record_size, reader->ip_version);
+    return reader;
+}
+
+static void
+mmdb_reader_free(gpointer data)
+{
+    mmdb_reader_t *reader = (mmdb_reader_t *) data;
+    g_mapped_file_unref(reader->mapped);
+    g_free(reader);
+}
+
+static void mmdb_readers_close(void) {
+    if (mmdb_readers) {
+        g_ptr_array_free(mmdb_readers, TRUE);
+        mmdb_readers = NULL;
+    }
+    if (mmdb_cache) {
+        g_hash_table_destroy(mmdb_cache);
+        mmdb_cache = NULL;
+    }
+    g_queue_clear(&mmdb_cache_lru);
+}
+
+static gboolean mmdb_readers_open(void) {
+    if (mmdb_readers) {
+        return mmdb_readers->len > 0;
+    }
+
+    mmdb_readers = g_ptr_array_new_with_free_func(mmdb_reader_free);
+    for (guint i = 0; mmdb_file_arr && i < mmdb_file_arr->len; i++) {
+        mmdb_reader_t *reader = mmdb_reader_open((const char *) g_ptr_array_index(mmdb_file_arr, i));
+        if (reader) {
+            g_ptr_array_add(mmdb_readers, reader);
+        }
+    }
+    return mmdb_readers->len > 0;
+}
+
+static guint mmdb_lookup_hash(gconstpointer key) {
+    const mmdb_lookup_t *lookup = (const mmdb_lookup_t *) key;
+    // Strings are interned, so their addresses can be hashed.
+    return g_direct_hash(lookup->country) ^ g_direct_hash(lookup->city) ^
+           g_direct_hash(lookup->as_org) ^ g_int_hash(&lookup->as_number) ^
+           g_double_hash(&lookup->latitude) ^ g_double_hash(&lookup->longitude);
+}
+
+static gboolean mmdb_lookup_equal(gconstpointer v1, gconstpointer v2) {
+    const mmdb_lookup_t *l1 = (const mmdb_lookup_t *) v1;
+    const mmdb_lookup_t *l2 = (const mmdb_lookup_t *) v2;
+    return l1->found == l2->found && l1->country == l2->country &&
+           l1->country_iso == l2->country_iso && l1->city == l2->city &&
+           l1->as_number == l2->as_number && l1->as_org == l2->as_org &&
+           l1->latitude == l2->latitude && l1->longitude == l2->longitude;
+}
+
+// Looks up an address (IPv4 if "bits" is 32) in all databases. Later
+// databases override values of earlier ones, as with mmdbresolve.
+static const mmdb_lookup_t *
+mmdb_lookup_in_process(const guint8 *addr, guint bits) {
+    static const char *co_iso_key[]     = {"country", "iso_code", NULL};
+    static const char *co_name_key[]    = {"country", "names", "en", NULL};
+    static const char *ci_name_key[]    = {"city", "names", "en", NULL};
+    static const char *asn_o_key[]      = {"autonomous_system_organization", NULL};
+    static const char *asn_key[]        = {"autonomous_system_number", NULL};
+    static const char *l_lat_key[]      = {"location", "latitude", NULL};
+    static const char *l_lon_key[]      = {"location", "longitude", NULL};
+    mmdb_lookup_t cur_lookup;
+
+    init_lookup(&cur_lookup);
+
+    for (guint i = 0; i < mmdb_readers->len; i++) {
+        const mmdb_reader_t *reader = (const mmdb_reader_t *) g_ptr_array_index(mmdb_readers, i);
+        const guint8 *data = reader->data;
+        gsize data_len = reader->data_len;
+        mmdb_field_t field;
+        gsize offset;
+        guint64 as_number;
+        double coord;
+        const char *str;
+
+        if (bits == 128 && reader->ip_version == 4) continue;
+        if (!mmdb_reader_search(reader, bits == 32 ? reader->ipv4_start : 0, addr, bits, &offset)) continue;
+
+        if (mmdb_find_field(data, data_len, offset, co_iso_key, &field) &&
+                (str = mmdb_field_get_string(data, &field)) != NULL) {
+            cur_lookup.found = TRUE;
+            cur_lookup.country_iso = str;
+        }
+        if (mmdb_find_field(data, data_len, offset, co_name_key, &field) &&
+                (str = mmdb_field_get_string(data, &field)) != NULL) {
+            cur_lookup.found = TRUE;
+            cur_lookup.country = str;
+        }
+        if (mmdb_find_field(data, data_len, offset, ci_name_key, &field) &&
+                (str = mmdb_field_get_string(data, &field)) != NULL) {
+            cur_lookup.found = TRUE;
+            cur_lookup.city = str;
+        }
+        if (mmdb_find_field(data, data_len, offset, asn_o_key, &field) &&
+                (str = mmdb_field_get_string(data, &field)) != NULL) {
+            cur_lookup.found = TRUE;
+            cur_lookup.as_org = str;
+        }
+        if (mmdb_find_field(data, data_len, offset, asn_key, &field) &&
+                mmdb_field_get_uint(data, &field, &as_number) && as_number <= G_MAXUINT32) {
+            cur_lookup.found = TRUE;
+            cur_lookup.as_number = (guint32) as_number;
+        }
+        if (mmdb_find_field(data, data_len, offset, l_lat_key, &field) &&
+                mmdb_field_get_double(data, &field, &coord)) {
+            cur_lookup.found = TRUE;
+            cur_lookup.latitude = coord;
+        }
+        if (mmdb_find_field(data, data_len, offset, l_lon_key, &field) &&
+                mmdb_field_get_double(data, &field, &coord)) {
+            cur_lookup.found = TRUE;
+            cur_lookup.longitude = coord;
+        }
+    }
+
+    if (!cur_lookup.found) {
+        return &mmdb_not_found;
+    }
+
+    // Many addresses share a result, keep a single copy of each.
+    if (!mmdb_lookup_chunk) {
+        mmdb_lookup_chunk = wmem_map_new(wmem_epan_scope(), mmdb_lookup_hash, mmdb_lookup_equal);
+    }
+    mmdb_lookup_t *result = (mmdb_lookup_t *) wmem_map_lookup(mmdb_lookup_chunk, &cur_lookup);
+    if (!result) {
+        result = (mmdb_lookup_t *) wmem_memdup(wmem_epan_scope(), &cur_lookup, sizeof(cur_lookup));
+        wmem_map_insert(mmdb_lookup_chunk, result, result);
+    }
+    return result;
+}
+
+static const mmdb_lookup_t *
+mmdb_cache_lookup(const ws_in6_addr *addr, guint bits) {
+    mmdb_cache_entry_t *entry;
+
+    if (!mmdb_cache) {
+        mmdb_cache = g_hash_table_new_full(ipv6_oat_hash, ipv6_equal, NULL, g_free);
+    }
+
+    entry = (mmdb_cache_entry_t *) g_hash_table_lookup(mmdb_cache, addr);
+    if (entry) {
+        g_queue_unlink(&mmdb_cache_lru, entry->lru_link);
+        g_queue_push_tail_link(&mmdb_cache_lru, entry->lru_link);
+        return entry->result;
+    }
+
+    if (g_hash_table_size(mmdb_cache) >= MMDB_CACHE_SIZE) {
+        // Reuse the least recently used entry.
+        GList *link = g_queue_pop_head_link(&mmdb_cache_lru);
+        entry = (mmdb_cache_entry_t *) link->data;
+        g_hash_table_steal(mmdb_cache, &entry->addr);
+        g_list_free_1(link);
+    } else {
+        entry = g_new(mmdb_cache_entry_t, 1);
+    }
+
+    entry->addr = *addr;
+    entry->result = mmdb_lookup_in_process(bits == 32 ? addr->bytes + 12 : addr->bytes, bits);
+    g_queue_push_tail(&mmdb_cache_lru, entry);
+    entry->lru_link = mmdb_cache_lru.tail;
+    g_hash_table_insert(mmdb_cache, &entry->addr, entry);
+    return entry->result;
+}
+
 static gboolean mmdbr_pipe_valid(void) {
     g_mutex_lock(&mmdbr_pipe_mtx);
     gboolean pipe_valid = ws_pipe_valid(&mmdbr_pipe);
@@ -321,6 +839,12 @@ static void mmdb_resolve_start(void) {
 
     mmdb_resolve_stop();
 
+    mmdb_resolve_in_process = mmdb_in_process;
+    if (mmdb_in_process) {
+        MMDB_DEBUG("looking up in process, not starting mmdbresolve");
+        return;
+    }
+
     if (mmdb_file_arr->len == 0) {
         MMDB_DEBUG("no GeoIP databases found");
         return;
@@ -359,6 +883,17 @@ static void mmdb_resolve_start(void) {
     mmdbr_thread = g_thread_new("write_mmdbr_stdin_worker", write_mmdbr_stdin_worker, NULL);
 }
 
+/**
+ * Start or stop mmdbresolve if the preference was changed after the
+ * databases were scanned, e.g. by a later "-o" on the command line.
+ */
+static void mmdb_resolve_check_mode(void) {
+    if (mmdb_in_process == mmdb_resolve_in_process || !mmdb_file_arr) {
+        return;
+    }
+    mmdb_resolve_start();
+}
+
 /**
  * Scan a directory for GeoIP databases and load them
  */
@@ -404,6 +939,7 @@ static void maxmind_db_cleanup(void) {
     guint i;
 
     mmdb_resolve_stop();
+    mmdb_readers_close();
 
     /* If we have old data, clear out the whole thing
      * and start again. TODO: Just update the ones that
@@ -476,11 +1012,20 @@ maxmind_db_pref_init(module_t *nameres)
             " Wireshark will look in each directory for files ending"
             " with \".mmdb\".",
             maxmind_db_paths_uat);
+
+    prefs_register_bool_preference(nameres,
+            "maxmind_db_in_process",
+            "Look up GeoIP information in process",
+            "Read the MaxMind databases directly instead of querying them"
+            " through the mmdbresolve helper. Results are available"
+            " immediately, at the cost of mapping the databases into memory.",
+            &mmdb_in_process);
 }
 
 void maxmind_db_pref_cleanup(void)
 {
     mmdb_resolve_stop();
+    mmdb_readers_close();
 }
 
 /**
@@ -500,6 +1045,15 @@ gboolean maxmind_db_lookup_process(void)
 
 const mmdb_lookup_t *
 maxmind_db_lookup_ipv4(guint32 addr) {
+    mmdb_resolve_check_mode();
+
+    if (mmdb_in_process && mmdb_readers_open()) {
+        ws_in6_addr mapped_addr = {{ 0 }};
+        mapped_addr.bytes[10] = mapped_addr.bytes[11] = 0xff;
+        memcpy(mapped_addr.bytes + 12, &addr, 4);
+        return mmdb_cache_lookup(&mapped_addr, 32);
+    }
+
     mmdb_lookup_t *result = (mmdb_lookup_t *) wmem_map_lookup(mmdb_ipv4_map, GUINT_TO_POINTER(addr));
 
     if (!result) {
@@ -525,6 +1079,12 @@ maxmind_db_lookup_ipv4(guint32 addr) {
 
 const mmdb_lookup_t *
 maxmind_db_lookup_ipv6(const ws_in6_addr *addr) {
+    mmdb_resolve_check_mode();
+
+    if (mmdb_in_process && mmdb_readers_open()) {
+        return mmdb_cache_lookup(addr, 128);
+    }
+
     mmdb_lookup_t * result = (mmdb_lookup_t *) wmem_map_lookup(mmdb_ipv6_map, addr->bytes);
 
     if (!result) {
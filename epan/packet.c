@@ -314,6 +314,9 @@ init_dissection(void)
 	/* Initialize protocol-specific variables. */
 	g_slist_foreach(init_routines, &call_routine, NULL);
 
+	/* Init routines may have rebuilt value_strings in place. */
+	value_string_forget_all();
+
 	/* Initialize the stream-handling tables */
 	stream_init();
 
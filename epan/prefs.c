@@ -3618,6 +3618,19 @@ prefs_register_modules(void)
                                    "Currently only ICMP and ICMPv6 use this preference to add VLAN ID to conversation tracking",
                                    &prefs.strict_conversation_tracking_heuristics);
 
+    prefs_register_uint_preference(protocols_module, "reassembly_max_memory",
+                                   "Reassembly memory limit per table (MB)",
+                                   "The maximum amount of memory, in megabytes, that each reassembly table may use for "
+                                   "reassemblies in progress (and, if spilling is enabled, for completed reassemblies) "
+                                   "before the least recently used ones are discarded or spilled. 0 means no limit.",
+                                   10, &prefs.reassembly_max_memory);
+
+    prefs_register_bool_preference(protocols_module, "reassembly_spill",
+                                   "Spill reassembled data to a temporary file",
+                                   "When the reassembly memory limit is reached, write completed reassemblies to a "
+                                   "temporary file and read them back when they are needed, rather than keeping them in memory.",
+                                   &prefs.reassembly_spill);
+
     /* Obsolete preferences
      * These "modules" were reorganized/renamed to correspond to their GUI
      * configuration screen within the preferences dialog
@@ -4141,6 +4154,8 @@ pre_init_prefs(void)
     prefs.st_sort_showfullname = FALSE;
     prefs.display_hidden_proto_items = FALSE;
     prefs.display_byte_fields_with_spaces = FALSE;
+    prefs.reassembly_max_memory = 0;
+    prefs.reassembly_spill = FALSE;
 }
 
 /*
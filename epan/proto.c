@@ -5641,6 +5641,84 @@ hfinfo_remove_from_gpa_name_map(const header_field_info *hfinfo)
 	}
 }
 
+/* Return the first field with the field id's name that a custom column
+ * walks, i.e. the last one registered unless occurrence counts from the
+ * end, or NULL if the field id is invalid. */
+static header_field_info *
+proto_custom_first_hfinfo(int field_id, gint occurrence)
+{
+	header_field_info *hfinfo;
+
+	PROTO_REGISTRAR_GET_NTH((guint)field_id, hfinfo);
+
+	if (hfinfo && occurrence < 0) {
+		/* Search other direction */
+		while (hfinfo->same_name_prev_id != -1) {
+			PROTO_REGISTRAR_GET_NTH(hfinfo->same_name_prev_id, hfinfo);
+		}
+	}
+
+	return hfinfo;
+}
+
+/* Starting at *hfinfo_p, find the next field with the same name that has
+ * the occurrence a custom column shows. Returns its field_infos and sets
+ * *first and *last to the range of them to show, with *hfinfo_p set to
+ * the field, or returns NULL if there are no more. *prev_len counts the
+ * occurrences passed so far and must start at 0 for the first field id. */
+static GPtrArray *
+proto_custom_find_finfos(proto_tree *tree, header_field_info **hfinfo_p, gint occurrence,
+			 int *prev_len, int *first, int *last)
+{
+	header_field_info *hfinfo = *hfinfo_p;
+	GPtrArray         *finfos;
+	int                len;
+
+	while (hfinfo) {
+		finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
+
+		if (!finfos || !(len = g_ptr_array_len(finfos))) {
+			if (occurrence < 0) {
+				hfinfo = hfinfo->same_name_next;
+			} else {
+				hfinfo = hfinfo_same_name_get_prev(hfinfo);
+			}
+			continue;
+		}
+
+		/* Are there enough occurrences of the field? */
+		if (((occurrence - *prev_len) > len) || ((occurrence + *prev_len) < -len)) {
+			if (occurrence < 0) {
+				hfinfo = hfinfo->same_name_next;
+			} else {
+				hfinfo = hfinfo_same_name_get_prev(hfinfo);
+			}
+			*prev_len += len;
+			continue;
+		}
+
+		/* Calculate single index or set outer bounderies */
+		if (occurrence < 0) {
+			*first = occurrence + len + *prev_len;
+			*last = *first;
+		} else if (occurrence > 0) {
+			*first = occurrence - 1 - *prev_len;
+			*last = *first;
+		} else {
+			*first = 0;
+			*last = len - 1;
+		}
+
+		*prev_len += len; /* Count handled occurrences */
+
+		*hfinfo_p = hfinfo;
+		return finfos;
+	}
+
+	*hfinfo_p = NULL;
+	return NULL;
+}
+
 /* -------------------------- */
 const gchar *
 proto_custom_set(proto_tree* tree, GSList *field_ids, gint occurrence,
@@ -5655,7 +5733,7 @@ proto_custom_set(proto_tree* tree, GSList *field_ids, gint occurrence,
 
 	const true_false_string  *tfstring;
 
-	int                 len, prev_len = 0, last, i, offset_r = 0, offset_e = 0;
+	int                 prev_len = 0, last, i, offset_r = 0, offset_e = 0;
 	GPtrArray          *finfos;
 	field_info         *finfo         = NULL;
 	header_field_info*  hfinfo;
@@ -5666,62 +5744,17 @@ proto_custom_set(proto_tree* tree, GSList *field_ids, gint occurrence,
 	const char *number_out;
 	char *tmpbuf, *str;
 	int *field_idx;
-	int field_id;
 	int ii = 0;
 
 	g_assert(field_ids != NULL);
 	while ((field_idx = (int *) g_slist_nth_data(field_ids, ii++))) {
-		field_id = *field_idx;
-		PROTO_REGISTRAR_GET_NTH((guint)field_id, hfinfo);
+		hfinfo = proto_custom_first_hfinfo(*field_idx, occurrence);
 
 		/* do we need to rewind ? */
 		if (!hfinfo)
 			return "";
 
-		if (occurrence < 0) {
-			/* Search other direction */
-			while (hfinfo->same_name_prev_id != -1) {
-				PROTO_REGISTRAR_GET_NTH(hfinfo->same_name_prev_id, hfinfo);
-			}
-		}
-
-		while (hfinfo) {
-			finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
-
-			if (!finfos || !(len = g_ptr_array_len(finfos))) {
-				if (occurrence < 0) {
-					hfinfo = hfinfo->same_name_next;
-				} else {
-					hfinfo = hfinfo_same_name_get_prev(hfinfo);
-				}
-				continue;
-			}
-
-			/* Are there enough occurrences of the field? */
-			if (((occurrence - prev_len) > len) || ((occurrence + prev_len) < -len)) {
-				if (occurrence < 0) {
-					hfinfo = hfinfo->same_name_next;
-				} else {
-					hfinfo = hfinfo_same_name_get_prev(hfinfo);
-				}
-				prev_len += len;
-				continue;
-			}
-
-			/* Calculate single index or set outer bounderies */
-			if (occurrence < 0) {
-				i = occurrence + len + prev_len;
-				last = i;
-			} else if (occurrence > 0) {
-				i = occurrence - 1 - prev_len;
-				last = i;
-			} else {
-				i = 0;
-				last = len - 1;
-			}
-
-			prev_len += len; /* Count handled occurrences */
-
+		while ((finfos = proto_custom_find_finfos(tree, &hfinfo, occurrence, &prev_len, &i, &last)) != NULL) {
 			while (i <= last) {
 				finfo = (field_info *)g_ptr_array_index(finfos, i);
 
@@ -6122,6 +6155,34 @@ proto_custom_set(proto_tree* tree, GSList *field_ids, gint occurrence,
 	return abbrev ? abbrev : "";
 }
 
+/* Return the first field_info whose value proto_custom_set() would put in
+ * the custom column, or NULL if there isn't one. */
+field_info *
+proto_custom_get_finfo(proto_tree *tree, GSList *field_ids, gint occurrence)
+{
+	GPtrArray          *finfos;
+	header_field_info  *hfinfo;
+	int                *field_idx;
+	int                 prev_len = 0, first, last;
+	int                 ii = 0;
+
+	if (!tree || !field_ids)
+		return NULL;
+
+	while ((field_idx = (int *) g_slist_nth_data(field_ids, ii++))) {
+		hfinfo = proto_custom_first_hfinfo(*field_idx, occurrence);
+
+		if (!hfinfo)
+			return NULL;
+
+		finfos = proto_custom_find_finfos(tree, &hfinfo, occurrence, &prev_len, &first, &last);
+		if (finfos)
+			return (field_info *)g_ptr_array_index(finfos, first);
+	}
+
+	return NULL;
+}
+
 
 /* Set text of proto_item after having already been created. */
 void
@@ -7265,6 +7326,7 @@ free_deregistered_field (gpointer data, gpointer user_data _U_)
 			}
 		}
 		if (hfi->type != FT_FRAMENUM) {
+			value_string_forget(hfi->strings);
 			g_free((void *)hfi->strings);
 		}
 	}
@@ -7929,6 +7991,17 @@ proto_register_field_init(header_field_info *hfinfo, const int parent)
 	gpa_hfinfo.len++;
 	hfinfo->id = gpa_hfinfo.len - 1;
 
+	/* The value_string or range_string of a field stays put (or is
+	 * forgotten when the field is deregistered), so it can be compiled. */
+	if (hfinfo->strings != NULL &&
+	    ((IS_FT_UINT32(hfinfo->type) && hfinfo->type != FT_FRAMENUM) ||
+	     hfinfo->type == FT_INT8 || hfinfo->type == FT_INT16 ||
+	     hfinfo->type == FT_INT24 || hfinfo->type == FT_INT32) &&
+	    !(hfinfo->display & (BASE_EXT_STRING | BASE_VAL64_STRING | BASE_UNIT_STRING)) &&
+	    FIELD_DISPLAY(hfinfo->display) != BASE_CUSTOM) {
+		value_string_register_static(hfinfo->strings);
+	}
+
 	/* if we have real names, enter this field in the name tree */
 	if ((hfinfo->name[0] != 0) && (hfinfo->abbrev[0] != 0 )) {
 
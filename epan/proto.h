@@ -3025,6 +3025,14 @@ proto_custom_set(proto_tree* tree, GSList *field_id,
                              gchar *result,
                              gchar *expr, const int size );
 
+/** Find the field whose value is shown first in a custom column
+ @param tree the tree the custom column's fields were added to
+ @param field_ids the field ids used for the custom column
+ @param occurrence the occurrence of the field used for the custom column
+ @return the field_info, or NULL if the column is empty */
+WS_DLL_PUBLIC field_info *
+proto_custom_get_finfo(proto_tree *tree, GSList *field_ids, gint occurrence);
+
 /* #define HAVE_HFI_SECTION_INIT */
 
 #ifdef HAVE_HFI_SECTION_INIT
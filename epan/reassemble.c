@@ -14,10 +14,13 @@
 
 #include <epan/packet.h>
 #include <epan/exceptions.h>
+#include <epan/prefs.h>
 #include <epan/reassemble.h>
 #include <epan/tvbuff-int.h>
 
+#include <wsutil/file_util.h>
 #include <wsutil/str_util.h>
+#include <wsutil/tempfile.h>
 
 /*
  * Functions for reassembly tables where the endpoint addresses, and a
@@ -397,6 +400,480 @@ free_fragments(gpointer data, gpointer user_data _U_)
 	g_slice_free(fragment_item, fd_head);
 }
 
+/*
+ * Memory limits; see the comment in reassemble.h.
+ *
+ * Only the reassemblies whose memory can be given back are counted against
+ * the limit: those in progress, which can be discarded on the first pass,
+ * and, if spilling is enabled, completed reassemblies that are only in the
+ * table of reassembled packets, as nothing changes those any more.
+ *
+ * Data that's spilled may still be pointed to by the tvbuffs of a frame
+ * that looked up the reassembly earlier and hasn't been freed yet, such as
+ * the one selected in the GUI, so those frames pin the data; it's freed
+ * along with the last of them.  Data that's read back on behalf of a frame
+ * belongs to that frame, and fd_head->tvb_data is cleared when the frame
+ * is freed.
+ */
+typedef struct _reassembly_mem_pin {
+	guint frames;			/* frames holding the data */
+	gboolean orphaned;		/* the entry is gone */
+	GSList *spilled_tvbs;		/* data spilled while frames held it */
+} reassembly_mem_pin;
+
+typedef struct _reassembly_mem_copy reassembly_mem_copy;
+
+typedef struct _reassembly_mem_entry {
+	fragment_head *fd_head;
+	gpointer key;			/* key in the fragment table, or NULL */
+	GList *lru_link;		/* link in mem->lru, or NULL */
+	GList *dirty_link;		/* link in mem->dirty, or NULL */
+	guint64 bytes;			/* memory counted against the limit */
+	guint32 last_frame;		/* frame in which it was last used */
+	gint64 spill_offset;		/* offset in the spill file, or -1 */
+	guint32 spill_len;
+	gboolean spilled;		/* fd_head->tvb_data isn't ours */
+	reassembly_mem_pin *pin;	/* frames holding fd_head->tvb_data */
+	reassembly_mem_copy *copy;	/* frame's copy in fd_head->tvb_data */
+} reassembly_mem_entry;
+
+/* Spilled data read back for a frame, followed by the data itself. */
+struct _reassembly_mem_copy {
+	reassembly_mem_entry *entry;	/* whose fd_head->tvb_data this is, or NULL */
+};
+
+struct _reassembly_table_mem {
+	reassembly_table *table;
+	const char *name;		/* protocol that first added a fragment */
+	guint64 limit;			/* in bytes; 0 if there's no limit */
+	gboolean spill;
+	GHashTable *entries;		/* fragment_head -> reassembly_mem_entry */
+	GQueue lru;			/* least recently used first */
+	GQueue dirty;			/* used since they were last measured */
+	guint64 bytes;			/* memory counted against the limit */
+	int spill_fd;
+	gchar *spill_name;
+	gint64 spill_end;
+	guint64 spilled_bytes;
+	guint evicted;
+	guint spilled;
+	guint reloaded;
+};
+
+static GList *reassembly_mem_list = NULL;
+
+static void
+reassembly_mem_pin_free_tvbs(reassembly_mem_pin *pin)
+{
+	g_slist_free_full(pin->spilled_tvbs, (GDestroyNotify)tvb_free);
+	pin->spilled_tvbs = NULL;
+}
+
+static void
+reassembly_mem_entry_free(gpointer p)
+{
+	reassembly_mem_entry *entry = (reassembly_mem_entry *)p;
+
+	if (entry->pin != NULL) {
+		if (entry->pin->frames == 0)
+			g_free(entry->pin);
+		else
+			entry->pin->orphaned = TRUE;
+	}
+	if (entry->copy != NULL)
+		entry->copy->entry = NULL;
+	g_slice_free(reassembly_mem_entry, p);
+}
+
+/*
+ * Called when a frame that pinned a reassembly's data is freed.
+ */
+static void
+reassembly_mem_unpin(void *p)
+{
+	reassembly_mem_pin *pin = (reassembly_mem_pin *)p;
+
+	if (--pin->frames != 0)
+		return;
+	reassembly_mem_pin_free_tvbs(pin);
+	if (pin->orphaned)
+		g_free(pin);
+}
+
+/*
+ * Keep the data of a reassembly that's looked up in a frame until the
+ * frame is freed, by chaining an empty tvbuff to the frame's tvbuff that
+ * unpins the data when it's freed.
+ */
+static void
+reassembly_mem_pin_frame(reassembly_mem_entry *entry, const packet_info *pinfo)
+{
+	tvbuff_t *tvb;
+
+	if (pinfo == NULL || pinfo->data_src == NULL)
+		return;
+	if (entry->pin == NULL)
+		entry->pin = g_new0(reassembly_mem_pin, 1);
+	entry->pin->frames++;
+	tvb = tvb_new_real_data((const guint8 *)entry->pin, 0, 0);
+	tvb_set_free_cb(tvb, reassembly_mem_unpin);
+	tvb_add_to_chain(get_data_source_tvb((const struct data_source *)pinfo->data_src->data), tvb);
+}
+
+/*
+ * Called when a frame that spilled data was read back for is freed.
+ */
+static void
+reassembly_mem_copy_free(void *data)
+{
+	reassembly_mem_copy *copy = ((reassembly_mem_copy *)data) - 1;
+
+	if (copy->entry != NULL) {
+		copy->entry->fd_head->tvb_data = NULL;
+		copy->entry->copy = NULL;
+	}
+	g_free(copy);
+}
+
+/*
+ * Forget about all the reassemblies; called before the reassembly table
+ * frees them.
+ */
+static void
+reassembly_mem_reset(reassembly_table_mem *mem)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if (mem->entries != NULL) {
+		/*
+		 * The data read back for a spilled reassembly belongs
+		 * to a frame, so don't let the table free it.
+		 */
+		g_hash_table_iter_init(&iter, mem->entries);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			reassembly_mem_entry *entry = (reassembly_mem_entry *)value;
+
+			if (entry->spilled)
+				entry->fd_head->tvb_data = NULL;
+		}
+		g_hash_table_destroy(mem->entries);
+		mem->entries = NULL;
+	}
+	g_queue_clear(&mem->lru);
+	g_queue_clear(&mem->dirty);
+	mem->bytes = 0;
+
+	if (mem->spill_fd != -1) {
+		ws_close(mem->spill_fd);
+		ws_unlink(mem->spill_name);
+		mem->spill_fd = -1;
+	}
+	g_free(mem->spill_name);
+	mem->spill_name = NULL;
+	mem->spill_end = 0;
+	mem->spilled_bytes = 0;
+
+	mem->evicted = 0;
+	mem->spilled = 0;
+	mem->reloaded = 0;
+}
+
+static reassembly_mem_entry *
+reassembly_mem_lookup(reassembly_table_mem *mem, const fragment_head *fd_head)
+{
+	if (mem->entries == NULL)
+		return NULL;
+	return (reassembly_mem_entry *)g_hash_table_lookup(mem->entries, fd_head);
+}
+
+/*
+ * Note that a reassembly was used, and may have changed, in this frame.
+ */
+static void
+reassembly_mem_touch(reassembly_table_mem *mem, fragment_head *fd_head,
+		     gpointer key, const packet_info *pinfo)
+{
+	reassembly_mem_entry *entry;
+
+	if (mem->entries == NULL || pinfo->fd->flags.visited)
+		return;
+
+	entry = (reassembly_mem_entry *)g_hash_table_lookup(mem->entries, fd_head);
+	if (entry == NULL) {
+		entry = g_slice_new0(reassembly_mem_entry);
+		entry->fd_head = fd_head;
+		entry->key = key;
+		entry->spill_offset = -1;
+		g_hash_table_insert(mem->entries, fd_head, entry);
+	}
+	entry->last_frame = pinfo->num;
+	if (entry->lru_link != NULL) {
+		g_queue_unlink(&mem->lru, entry->lru_link);
+		g_queue_push_tail_link(&mem->lru, entry->lru_link);
+	}
+	if (entry->dirty_link == NULL) {
+		g_queue_push_tail(&mem->dirty, entry);
+		entry->dirty_link = mem->dirty.tail;
+	}
+}
+
+/*
+ * Stop keeping track of a reassembly.
+ */
+static void
+reassembly_mem_forget(reassembly_table_mem *mem, reassembly_mem_entry *entry)
+{
+	mem->bytes -= entry->bytes;
+	if (entry->lru_link != NULL)
+		g_queue_delete_link(&mem->lru, entry->lru_link);
+	if (entry->dirty_link != NULL)
+		g_queue_delete_link(&mem->dirty, entry->dirty_link);
+	g_hash_table_remove(mem->entries, entry->fd_head);
+}
+
+static guint64
+reassembly_mem_measure(const fragment_head *fd_head, gboolean with_head_data)
+{
+	const fragment_item *fd;
+	guint64 bytes = 0;
+
+	for (fd = fd_head; fd != NULL; fd = fd->next) {
+		bytes += sizeof(fragment_item);
+		if (fd->tvb_data && !(fd->flags & FD_SUBSET_TVB) &&
+		    (fd != fd_head || with_head_data))
+			bytes += tvb_captured_length(fd->tvb_data);
+	}
+	return bytes;
+}
+
+/*
+ * Can the memory used by this reassembly be given back?
+ */
+static gboolean
+reassembly_mem_reclaimable(const reassembly_table_mem *mem,
+			   const reassembly_mem_entry *entry)
+{
+	const fragment_head *fd_head = entry->fd_head;
+
+	if (entry->spilled)
+		return FALSE;
+	if (!(fd_head->flags & FD_DEFRAGMENTED))
+		return entry->key != NULL;
+	return mem->spill && entry->key == NULL && fd_head->tvb_data != NULL &&
+	    !(fd_head->flags & (FD_SUBSET_TVB|FD_PARTIAL_REASSEMBLY));
+}
+
+static gboolean
+reassembly_mem_spill_write(int fd, const guint8 *data, guint32 len)
+{
+	while (len != 0) {
+		int written = (int)ws_write(fd, data, len);
+
+		if (written <= 0)
+			return FALSE;
+		data += written;
+		len -= (guint32)written;
+	}
+	return TRUE;
+}
+
+static gboolean
+reassembly_mem_spill_read(int fd, guint8 *data, guint32 len)
+{
+	while (len != 0) {
+		int nread = (int)ws_read(fd, data, len);
+
+		if (nread <= 0)
+			return FALSE;
+		data += nread;
+		len -= (guint32)nread;
+	}
+	return TRUE;
+}
+
+/*
+ * Write the reassembled data of a completed reassembly to the spill file,
+ * unless it's there already, and free it.  If the data can't be written,
+ * stop spilling for this table.
+ */
+static gboolean
+reassembly_mem_spill(reassembly_table_mem *mem, reassembly_mem_entry *entry)
+{
+	fragment_head *fd_head = entry->fd_head;
+	guint32 len;
+	char *name;
+
+	if (entry->spill_offset < 0) {
+		len = tvb_captured_length(fd_head->tvb_data);
+		if (mem->spill_fd == -1) {
+			mem->spill_fd = create_tempfile(&name, "wireshark_reassembly", NULL);
+			if (mem->spill_fd == -1) {
+				mem->spill = FALSE;
+				return FALSE;
+			}
+			mem->spill_name = g_strdup(name);
+		}
+		if (ws_lseek64(mem->spill_fd, mem->spill_end, SEEK_SET) != mem->spill_end ||
+		    !reassembly_mem_spill_write(mem->spill_fd,
+			    tvb_get_ptr(fd_head->tvb_data, 0, len), len)) {
+			mem->spill = FALSE;
+			return FALSE;
+		}
+		entry->spill_offset = mem->spill_end;
+		entry->spill_len = len;
+		mem->spill_end += len;
+		mem->spilled_bytes += len;
+		mem->spilled++;
+	}
+
+	if (entry->pin != NULL && entry->pin->frames != 0)
+		entry->pin->spilled_tvbs = g_slist_prepend(entry->pin->spilled_tvbs,
+		    fd_head->tvb_data);
+	else
+		tvb_free(fd_head->tvb_data);
+	fd_head->tvb_data = NULL;
+	entry->spilled = TRUE;
+	return TRUE;
+}
+
+/*
+ * If a reassembly looked up in the table of reassembled packets was
+ * spilled, read its data back.  The copy is chained to the top-level
+ * tvbuff of the frame being dissected, so it's freed along with the frame,
+ * and fd_head->tvb_data is cleared then; every lookup reads it back again.
+ * Without a frame, the copy is ours again, and is spilled again when the
+ * table is next over its limit.  If it wasn't spilled, but could be, the
+ * frame pins it.
+ */
+static fragment_head *
+reassembly_mem_reload(reassembly_table *table, fragment_head *fd_head,
+		      const packet_info *pinfo)
+{
+	reassembly_table_mem *mem = table->mem;
+	reassembly_mem_entry *entry;
+	reassembly_mem_copy *copy;
+	tvbuff_t *tvb;
+	guint8 *data;
+
+	if (fd_head == NULL || (!mem->spill && mem->spilled == 0))
+		return fd_head;
+	entry = reassembly_mem_lookup(mem, fd_head);
+	if (entry == NULL)
+		return fd_head;
+	if (!entry->spilled) {
+		if (reassembly_mem_reclaimable(mem, entry))
+			reassembly_mem_pin_frame(entry, pinfo);
+		return fd_head;
+	}
+
+	if (entry->copy != NULL) {
+		/* An earlier frame's copy; that frame keeps it. */
+		entry->copy->entry = NULL;
+		entry->copy = NULL;
+	}
+	fd_head->tvb_data = NULL;
+	copy = (reassembly_mem_copy *)g_malloc(sizeof(reassembly_mem_copy) + entry->spill_len);
+	copy->entry = NULL;
+	data = (guint8 *)(copy + 1);
+	if (ws_lseek64(mem->spill_fd, entry->spill_offset, SEEK_SET) != entry->spill_offset ||
+	    !reassembly_mem_spill_read(mem->spill_fd, data, entry->spill_len)) {
+		g_free(copy);
+		THROW_MESSAGE(ReassemblyError, "Reassembled data could not be read back from the temporary file");
+	}
+	tvb = tvb_new_real_data(data, entry->spill_len, entry->spill_len);
+	tvb_set_free_cb(tvb, reassembly_mem_copy_free);
+	mem->reloaded++;
+
+	if (pinfo != NULL && pinfo->data_src != NULL) {
+		copy->entry = entry;
+		entry->copy = copy;
+		tvb_add_to_chain(get_data_source_tvb((const struct data_source *)pinfo->data_src->data), tvb);
+	} else {
+		entry->spilled = FALSE;
+		if (entry->dirty_link == NULL) {
+			g_queue_push_tail(&mem->dirty, entry);
+			entry->dirty_link = mem->dirty.tail;
+		}
+	}
+	fd_head->tvb_data = tvb;
+	return fd_head;
+}
+
+/*
+ * Discard a reassembly in progress, as if none of its fragments had been
+ * seen.
+ */
+static void
+reassembly_mem_evict(reassembly_table *table, reassembly_mem_entry *entry)
+{
+	fragment_head *fd_head = entry->fd_head;
+	gpointer key = entry->key;
+
+	reassembly_mem_forget(table->mem, entry);
+	free_all_fragments(key, fd_head, NULL);
+	g_hash_table_remove(table->fragment_table, key);
+	table->mem->evicted++;
+}
+
+/*
+ * If the table is over its limit, discard or spill the least recently used
+ * reassemblies until it isn't.  This is only done on the first pass, before
+ * a fragment is added, and never to a reassembly used in the current frame,
+ * so that no fragment_head a dissector has been handed in this frame goes
+ * away.
+ */
+static void
+reassembly_table_check_limit(reassembly_table *table, const packet_info *pinfo)
+{
+	reassembly_table_mem *mem = table->mem;
+	reassembly_mem_entry *entry;
+	GList *link, *next;
+
+	if (mem->entries == NULL || pinfo->fd->flags.visited)
+		return;
+
+	/* Measure everything that was used since the last check. */
+	while ((entry = (reassembly_mem_entry *)g_queue_pop_head(&mem->dirty)) != NULL) {
+		entry->dirty_link = NULL;
+		mem->bytes -= entry->bytes;
+		if (reassembly_mem_reclaimable(mem, entry)) {
+			entry->bytes = reassembly_mem_measure(entry->fd_head, TRUE);
+			mem->bytes += entry->bytes;
+			if (entry->lru_link == NULL) {
+				g_queue_push_tail(&mem->lru, entry);
+				entry->lru_link = mem->lru.tail;
+			}
+		} else {
+			entry->bytes = 0;
+			if (entry->lru_link != NULL) {
+				g_queue_delete_link(&mem->lru, entry->lru_link);
+				entry->lru_link = NULL;
+			}
+			if (!entry->spilled)
+				g_hash_table_remove(mem->entries, entry->fd_head);
+		}
+	}
+
+	for (link = mem->lru.head; link != NULL && mem->bytes > mem->limit; link = next) {
+		next = link->next;
+		entry = (reassembly_mem_entry *)link->data;
+		if (entry->last_frame == pinfo->num)
+			continue;
+
+		if (!(entry->fd_head->flags & FD_DEFRAGMENTED)) {
+			reassembly_mem_evict(table, entry);
+		} else {
+			mem->bytes -= entry->bytes;
+			entry->bytes = 0;
+			g_queue_delete_link(&mem->lru, link);
+			entry->lru_link = NULL;
+			if (!reassembly_mem_spill(mem, entry))
+				g_hash_table_remove(mem->entries, entry->fd_head);
+		}
+	}
+}
+
 typedef struct register_reassembly_table {
 	reassembly_table *table;
 	const reassembly_table_functions *funcs;
@@ -435,6 +912,21 @@ reassembly_table_init(reassembly_table *table,
 		table->persistent_key_func = funcs->persistent_key_func;
 	if (table->free_temporary_key_func == NULL)
 		table->free_temporary_key_func = funcs->free_temporary_key_func;
+
+	if (table->mem != NULL) {
+		reassembly_mem_reset(table->mem);
+	} else {
+		table->mem = g_new0(reassembly_table_mem, 1);
+		table->mem->table = table;
+		table->mem->spill_fd = -1;
+		reassembly_mem_list = g_list_prepend(reassembly_mem_list, table->mem);
+	}
+	table->mem->limit = (guint64)prefs.reassembly_max_memory * 1024 * 1024;
+	table->mem->spill = prefs.reassembly_spill;
+	if (table->mem->limit != 0)
+		table->mem->entries = g_hash_table_new_full(g_direct_hash,
+		    g_direct_equal, NULL, reassembly_mem_entry_free);
+
 	if (table->fragment_table != NULL) {
 		/*
 		 * The fragment hash table exists.
@@ -488,6 +980,12 @@ reassembly_table_destroy(reassembly_table *table)
 	table->temporary_key_func = NULL;
 	table->persistent_key_func = NULL;
 	table->free_temporary_key_func = NULL;
+	if (table->mem != NULL) {
+		reassembly_mem_reset(table->mem);
+		reassembly_mem_list = g_list_remove(reassembly_mem_list, table->mem);
+		g_free(table->mem);
+		table->mem = NULL;
+	}
 	if (table->fragment_table != NULL) {
 		/*
 		 * The fragment hash table exists.
@@ -541,6 +1039,7 @@ lookup_fd_head(reassembly_table *table, const packet_info *pinfo,
 	       const guint32 id, const void *data, gpointer *orig_keyp)
 {
 	gpointer key;
+	gpointer orig_key;
 	gpointer value;
 
 	/* Create key to search hash with */
@@ -549,12 +1048,19 @@ lookup_fd_head(reassembly_table *table, const packet_info *pinfo,
 	/*
 	 * Look up the reassembly in the fragment table.
 	 */
-	if (!g_hash_table_lookup_extended(table->fragment_table, key, orig_keyp,
-					  &value))
+	if (!g_hash_table_lookup_extended(table->fragment_table, key, &orig_key,
+					  &value)) {
+		orig_key = NULL;
 		value = NULL;
+	}
 	/* Free the key */
 	table->free_temporary_key_func(key);
 
+	if (value != NULL)
+		reassembly_mem_touch(table->mem, (fragment_head *)value, orig_key, pinfo);
+	if (orig_keyp != NULL)
+		*orig_keyp = orig_key;
+
 	return (fragment_head *)value;
 }
 
@@ -573,6 +1079,10 @@ insert_fd_head(reassembly_table *table, fragment_head *fd_head,
 	 */
 	key = table->persistent_key_func(pinfo, id, data);
 	g_hash_table_insert(table->fragment_table, key, fd_head);
+
+	if (table->mem->name == NULL)
+		table->mem->name = pinfo->current_proto;
+	reassembly_mem_touch(table->mem, fd_head, key, pinfo);
 	return key;
 }
 
@@ -596,6 +1106,7 @@ fragment_delete(reassembly_table *table, const packet_info *pinfo,
 	fragment_item *fd;
 	tvbuff_t *fd_tvb_data=NULL;
 	gpointer key;
+	reassembly_mem_entry *entry;
 
 	fd_head = lookup_fd_head(table, pinfo, id, data, &key);
 	if(fd_head==NULL){
@@ -603,6 +1114,10 @@ fragment_delete(reassembly_table *table, const packet_info *pinfo,
 		return NULL;
 	}
 
+	entry = reassembly_mem_lookup(table->mem, fd_head);
+	if (entry != NULL)
+		reassembly_mem_forget(table->mem, entry);
+
 	fd_tvb_data=fd_head->tvb_data;
 	/* loop over all partial fragments and free any tvbuffs */
 	for(fd=fd_head->next;fd;){
@@ -642,7 +1157,7 @@ fragment_get_reassembled(reassembly_table *table, const guint32 id)
 	key.id = id;
 	fd_head = (fragment_head *)g_hash_table_lookup(table->reassembled_table, &key);
 
-	return fd_head;
+	return reassembly_mem_reload(table, fd_head, NULL);
 }
 
 fragment_head *
@@ -657,7 +1172,7 @@ fragment_get_reassembled_id(reassembly_table *table, const packet_info *pinfo,
 	key.id = id;
 	fd_head = (fragment_head *)g_hash_table_lookup(table->reassembled_table, &key);
 
-	return fd_head;
+	return reassembly_mem_reload(table, fd_head, pinfo);
 }
 
 /* To specify the offset for the fragment numbering, the first fragment is added with 0, and
@@ -794,6 +1309,16 @@ fragment_set_partial_reassembly(reassembly_table *table,
 static void
 fragment_unhash(reassembly_table *table, gpointer key)
 {
+	reassembly_mem_entry *entry;
+
+	/*
+	 * The key is about to be freed.
+	 */
+	entry = reassembly_mem_lookup(table->mem,
+	    (fragment_head *)g_hash_table_lookup(table->fragment_table, key));
+	if (entry != NULL)
+		entry->key = NULL;
+
 	/*
 	 * Remove the entry from the fragment table.
 	 */
@@ -837,6 +1362,7 @@ fragment_reassembled(reassembly_table *table, fragment_head *fd_head,
 	fd_head->flags |= FD_DEFRAGMENTED;
 	fd_head->reassembled_in = pinfo->num;
 	fd_head->reas_in_layer_num = pinfo->curr_layer_num;
+	reassembly_mem_touch(table->mem, fd_head, NULL, pinfo);
 }
 
 /*
@@ -875,6 +1401,7 @@ fragment_reassembled_single(reassembly_table *table, fragment_head *fd_head,
 	fd_head->flags |= FD_DEFRAGMENTED;
 	fd_head->reassembled_in = pinfo->num;
 	fd_head->reas_in_layer_num = pinfo->curr_layer_num;
+	reassembly_mem_touch(table->mem, fd_head, NULL, pinfo);
 }
 
 static void
@@ -907,6 +1434,201 @@ MERGE_FRAG(fragment_head *fd_head, fragment_item *fd)
 	}
 	fd_i->next = fd;
 }
+
+/*
+ * Make the reassembled data out of the fragment tvbuffs in "members", in
+ * order, rather than copying them into a new buffer.  The returned tvbuff
+ * owns them; if there's more than one, it's a composite tvbuff, which is
+ * only flattened if a dissector asks for a pointer to data that spans
+ * fragments.
+ */
+static tvbuff_t *
+fragment_join_tvbs(GPtrArray *members)
+{
+	tvbuff_t *tvb;
+	guint i;
+
+	if (members->len == 1)
+		return (tvbuff_t *)g_ptr_array_index(members, 0);
+
+	tvb = tvb_new_composite();
+	for (i = 0; i < members->len; i++)
+		tvb_composite_append(tvb, (tvbuff_t *)g_ptr_array_index(members, i));
+	tvb_composite_finalize_owning(tvb);
+	return tvb;
+}
+
+/*
+ * If the fragments of fd_head, which are sorted by offset, cover its data
+ * exactly - no gaps, no overlaps, nothing past the end - and each has a
+ * tvbuff of its own, return those tvbuffs in order.  Otherwise return NULL;
+ * the data has to be copied and checked fragment by fragment.
+ */
+static GPtrArray *
+fragment_tiling_tvbs(const fragment_head *fd_head)
+{
+	const fragment_item *fd_i;
+	GPtrArray *members;
+	guint32 dfpos = 0;
+
+	if (fd_head->len || !fd_head->datalen)
+		return NULL;
+
+	for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
+		if (!fd_i->len)
+			continue;
+		if (fd_i->offset != dfpos
+		    || fd_i->len > fd_head->datalen - dfpos
+		    || !fd_i->tvb_data
+		    || (fd_i->flags & FD_SUBSET_TVB))
+			return NULL;
+		dfpos += fd_i->len;
+	}
+	if (dfpos != fd_head->datalen)
+		return NULL;
+
+	members = g_ptr_array_new();
+	for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
+		if (fd_i->len)
+			g_ptr_array_add(members, fd_i->tvb_data);
+	}
+	return members;
+}
+
+/*
+ * Copy the data of the fragments of fd_head into a new buffer, checking
+ * for overlapping fragments and fragments past the end of the packet.
+ */
+static void
+fragment_add_copy_data(fragment_head *fd_head)
+{
+	fragment_item *fd_i;
+	guint32 dfpos, fraglen;
+	guint8 *data;
+
+	data = (guint8 *) g_malloc(fd_head->datalen);
+	fd_head->tvb_data = tvb_new_real_data(data, fd_head->datalen, fd_head->datalen);
+	tvb_set_free_cb(fd_head->tvb_data, g_free);
+
+	/* add all data fragments */
+	for (dfpos=0,fd_i=fd_head;fd_i;fd_i=fd_i->next) {
+		if (fd_i->len) {
+			/*
+			 * The loop in fragment_add_work() that
+			 * calculates max also ensures that the only gaps that exist here
+			 * are ones where a fragment starts past the
+			 * end of the reassembled datagram, and there's
+			 * a gap between the previous fragment and
+			 * that fragment.
+			 *
+			 * A "DESEGMENT_UNTIL_FIN" was involved wherein the
+			 * FIN packet had an offset less than the highest
+			 * fragment offset seen. [Seen from a fuzz-test:
+			 * bug #2470]).
+			 *
+			 * Note that the "overlap" compare must only be
+			 * done for fragments with (offset+len) <= fd_head->datalen
+			 * and thus within the newly g_malloc'd buffer.
+			 */
+			if (fd_i->offset + fd_i->len > dfpos) {
+				if (fd_i->offset >= fd_head->datalen) {
+					/*
+					 * Fragment starts after the end
+					 * of the reassembled packet.
+					 *
+					 * This can happen if the length was
+					 * set after the offending fragment
+					 * was added to the reassembly.
+					 *
+					 * Flag this fragment, but don't
+					 * try to extract any data from
+					 * it, as there's no place to put
+					 * it.
+					 *
+					 * XXX - add different flag value
+					 * for this.
+					 */
+					fd_i->flags    |= FD_TOOLONGFRAGMENT;
+					fd_head->flags |= FD_TOOLONGFRAGMENT;
+				} else if (dfpos < fd_i->offset) {
+					/*
+					 * XXX - can this happen?  We've
+					 * already rejected fragments that
+					 * start past the end of the
+					 * reassembled datagram, and
+					 * the loop that calculated max
+					 * should have ruled out gaps,
+					 * but could fd_i->offset +
+					 * fd_i->len overflow?
+					 */
+					fd_head->error = "dfpos < offset";
+				} else if (dfpos - fd_i->offset > fd_i->len)
+					fd_head->error = "dfpos - offset > len";
+				else if (!fd_head->tvb_data)
+					fd_head->error = "no data";
+				else {
+					fraglen = fd_i->len;
+					if (fd_i->offset + fraglen > fd_head->datalen) {
+						/*
+						 * Fragment goes past the end
+						 * of the packet, as indicated
+						 * by the last fragment.
+						 *
+						 * This can happen if the
+						 * length was set after the
+						 * offending fragment was
+						 * added to the reassembly.
+						 *
+						 * Mark it as such, and only
+						 * copy from it what fits in
+						 * the packet.
+						 */
+						fd_i->flags    |= FD_TOOLONGFRAGMENT;
+						fd_head->flags |= FD_TOOLONGFRAGMENT;
+						fraglen = fd_head->datalen - fd_i->offset;
+					}
+					if (fd_i->offset < dfpos) {
+						guint32 cmp_len = MIN(fd_i->len,(dfpos-fd_i->offset));
+
+						fd_i->flags    |= FD_OVERLAP;
+						fd_head->flags |= FD_OVERLAP;
+						if ( memcmp(data + fd_i->offset,
+								tvb_get_ptr(fd_i->tvb_data, 0, cmp_len),
+								cmp_len)
+								 ) {
+							fd_i->flags    |= FD_OVERLAPCONFLICT;
+							fd_head->flags |= FD_OVERLAPCONFLICT;
+						}
+					}
+					if (fraglen < dfpos - fd_i->offset) {
+						/*
+						 * XXX - can this happen?
+						 */
+						fd_head->error = "fraglen < dfpos - offset";
+					} else {
+						memcpy(data+dfpos,
+							tvb_get_ptr(fd_i->tvb_data, (dfpos-fd_i->offset), fraglen-(dfpos-fd_i->offset)),
+							fraglen-(dfpos-fd_i->offset));
+						dfpos=MAX(dfpos, (fd_i->offset + fraglen));
+					}
+				}
+			} else {
+				if (fd_i->offset + fd_i->len < fd_i->offset) {
+					/* Integer overflow? */
+					fd_head->error = "offset + len < offset";
+				}
+			}
+
+			if (fd_i->flags & FD_SUBSET_TVB)
+				fd_i->flags &= ~FD_SUBSET_TVB;
+			else if (fd_i->tvb_data)
+				tvb_free(fd_i->tvb_data);
+
+			fd_i->tvb_data=NULL;
+		}
+	}
+}
+
 /*
  * This function adds a new fragment to the fragment hash table.
  * If this is the first fragment seen for this datagram, a new entry
@@ -935,9 +1657,9 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 {
 	fragment_item *fd;
 	fragment_item *fd_i;
-	guint32 max, dfpos, fraglen;
+	guint32 max;
 	tvbuff_t *old_tvb_data;
-	guint8 *data;
+	GPtrArray *members;
 
 	/* create new fd describing this fragment */
 	fd = g_slice_new(fragment_item);
@@ -1134,126 +1856,20 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	 */
 	/* store old data just in case */
 	old_tvb_data=fd_head->tvb_data;
-	data = (guint8 *) g_malloc(fd_head->datalen);
-	fd_head->tvb_data = tvb_new_real_data(data, fd_head->datalen, fd_head->datalen);
-	tvb_set_free_cb(fd_head->tvb_data, g_free);
-
-	/* add all data fragments */
-	for (dfpos=0,fd_i=fd_head;fd_i;fd_i=fd_i->next) {
-		if (fd_i->len) {
-			/*
-			 * The loop above that calculates max also
-			 * ensures that the only gaps that exist here
-			 * are ones where a fragment starts past the
-			 * end of the reassembled datagram, and there's
-			 * a gap between the previous fragment and
-			 * that fragment.
-			 *
-			 * A "DESEGMENT_UNTIL_FIN" was involved wherein the
-			 * FIN packet had an offset less than the highest
-			 * fragment offset seen. [Seen from a fuzz-test:
-			 * bug #2470]).
-			 *
-			 * Note that the "overlap" compare must only be
-			 * done for fragments with (offset+len) <= fd_head->datalen
-			 * and thus within the newly g_malloc'd buffer.
-			 */
-			if (fd_i->offset + fd_i->len > dfpos) {
-				if (fd_i->offset >= fd_head->datalen) {
-					/*
-					 * Fragment starts after the end
-					 * of the reassembled packet.
-					 *
-					 * This can happen if the length was
-					 * set after the offending fragment
-					 * was added to the reassembly.
-					 *
-					 * Flag this fragment, but don't
-					 * try to extract any data from
-					 * it, as there's no place to put
-					 * it.
-					 *
-					 * XXX - add different flag value
-					 * for this.
-					 */
-					fd_i->flags    |= FD_TOOLONGFRAGMENT;
-					fd_head->flags |= FD_TOOLONGFRAGMENT;
-				} else if (dfpos < fd_i->offset) {
-					/*
-					 * XXX - can this happen?  We've
-					 * already rejected fragments that
-					 * start past the end of the
-					 * reassembled datagram, and
-					 * the loop that calculated max
-					 * should have ruled out gaps,
-					 * but could fd_i->offset +
-					 * fd_i->len overflow?
-					 */
-					fd_head->error = "dfpos < offset";
-				} else if (dfpos - fd_i->offset > fd_i->len)
-					fd_head->error = "dfpos - offset > len";
-				else if (!fd_head->tvb_data)
-					fd_head->error = "no data";
-				else {
-					fraglen = fd_i->len;
-					if (fd_i->offset + fraglen > fd_head->datalen) {
-						/*
-						 * Fragment goes past the end
-						 * of the packet, as indicated
-						 * by the last fragment.
-						 *
-						 * This can happen if the
-						 * length was set after the
-						 * offending fragment was
-						 * added to the reassembly.
-						 *
-						 * Mark it as such, and only
-						 * copy from it what fits in
-						 * the packet.
-						 */
-						fd_i->flags    |= FD_TOOLONGFRAGMENT;
-						fd_head->flags |= FD_TOOLONGFRAGMENT;
-						fraglen = fd_head->datalen - fd_i->offset;
-					}
-					if (fd_i->offset < dfpos) {
-						guint32 cmp_len = MIN(fd_i->len,(dfpos-fd_i->offset));
-
-						fd_i->flags    |= FD_OVERLAP;
-						fd_head->flags |= FD_OVERLAP;
-						if ( memcmp(data + fd_i->offset,
-								tvb_get_ptr(fd_i->tvb_data, 0, cmp_len),
-								cmp_len)
-								 ) {
-							fd_i->flags    |= FD_OVERLAPCONFLICT;
-							fd_head->flags |= FD_OVERLAPCONFLICT;
-						}
-					}
-					if (fraglen < dfpos - fd_i->offset) {
-						/*
-						 * XXX - can this happen?
-						 */
-						fd_head->error = "fraglen < dfpos - offset";
-					} else {
-						memcpy(data+dfpos,
-							tvb_get_ptr(fd_i->tvb_data, (dfpos-fd_i->offset), fraglen-(dfpos-fd_i->offset)),
-							fraglen-(dfpos-fd_i->offset));
-						dfpos=MAX(dfpos, (fd_i->offset + fraglen));
-					}
-				}
-			} else {
-				if (fd_i->offset + fd_i->len < fd_i->offset) {
-					/* Integer overflow? */
-					fd_head->error = "offset + len < offset";
-				}
-			}
-
-			if (fd_i->flags & FD_SUBSET_TVB)
-				fd_i->flags &= ~FD_SUBSET_TVB;
-			else if (fd_i->tvb_data)
-				tvb_free(fd_i->tvb_data);
-
-			fd_i->tvb_data=NULL;
+	members = fragment_tiling_tvbs(fd_head);
+	if (members) {
+		/*
+		 * The fragments hold the packet exactly, so use their
+		 * tvbuffs as they are rather than copying them.
+		 */
+		fd_head->tvb_data = fragment_join_tvbs(members);
+		g_ptr_array_free(members, TRUE);
+		for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
+			if (fd_i->len)
+				fd_i->tvb_data=NULL;
 		}
+	} else {
+		fragment_add_copy_data(fd_head);
 	}
 
 	if (old_tvb_data)
@@ -1293,6 +1909,8 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 	 */
 	DISSECTOR_ASSERT(tvb_bytes_exist(tvb, offset, frag_data_len));
 
+	reassembly_table_check_limit(table, pinfo);
+
 	fd_head = lookup_fd_head(table, pinfo, id, data, NULL);
 
 #if 0
@@ -1504,9 +2122,13 @@ fragment_add_check(reassembly_table *table, tvbuff_t *tvb, const int offset,
 	if (pinfo->fd->flags.visited) {
 		reass_key.frame = pinfo->num;
 		reass_key.id = id;
-		return (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key);
+		return reassembly_mem_reload(table,
+		    (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key),
+		    pinfo);
 	}
 
+	reassembly_table_check_limit(table, pinfo);
+
 	/* Looks up a key in the GHashTable, returning the original key and the associated value
 	 * and a gboolean which is TRUE if the key was found. This is useful if you need to free
 	 * the memory allocated for the original key, for example before calling g_hash_table_remove()
@@ -1566,20 +2188,31 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 	fragment_item *last_fd = NULL;
 	guint32  dfpos = 0, size = 0;
 	tvbuff_t *old_tvb_data = NULL;
-	guint8 *data;
+	guint8 *data = NULL;
+	GPtrArray *members = NULL;
+	guint member_i;
+	gboolean copy_data = FALSE;
 
 	for(fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
 		if(!last_fd || last_fd->offset!=fd_i->offset){
 			size+=fd_i->len;
+			/* Data that isn't in a tvbuff of its own has to be copied */
+			if (fd_i->len && (!fd_i->tvb_data || (fd_i->flags & FD_SUBSET_TVB)))
+				copy_data = TRUE;
 		}
 		last_fd=fd_i;
 	}
 
 	/* store old data in case the fd_i->data pointers refer to it */
 	old_tvb_data=fd_head->tvb_data;
-	data = (guint8 *) g_malloc(size);
-	fd_head->tvb_data = tvb_new_real_data(data, size, size);
-	tvb_set_free_cb(fd_head->tvb_data, g_free);
+	if (copy_data || !size) {
+		data = (guint8 *) g_malloc(size);
+		fd_head->tvb_data = tvb_new_real_data(data, size, size);
+		tvb_set_free_cb(fd_head->tvb_data, g_free);
+	} else {
+		/* Use the fragments' tvbuffs as they are, without copying */
+		members = g_ptr_array_new();
+	}
 	fd_head->len = size;		/* record size for caller	*/
 
 	/* add all data fragments */
@@ -1588,7 +2221,10 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 		if (fd_i->len) {
 			if(!last_fd || last_fd->offset != fd_i->offset) {
 				/* First fragment or in-sequence fragment */
-				memcpy(data+dfpos, tvb_get_ptr(fd_i->tvb_data, 0, fd_i->len), fd_i->len);
+				if (members)
+					g_ptr_array_add(members, fd_i->tvb_data);
+				else
+					memcpy(data+dfpos, tvb_get_ptr(fd_i->tvb_data, 0, fd_i->len), fd_i->len);
 				dfpos += fd_i->len;
 			} else {
 				/* duplicate/retransmission/overlap */
@@ -1605,13 +2241,21 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 	}
 
 	/* we have defragmented the pdu, now free all fragments*/
+	member_i = 0;
 	for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
 		if (fd_i->flags & FD_SUBSET_TVB)
 			fd_i->flags &= ~FD_SUBSET_TVB;
+		else if (members && member_i < members->len &&
+		    fd_i->tvb_data == g_ptr_array_index(members, member_i))
+			member_i++;	/* now owned by the reassembled tvbuff */
 		else if (fd_i->tvb_data)
 			tvb_free(fd_i->tvb_data);
 		fd_i->tvb_data=NULL;
 	}
+	if (members) {
+		fd_head->tvb_data = fragment_join_tvbs(members);
+		g_ptr_array_free(members, TRUE);
+	}
 	if (old_tvb_data)
 		tvb_free(old_tvb_data);
 
@@ -1984,6 +2628,8 @@ fragment_add_seq(reassembly_table *table, tvbuff_t *tvb, const int offset,
 		 const guint32 frag_number, const guint32 frag_data_len,
 		 const gboolean more_frags, const guint32 flags)
 {
+	reassembly_table_check_limit(table, pinfo);
+
 	return fragment_add_seq_common(table, tvb, offset, pinfo, id, data,
 				       frag_number, frag_data_len,
 				       more_frags, flags, NULL);
@@ -2042,9 +2688,13 @@ fragment_add_seq_check_work(reassembly_table *table, tvbuff_t *tvb,
 	if (pinfo->fd->flags.visited) {
 		reass_key.frame = pinfo->num;
 		reass_key.id = id;
-		return (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key);
+		return reassembly_mem_reload(table,
+		    (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key),
+		    pinfo);
 	}
 
+	reassembly_table_check_limit(table, pinfo);
+
 	fd_head = fragment_add_seq_common(table, tvb, offset, pinfo, id, data,
 					  frag_number, frag_data_len,
 					  more_frags,
@@ -2189,8 +2839,11 @@ fragment_add_seq_single_work(reassembly_table *table, tvbuff_t *tvb,
 		reass_key.frame = pinfo->num;
 		reass_key.id = id;
 		fh = (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key);
-		return fh;
+		return reassembly_mem_reload(table, fh, pinfo);
 	}
+
+	reassembly_table_check_limit(table, pinfo);
+
 	/* First let's figure out where we want to add our new fragment */
 	fh = NULL;
 	if (first) {
@@ -2431,6 +3084,8 @@ fragment_start_seq_check(reassembly_table *table, const packet_info *pinfo,
 		return;
 	}
 
+	reassembly_table_check_limit(table, pinfo);
+
 	/* Check if fragment data exists */
 	fd_head = lookup_fd_head(table, pinfo, id, data, NULL);
 
@@ -2469,7 +3124,9 @@ fragment_end_seq_next(reassembly_table *table, const packet_info *pinfo,
 	if (pinfo->fd->flags.visited) {
 		reass_key.frame = pinfo->num;
 		reass_key.id = id;
-		return (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key);
+		return reassembly_mem_reload(table,
+		    (fragment_head *)g_hash_table_lookup(table->reassembled_table, &reass_key),
+		    pinfo);
 	}
 
 	fd_head = lookup_fd_head(table, pinfo, id, data, &orig_key);
@@ -2844,6 +3501,69 @@ reassembly_table_cleanup(void)
 	g_list_free(reassembly_table_list);
 }
 
+static void
+reassembly_stats_add(reassembly_table_mem *mem, GHashTable *seen,
+		     const fragment_head *fd_head, reassembly_table_stats_t *stats)
+{
+	const reassembly_mem_entry *entry;
+	gboolean spilled;
+
+	/* A reassembled packet is in the table once per fragment. */
+	if (g_hash_table_lookup(seen, fd_head) != NULL)
+		return;
+	g_hash_table_insert(seen, (gpointer)fd_head, (gpointer)fd_head);
+
+	entry = reassembly_mem_lookup(mem, fd_head);
+	spilled = entry != NULL && entry->spilled;
+	if (fd_head->flags & FD_DEFRAGMENTED) {
+		stats->reassembled++;
+		stats->reassembled_bytes += reassembly_mem_measure(fd_head, !spilled);
+	} else {
+		stats->in_progress++;
+		stats->in_progress_bytes += reassembly_mem_measure(fd_head, TRUE);
+	}
+}
+
+void
+reassembly_tables_foreach_stats(reassembly_table_stats_func func,
+				gpointer user_data)
+{
+	GList *l;
+	GHashTable *seen;
+	GHashTableIter iter;
+	gpointer value;
+
+	seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (l = reassembly_mem_list; l != NULL; l = l->next) {
+		reassembly_table_mem *mem = (reassembly_table_mem *)l->data;
+		reassembly_table_stats_t stats;
+
+		if (mem->name == NULL)
+			continue;
+
+		memset(&stats, 0, sizeof(stats));
+		stats.name = mem->name;
+		if (mem->table->fragment_table != NULL) {
+			g_hash_table_iter_init(&iter, mem->table->fragment_table);
+			while (g_hash_table_iter_next(&iter, NULL, &value))
+				reassembly_stats_add(mem, seen, (const fragment_head *)value, &stats);
+		}
+		if (mem->table->reassembled_table != NULL) {
+			g_hash_table_iter_init(&iter, mem->table->reassembled_table);
+			while (g_hash_table_iter_next(&iter, NULL, &value))
+				reassembly_stats_add(mem, seen, (const fragment_head *)value, &stats);
+		}
+		stats.spilled_bytes = mem->spilled_bytes;
+		stats.evicted = mem->evicted;
+		stats.spilled = mem->spilled;
+		stats.reloaded = mem->reloaded;
+
+		func(&stats, user_data);
+		g_hash_table_remove_all(seen);
+	}
+	g_hash_table_destroy(seen);
+}
+
 /*
  * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
  *
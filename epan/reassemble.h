@@ -121,6 +121,11 @@ typedef gpointer (*fragment_temporary_key)(const packet_info *pinfo,
 typedef gpointer (*fragment_persistent_key)(const packet_info *pinfo,
     const guint32 id, const void *data);
 
+/*
+ * Memory accounting for a reassembly table; private to reassemble.c.
+ */
+typedef struct _reassembly_table_mem reassembly_table_mem;
+
 /*
  * Data structure to keep track of fragments and reassemblies.
  */
@@ -130,6 +135,7 @@ typedef struct {
 	fragment_temporary_key temporary_key_func;
 	fragment_persistent_key persistent_key_func;
 	GDestroyNotify free_temporary_key_func;		/* temporary key destruction function */
+	reassembly_table_mem *mem;			/* memory accounting, see below */
 } reassembly_table;
 
 /*
@@ -450,6 +456,55 @@ WS_DLL_PUBLIC gboolean
 show_fragment_seq_tree(fragment_head *ipfd_head, const fragment_items *fit,
     proto_tree *tree, packet_info *pinfo, tvbuff_t *tvb, proto_item **fi);
 
+/*
+ * Memory limits.
+ *
+ * If the "protocols.reassembly_max_memory" preference is non-zero, each
+ * reassembly table keeps the memory used by its reassemblies in progress
+ * below that many megabytes: on the first pass, before a fragment is added,
+ * the least recently used reassemblies in progress are discarded until the
+ * table is back under the limit, as if their remaining fragments had never
+ * been seen.
+ *
+ * If the "protocols.reassembly_spill" preference is also set, completed
+ * reassemblies from the fragment_add_check(), fragment_add_seq_check() and
+ * similar functions count against the limit too, and the least recently
+ * used ones have their reassembled data written to a temporary file.  It is
+ * read back by the functions that return the reassembly from the table of
+ * reassembled packets; that copy of the data belongs to the frame being
+ * dissected and is freed with it, so a dissector must not keep a pointer to
+ * fd_head->tvb_data from one frame to the next.
+ *
+ * The limits take effect the next time the tables are initialized, i.e.
+ * when a capture file is (re)dissected.
+ */
+
+/*
+ * Statistics for a reassembly table.
+ */
+typedef struct {
+	const char *name;		/* protocol that first added a fragment to the table */
+	guint in_progress;		/* reassemblies in progress */
+	guint64 in_progress_bytes;	/* memory used by them */
+	guint reassembled;		/* completed reassemblies */
+	guint64 reassembled_bytes;	/* memory used by their data */
+	guint64 spilled_bytes;		/* reassembled data in the spill file */
+	guint evicted;			/* reassemblies in progress discarded */
+	guint spilled;			/* completed reassemblies spilled */
+	guint reloaded;			/* times spilled data was read back */
+} reassembly_table_stats_t;
+
+typedef void (*reassembly_table_stats_func)(const reassembly_table_stats_t *stats,
+    gpointer user_data);
+
+/*
+ * Call "func" with the statistics of each reassembly table that has had
+ * fragments added to it.
+ */
+WS_DLL_PUBLIC void
+reassembly_tables_foreach_stats(reassembly_table_stats_func func,
+    gpointer user_data);
+
 /* Initialize internal structures
  */
 extern void reassembly_tables_init(void);
@@ -44,6 +44,7 @@
 
 #include <epan/packet.h>
 #include <epan/packet_info.h>
+#include <epan/prefs.h>
 #include <epan/proto.h>
 #include <epan/tvbuff.h>
 #include <epan/reassemble.h>
@@ -196,6 +197,7 @@ static void
 test_simple_fragment_add_seq(void)
 {
     fragment_head *fd_head, *fdh0;
+    guint8 buf[20];
 
     printf("Starting test test_simple_fragment_add_seq\n");
 
@@ -275,6 +277,14 @@ test_simple_fragment_add_seq(void)
     ASSERT(!tvb_memeql(fd_head->tvb_data,50,data+15,60));
     ASSERT(!tvb_memeql(fd_head->tvb_data,110,data+5,60));
 
+    /* the reassembled data is made of the fragments' own tvbuffs; copies
+     * and pointers spanning fragments must still be right */
+    tvb_memcpy(fd_head->tvb_data,buf,40,20);
+    ASSERT(!memcmp(buf,data+50,10));
+    ASSERT(!memcmp(buf+10,data+15,10));
+    ASSERT(!memcmp(tvb_get_ptr(fd_head->tvb_data,100,20),data+65,10));
+    ASSERT(!memcmp(tvb_get_ptr(fd_head->tvb_data,110,10),data+5,10));
+
 #if 0
     print_fragment_table();
 #endif
@@ -1511,6 +1521,254 @@ test_missing_data_fragment_add_seq_next_3(void)
 #endif
 
 
+/**********************************************************************************
+ *
+ * memory limits
+ *
+ *********************************************************************************/
+
+#define MEMORY_LIMIT_PDUS 8000
+
+static void
+get_test_table_stats(const reassembly_table_stats_t *stats, gpointer user_data)
+{
+    if (strcmp(stats->name, "TEST") == 0)
+        *(reassembly_table_stats_t *)user_data = *stats;
+}
+
+/* With a 1 MB limit, adding many more reassemblies in progress than fit
+ * discards the oldest ones, and keeps the most recent ones.
+ */
+static void
+test_fragment_add_seq_check_memory_limit(void)
+{
+    reassembly_table_stats_t stats;
+    fragment_head *fd_head;
+    guint32 i;
+
+    printf("Starting test test_fragment_add_seq_check_memory_limit\n");
+
+    prefs.reassembly_max_memory = 1;
+    reassembly_table_init(&test_reassembly_table,
+                          &addresses_reassembly_table_functions);
+    pinfo.current_proto = "TEST";
+
+    for (i = 1; i <= MEMORY_LIMIT_PDUS; i++) {
+        pinfo.num = i;
+        fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 0, &pinfo, i, NULL,
+                                       0, 200, TRUE);
+        ASSERT_EQ_POINTER(NULL,fd_head);
+    }
+
+    ASSERT(g_hash_table_size(test_reassembly_table.fragment_table) > 0);
+    ASSERT(g_hash_table_size(test_reassembly_table.fragment_table) < MEMORY_LIMIT_PDUS);
+    ASSERT_EQ_POINTER(NULL,fragment_get(&test_reassembly_table, &pinfo, 1, NULL));
+    ASSERT_NE_POINTER(NULL,fragment_get(&test_reassembly_table, &pinfo, MEMORY_LIMIT_PDUS, NULL));
+
+    /* the newest reassembly can still be completed */
+    pinfo.num = MEMORY_LIMIT_PDUS + 1;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 5, &pinfo, MEMORY_LIMIT_PDUS, NULL,
+                                   1, 60, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(260,fd_head->len);
+
+    memset(&stats, 0, sizeof(stats));
+    reassembly_tables_foreach_stats(get_test_table_stats, &stats);
+    ASSERT(stats.evicted > 0);
+    ASSERT_EQ(MEMORY_LIMIT_PDUS - stats.evicted - 1, stats.in_progress);
+    ASSERT_EQ(1,stats.reassembled);
+    ASSERT_EQ(0,stats.spilled);
+
+    prefs.reassembly_max_memory = 0;
+}
+
+/* With spilling enabled, completed reassemblies are written to the spill
+ * file and read back when they are revisited.
+ */
+static void
+test_fragment_add_seq_check_memory_spill(void)
+{
+    reassembly_table_stats_t stats;
+    fragment_head *fd_head;
+    guint32 i;
+
+    printf("Starting test test_fragment_add_seq_check_memory_spill\n");
+
+    prefs.reassembly_max_memory = 1;
+    prefs.reassembly_spill = TRUE;
+    reassembly_table_init(&test_reassembly_table,
+                          &addresses_reassembly_table_functions);
+    pinfo.current_proto = "TEST";
+
+    for (i = 0; i < MEMORY_LIMIT_PDUS; i++) {
+        pinfo.num = 2*i + 1;
+        fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, i % 50, &pinfo, i, NULL,
+                                       0, 200, TRUE);
+        ASSERT_EQ_POINTER(NULL,fd_head);
+
+        pinfo.num = 2*i + 2;
+        fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 50, &pinfo, i, NULL,
+                                       1, 200, FALSE);
+        ASSERT_NE_POINTER(NULL,fd_head);
+    }
+
+    ASSERT_EQ(0,g_hash_table_size(test_reassembly_table.fragment_table));
+
+    memset(&stats, 0, sizeof(stats));
+    reassembly_tables_foreach_stats(get_test_table_stats, &stats);
+    ASSERT(stats.spilled > 0);
+    ASSERT_EQ(MEMORY_LIMIT_PDUS,stats.reassembled);
+    ASSERT_EQ(stats.spilled*400,stats.spilled_bytes);
+    ASSERT_EQ(0,stats.evicted);
+
+    /* revisit the first reassembly, which was spilled */
+    pinfo.fd->flags.visited = TRUE;
+    pinfo.num = 2;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 50, &pinfo, 0, NULL,
+                                   1, 200, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(2,fd_head->reassembled_in);
+    ASSERT_NE_POINTER(NULL,fd_head->tvb_data);
+    ASSERT_EQ(400,tvb_captured_length(fd_head->tvb_data));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data,200));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,200,data+50,200));
+
+    reassembly_tables_foreach_stats(get_test_table_stats, &stats);
+    ASSERT_EQ(1,stats.reloaded);
+
+    prefs.reassembly_max_memory = 0;
+    prefs.reassembly_spill = FALSE;
+}
+
+/* Start dissecting a frame, as the GUI does for the selected packet. */
+static tvbuff_t *
+memory_spill_frame_start(guint32 num)
+{
+    tvbuff_t *frame_tvb = tvb_new_real_data(data, DATA_LEN, DATA_LEN);
+
+    pinfo.num = num;
+    add_new_data_source(&pinfo, frame_tvb, "Frame");
+    return frame_tvb;
+}
+
+/* Finish dissecting it; its tvbuffs stay until they're freed with
+ * tvb_free_chain(). */
+static void
+memory_spill_frame_end(void)
+{
+    g_free(pinfo.data_src->data);
+    g_slist_free(pinfo.data_src);
+    pinfo.data_src = NULL;
+}
+
+/* Like test_fragment_add_seq_check_memory_spill, but with frames that hold
+ * on to the data they were handed, as a dissector that chains the
+ * reassembled data to the frame's tvbuff does.
+ */
+static void
+test_fragment_add_seq_check_memory_spill_frame(void)
+{
+    reassembly_table_stats_t stats;
+    fragment_head *fd_head;
+    tvbuff_t *frame_tvb, *held_frame_tvb, *held_tvb;
+    guint32 i;
+
+    printf("Starting test test_fragment_add_seq_check_memory_spill_frame\n");
+
+    prefs.reassembly_max_memory = 1;
+    prefs.reassembly_spill = TRUE;
+    reassembly_table_init(&test_reassembly_table,
+                          &addresses_reassembly_table_functions);
+    pinfo.current_proto = "TEST";
+
+    /* A few reassemblies, well under the limit */
+    for (i = 0; i < 10; i++) {
+        pinfo.num = 2*i + 1;
+        fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, i % 50, &pinfo, i, NULL,
+                                       0, 200, TRUE);
+        ASSERT_EQ_POINTER(NULL,fd_head);
+
+        pinfo.num = 2*i + 2;
+        fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 50, &pinfo, i, NULL,
+                                       1, 200, FALSE);
+        ASSERT_NE_POINTER(NULL,fd_head);
+    }
+
+    /* Select the first one, which hasn't been spilled, and keep it */
+    pinfo.fd->flags.visited = TRUE;
+    held_frame_tvb = memory_spill_frame_start(2);
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 50, &pinfo, 0, NULL,
+                                   1, 200, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    held_tvb = tvb_new_chain(held_frame_tvb, fd_head->tvb_data);
+    memory_spill_frame_end();
+
+    /* Go on reading until the selected one is spilled */
+    pinfo.fd->flags.visited = FALSE;
+    for (; i < MEMORY_LIMIT_PDUS; i++) {
+        pinfo.num = 2*i + 1;
+        fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, i % 50, &pinfo, i, NULL,
+                                       0, 200, TRUE);
+        ASSERT_EQ_POINTER(NULL,fd_head);
+
+        pinfo.num = 2*i + 2;
+        fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 50, &pinfo, i, NULL,
+                                       1, 200, FALSE);
+        ASSERT_NE_POINTER(NULL,fd_head);
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    reassembly_tables_foreach_stats(get_test_table_stats, &stats);
+    ASSERT(stats.spilled > 0);
+    ASSERT_EQ(0,stats.reloaded);
+
+    /* The selected frame's data is still there */
+    ASSERT_EQ(400,tvb_captured_length(held_tvb));
+    ASSERT(!tvb_memeql(held_tvb,0,data,200));
+    ASSERT(!tvb_memeql(held_tvb,200,data+50,200));
+
+    /* Revisiting it in another frame reads it back into that frame */
+    pinfo.fd->flags.visited = TRUE;
+    frame_tvb = memory_spill_frame_start(2);
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 50, &pinfo, 0, NULL,
+                                   1, 200, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_NE_POINTER(NULL,fd_head->tvb_data);
+    ASSERT_EQ(400,tvb_captured_length(fd_head->tvb_data));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data,200));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,200,data+50,200));
+    memory_spill_frame_end();
+    reassembly_tables_foreach_stats(get_test_table_stats, &stats);
+    ASSERT_EQ(1,stats.reloaded);
+
+    /* and that copy goes away with the frame */
+    tvb_free_chain(frame_tvb);
+    ASSERT_EQ_POINTER(NULL,fd_head->tvb_data);
+
+    /* as does the spilled data when the selected frame is freed */
+    tvb_free_chain(held_frame_tvb);
+
+    /* The next lookup reads it back again */
+    frame_tvb = memory_spill_frame_start(2);
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 50, &pinfo, 0, NULL,
+                                   1, 200, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_NE_POINTER(NULL,fd_head->tvb_data);
+    ASSERT(!tvb_memeql(fd_head->tvb_data,200,data+50,200));
+    memory_spill_frame_end();
+    reassembly_tables_foreach_stats(get_test_table_stats, &stats);
+    ASSERT_EQ(2,stats.reloaded);
+
+    /* Freeing the table before the frame is fine too */
+    reassembly_table_destroy(&test_reassembly_table);
+    tvb_free_chain(frame_tvb);
+    reassembly_table_init(&test_reassembly_table,
+                          &addresses_reassembly_table_functions);
+
+    prefs.reassembly_max_memory = 0;
+    prefs.reassembly_spill = FALSE;
+}
+
 /**********************************************************************************
  *
  * main
@@ -1535,6 +1793,9 @@ main(int argc _U_, char **argv _U_)
         test_fragment_add_seq_802_11_0,
         test_fragment_add_seq_802_11_1,
         test_simple_fragment_add_seq_next,
+        test_fragment_add_seq_check_memory_limit,
+        test_fragment_add_seq_check_memory_spill,
+        test_fragment_add_seq_check_memory_spill_frame,
 #if 0
         test_missing_data_fragment_add_seq_next,
         test_missing_data_fragment_add_seq_next_2,
@@ -78,20 +78,45 @@ typedef struct _tap_packet_t {
 static tap_packet_t tap_packet_array[TAP_PACKET_QUEUE_LEN];
 static guint tap_packet_index;
 
+/*
+ * Tap listeners with the same filter string share the compiled filter.
+ * A filter is applied to the whole packet, not to the tapped data, so its
+ * result is the same for every tap queued for a packet; it's evaluated
+ * at most once per packet, however many listeners use it and however
+ * many times their taps are queued.
+ */
+typedef struct _tap_filter_t {
+	guint ref_count;
+	gchar *fstring;
+	dfilter_t *code;
+	guint packet_id;	/* value of tap_packet_id when passed was set */
+	gboolean passed;
+	guint mark;		/* to visit each filter once in a walk over the listeners */
+	guint64 evals;
+	guint64 eval_us;
+} tap_filter_t;
+
+static guint tap_packet_id;
+static guint tap_filter_mark;
+
 typedef struct _tap_listener_t {
 	volatile struct _tap_listener_t *next;
 	int tap_id;
 	gboolean needs_redraw;
 	guint flags;
-	gchar *fstring;
-	dfilter_t *code;
+	tap_filter_t *filter;
 	void *tapdata;
 	tap_reset_cb reset;
 	tap_packet_cb packet;
 	tap_draw_cb draw;
+	guint64 packets;
+	guint64 packet_us;
 } tap_listener_t;
 static volatile tap_listener_t *tap_listener_queue=NULL;
 
+/* Whether to time the packet routines and filters of the tap listeners */
+static gboolean tap_timing=FALSE;
+
 #ifdef HAVE_PLUGINS
 static GSList *tap_plugins = NULL;
 
@@ -251,9 +276,11 @@ void tap_build_interesting (epan_dissect_t *edt)
 
 	/* loop over all tap listeners and build the list of all
 	   interesting hf_fields */
+	tap_filter_mark++;
 	for(tl=tap_listener_queue;tl;tl=tl->next){
-		if(tl->code){
-			epan_dissect_prime_with_dfilter(edt, tl->code);
+		if(tl->filter && tl->filter->code && tl->filter->mark!=tap_filter_mark){
+			epan_dissect_prime_with_dfilter(edt, tl->filter->code);
+			tl->filter->mark=tap_filter_mark;
 		}
 	}
 }
@@ -277,6 +304,33 @@ tap_queue_init(epan_dissect_t *edt)
 	tap_build_interesting (edt);
 }
 
+/* Apply a filter to the packet being tapped, or return its result if it
+   has already been applied to it. */
+static gboolean
+tap_filter_apply(tap_filter_t *filter, epan_dissect_t *edt)
+{
+	gint64 start=0;
+
+	if(!filter->code){
+		return TRUE;
+	}
+	if(filter->packet_id==tap_packet_id){
+		return filter->passed;
+	}
+
+	if(tap_timing){
+		start=g_get_monotonic_time();
+	}
+	filter->passed=dfilter_apply_edt(filter->code, edt);
+	if(tap_timing){
+		filter->eval_us+=g_get_monotonic_time()-start;
+	}
+	filter->evals++;
+	filter->packet_id=tap_packet_id;
+
+	return filter->passed;
+}
+
 /* this function is called after a packet has been fully dissected to push the tapped
    data to all extensions that has callbacks registered.
 */
@@ -299,6 +353,9 @@ tap_push_tapped_queue(epan_dissect_t *edt)
 		return;
 	}
 
+	/* a new packet, so no filter has been applied to it yet */
+	tap_packet_id++;
+
 	/* loop over all tap listeners and call the listener callback
 	   for all packets that match the filter. */
 	for(i=0;i<tap_packet_index;i++){
@@ -309,11 +366,20 @@ tap_push_tapped_queue(epan_dissect_t *edt)
 			{
 				if(tp->tap_id==tl->tap_id){
 					gboolean passed=TRUE;
-					if(tl->code){
-						passed=dfilter_apply_edt(tl->code, edt);
+					if(tl->filter){
+						passed=tap_filter_apply(tl->filter, edt);
 					}
 					if(passed && tl->packet){
+						gint64 start=0;
+
+						if(tap_timing){
+							start=g_get_monotonic_time();
+						}
 						tl->needs_redraw|=tl->packet(tl->tapdata, tp->pinfo, edt, tp->tap_specific_data);
+						if(tap_timing){
+							tl->packet_us+=g_get_monotonic_time()-start;
+						}
+						tl->packets++;
 					}
 				}
             }
@@ -378,6 +444,12 @@ reset_tap_listeners(void)
 			tl->reset(tl->tapdata);
 		}
 		tl->needs_redraw=TRUE;
+		tl->packets=0;
+		tl->packet_us=0;
+		if(tl->filter){
+			tl->filter->evals=0;
+			tl->filter->eval_us=0;
+		}
 	}
 
 }
@@ -445,13 +517,49 @@ find_tap_id(const char *name)
 	return 0;
 }
 
+/* Return the filter of another tap listener with the same filter string,
+   or compile a new one.  Returns NULL, with *err_msg set, if the filter
+   string isn't valid. */
+static tap_filter_t *
+tap_filter_get(const char *fstring, gchar **err_msg)
+{
+	volatile tap_listener_t *tl;
+	tap_filter_t *filter;
+	dfilter_t *code=NULL;
+
+	for(tl=tap_listener_queue;tl;tl=tl->next){
+		if(tl->filter && !strcmp(tl->filter->fstring, fstring)){
+			tl->filter->ref_count++;
+			return tl->filter;
+		}
+	}
+
+	if(!dfilter_compile(fstring, &code, err_msg)){
+		return NULL;
+	}
+	filter=g_new0(tap_filter_t, 1);
+	filter->ref_count=1;
+	filter->fstring=g_strdup(fstring);
+	filter->code=code;
+	return filter;
+}
+
+static void
+tap_filter_unref(tap_filter_t *filter)
+{
+	if(!filter || --filter->ref_count>0)
+		return;
+	dfilter_free(filter->code);
+	g_free(filter->fstring);
+	g_free(filter);
+}
+
 static void
 free_tap_listener(volatile tap_listener_t *tl)
 {
 	if(!tl)
 		return;
-	dfilter_free(tl->code);
-	g_free(tl->fstring);
+	tap_filter_unref(tl->filter);
 DIAG_OFF(cast-qual)
 	g_free((gpointer)tl);
 DIAG_ON(cast-qual)
@@ -469,7 +577,7 @@ register_tap_listener(const char *tapname, void *tapdata, const char *fstring,
 {
 	volatile tap_listener_t *tl;
 	int tap_id;
-	dfilter_t *code=NULL;
+	tap_filter_t *filter=NULL;
 	GString *error_string;
 	gchar *err_msg;
 
@@ -484,7 +592,8 @@ register_tap_listener(const char *tapname, void *tapdata, const char *fstring,
 	tl->needs_redraw=TRUE;
 	tl->flags=flags;
 	if(fstring){
-		if(!dfilter_compile(fstring, &code, &err_msg)){
+		filter=tap_filter_get(fstring, &err_msg);
+		if(!filter){
 			error_string = g_string_new("");
 			g_string_printf(error_string,
 			    "Filter \"%s\" is invalid - %s",
@@ -494,8 +603,7 @@ register_tap_listener(const char *tapname, void *tapdata, const char *fstring,
 			return error_string;
 		}
 	}
-	tl->fstring=g_strdup(fstring);
-	tl->code=code;
+	tl->filter=filter;
 
 	tl->tap_id=tap_id;
 	tl->tapdata=tapdata;
@@ -515,7 +623,7 @@ GString *
 set_tap_dfilter(void *tapdata, const char *fstring)
 {
 	volatile tap_listener_t *tl=NULL,*tl2;
-	dfilter_t *code=NULL;
+	tap_filter_t *filter=NULL;
 	GString *error_string;
 	gchar *err_msg;
 
@@ -536,15 +644,12 @@ set_tap_dfilter(void *tapdata, const char *fstring)
 	}
 
 	if(tl){
-		if(tl->code){
-			dfilter_free(tl->code);
-			tl->code=NULL;
-		}
+		tap_filter_unref(tl->filter);
+		tl->filter=NULL;
 		tl->needs_redraw=TRUE;
-		g_free(tl->fstring);
 		if(fstring){
-			if(!dfilter_compile(fstring, &code, &err_msg)){
-				tl->fstring=NULL;
+			filter=tap_filter_get(fstring, &err_msg);
+			if(!filter){
 				error_string = g_string_new("");
 				g_string_printf(error_string,
 						 "Filter \"%s\" is invalid - %s",
@@ -553,8 +658,7 @@ set_tap_dfilter(void *tapdata, const char *fstring)
 				return error_string;
 			}
 		}
-		tl->fstring=g_strdup(fstring);
-		tl->code=code;
+		tl->filter=filter;
 	}
 
 	return NULL;
@@ -569,23 +673,24 @@ tap_listeners_dfilter_recompile(void)
 	dfilter_t *code;
 	gchar *err_msg;
 
+	tap_filter_mark++;
 	for(tl=tap_listener_queue;tl;tl=tl->next){
-		if(tl->code){
-			dfilter_free(tl->code);
-			tl->code=NULL;
-		}
 		tl->needs_redraw=TRUE;
+		/* recompile shared filters only once */
+		if(!tl->filter || tl->filter->mark==tap_filter_mark){
+			continue;
+		}
+		tl->filter->mark=tap_filter_mark;
+		dfilter_free(tl->filter->code);
 		code=NULL;
-		if(tl->fstring){
-			if(!dfilter_compile(tl->fstring, &code, &err_msg)){
+		if(!dfilter_compile(tl->filter->fstring, &code, &err_msg)){
+			g_free(err_msg);
+			err_msg = NULL;
+			/* Not valid, make a dfilter matching no packets */
+			if (!dfilter_compile("frame.number == 0", &code, &err_msg))
 				g_free(err_msg);
-				err_msg = NULL;
-				/* Not valid, make a dfilter matching no packets */
-				if (!dfilter_compile("frame.number == 0", &code, &err_msg))
-					g_free(err_msg);
-			}
 		}
-		tl->code=code;
+		tl->filter->code=code;
 	}
 }
 
@@ -661,7 +766,7 @@ have_filtering_tap_listeners(void)
 	volatile tap_listener_t *tl;
 
 	for(tl=tap_listener_queue;tl;tl=tl->next){
-		if(tl->code)
+		if(tl->filter && tl->filter->code)
 			return TRUE;
 	}
 	return FALSE;
@@ -684,6 +789,36 @@ union_of_tap_listener_flags(void)
 	return flags;
 }
 
+void
+tap_listeners_set_timing(gboolean enable)
+{
+	tap_timing=enable;
+}
+
+GArray *
+tap_listeners_get_timing(void)
+{
+	GArray *timings=g_array_new(FALSE, FALSE, sizeof(tap_listener_timing_t));
+	volatile tap_listener_t *tl;
+	tap_dissector_t *td;
+	tap_listener_timing_t timing;
+	int i;
+
+	for(tl=tap_listener_queue;tl;tl=tl->next){
+		/* tap ids are the 1-origin positions in the list of taps */
+		for(i=1,td=tap_dissector_list;td && i<tl->tap_id;i++,td=td->next)
+			;
+		timing.tapname=td ? td->name : NULL;
+		timing.fstring=tl->filter ? tl->filter->fstring : NULL;
+		timing.packets=tl->packets;
+		timing.packet_us=tl->packet_us;
+		timing.filter_evals=tl->filter ? tl->filter->evals : 0;
+		timing.filter_us=tl->filter ? tl->filter->eval_us : 0;
+		g_array_prepend_val(timings, timing);
+	}
+	return timings;
+}
+
 void tap_cleanup(void)
 {
 	volatile tap_listener_t *elem_lq;
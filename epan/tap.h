@@ -238,6 +238,35 @@ WS_DLL_PUBLIC gboolean have_filtering_tap_listeners(void);
  */
 WS_DLL_PUBLIC guint union_of_tap_listener_flags(void);
 
+/** Time spent in a tap listener, as returned by tap_listeners_get_timing().
+ *  Times are only measured while timing is enabled with
+ *  tap_listeners_set_timing(). */
+typedef struct {
+	const char *tapname;	/**< name of the tap it listens to */
+	const char *fstring;	/**< its filter, or NULL */
+	guint64 packets;	/**< number of calls of its packet routine */
+	guint64 packet_us;	/**< microseconds spent in its packet routine */
+	guint64 filter_evals;	/**< number of evaluations of its filter */
+	guint64 filter_us;	/**< microseconds spent evaluating its filter */
+} tap_listener_timing_t;
+
+/** Enable or disable timing of the packet routines and filters of the
+ *  tap listeners. The counts are reset by reset_tap_listeners(). */
+WS_DLL_PUBLIC void tap_listeners_set_timing(gboolean enable);
+
+/** Get the counts and times of the tap listeners, in the order in which
+ *  they were registered.
+ *
+ *  Tap listeners with the same filter string share it, and it's evaluated
+ *  at most once per packet for all of them, so the filter counts of such
+ *  listeners are those of the shared filter.
+ *
+ *  @return A GArray of tap_listener_timing_t, to be freed with
+ *  g_array_free(timings, TRUE). The strings in it are owned by the tap
+ *  system and are valid until the listener is removed.
+ */
+WS_DLL_PUBLIC GArray *tap_listeners_get_timing(void);
+
 /** This function can be used by a dissector to fetch any tapped data before
  * returning.
  * This can be useful if one wants to extract the data inside dissector  BEFORE
@@ -16,6 +16,7 @@
 #include <string.h>
 
 #include "tvbuff.h"
+#include "tvbuff-int.h"
 #include "exceptions.h"
 #include "wsutil/pint.h"
 
@@ -483,6 +484,183 @@ run_tests(void)
 	tvb_free_chain(tvb_parent);  /* should free all tvb's and associated data */
 }
 
+/* The needles are spread so that searches start, stop and find them in
+ * different members of the composites below */
+static const guint8 search_data[] = "xyzaxbyczdxaybzq";
+#define SEARCH_LENGTH	15
+#define SEARCH_MEMBER_LENGTH	5
+
+/* Search for each of needles starting from every offset, with every
+ * maxlength, and check the results against those for the flat data. */
+static void
+test_search(tvbuff_t *tvb, const gchar* name, const gchar *needles)
+{
+	ws_mempbrk_pattern	pattern;
+	const guint8		*found;
+	guchar			found_needle, expected_needle;
+	gint			offset, maxlength, result, expected;
+	const gchar		*needle;
+
+	ws_mempbrk_compile(&pattern, needles);
+
+	for (offset = 0; offset <= SEARCH_LENGTH; offset++) {
+		for (maxlength = -1; maxlength <= SEARCH_LENGTH - offset; maxlength++) {
+			guint limit = (guint)(maxlength == -1 ? SEARCH_LENGTH - offset : maxlength);
+
+			for (needle = needles; *needle; needle++) {
+				found = (const guint8 *)memchr(&search_data[offset], *needle, limit);
+				expected = found ? (gint)(found - search_data) : -1;
+				result = tvb_find_guint8(tvb, offset, maxlength, *needle);
+				if (result != expected) {
+					printf("13: Failed TVB=%s find_guint8 '%c' @ %d/%d = %d, expected %d\n",
+							name, *needle, offset, maxlength, result, expected);
+					failed = TRUE;
+					return;
+				}
+			}
+
+			expected = -1;
+			expected_needle = 0;
+			for (result = offset; result < offset + (gint)limit; result++) {
+				if (strchr(needles, search_data[result])) {
+					expected = result;
+					expected_needle = search_data[result];
+					break;
+				}
+			}
+			found_needle = 0;
+			result = tvb_ws_mempbrk_pattern_guint8(tvb, offset, maxlength, &pattern, &found_needle);
+			if (result != expected || found_needle != expected_needle) {
+				printf("14: Failed TVB=%s pbrk \"%s\" @ %d/%d = %d, expected %d\n",
+						name, needles, offset, maxlength, result, expected);
+				failed = TRUE;
+				return;
+			}
+		}
+	}
+}
+
+/* Searching a composite mustn't flatten it */
+static void
+test_not_flattened(tvbuff_t *tvb, const gchar* name)
+{
+	if (tvb->real_data) {
+		printf("15: Failed TVB=%s was flattened by searching\n", name);
+		failed = TRUE;
+	}
+}
+
+static void
+test_composite_search(void)
+{
+	tvbuff_t	*tvb_flat, *tvb_comp;
+	gint		i;
+
+	tvb_flat = tvb_new_real_data(search_data, SEARCH_LENGTH, SEARCH_LENGTH);
+
+	printf("Making Composite Search\n");
+	tvb_comp = tvb_new_composite();
+	for (i = 0; i < SEARCH_LENGTH; i += SEARCH_MEMBER_LENGTH)
+		tvb_composite_append(tvb_comp, tvb_new_subset_length(tvb_flat, i, SEARCH_MEMBER_LENGTH));
+	tvb_composite_finalize(tvb_comp);
+
+	test_search(tvb_comp, "Composite Search", "abcdxyzq");
+	test_search(tvb_comp, "Composite Search", "ab");
+	test_search(tvb_comp, "Composite Search", "dz");
+	test_search(tvb_comp, "Composite Search", "q");
+	test_not_flattened(tvb_comp, "Composite Search");
+
+	tvb_free_chain(tvb_flat);
+}
+
+static guint members_freed;
+
+static void
+member_free_cb(void *data)
+{
+	members_freed++;
+	g_free(data);
+}
+
+static tvbuff_t *
+new_owning_composite(void)
+{
+	tvbuff_t	*tvb_comp, *member;
+	gint		i;
+
+	tvb_comp = tvb_new_composite();
+	for (i = 0; i < SEARCH_LENGTH; i += SEARCH_MEMBER_LENGTH) {
+		member = tvb_new_real_data((const guint8 *)g_memdup(&search_data[i], SEARCH_MEMBER_LENGTH),
+				SEARCH_MEMBER_LENGTH, SEARCH_MEMBER_LENGTH);
+		tvb_set_free_cb(member, member_free_cb);
+		tvb_composite_append(tvb_comp, member);
+	}
+	tvb_composite_finalize_owning(tvb_comp);
+	members_freed = 0;
+	return tvb_comp;
+}
+
+/* Get a pointer to data spanning members, which flattens the composite */
+static void
+test_flatten(tvbuff_t *tvb, const gchar* name)
+{
+	const guint8	*ptr;
+
+	ptr = tvb_get_ptr(tvb, SEARCH_MEMBER_LENGTH - 2, 4);
+	if (memcmp(ptr, &search_data[SEARCH_MEMBER_LENGTH - 2], 4) != 0) {
+		printf("16: Failed TVB=%s flattened data doesn't match\n", name);
+		failed = TRUE;
+	}
+}
+
+/* A composite that owns its members frees them once it's flattened,
+ * unless a pointer into one of them has been returned. */
+static void
+test_composite_owning(void)
+{
+	tvbuff_t	*tvb_comp;
+	const guint8	*member_ptr;
+
+	printf("Making Composite Owning 0\n");
+	tvb_comp = new_owning_composite();
+	test_search(tvb_comp, "Composite Owning 0", "abcdxyzq");
+	test_not_flattened(tvb_comp, "Composite Owning 0");
+	test_flatten(tvb_comp, "Composite Owning 0");
+	if (members_freed != SEARCH_LENGTH / SEARCH_MEMBER_LENGTH) {
+		printf("17: Failed TVB=Composite Owning 0 %u members freed after flattening\n",
+				members_freed);
+		failed = TRUE;
+	}
+	if (tvb_offset_from_real_beginning(tvb_comp) != 0) {
+		printf("18: Failed TVB=Composite Owning 0 offset from real beginning %u\n",
+				tvb_offset_from_real_beginning(tvb_comp));
+		failed = TRUE;
+	}
+	test(tvb_comp, "Composite Owning 0", (guint8 *)search_data, SEARCH_LENGTH, SEARCH_LENGTH);
+	test_search(tvb_comp, "Composite Owning 0", "ab");
+	tvb_free(tvb_comp);
+	if (members_freed != SEARCH_LENGTH / SEARCH_MEMBER_LENGTH) {
+		printf("19: Failed TVB=Composite Owning 0 %u members freed\n", members_freed);
+		failed = TRUE;
+	}
+
+	printf("Making Composite Owning 1\n");
+	tvb_comp = new_owning_composite();
+	member_ptr = tvb_get_ptr(tvb_comp, SEARCH_MEMBER_LENGTH, SEARCH_MEMBER_LENGTH);
+	test_flatten(tvb_comp, "Composite Owning 1");
+	if (members_freed != 0 ||
+	    memcmp(member_ptr, &search_data[SEARCH_MEMBER_LENGTH], SEARCH_MEMBER_LENGTH) != 0) {
+		printf("20: Failed TVB=Composite Owning 1 member freed while pointed to\n");
+		failed = TRUE;
+	}
+	test(tvb_comp, "Composite Owning 1", (guint8 *)search_data, SEARCH_LENGTH, SEARCH_LENGTH);
+	tvb_free(tvb_comp);
+	if (members_freed != SEARCH_LENGTH / SEARCH_MEMBER_LENGTH) {
+		printf("21: Failed TVB=Composite Owning 1 %u members freed\n", members_freed);
+		failed = TRUE;
+	}
+}
+
 /* Note: valgrind can be used to check for tvbuff memory leaks */
 int
 main(void)
@@ -493,6 +671,8 @@ main(void)
 
 	except_init();
 	run_tests();
+	test_composite_search();
+	test_composite_owning();
 	except_deinit();
 	exit(failed?1:0);
 }
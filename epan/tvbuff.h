@@ -208,6 +208,13 @@ WS_DLL_PUBLIC tvbuff_t *tvb_new_composite(void);
  * occur, data access can finally happen after this finalization. */
 WS_DLL_PUBLIC void tvb_composite_finalize(tvbuff_t *tvb);
 
+/** Like tvb_composite_finalize(), but the composite tvbuff takes ownership
+ * of its members instead of being chained to the first of them; the members
+ * are freed when the composite tvbuff is freed, or when it's flattened if
+ * nothing can still point into them, so they must not be in any other
+ * chain. */
+WS_DLL_PUBLIC void tvb_composite_finalize_owning(tvbuff_t *tvb);
+
 
 /* Get amount of captured data in the buffer (which is *NOT* necessarily the
  * length of the packet). You probably want tvb_reported_length instead. */
@@ -11,12 +11,14 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "tvbuff.h"
 #include "tvbuff-int.h"
 #include "proto.h"	/* XXX - only used for DISSECTOR_ASSERT, probably a new header file? */
 
 typedef struct {
-	GSList		*tvbs;
+	GPtrArray	*tvbs;
 
 	/* Used for quick testing to see if this
 	 * is the tvbuff that a COMPOSITE is
@@ -24,6 +26,16 @@ typedef struct {
 	guint		*start_offsets;
 	guint		*end_offsets;
 
+	/* The members are freed along with the composite */
+	gboolean	owns_members;
+
+	/* A pointer into a member's data has been returned, so the
+	 * members can't be freed when the composite is flattened */
+	gboolean	member_ptr_returned;
+
+	/* Offset of the first member from the real beginning, kept
+	 * for when the members have been freed */
+	guint		first_member_offset;
 } tvb_comp_t;
 
 struct tvb_composite {
@@ -32,13 +44,21 @@ struct tvb_composite {
 	tvb_comp_t	composite;
 };
 
+#define COMPOSITE_MEMBER(composite, i) \
+	((tvbuff_t *)g_ptr_array_index((composite)->tvbs, (i)))
+
 static void
 composite_free(tvbuff_t *tvb)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	tvb_comp_t *composite = &composite_tvb->composite;
+	guint	    i;
 
-	g_slist_free(composite->tvbs);
+	if (composite->owns_members) {
+		for (i = 0; i < composite->tvbs->len; i++)
+			tvb_free(COMPOSITE_MEMBER(composite, i));
+	}
+	g_ptr_array_free(composite->tvbs, TRUE);
 
 	g_free(composite->start_offsets);
 	g_free(composite->end_offsets);
@@ -54,42 +74,81 @@ static guint
 composite_offset(const tvbuff_t *tvb, const guint counter)
 {
 	const struct tvb_composite *composite_tvb = (const struct tvb_composite *) tvb;
-	const tvbuff_t *member = (const tvbuff_t *)composite_tvb->composite.tvbs->data;
+	const tvb_comp_t *composite = &composite_tvb->composite;
 
-	return tvb_offset_from_real_beginning_counter(member, counter);
+	if (composite->tvbs->len == 0) {
+		/* Flattened, and the members freed */
+		return composite->first_member_offset + counter;
+	}
+	return tvb_offset_from_real_beginning_counter(COMPOSITE_MEMBER(composite, 0), counter);
+}
+
+/*
+ * Once a composite that owns its members has been flattened, the members
+ * are only needed for pointers that have already been returned into their
+ * data; if there are none, free them rather than keep two copies.
+ */
+static void
+composite_free_members(tvb_comp_t *composite)
+{
+	guint	    i;
+
+	if (!composite->owns_members || composite->member_ptr_returned)
+		return;
+
+	composite->first_member_offset =
+		tvb_offset_from_real_beginning(COMPOSITE_MEMBER(composite, 0));
+	for (i = 0; i < composite->tvbs->len; i++)
+		tvb_free(COMPOSITE_MEMBER(composite, i));
+	g_ptr_array_set_size(composite->tvbs, 0);
+}
+
+/*
+ * Find the index of the member containing abs_offset, by a binary search
+ * of the end offsets (which are strictly increasing, as members can't be
+ * zero-length).  Returns the number of members if abs_offset is past the
+ * end of the last member.
+ */
+static guint
+composite_find_member(const tvb_comp_t *composite, const guint abs_offset)
+{
+	guint low = 0;
+	guint high = composite->tvbs->len;
+	guint mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (composite->end_offsets[mid] < abs_offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
 }
 
 static const guint8*
 composite_get_ptr(tvbuff_t *tvb, guint abs_offset, guint abs_length)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
-	tvbuff_t   *member_tvb = NULL;
+	tvbuff_t   *member_tvb;
 	guint	    member_offset;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
 	/* Maybe the range specified by offset/length
 	 * is contiguous inside one of the member tvbuffs */
 	composite = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	i = composite_find_member(composite, abs_offset);
 
 	/* special case */
-	if (!member_tvb) {
+	if (i == composite->tvbs->len) {
 		DISSECTOR_ASSERT(abs_offset == tvb->length && abs_length == 0);
 		return "";
 	}
 
+	member_tvb = COMPOSITE_MEMBER(composite, i);
 	member_offset = abs_offset - composite->start_offsets[i];
 
 	if (tvb_bytes_exist(member_tvb, member_offset, abs_length)) {
@@ -97,6 +156,7 @@ composite_get_ptr(tvbuff_t *tvb, guint abs_offset, guint abs_length)
 		 * The range is, in fact, contiguous within member_tvb.
 		 */
 		DISSECTOR_ASSERT(!tvb->real_data);
+		composite->member_ptr_returned = TRUE;
 		return tvb_get_ptr(member_tvb, member_offset, abs_length);
 	}
 	else {
@@ -104,6 +164,7 @@ composite_get_ptr(tvbuff_t *tvb, guint abs_offset, guint abs_length)
 		void *real_data = g_malloc(tvb->length);
 		tvb_memcpy(tvb, real_data, 0, tvb->length);
 		tvb->real_data = (const guint8 *)real_data;
+		composite_free_members(composite);
 		return tvb->real_data + abs_offset;
 	}
 
@@ -116,63 +177,108 @@ composite_memcpy(tvbuff_t *tvb, void* _target, guint abs_offset, guint abs_lengt
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	guint8 *target = (guint8 *) _target;
 
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
-	tvbuff_t   *member_tvb = NULL;
+	tvbuff_t   *member_tvb;
 	guint	    member_offset, member_length;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
-	/* Maybe the range specified by offset/length
-	 * is contiguous inside one of the member tvbuffs */
-	composite   = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	composite = &composite_tvb->composite;
+	i = composite_find_member(composite, abs_offset);
 
 	/* special case */
-	if (!member_tvb) {
+	if (i == composite->tvbs->len) {
 		DISSECTOR_ASSERT(abs_offset == tvb->length && abs_length == 0);
 		return target;
 	}
 
+	DISSECTOR_ASSERT(!tvb->real_data);
+
+	/* Copy the part that's in the first member tvb, then the portions
+	 * of the following members, until we have copied all data.
+	 */
 	member_offset = abs_offset - composite->start_offsets[i];
+	while (abs_length > 0) {
+		DISSECTOR_ASSERT(i < composite->tvbs->len);
+		member_tvb = COMPOSITE_MEMBER(composite, i);
+		member_length = member_tvb->length - member_offset;
+		if (member_length > abs_length)
+			member_length = abs_length;
 
-	if (tvb_bytes_exist(member_tvb, member_offset, abs_length)) {
-		DISSECTOR_ASSERT(!tvb->real_data);
-		return tvb_memcpy(member_tvb, target, member_offset, abs_length);
+		tvb_memcpy(member_tvb, target, member_offset, member_length);
+		target		+= member_length;
+		abs_length	-= member_length;
+		member_offset	 = 0;
+		i++;
 	}
-	else {
-		/* The requested data is non-contiguous inside
-		 * the member tvb. We have to memcpy() the part that's in the member tvb,
-		 * then iterate across the other member tvb's, copying their portions
-		 * until we have copied all data.
-		 */
-		member_length = tvb_captured_length_remaining(member_tvb, member_offset);
 
-		/* composite_memcpy() can't handle a member_length of zero. */
-		DISSECTOR_ASSERT(member_length > 0);
+	return _target;
+}
 
-		tvb_memcpy(member_tvb, target, member_offset, member_length);
-		abs_offset	+= member_length;
-		abs_length	-= member_length;
+static gint
+composite_find_guint8(tvbuff_t *tvb, guint abs_offset, guint limit, guint8 needle)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+	tvb_comp_t *composite = &composite_tvb->composite;
+	tvbuff_t   *member_tvb;
+	guint	    i, member_offset, member_limit;
+	gint	    result;
 
-		/* Recurse */
-		if (abs_length > 0) {
-			composite_memcpy(tvb, target + member_length, abs_offset, abs_length);
-		}
+	/* Search each member in turn, so as not to flatten the composite */
+	i = composite_find_member(composite, abs_offset);
+	if (i == composite->tvbs->len)
+		return -1;
 
-		return target;
+	member_offset = abs_offset - composite->start_offsets[i];
+	while (limit > 0 && i < composite->tvbs->len) {
+		member_tvb = COMPOSITE_MEMBER(composite, i);
+		member_limit = member_tvb->length - member_offset;
+		if (member_limit > limit)
+			member_limit = limit;
+
+		result = tvb_find_guint8(member_tvb, member_offset, member_limit, needle);
+		if (result != -1)
+			return (gint) composite->start_offsets[i] + result;
+
+		limit		-= member_limit;
+		member_offset	 = 0;
+		i++;
 	}
 
-	DISSECTOR_ASSERT_NOT_REACHED();
+	return -1;
+}
+
+static gint
+composite_pbrk_guint8(tvbuff_t *tvb, guint abs_offset, guint limit, const ws_mempbrk_pattern* pattern, guchar *found_needle)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+	tvb_comp_t *composite = &composite_tvb->composite;
+	tvbuff_t   *member_tvb;
+	guint	    i, member_offset, member_limit;
+	gint	    result;
+
+	i = composite_find_member(composite, abs_offset);
+	if (i == composite->tvbs->len)
+		return -1;
+
+	member_offset = abs_offset - composite->start_offsets[i];
+	while (limit > 0 && i < composite->tvbs->len) {
+		member_tvb = COMPOSITE_MEMBER(composite, i);
+		member_limit = member_tvb->length - member_offset;
+		if (member_limit > limit)
+			member_limit = limit;
+
+		result = tvb_ws_mempbrk_pattern_guint8(member_tvb, member_offset, member_limit, pattern, found_needle);
+		if (result != -1)
+			return (gint) composite->start_offsets[i] + result;
+
+		limit		-= member_limit;
+		member_offset	 = 0;
+		i++;
+	}
+
+	return -1;
 }
 
 static const struct tvb_ops tvb_composite_ops = {
@@ -182,8 +288,8 @@ static const struct tvb_ops tvb_composite_ops = {
 	composite_offset,     /* offset */
 	composite_get_ptr,    /* get_ptr */
 	composite_memcpy,     /* memcpy */
-	NULL,                 /* find_guint8 XXX */
-	NULL,                 /* pbrk_guint8 XXX */
+	composite_find_guint8, /* find_guint8 */
+	composite_pbrk_guint8, /* pbrk_guint8 */
 	NULL,                 /* clone */
 };
 
@@ -194,6 +300,11 @@ static const struct tvb_ops tvb_composite_ops = {
  *      tvb is finalized.
  *      This means that composite tvb members must all be in the same chain.
  *      ToDo: enforce this: By searching the chain?
+ *
+ *   2. Unless it's finalized with tvb_composite_finalize_owning(), in which
+ *      case it isn't chained at all; it owns its members and frees them when
+ *      it's freed, or as soon as it's flattened if no pointer into their
+ *      data has been returned.
  */
 tvbuff_t *
 tvb_new_composite(void)
@@ -202,9 +313,12 @@ tvb_new_composite(void)
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	tvb_comp_t *composite = &composite_tvb->composite;
 
-	composite->tvbs		 = NULL;
+	composite->tvbs		 = g_ptr_array_new();
 	composite->start_offsets = NULL;
 	composite->end_offsets	 = NULL;
+	composite->owns_members	 = FALSE;
+	composite->member_ptr_returned = FALSE;
+	composite->first_member_offset = 0;
 
 	return tvb;
 }
@@ -223,8 +337,8 @@ tvb_composite_append(tvbuff_t *tvb, tvbuff_t *member)
 	 */
 	DISSECTOR_ASSERT(member->length);
 
-	composite       = &composite_tvb->composite;
-	composite->tvbs = g_slist_append(composite->tvbs, member);
+	composite = &composite_tvb->composite;
+	g_ptr_array_add(composite->tvbs, member);
 }
 
 void
@@ -241,19 +355,21 @@ tvb_composite_prepend(tvbuff_t *tvb, tvbuff_t *member)
 	 */
 	DISSECTOR_ASSERT(member->length);
 
-	composite       = &composite_tvb->composite;
-	composite->tvbs = g_slist_prepend(composite->tvbs, member);
+	composite = &composite_tvb->composite;
+	g_ptr_array_add(composite->tvbs, NULL);
+	memmove(&composite->tvbs->pdata[1], &composite->tvbs->pdata[0],
+	    (composite->tvbs->len - 1) * sizeof(gpointer));
+	composite->tvbs->pdata[0] = member;
 }
 
-void
-tvb_composite_finalize(tvbuff_t *tvb)
+static void
+composite_finalize(tvbuff_t *tvb, gboolean owns_members)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
-	GSList	   *slist;
 	guint	    num_members;
 	tvbuff_t   *member_tvb;
 	tvb_comp_t *composite;
-	int	    i = 0;
+	guint	    i;
 
 	DISSECTOR_ASSERT(tvb && !tvb->initialized);
 	DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops);
@@ -262,7 +378,7 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	DISSECTOR_ASSERT(tvb->contained_length == 0);
 
 	composite   = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
+	num_members = composite->tvbs->len;
 
 	/* Dissectors should not create composite TVBs if they're not going to
 	 * put at least one TVB in them.
@@ -273,24 +389,34 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	composite->start_offsets = g_new(guint, num_members);
 	composite->end_offsets = g_new(guint, num_members);
 
-	for (slist = composite->tvbs; slist != NULL; slist = slist->next) {
-		DISSECTOR_ASSERT((guint) i < num_members);
-		member_tvb = (tvbuff_t *)slist->data;
+	for (i = 0; i < num_members; i++) {
+		member_tvb = COMPOSITE_MEMBER(composite, i);
 		composite->start_offsets[i] = tvb->length;
 		tvb->length += member_tvb->length;
 		tvb->reported_length += member_tvb->reported_length;
 		tvb->contained_length += member_tvb->contained_length;
 		composite->end_offsets[i] = tvb->length - 1;
-		i++;
 	}
 
-	DISSECTOR_ASSERT(composite->tvbs);
-
-	tvb_add_to_chain((tvbuff_t *)composite->tvbs->data, tvb); /* chain composite tvb to first member */
+	composite->owns_members = owns_members;
+	if (!owns_members)
+		tvb_add_to_chain(COMPOSITE_MEMBER(composite, 0), tvb); /* chain composite tvb to first member */
 	tvb->initialized = TRUE;
 	tvb->ds_tvb = tvb;
 }
 
+void
+tvb_composite_finalize(tvbuff_t *tvb)
+{
+	composite_finalize(tvb, FALSE);
+}
+
+void
+tvb_composite_finalize_owning(tvbuff_t *tvb)
+{
+	composite_finalize(tvb, TRUE);
+}
+
 /*
  * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
  *
@@ -19,6 +19,506 @@
 #include "value_string.h"
 #include <wsutil/ws_printf.h> /* ws_g_warning */
 
+/* COMPILED LOOKUPS */
+
+/* Plain value_string and range_string arrays are searched linearly, which
+ * gets slow for the larger ones. So the first time an array is searched, it
+ * is "compiled" into a structure that can be searched faster, chosen from the
+ * values it contains:
+ *
+ * - VSC_LINEAR - a few entries: a linear search, which is as fast as any
+ * - VSC_INDEX  - contiguous values in order: the value is the index
+ * - VSC_DENSE  - values within a small range: a table indexed by the value
+ * - VSC_SORTED - anything else: a binary search of the sorted values, or of
+ *                the start of each run of values that the ranges of a
+ *                range_string map to the same entry
+ *
+ * Lookups return the index of the first matching entry, just as a linear
+ * search would, so duplicate values and overlapping ranges work as before.
+ *
+ * Only arrays registered with value_string_register_static(), which the
+ * arrays of registered fields are, are compiled; those are promised not to
+ * be changed in place or freed without value_string_forget() being called,
+ * so a value that isn't in the compiled structure isn't in the array. Any
+ * other array might have been changed, or freed and replaced by a shorter
+ * one at the same address, so it's searched linearly up to its terminator
+ * as it always was.
+ *
+ * The compiled structures, and the note that an array isn't registered,
+ * are found by the address of the array, through a small direct-mapped
+ * cache in front of a hash table. Some registered arrays are filled in, or
+ * appended to, after they have been used, so a compiled structure is only
+ * used while the array still starts with the same string and is still
+ * terminated where it was when compiled, and a match is always checked
+ * against the array itself. Their storage stays put, so reading where the
+ * terminator was is safe. Everything is also forgotten whenever dissection
+ * is reinitialized.
+ *
+ * Another thread may be searching with a compiled structure that is being
+ * replaced or forgotten, so they're kept until everything is forgotten.
+ */
+#define VSC_MIN_ENTRIES   8     /* fewer entries than this are searched linearly */
+#define VSC_CACHE_BITS    10
+#define VSC_CACHE_SIZE    (1U << VSC_CACHE_BITS)
+#define VSC_CACHE_HASH(P) ((guint)((guint32)((guintptr)(P) >> 3) * 0x9E3779B1U) >> (32 - VSC_CACHE_BITS))
+/* The largest span of values (from min to max) for a VSC_DENSE table */
+#define VSC_DENSE_MAX_SPAN(N) (4 * (N) + 64)
+
+typedef struct _vs_compiled vs_compiled;
+
+/* Returns the index of the first entry matching val, or -1 */
+typedef gint (*vs_compiled_match_t)(const vs_compiled *vsc, guint32 val);
+
+struct _vs_compiled {
+    vs_compiled_match_t  match;        /* NULL if the array isn't registered */
+    const void          *strings;      /* the value_string or range_string array */
+    const gchar * const *begin_strptr; /* strptr of its first entry */
+    const gchar         *first_strptr; /* and what it pointed to */
+    const gchar * const *end_strptr;   /* strptr of its terminating entry */
+    guint                num_entries;  /* excluding the terminating entry */
+    guint32              first_value;  /* VSC_INDEX, VSC_DENSE */
+    guint                table_len;    /* VSC_DENSE, VSC_SORTED */
+    guint32             *values;       /* VSC_SORTED */
+    gint                *table;        /* VSC_DENSE, VSC_SORTED: index of the entry or -1 */
+};
+
+typedef vs_compiled *(*vs_compile_func_t)(const void *strings);
+
+static vs_compiled *vs_compiled_cache[VSC_CACHE_SIZE];
+static GHashTable  *vs_compiled_table = NULL;
+static GPtrArray   *vs_compiled_stale = NULL;
+static GHashTable  *vs_static_table = NULL;  /* registered arrays */
+static GMutex       vs_compiled_lock;
+
+/* Searches of arrays that aren't registered, up to their terminator. */
+static gint
+vs_search_linear(const value_string *vs, guint32 val)
+{
+    gint i;
+
+    for (i = 0; vs[i].strptr; i++) {
+        if (vs[i].value == val)
+            return i;
+    }
+    return -1;
+}
+
+static gint
+rs_search_linear(const range_string *rs, guint32 val)
+{
+    gint i;
+
+    for (i = 0; rs[i].strptr; i++) {
+        if ((val >= rs[i].value_min) && (val <= rs[i].value_max))
+            return i;
+    }
+    return -1;
+}
+
+static gint
+vs_match_linear(const vs_compiled *vsc, guint32 val)
+{
+    const value_string *vs = (const value_string *)vsc->strings;
+    guint i;
+
+    for (i = 0; i < vsc->num_entries; i++) {
+        if (vs[i].value == val)
+            return (gint)i;
+    }
+    return -1;
+}
+
+static gint
+vs_match_index(const vs_compiled *vsc, guint32 val)
+{
+    guint i = val - vsc->first_value;
+
+    return i < vsc->num_entries ? (gint)i : -1;
+}
+
+static gint
+vs_match_dense(const vs_compiled *vsc, guint32 val)
+{
+    guint i = val - vsc->first_value;
+
+    return i < vsc->table_len ? vsc->table[i] : -1;
+}
+
+static gint
+vs_match_sorted(const vs_compiled *vsc, guint32 val)
+{
+    guint low = 0, max = vsc->table_len, i;
+
+    while (low < max) {
+        i = (low + max) / 2;
+        if (val < vsc->values[i])
+            max = i;
+        else if (val > vsc->values[i])
+            low = i + 1;
+        else
+            return vsc->table[i];
+    }
+    return -1;
+}
+
+static gint
+rs_match_linear(const vs_compiled *vsc, guint32 val)
+{
+    const range_string *rs = (const range_string *)vsc->strings;
+    guint i;
+
+    for (i = 0; i < vsc->num_entries; i++) {
+        if ((val >= rs[i].value_min) && (val <= rs[i].value_max))
+            return (gint)i;
+    }
+    return -1;
+}
+
+/* The values are the start of each run, the first one being 0, so find the
+ * last one that's <= val. */
+static gint
+rs_match_sorted(const vs_compiled *vsc, guint32 val)
+{
+    guint low = 0, max = vsc->table_len, i;
+
+    while (max - low > 1) {
+        i = (low + max) / 2;
+        if (val < vsc->values[i])
+            max = i;
+        else
+            low = i;
+    }
+    return vsc->table[low];
+}
+
+typedef struct {
+    guint32 value;
+    gint    idx;
+} vs_compiled_pair;
+
+static int
+vs_compiled_pair_cmp(const void *a, const void *b)
+{
+    const vs_compiled_pair *pa = (const vs_compiled_pair *)a;
+    const vs_compiled_pair *pb = (const vs_compiled_pair *)b;
+
+    if (pa->value != pb->value)
+        return pa->value < pb->value ? -1 : 1;
+    return pa->idx - pb->idx;
+}
+
+static int
+vs_compiled_value_cmp(const void *a, const void *b)
+{
+    guint32 va = *(const guint32 *)a;
+    guint32 vb = *(const guint32 *)b;
+
+    return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+static vs_compiled *
+vs_compile(const void *strings)
+{
+    const value_string *vs = (const value_string *)strings;
+    vs_compiled        *vsc = g_new0(vs_compiled, 1);
+    vs_compiled_pair   *pairs;
+    guint32             min_value, max_value;
+    gboolean            contiguous = TRUE;
+    guint               n, i, j;
+
+    for (n = 0; vs[n].strptr; n++)
+        ;
+
+    vsc->strings      = strings;
+    vsc->begin_strptr = &vs[0].strptr;
+    vsc->first_strptr = vs[0].strptr;
+    vsc->end_strptr   = &vs[n].strptr;
+    vsc->num_entries = n;
+    vsc->match       = vs_match_linear;
+    if (n < VSC_MIN_ENTRIES)
+        return vsc;
+
+    min_value = max_value = vs[0].value;
+    for (i = 0; i < n; i++) {
+        if (vs[i].value != vs[0].value + i)
+            contiguous = FALSE;
+        if (vs[i].value < min_value)
+            min_value = vs[i].value;
+        if (vs[i].value > max_value)
+            max_value = vs[i].value;
+    }
+
+    if (contiguous) {
+        /* This also covers runs like { -2, -1, 0, 1 } */
+        vsc->first_value = vs[0].value;
+        vsc->match       = vs_match_index;
+    }
+    else if (max_value - min_value < VSC_DENSE_MAX_SPAN(n)) {
+        vsc->first_value = min_value;
+        vsc->table_len   = max_value - min_value + 1;
+        vsc->table       = g_new(gint, vsc->table_len);
+        for (i = 0; i < vsc->table_len; i++)
+            vsc->table[i] = -1;
+        /* backwards, so that the first of duplicate values wins */
+        for (i = n; i-- > 0; )
+            vsc->table[vs[i].value - min_value] = (gint)i;
+        vsc->match       = vs_match_dense;
+    }
+    else {
+        pairs = g_new(vs_compiled_pair, n);
+        for (i = 0; i < n; i++) {
+            pairs[i].value = vs[i].value;
+            pairs[i].idx   = (gint)i;
+        }
+        qsort(pairs, n, sizeof(vs_compiled_pair), vs_compiled_pair_cmp);
+
+        vsc->values = g_new(guint32, n);
+        vsc->table  = g_new(gint, n);
+        for (i = 0, j = 0; i < n; i++) {
+            /* only the first of duplicate values */
+            if (j > 0 && vsc->values[j - 1] == pairs[i].value)
+                continue;
+            vsc->values[j] = pairs[i].value;
+            vsc->table[j]  = pairs[i].idx;
+            j++;
+        }
+        vsc->table_len = j;
+        vsc->match     = vs_match_sorted;
+        g_free(pairs);
+    }
+
+    return vsc;
+}
+
+static vs_compiled *
+rs_compile(const void *strings)
+{
+    const range_string *rs = (const range_string *)strings;
+    vs_compiled        *vsc = g_new0(vs_compiled, 1);
+    guint32            *starts;
+    gint               *table;
+    guint               n, num_starts, i, j, k;
+
+    for (n = 0; rs[n].strptr; n++)
+        ;
+
+    vsc->strings      = strings;
+    vsc->begin_strptr = &rs[0].strptr;
+    vsc->first_strptr = rs[0].strptr;
+    vsc->end_strptr   = &rs[n].strptr;
+    vsc->num_entries = n;
+    vsc->match       = rs_match_linear;
+    if (n < VSC_MIN_ENTRIES)
+        return vsc;
+
+    /* Split the values into runs at the ends of every range. */
+    starts = g_new(guint32, 2 * n + 1);
+    num_starts = 0;
+    starts[num_starts++] = 0;
+    for (i = 0; i < n; i++) {
+        if (rs[i].value_min > rs[i].value_max)
+            continue;
+        starts[num_starts++] = rs[i].value_min;
+        if (rs[i].value_max != G_MAXUINT32)
+            starts[num_starts++] = rs[i].value_max + 1;
+    }
+    qsort(starts, num_starts, sizeof(guint32), vs_compiled_value_cmp);
+    for (i = 1, j = 1; i < num_starts; i++) {
+        if (starts[i] != starts[j - 1])
+            starts[j++] = starts[i];
+    }
+    num_starts = j;
+
+    /* Each run maps to the first range that covers it. */
+    table = g_new(gint, num_starts);
+    for (k = 0; k < num_starts; k++)
+        table[k] = -1;
+    for (i = 0; i < n; i++) {
+        if (rs[i].value_min > rs[i].value_max)
+            continue;
+        /* the run starting at value_min */
+        for (k = 0, j = num_starts; j - k > 1; ) {
+            guint mid = (k + j) / 2;
+
+            if (starts[mid] <= rs[i].value_min)
+                k = mid;
+            else
+                j = mid;
+        }
+        for (; k < num_starts && starts[k] <= rs[i].value_max; k++) {
+            if (table[k] == -1)
+                table[k] = (gint)i;
+        }
+    }
+
+    /* Merge neighbouring runs that map to the same range. */
+    for (k = 1, j = 1; k < num_starts; k++) {
+        if (table[k] != table[j - 1]) {
+            starts[j] = starts[k];
+            table[j]  = table[k];
+            j++;
+        }
+    }
+
+    vsc->values    = starts;
+    vsc->table     = table;
+    vsc->table_len = j;
+    vsc->match     = rs_match_sorted;
+
+    return vsc;
+}
+
+static void
+vs_compiled_free(gpointer data)
+{
+    vs_compiled *vsc = (vs_compiled *)data;
+
+    g_free(vsc->values);
+    g_free(vsc->table);
+    g_free(vsc);
+}
+
+/* Is the array still the one that was compiled, and still terminated where
+ * it was? Only registered arrays are compiled, so end_strptr is within the
+ * array's storage. An array that isn't registered isn't read here. */
+static inline gboolean
+vs_compiled_valid(const vs_compiled *vsc)
+{
+    return vsc->match == NULL ||
+        (*vsc->begin_strptr == vsc->first_strptr && *vsc->end_strptr == NULL);
+}
+
+/* Stop using a compiled structure, but keep it until everything is
+ * forgotten, as another thread might still be using it. Called with
+ * vs_compiled_lock held. */
+static void
+vs_compiled_retire(vs_compiled *vsc)
+{
+    guint h = VSC_CACHE_HASH(vsc->strings);
+
+    if (vs_compiled_cache[h] == vsc)
+        g_atomic_pointer_set(&vs_compiled_cache[h], NULL);
+    g_hash_table_steal(vs_compiled_table, vsc->strings);
+    g_ptr_array_add(vs_compiled_stale, vsc);
+}
+
+static const vs_compiled *
+vs_compiled_get_slow(const void *strings, vs_compile_func_t compile)
+{
+    vs_compiled *vsc;
+
+    g_mutex_lock(&vs_compiled_lock);
+
+    if (vs_compiled_table == NULL) {
+        vs_compiled_table = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                NULL, vs_compiled_free);
+        vs_compiled_stale = g_ptr_array_new_with_free_func(vs_compiled_free);
+    }
+
+    vsc = (vs_compiled *)g_hash_table_lookup(vs_compiled_table, strings);
+    if (vsc != NULL && !vs_compiled_valid(vsc)) {
+        /* The array has grown, or been replaced, since it was compiled. */
+        vs_compiled_retire(vsc);
+        vsc = NULL;
+    }
+    if (vsc == NULL) {
+        if (vs_static_table != NULL && g_hash_table_contains(vs_static_table, strings)) {
+            vsc = compile(strings);
+        } else {
+            /* Remember that it's searched linearly. */
+            vsc = g_new0(vs_compiled, 1);
+            vsc->strings = strings;
+        }
+        g_hash_table_insert(vs_compiled_table, (gpointer)strings, vsc);
+    }
+    g_atomic_pointer_set(&vs_compiled_cache[VSC_CACHE_HASH(strings)], vsc);
+
+    g_mutex_unlock(&vs_compiled_lock);
+
+    return vsc;
+}
+
+static inline const vs_compiled *
+vs_compiled_get(const void *strings, vs_compile_func_t compile)
+{
+    const vs_compiled *vsc;
+
+    vsc = (const vs_compiled *)g_atomic_pointer_get(&vs_compiled_cache[VSC_CACHE_HASH(strings)]);
+    if (G_LIKELY(vsc != NULL && vsc->strings == strings && vs_compiled_valid(vsc)))
+        return vsc;
+
+    return vs_compiled_get_slow(strings, compile);
+}
+
+static void
+vs_compiled_forget_locked(const void *strings)
+{
+    vs_compiled *vsc;
+
+    if (vs_compiled_table != NULL) {
+        vsc = (vs_compiled *)g_hash_table_lookup(vs_compiled_table, strings);
+        if (vsc != NULL)
+            vs_compiled_retire(vsc);
+    }
+}
+
+void
+value_string_register_static(const void *strings)
+{
+    if (strings == NULL)
+        return;
+
+    g_mutex_lock(&vs_compiled_lock);
+    if (vs_static_table == NULL)
+        vs_static_table = g_hash_table_new(g_direct_hash, g_direct_equal);
+    if (!g_hash_table_contains(vs_static_table, strings)) {
+        g_hash_table_add(vs_static_table, (gpointer)strings);
+        /* It may have been searched linearly so far. */
+        vs_compiled_forget_locked(strings);
+    }
+    g_mutex_unlock(&vs_compiled_lock);
+}
+
+void
+value_string_forget(const void *strings)
+{
+    g_mutex_lock(&vs_compiled_lock);
+    vs_compiled_forget_locked(strings);
+    if (vs_static_table != NULL)
+        g_hash_table_remove(vs_static_table, strings);
+    g_mutex_unlock(&vs_compiled_lock);
+}
+
+void
+value_string_forget_all(void)
+{
+    guint h;
+
+    g_mutex_lock(&vs_compiled_lock);
+    for (h = 0; h < VSC_CACHE_SIZE; h++)
+        g_atomic_pointer_set(&vs_compiled_cache[h], NULL);
+    if (vs_compiled_table != NULL) {
+        g_hash_table_destroy(vs_compiled_table);
+        g_ptr_array_free(vs_compiled_stale, TRUE);
+        vs_compiled_table = NULL;
+        vs_compiled_stale = NULL;
+    }
+    g_mutex_unlock(&vs_compiled_lock);
+}
+
+void
+value_string_cleanup(void)
+{
+    value_string_forget_all();
+
+    g_mutex_lock(&vs_compiled_lock);
+    if (vs_static_table != NULL) {
+        g_hash_table_destroy(vs_static_table);
+        vs_static_table = NULL;
+    }
+    g_mutex_unlock(&vs_compiled_lock);
+}
+
 /* REGULAR VALUE STRING */
 
 /* Tries to match val against each element in the value_string array vs.
@@ -77,17 +577,25 @@ val_to_str_const(const guint32 val, const value_string *vs,
 const gchar *
 try_val_to_str_idx(const guint32 val, const value_string *vs, gint *idx)
 {
-    gint i = 0;
+    const vs_compiled *vsc;
+    gint i;
 
     DISSECTOR_ASSERT(idx != NULL);
 
     if(vs) {
-        while (vs[i].strptr) {
-            if (vs[i].value == val) {
-                *idx = i;
-                return(vs[i].strptr);
+        vsc = vs_compiled_get(vs, vs_compile);
+        if (vsc->match == NULL) {
+            i = vs_search_linear(vs, val);
+        } else {
+            i = vsc->match(vsc, val);
+            if (i >= 0 && vs[i].value != val) {
+                /* Changed in place without being forgotten; search it. */
+                i = vs_search_linear(vs, val);
             }
-            i++;
+        }
+        if (i >= 0) {
+            *idx = i;
+            return(vs[i].strptr);
         }
     }
 
@@ -577,15 +1085,23 @@ rval_to_str_const(const guint32 val, const range_string *rs,
 const gchar *
 try_rval_to_str_idx(const guint32 val, const range_string *rs, gint *idx)
 {
-    gint i = 0;
+    const vs_compiled *vsc;
+    gint i;
 
     if(rs) {
-        while(rs[i].strptr) {
-            if( (val >= rs[i].value_min) && (val <= rs[i].value_max) ) {
-                *idx = i;
-                return (rs[i].strptr);
+        vsc = vs_compiled_get(rs, rs_compile);
+        if (vsc->match == NULL) {
+            i = rs_search_linear(rs, val);
+        } else {
+            i = vsc->match(vsc, val);
+            if( (i >= 0) && ((val < rs[i].value_min) || (val > rs[i].value_max)) ) {
+                /* Changed in place without being forgotten; search it. */
+                i = rs_search_linear(rs, val);
             }
-            i++;
+        }
+        if (i >= 0) {
+            *idx = i;
+            return (rs[i].strptr);
         }
     }
 
@@ -605,17 +1121,9 @@ try_rval_to_str(const guint32 val, const range_string *rs)
 const gchar *
 try_rval64_to_str_idx(const guint64 val, const range_string *rs, gint *idx)
 {
-    gint i = 0;
-
-    if(rs) {
-        while(rs[i].strptr) {
-            if( (val >= rs[i].value_min) && (val <= rs[i].value_max) ) {
-                *idx = i;
-                return (rs[i].strptr);
-            }
-            i++;
-        }
-    }
+    /* The ranges are 32-bit, so larger values can't match */
+    if (val <= G_MAXUINT32)
+        return try_rval_to_str_idx((guint32)val, rs, idx);
 
     *idx = -1;
     return NULL;
@@ -262,6 +262,22 @@ WS_DLL_PUBLIC
 const gchar *
 try_rval64_to_str_idx(const guint64 val, const range_string *rs, gint *idx);
 
+/* Plain value_string and range_string arrays that are registered as
+ * static are compiled into faster lookup structures the first time they're
+ * searched, see value_string.c; other arrays are searched linearly. A
+ * registered array may be appended to, and everything is forgotten
+ * whenever dissection is reinitialized, but its entries mustn't be changed
+ * in place, nor the array freed, unless it's forgotten first. The arrays
+ * of fields are registered when the fields are. */
+WS_DLL_PUBLIC
+void
+value_string_register_static(const void *strings);
+
+/* Forgets the compiled structure of an array, and its registration. */
+WS_DLL_PUBLIC
+void
+value_string_forget(const void *strings);
+
 /* BYTES TO STRING MATCHING */
 
 typedef struct _bytes_string {
@@ -290,6 +306,14 @@ try_bytesprefix_to_str(const guint8 *haystack, const size_t haystack_len, const
 
 /* MISC (generally do not use) */
 
+WS_DLL_LOCAL
+void
+value_string_forget_all(void);
+
+WS_DLL_LOCAL
+void
+value_string_cleanup(void);
+
 WS_DLL_LOCAL
 gboolean
 value_string_ext_validate(const value_string_ext *vse);
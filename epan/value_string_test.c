@@ -0,0 +1,442 @@
+/* value_string_test.c
+ * Tests for compiled value_string and range_string lookups
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "value_string.h"
+
+/* Enough room for any of the arrays here, including their terminators. */
+#define TEST_MAX_ENTRIES 200
+
+static const gchar *test_strs[TEST_MAX_ENTRIES];
+
+static guint32 test_rand_state;
+
+/* A fixed sequence, so that a failure can be reproduced. */
+static guint32
+test_rand(void)
+{
+    test_rand_state = test_rand_state * 1103515245 + 12345;
+    return test_rand_state >> 8;
+}
+
+/* Give every entry a distinct string, so that its index can be told. */
+static void
+init_strs(void)
+{
+    guint i;
+
+    for (i = 0; i < TEST_MAX_ENTRIES; i++)
+        test_strs[i] = g_strdup_printf("entry %u", i);
+}
+
+static gint
+ref_val_idx(guint32 val, const value_string *vs)
+{
+    gint i;
+
+    for (i = 0; vs[i].strptr; i++) {
+        if (vs[i].value == val)
+            return i;
+    }
+    return -1;
+}
+
+static gint
+ref_rval_idx(guint32 val, const range_string *rs)
+{
+    gint i;
+
+    for (i = 0; rs[i].strptr; i++) {
+        if (val >= rs[i].value_min && val <= rs[i].value_max)
+            return i;
+    }
+    return -1;
+}
+
+static void
+check_val(guint32 val, const value_string *vs)
+{
+    gint expected = ref_val_idx(val, vs);
+    gint idx;
+    const gchar *str;
+
+    str = try_val_to_str_idx(val, vs, &idx);
+    g_assert(idx == expected);
+    g_assert(str == (expected >= 0 ? vs[expected].strptr : NULL));
+}
+
+static void
+check_rval(guint32 val, const range_string *rs)
+{
+    gint expected = ref_rval_idx(val, rs);
+    gint idx;
+    const gchar *str;
+
+    str = try_rval_to_str_idx(val, rs, &idx);
+    g_assert(idx == expected);
+    g_assert(str == (expected >= 0 ? rs[expected].strptr : NULL));
+}
+
+/* Check every value of the array, its neighbours and a few others. */
+static void
+check_vals(const value_string *vs)
+{
+    guint i;
+
+    for (i = 0; vs[i].strptr; i++) {
+        check_val(vs[i].value, vs);
+        check_val(vs[i].value - 1, vs);
+        check_val(vs[i].value + 1, vs);
+    }
+    check_val(0, vs);
+    check_val(G_MAXUINT32, vs);
+    for (i = 0; i < 100; i++)
+        check_val(test_rand(), vs);
+}
+
+static void
+check_rvals(const range_string *rs)
+{
+    guint i;
+
+    for (i = 0; rs[i].strptr; i++) {
+        check_rval(rs[i].value_min, rs);
+        check_rval(rs[i].value_min - 1, rs);
+        check_rval(rs[i].value_max, rs);
+        check_rval(rs[i].value_max + 1, rs);
+    }
+    check_rval(0, rs);
+    check_rval(G_MAXUINT32, rs);
+    for (i = 0; i < 100; i++)
+        check_rval(test_rand(), rs);
+}
+
+static void
+value_string_test_duplicates(void)
+{
+    /* Too few entries to compile */
+    static const value_string linear_vals[] = {
+        { 1, "one" }, { 2, "two" }, { 1, "one again" }, { 0, NULL }
+    };
+    /* Values close together, so a table indexed by value */
+    static const value_string dense_vals[] = {
+        { 10, "ten" }, { 12, "twelve" }, { 11, "eleven" }, { 12, "twelve again" },
+        { 20, "twenty" }, { 10, "ten again" }, { 15, "fifteen" }, { 30, "thirty" },
+        { 15, "fifteen again" }, { 0, NULL }
+    };
+    /* Values spread out, so a sorted search */
+    static const value_string sorted_vals[] = {
+        { 0x80000000, "a" }, { 7, "b" }, { 0x10000, "c" }, { 7, "b again" },
+        { G_MAXUINT32, "max" }, { 0x10000, "c again" }, { 0, "zero" }, { 1000000, "d" },
+        { G_MAXUINT32, "max again" }, { 0, "zero again" }, { 0, NULL }
+    };
+    gint idx;
+
+    value_string_register_static(linear_vals);
+    value_string_register_static(dense_vals);
+    value_string_register_static(sorted_vals);
+
+    g_assert(g_str_equal(try_val_to_str_idx(1, linear_vals, &idx), "one") && idx == 0);
+    g_assert(g_str_equal(try_val_to_str_idx(12, dense_vals, &idx), "twelve") && idx == 1);
+    g_assert(g_str_equal(try_val_to_str_idx(10, dense_vals, &idx), "ten") && idx == 0);
+    g_assert(g_str_equal(try_val_to_str_idx(15, dense_vals, &idx), "fifteen") && idx == 6);
+    g_assert(g_str_equal(try_val_to_str_idx(7, sorted_vals, &idx), "b") && idx == 1);
+    g_assert(g_str_equal(try_val_to_str_idx(0x10000, sorted_vals, &idx), "c") && idx == 2);
+    g_assert(g_str_equal(try_val_to_str_idx(G_MAXUINT32, sorted_vals, &idx), "max") && idx == 4);
+    g_assert(g_str_equal(try_val_to_str_idx(0, sorted_vals, &idx), "zero") && idx == 6);
+
+    check_vals(linear_vals);
+    check_vals(dense_vals);
+    check_vals(sorted_vals);
+}
+
+/* Random arrays of every size and spread of values. */
+static void
+value_string_test_random(void)
+{
+    value_string vs[TEST_MAX_ENTRIES];
+    guint n, i, span;
+
+    test_rand_state = 1;
+    for (n = 0; n < TEST_MAX_ENTRIES; n += 1 + n / 8) {
+        /* contiguous, dense with duplicates, and spread out */
+        for (span = 0; span < 3; span++) {
+            guint32 base = span == 0 ? G_MAXUINT32 - 5 : test_rand();
+
+            for (i = 0; i < n; i++) {
+                if (span == 0)
+                    vs[i].value = base + i;
+                else if (span == 1)
+                    vs[i].value = base + test_rand() % (n + 1);
+                else
+                    vs[i].value = test_rand() << 8 | test_rand() % 4;
+                vs[i].strptr = test_strs[i];
+            }
+            vs[n].value = 0;
+            vs[n].strptr = NULL;
+
+            value_string_register_static(vs);
+            check_vals(vs);
+            value_string_forget(vs);
+        }
+    }
+}
+
+static void
+value_string_test_ranges(void)
+{
+    /* Overlapping ranges, ranges up to G_MAXUINT32 and an empty range */
+    static const range_string overlap_rvals[] = {
+        { 100, 199, "100-199" },
+        { 150, 250, "150-250" },
+        { 0xFFFFFF00, G_MAXUINT32, "top" },
+        { 120, 130, "120-130" },
+        { 5, 4, "empty" },
+        { 250, 250, "250" },
+        { G_MAXUINT32, G_MAXUINT32, "max" },
+        { 0, 0, "zero" },
+        { 0, G_MAXUINT32, "everything" },
+        { 0, 0, NULL }
+    };
+    /* Ranges up to G_MAXUINT32 that aren't first */
+    static const range_string top_rvals[] = {
+        { 0, 9, "0-9" },
+        { 20, 29, "20-29" },
+        { 40, 49, "40-49" },
+        { 60, 69, "60-69" },
+        { 80, 89, "80-89" },
+        { 0x80000000, G_MAXUINT32, "high" },
+        { 100, 109, "100-109" },
+        { G_MAXUINT32 - 1, G_MAXUINT32, "max" },
+        { 0, 0, NULL }
+    };
+    range_string rs[TEST_MAX_ENTRIES];
+    gint idx;
+    guint n, i;
+
+    value_string_register_static(overlap_rvals);
+    value_string_register_static(top_rvals);
+
+    g_assert(g_str_equal(try_rval_to_str_idx(125, overlap_rvals, &idx), "100-199") && idx == 0);
+    g_assert(g_str_equal(try_rval_to_str_idx(200, overlap_rvals, &idx), "150-250") && idx == 1);
+    g_assert(g_str_equal(try_rval_to_str_idx(250, overlap_rvals, &idx), "150-250") && idx == 1);
+    g_assert(g_str_equal(try_rval_to_str_idx(G_MAXUINT32, overlap_rvals, &idx), "top") && idx == 2);
+    g_assert(g_str_equal(try_rval_to_str_idx(0, overlap_rvals, &idx), "zero") && idx == 7);
+    g_assert(g_str_equal(try_rval_to_str_idx(4, overlap_rvals, &idx), "everything") && idx == 8);
+    g_assert(g_str_equal(try_rval_to_str_idx(G_MAXUINT32 - 1, top_rvals, &idx), "high") && idx == 5);
+    g_assert(g_str_equal(try_rval_to_str_idx(G_MAXUINT32, top_rvals, &idx), "high") && idx == 5);
+    g_assert(try_rval_to_str_idx(0x7FFFFFFF, top_rvals, &idx) == NULL && idx == -1);
+    g_assert(try_rval64_to_str(G_GUINT64_CONSTANT(0x100000000), overlap_rvals) == NULL);
+
+    check_rvals(overlap_rvals);
+    check_rvals(top_rvals);
+
+    test_rand_state = 2;
+    for (n = 0; n < TEST_MAX_ENTRIES; n += 1 + n / 8) {
+        for (i = 0; i < n; i++) {
+            guint32 min = test_rand() << 8;
+
+            if (test_rand() % 4 == 0)
+                rs[i].value_min = min;
+            else
+                rs[i].value_min = min - test_rand() % 0x10000000;
+            if (test_rand() % 8 == 0)
+                rs[i].value_max = G_MAXUINT32;
+            else
+                rs[i].value_max = rs[i].value_min + test_rand() % 0x1000000;
+            rs[i].strptr = test_strs[i];
+        }
+        rs[n].value_min = rs[n].value_max = 0;
+        rs[n].strptr = NULL;
+
+        value_string_register_static(rs);
+        check_rvals(rs);
+        value_string_forget(rs);
+    }
+}
+
+/* Arrays that are appended to after they have been searched. */
+static void
+value_string_test_extended(void)
+{
+    value_string vs[TEST_MAX_ENTRIES];
+    range_string rs[TEST_MAX_ENTRIES];
+    guint n;
+
+    vs[0].strptr = NULL;
+    rs[0].strptr = NULL;
+    value_string_register_static(vs);
+    value_string_register_static(rs);
+    for (n = 0; n < 150; n++) {
+        vs[n].value = n * 3;
+        vs[n].strptr = test_strs[n];
+        vs[n + 1].value = 0;
+        vs[n + 1].strptr = NULL;
+        check_val(n * 3, vs);
+        check_val(n * 3 + 1, vs);
+
+        rs[n].value_min = G_MAXUINT32 - n * 10;
+        rs[n].value_max = G_MAXUINT32 - n * 5;
+        rs[n].strptr = test_strs[n];
+        rs[n + 1].strptr = NULL;
+        check_rval(G_MAXUINT32 - n * 10, rs);
+        check_rval(G_MAXUINT32 - n * 7, rs);
+    }
+    check_vals(vs);
+    check_rvals(rs);
+    value_string_forget(vs);
+    value_string_forget(rs);
+}
+
+/* Registered arrays that are changed in place, or replaced by another
+   array at the same address, after being forgotten. */
+static void
+value_string_test_replaced(void)
+{
+    value_string vs[TEST_MAX_ENTRIES];
+    guint i;
+
+    for (i = 0; i < 20; i++) {
+        vs[i].value = i * 100;
+        vs[i].strptr = test_strs[i];
+    }
+    vs[20].strptr = NULL;
+    value_string_register_static(vs);
+    check_vals(vs);
+
+    /* Changed in place and forgotten, which unregisters it */
+    vs[5].value = 12345;
+    value_string_forget(vs);
+    check_val(500, vs);
+    check_val(12345, vs);
+    check_vals(vs);
+    value_string_register_static(vs);
+    check_vals(vs);
+
+    /* Changed in place without being forgotten: values that are no longer
+       there aren't found. */
+    vs[6].value = 54321;
+    check_val(600, vs);
+
+    /* Forgetting twice, or an array that was never searched, is fine. */
+    value_string_forget(vs);
+    value_string_forget(vs);
+    value_string_forget(&vs[1]);
+
+    /* A shorter array with other strings where the old one was. */
+    check_vals(vs);
+    for (i = 0; i < 10; i++) {
+        vs[i].value = i + 7;
+        vs[i].strptr = test_strs[i + 100];
+    }
+    vs[10].strptr = NULL;
+    value_string_register_static(vs);
+    for (i = 0; i < 2000; i += 100)
+        check_val(i, vs);
+    check_vals(vs);
+    value_string_forget(vs);
+}
+
+/* Arrays that aren't registered are searched as they are, whatever is done
+   to them without their being forgotten. */
+static void
+value_string_test_unregistered(void)
+{
+    value_string vs[TEST_MAX_ENTRIES];
+    range_string rs[TEST_MAX_ENTRIES];
+    guint i;
+
+    for (i = 0; i < 50; i++) {
+        vs[i].value = i * 100;
+        vs[i].strptr = test_strs[i];
+        rs[i].value_min = i * 100;
+        rs[i].value_max = i * 100 + 49;
+        rs[i].strptr = test_strs[i];
+    }
+    vs[50].strptr = NULL;
+    rs[50].strptr = NULL;
+    check_vals(vs);
+    check_rvals(rs);
+
+    /* Changed in place */
+    vs[6].value = 54321;
+    rs[6].value_min = 54300;
+    rs[6].value_max = 54399;
+    check_val(600, vs);
+    check_val(54321, vs);
+    check_rval(620, rs);
+    check_rval(54321, rs);
+    check_vals(vs);
+    check_rvals(rs);
+
+    /* A shorter array, whose terminator is before the old one */
+    for (i = 0; i < 5; i++) {
+        vs[i].value = i + 7;
+        vs[i].strptr = test_strs[i + 100];
+        rs[i].value_min = i * 1000;
+        rs[i].value_max = i * 1000 + 999;
+        rs[i].strptr = test_strs[i + 100];
+    }
+    vs[5].strptr = NULL;
+    rs[5].strptr = NULL;
+    for (i = 0; i < 6000; i += 100) {
+        check_val(i, vs);
+        check_rval(i, rs);
+    }
+    check_vals(vs);
+    check_rvals(rs);
+
+    /* Appended to */
+    for (i = 5; i < 150; i++) {
+        vs[i].value = i * 3;
+        vs[i].strptr = test_strs[i];
+        vs[i + 1].strptr = NULL;
+        check_val(i * 3, vs);
+    }
+    check_vals(vs);
+    value_string_forget(vs);
+    value_string_forget(rs);
+}
+
+int
+main(int argc, char **argv)
+{
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/value_string/duplicates", value_string_test_duplicates);
+    g_test_add_func("/value_string/random", value_string_test_random);
+    g_test_add_func("/value_string/ranges", value_string_test_ranges);
+    g_test_add_func("/value_string/extended", value_string_test_extended);
+    g_test_add_func("/value_string/replaced", value_string_test_replaced);
+    g_test_add_func("/value_string/unregistered", value_string_test_unregistered);
+
+    init_strs();
+    result = g_test_run();
+
+    return result;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,465 @@
+/* wmem_allocator_concurrent.c
+ * Wireshark Memory Manager Concurrent Allocator
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "wmem_core.h"
+#include "wmem_allocator.h"
+#include "wmem_allocator_concurrent.h"
+
+/* This allocator can be used by several threads at once. Each thread that
+ * allocates from it gets an arena of its own, so allocating takes no locks:
+ * chunks are carved out of large blocks, as in the fast block allocator, and
+ * rounded up to one of a few power-of-two size classes so that freed chunks
+ * can be reused.
+ *
+ * A chunk freed by the thread that owns its arena goes straight back on
+ * the arena's free list for its size class. A chunk freed by any other
+ * thread is pushed with a compare-and-swap on a stack of remote frees of its
+ * arena, which the owner takes over in one go when it runs out of chunks
+ * of some size. Pushing is the only operation other threads do on that
+ * stack, and the owner only ever takes the whole stack, so it isn't subject
+ * to the ABA problem.
+ *
+ * Allocations too large for any size class ("jumbo" allocations) are made
+ * with g_malloc and kept in a list under a mutex.
+ *
+ * free_all, gc and destroying the allocator must not run concurrently with
+ * any other use of it.
+ */
+
+/* See wmem_allocator_block_fast.c */
+#define WMEM_ALIGN_AMOUNT (2 * sizeof (gsize))
+#define WMEM_ALIGN_SIZE(SIZE) ((~(WMEM_ALIGN_AMOUNT-1)) & \
+        ((SIZE) + (WMEM_ALIGN_AMOUNT-1)))
+
+/* Size class n holds chunks of WMEM_CONCURRENT_MIN_SIZE << n bytes, from
+ * 16 bytes to 64 KiB. */
+#define WMEM_CONCURRENT_MIN_SIZE    16
+#define WMEM_CONCURRENT_NUM_CLASSES 13
+#define WMEM_CONCURRENT_MAX_SIZE    (WMEM_CONCURRENT_MIN_SIZE << (WMEM_CONCURRENT_NUM_CLASSES - 1))
+
+/* The size of the blocks chunks are carved out of; see
+ * wmem_allocator_block_fast.c */
+#define WMEM_BLOCK_SIZE (2 * 1024 * 1024)
+
+/* Number of allocators whose arena each thread remembers, so that a thread
+ * using both a packet scope and a file scope doesn't have to look up its
+ * arena all the time. */
+#define WMEM_CONCURRENT_THREAD_CACHE 4
+
+struct _wmem_concurrent_arena;
+
+typedef struct _wmem_concurrent_chunk {
+    struct _wmem_concurrent_arena *arena;   /* NULL for jumbo allocations */
+    guint32 size_class;
+} wmem_concurrent_chunk_t;
+#define WMEM_CHUNK_HEADER_SIZE WMEM_ALIGN_SIZE(sizeof(wmem_concurrent_chunk_t))
+
+#define WMEM_CHUNK_TO_DATA(CHUNK) ((void*)((guint8*)(CHUNK) + WMEM_CHUNK_HEADER_SIZE))
+#define WMEM_DATA_TO_CHUNK(DATA) ((wmem_concurrent_chunk_t*)((guint8*)(DATA) - WMEM_CHUNK_HEADER_SIZE))
+
+/* While a chunk is free, the start of its data links it into a free list
+ * or the stack of remote frees. */
+#define WMEM_CHUNK_NEXT(CHUNK) (*(wmem_concurrent_chunk_t**)WMEM_CHUNK_TO_DATA(CHUNK))
+
+typedef struct _wmem_concurrent_block {
+    struct _wmem_concurrent_block *next;
+    gsize pos;
+} wmem_concurrent_block_t;
+#define WMEM_BLOCK_HEADER_SIZE WMEM_ALIGN_SIZE(sizeof(wmem_concurrent_block_t))
+
+typedef struct _wmem_concurrent_jumbo {
+    struct _wmem_concurrent_jumbo *prev, *next;
+} wmem_concurrent_jumbo_t;
+#define WMEM_JUMBO_HEADER_SIZE WMEM_ALIGN_SIZE(sizeof(wmem_concurrent_jumbo_t))
+
+typedef struct _wmem_concurrent_arena {
+    struct _wmem_concurrent_arena *next;
+    guint thread_id;
+
+    /* Only touched by the owning thread */
+    wmem_concurrent_block_t *block_list;
+    wmem_concurrent_chunk_t *free_lists[WMEM_CONCURRENT_NUM_CLASSES];
+
+    /* Pushed to by other threads */
+    wmem_concurrent_chunk_t *remote_free;
+} wmem_concurrent_arena_t;
+
+typedef struct {
+    guint id;
+
+    GMutex lock;                        /* protects the two lists below */
+    wmem_concurrent_arena_t *arenas;
+    wmem_concurrent_jumbo_t *jumbo_list;
+} wmem_concurrent_allocator_t;
+
+typedef struct {
+    guint thread_id;
+    struct {
+        guint allocator_id;
+        wmem_concurrent_arena_t *arena;
+    } cache[WMEM_CONCURRENT_THREAD_CACHE];
+} wmem_concurrent_thread_t;
+
+static GPrivate wmem_concurrent_thread = G_PRIVATE_INIT(g_free);
+
+/* Ids are never reused, so that a stale entry in the cache of a thread
+ * can't match an allocator created later at the same address. 0 is never
+ * handed out, and marks empty cache entries. */
+static gint wmem_concurrent_last_thread_id = 0;
+static gint wmem_concurrent_last_allocator_id = 0;
+
+static wmem_concurrent_thread_t *
+wmem_concurrent_get_thread(void)
+{
+    wmem_concurrent_thread_t *thread;
+
+    thread = (wmem_concurrent_thread_t *)g_private_get(&wmem_concurrent_thread);
+    if (G_UNLIKELY(thread == NULL)) {
+        thread = g_new0(wmem_concurrent_thread_t, 1);
+        thread->thread_id = (guint)g_atomic_int_add(&wmem_concurrent_last_thread_id, 1) + 1;
+        g_private_set(&wmem_concurrent_thread, thread);
+    }
+
+    return thread;
+}
+
+/* Returns the arena of the calling thread, creating it if necessary. Arenas
+ * live as long as the allocator, even if their thread exits, as chunks from
+ * them may still be in use. */
+static wmem_concurrent_arena_t *
+wmem_concurrent_get_arena(wmem_concurrent_allocator_t *allocator)
+{
+    wmem_concurrent_thread_t *thread = wmem_concurrent_get_thread();
+    wmem_concurrent_arena_t  *arena;
+    guint                     slot = allocator->id % WMEM_CONCURRENT_THREAD_CACHE;
+
+    if (G_LIKELY(thread->cache[slot].allocator_id == allocator->id)) {
+        return thread->cache[slot].arena;
+    }
+
+    g_mutex_lock(&allocator->lock);
+    for (arena = allocator->arenas; arena; arena = arena->next) {
+        if (arena->thread_id == thread->thread_id) {
+            break;
+        }
+    }
+    if (!arena) {
+        arena = g_new0(wmem_concurrent_arena_t, 1);
+        arena->thread_id = thread->thread_id;
+        arena->next = allocator->arenas;
+        allocator->arenas = arena;
+    }
+    g_mutex_unlock(&allocator->lock);
+
+    thread->cache[slot].allocator_id = allocator->id;
+    thread->cache[slot].arena = arena;
+
+    return arena;
+}
+
+static inline guint32
+wmem_concurrent_size_class(const size_t size)
+{
+    guint32 size_class = 0;
+    size_t  class_size = WMEM_CONCURRENT_MIN_SIZE;
+
+    while (class_size < size) {
+        class_size <<= 1;
+        size_class++;
+    }
+
+    return size_class;
+}
+
+/* Moves the chunks freed by other threads to the free lists of the arena. */
+static void
+wmem_concurrent_take_remote_frees(wmem_concurrent_arena_t *arena)
+{
+    wmem_concurrent_chunk_t *chunk, *next;
+
+    do {
+        chunk = (wmem_concurrent_chunk_t *)g_atomic_pointer_get(&arena->remote_free);
+    } while (!g_atomic_pointer_compare_and_exchange(&arena->remote_free, chunk, NULL));
+
+    while (chunk) {
+        next = WMEM_CHUNK_NEXT(chunk);
+        WMEM_CHUNK_NEXT(chunk) = arena->free_lists[chunk->size_class];
+        arena->free_lists[chunk->size_class] = chunk;
+        chunk = next;
+    }
+}
+
+static void *
+wmem_concurrent_jumbo_alloc(wmem_concurrent_allocator_t *allocator, const size_t size)
+{
+    wmem_concurrent_jumbo_t *block;
+    wmem_concurrent_chunk_t *chunk;
+
+    block = (wmem_concurrent_jumbo_t *)wmem_alloc(NULL,
+            size + WMEM_JUMBO_HEADER_SIZE + WMEM_CHUNK_HEADER_SIZE);
+
+    chunk = (wmem_concurrent_chunk_t *)((guint8 *)block + WMEM_JUMBO_HEADER_SIZE);
+    chunk->arena = NULL;
+    chunk->size_class = 0;
+
+    g_mutex_lock(&allocator->lock);
+    block->prev = NULL;
+    block->next = allocator->jumbo_list;
+    if (block->next) {
+        block->next->prev = block;
+    }
+    allocator->jumbo_list = block;
+    g_mutex_unlock(&allocator->lock);
+
+    return WMEM_CHUNK_TO_DATA(chunk);
+}
+
+/* API */
+
+static void *
+wmem_concurrent_alloc(void *private_data, const size_t size)
+{
+    wmem_concurrent_allocator_t *allocator = (wmem_concurrent_allocator_t*) private_data;
+    wmem_concurrent_arena_t     *arena;
+    wmem_concurrent_chunk_t     *chunk;
+    guint32                      size_class;
+    gsize                        real_size;
+
+    if (size > WMEM_CONCURRENT_MAX_SIZE) {
+        return wmem_concurrent_jumbo_alloc(allocator, size);
+    }
+
+    size_class = wmem_concurrent_size_class(size);
+    arena = wmem_concurrent_get_arena(allocator);
+
+    /* Reuse a freed chunk if we can. */
+    chunk = arena->free_lists[size_class];
+    if (!chunk && g_atomic_pointer_get(&arena->remote_free)) {
+        wmem_concurrent_take_remote_frees(arena);
+        chunk = arena->free_lists[size_class];
+    }
+    if (chunk) {
+        arena->free_lists[size_class] = WMEM_CHUNK_NEXT(chunk);
+        return WMEM_CHUNK_TO_DATA(chunk);
+    }
+
+    /* Otherwise carve a new one out of the current block. */
+    real_size = WMEM_CHUNK_HEADER_SIZE + (WMEM_CONCURRENT_MIN_SIZE << size_class);
+    if (!arena->block_list ||
+            (WMEM_BLOCK_SIZE - arena->block_list->pos) < real_size) {
+        wmem_concurrent_block_t *block;
+
+        block = (wmem_concurrent_block_t *)wmem_alloc(NULL, WMEM_BLOCK_SIZE);
+        block->pos  = WMEM_BLOCK_HEADER_SIZE;
+        block->next = arena->block_list;
+        arena->block_list = block;
+    }
+
+    chunk = (wmem_concurrent_chunk_t *)((guint8 *)arena->block_list + arena->block_list->pos);
+    chunk->arena = arena;
+    chunk->size_class = size_class;
+    arena->block_list->pos += real_size;
+
+    return WMEM_CHUNK_TO_DATA(chunk);
+}
+
+static void
+wmem_concurrent_free(void *private_data, void *ptr)
+{
+    wmem_concurrent_allocator_t *allocator = (wmem_concurrent_allocator_t*) private_data;
+    wmem_concurrent_chunk_t     *chunk = WMEM_DATA_TO_CHUNK(ptr);
+    wmem_concurrent_arena_t     *arena = chunk->arena;
+    wmem_concurrent_chunk_t     *head;
+
+    if (arena == NULL) {
+        wmem_concurrent_jumbo_t *block;
+
+        block = (wmem_concurrent_jumbo_t *)((guint8 *)chunk - WMEM_JUMBO_HEADER_SIZE);
+
+        g_mutex_lock(&allocator->lock);
+        if (block->prev) {
+            block->prev->next = block->next;
+        }
+        else {
+            allocator->jumbo_list = block->next;
+        }
+        if (block->next) {
+            block->next->prev = block->prev;
+        }
+        g_mutex_unlock(&allocator->lock);
+
+        wmem_free(NULL, block);
+        return;
+    }
+
+    if (arena->thread_id == wmem_concurrent_get_thread()->thread_id) {
+        WMEM_CHUNK_NEXT(chunk) = arena->free_lists[chunk->size_class];
+        arena->free_lists[chunk->size_class] = chunk;
+        return;
+    }
+
+    /* The chunk belongs to another thread's arena; hand it back without
+     * taking a lock. */
+    do {
+        head = (wmem_concurrent_chunk_t *)g_atomic_pointer_get(&arena->remote_free);
+        WMEM_CHUNK_NEXT(chunk) = head;
+    } while (!g_atomic_pointer_compare_and_exchange(&arena->remote_free, head, chunk));
+}
+
+static void *
+wmem_concurrent_realloc(void *private_data, void *ptr, const size_t size)
+{
+    wmem_concurrent_allocator_t *allocator = (wmem_concurrent_allocator_t*) private_data;
+    wmem_concurrent_chunk_t     *chunk = WMEM_DATA_TO_CHUNK(ptr);
+    size_t                       class_size;
+    void                        *newptr;
+
+    if (chunk->arena == NULL) {
+        wmem_concurrent_jumbo_t *block;
+
+        block = (wmem_concurrent_jumbo_t *)((guint8 *)chunk - WMEM_JUMBO_HEADER_SIZE);
+
+        g_mutex_lock(&allocator->lock);
+        block = (wmem_concurrent_jumbo_t *)wmem_realloc(NULL, block,
+                size + WMEM_JUMBO_HEADER_SIZE + WMEM_CHUNK_HEADER_SIZE);
+        if (block->prev) {
+            block->prev->next = block;
+        }
+        else {
+            allocator->jumbo_list = block;
+        }
+        if (block->next) {
+            block->next->prev = block;
+        }
+        g_mutex_unlock(&allocator->lock);
+
+        return ((void*)((guint8*)(block) + WMEM_JUMBO_HEADER_SIZE + WMEM_CHUNK_HEADER_SIZE));
+    }
+
+    class_size = WMEM_CONCURRENT_MIN_SIZE << chunk->size_class;
+    if (size <= class_size) {
+        /* it still fits - great we can do nothing */
+        return ptr;
+    }
+
+    newptr = wmem_concurrent_alloc(private_data, size);
+    memcpy(newptr, ptr, class_size);
+    wmem_concurrent_free(private_data, ptr);
+
+    return newptr;
+}
+
+static void
+wmem_concurrent_free_all(void *private_data)
+{
+    wmem_concurrent_allocator_t *allocator = (wmem_concurrent_allocator_t*) private_data;
+    wmem_concurrent_arena_t     *arena;
+    wmem_concurrent_block_t     *cur, *nxt;
+    wmem_concurrent_jumbo_t     *cur_jum, *nxt_jum;
+
+    /* The arenas themselves are kept, as threads remember them; free all
+     * but the first block of each and reinitialize that one */
+    for (arena = allocator->arenas; arena; arena = arena->next) {
+        cur = arena->block_list;
+
+        if (cur) {
+            cur->pos = WMEM_BLOCK_HEADER_SIZE;
+            nxt = cur->next;
+            cur->next = NULL;
+            cur = nxt;
+        }
+
+        while (cur) {
+            nxt = cur->next;
+            wmem_free(NULL, cur);
+            cur = nxt;
+        }
+
+        memset(arena->free_lists, 0, sizeof(arena->free_lists));
+        arena->remote_free = NULL;
+    }
+
+    /* now do the jumbo blocks, freeing all of them */
+    cur_jum = allocator->jumbo_list;
+    while (cur_jum) {
+        nxt_jum = cur_jum->next;
+        wmem_free(NULL, cur_jum);
+        cur_jum = nxt_jum;
+    }
+    allocator->jumbo_list = NULL;
+}
+
+static void
+wmem_concurrent_gc(void *private_data _U_)
+{
+    /* No-op; freed chunks are kept in the free lists of their arena */
+}
+
+static void
+wmem_concurrent_allocator_cleanup(void *private_data)
+{
+    wmem_concurrent_allocator_t *allocator = (wmem_concurrent_allocator_t*) private_data;
+    wmem_concurrent_arena_t     *arena, *next;
+
+    /* wmem guarantees that free_all() is called directly before this, so
+     * simply free the first block of each arena */
+    for (arena = allocator->arenas; arena; arena = next) {
+        next = arena->next;
+        wmem_free(NULL, arena->block_list);
+        g_free(arena);
+    }
+
+    g_mutex_clear(&allocator->lock);
+
+    /* then just free the allocator structs */
+    wmem_free(NULL, private_data);
+}
+
+void
+wmem_concurrent_allocator_init(wmem_allocator_t *allocator)
+{
+    wmem_concurrent_allocator_t *concurrent_allocator;
+
+    concurrent_allocator = wmem_new(NULL, wmem_concurrent_allocator_t);
+
+    allocator->walloc   = &wmem_concurrent_alloc;
+    allocator->wrealloc = &wmem_concurrent_realloc;
+    allocator->wfree    = &wmem_concurrent_free;
+
+    allocator->free_all = &wmem_concurrent_free_all;
+    allocator->gc       = &wmem_concurrent_gc;
+    allocator->cleanup  = &wmem_concurrent_allocator_cleanup;
+
+    allocator->private_data = (void*) concurrent_allocator;
+
+    concurrent_allocator->id = (guint)g_atomic_int_add(&wmem_concurrent_last_allocator_id, 1) + 1;
+    g_mutex_init(&concurrent_allocator->lock);
+    concurrent_allocator->arenas     = NULL;
+    concurrent_allocator->jumbo_list = NULL;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
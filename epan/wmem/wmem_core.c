@@ -22,6 +22,7 @@
 #include "wmem_allocator_block.h"
 #include "wmem_allocator_block_fast.h"
 #include "wmem_allocator_strict.h"
+#include "wmem_allocator_concurrent.h"
 
 #include <wsutil/ws_printf.h> /* ws_g_warning */
 
@@ -158,6 +159,9 @@ wmem_allocator_new(const wmem_allocator_type_t type)
         case WMEM_ALLOCATOR_STRICT:
             wmem_strict_allocator_init(allocator);
             break;
+        case WMEM_ALLOCATOR_CONCURRENT:
+            wmem_concurrent_allocator_init(allocator);
+            break;
         default:
             g_assert_not_reached();
             /* This is necessary to squelch MSVC errors; is there
@@ -197,6 +201,9 @@ wmem_init(void)
         else if (strncmp(override_env, "block_fast", strlen("block_fast")) == 0) {
             override_type = WMEM_ALLOCATOR_BLOCK_FAST;
         }
+        else if (strncmp(override_env, "concurrent", strlen("concurrent")) == 0) {
+            override_type = WMEM_ALLOCATOR_CONCURRENT;
+        }
         else {
             ws_g_warning("Unrecognized wmem override");
             do_override = FALSE;
@@ -54,11 +54,17 @@ typedef enum _wmem_allocator_type_t {
                 memory usage via things like canaries and scrubbing freed
                 memory. Valgrind is the better choice on platforms that support
                 it. */
-    WMEM_ALLOCATOR_BLOCK_FAST /**< A block allocator like WMEM_ALLOCATOR_BLOCK
+    WMEM_ALLOCATOR_BLOCK_FAST, /**< A block allocator like WMEM_ALLOCATOR_BLOCK
                 but even faster by tracking absolutely minimal metadata and
                 making 'free' a no-op. Useful only for very short-lived scopes
                 where there's no reason to free individual allocations because
                 the next free_all is always just around the corner. */
+    WMEM_ALLOCATOR_CONCURRENT /**< A block allocator that can be used by
+                several threads at once. Each thread allocates from an arena
+                of its own without locking, and memory freed by a thread other
+                than the one that allocated it is handed back to its arena
+                without locking. free_all and destroying the pool must still
+                not race with other uses of it. */
 } wmem_allocator_type_t;
 
 /** Allocate the requested amount of memory in the given pool.
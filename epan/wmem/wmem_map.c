@@ -10,6 +10,8 @@
  */
 #include "config.h"
 
+#include <string.h>
+
 #include <glib.h>
 
 #include "wmem_core.h"
@@ -41,6 +43,12 @@ typedef struct _wmem_map_item_t {
     struct _wmem_map_item_t *next;
 } wmem_map_item_t;
 
+/* A slot of a flat map */
+typedef struct {
+    const void *key;
+    void *value;
+} wmem_map_slot_t;
+
 struct _wmem_map_t {
     guint count; /* number of items stored */
 
@@ -52,6 +60,12 @@ struct _wmem_map_t {
 
     wmem_map_item_t **table;
 
+    /* Flat maps (see wmem_map_new_flat) use these instead of table */
+    gboolean         flat;
+    guint            deleted; /* number of tombstones */
+    guint8          *ctrl;
+    wmem_map_slot_t *slots;
+
     GHashFunc  hash_func;
     GEqualFunc eql_func;
 
@@ -98,6 +112,10 @@ wmem_map_new(wmem_allocator_t *allocator,
     map->allocator = allocator;
     map->count = 0;
     map->table = NULL;
+    map->flat    = FALSE;
+    map->deleted = 0;
+    map->ctrl    = NULL;
+    map->slots   = NULL;
 
     return map;
 }
@@ -110,6 +128,9 @@ wmem_map_reset_cb(wmem_allocator_t *allocator _U_, wmem_cb_event_t event,
 
     map->count = 0;
     map->table = NULL;
+    map->deleted = 0;
+    map->ctrl    = NULL;
+    map->slots   = NULL;
 
     if (event == WMEM_CB_DESTROY_EVENT) {
         wmem_unregister_callback(map->master, map->master_cb_id);
@@ -144,6 +165,10 @@ wmem_map_new_autoreset(wmem_allocator_t *master, wmem_allocator_t *slave,
     map->allocator = slave;
     map->count = 0;
     map->table = NULL;
+    map->flat    = FALSE;
+    map->deleted = 0;
+    map->ctrl    = NULL;
+    map->slots   = NULL;
 
     map->master_cb_id = wmem_register_callback(master, wmem_map_destroy_cb, map);
     map->slave_cb_id  = wmem_register_callback(slave, wmem_map_reset_cb, map);
@@ -183,12 +208,349 @@ wmem_map_grow(wmem_map_t *map)
     wmem_free(map->allocator, old_table);
 }
 
+/* Flat maps
+ *
+ * The items of a flat map are kept in an array of slots, along with an array
+ * of control bytes, one per slot, that say whether the slot is EMPTY, whether
+ * its item has been removed (DELETED, a tombstone that lets probing carry on
+ * past it), or else hold 7 bits of the hash of the key of its item. A lookup
+ * compares a whole group of control bytes at once against those 7 bits, only
+ * calls the equality function for the slots that match, and moves on to the
+ * next group until it finds one with an EMPTY slot. This is the design of
+ * Abseil's "Swiss tables", see https://abseil.io/about/design/swisstables
+ *
+ * A group can start at any slot, so the first GROUP_WIDTH - 1 control bytes
+ * are mirrored after the last one, letting groups that wrap around the end
+ * of the table be loaded in one go.
+ */
+#define FLAT_EMPTY   ((guint8)0x80)
+#define FLAT_DELETED ((guint8)0xFE)
+#define FLAT_IS_FULL(CTRL) (((CTRL) & 0x80) == 0)
+
+/* The smallest table has 2^4 = 16 slots, at least one group */
+#define WMEM_MAP_FLAT_DEFAULT_CAPACITY 4
+
+/* At most 7/8 of the slots can hold items or tombstones, so that probing
+ * soon finds an EMPTY slot. */
+#define FLAT_MAX_LOAD 7
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+/* Bit i of a mask is set for slot i of the group. */
+#define GROUP_WIDTH 16
+#define GROUP_SHIFT 0
+typedef __m128i flat_group_t;
+typedef guint32 flat_mask_t;
+
+static inline flat_group_t
+flat_group_load(const guint8 *ctrl)
+{
+    return _mm_loadu_si128((const __m128i *)(const void *)ctrl);
+}
+
+static inline flat_mask_t
+flat_group_match(flat_group_t group, guint8 h2)
+{
+    return (flat_mask_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+}
+
+static inline flat_mask_t
+flat_group_match_empty(flat_group_t group)
+{
+    return (flat_mask_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)FLAT_EMPTY)));
+}
+
+/* EMPTY or DELETED, the only control bytes with the top bit set */
+static inline flat_mask_t
+flat_group_match_free(flat_group_t group)
+{
+    return (flat_mask_t)_mm_movemask_epi8(group);
+}
+#else
+/* Without SSE2, a group is 8 bytes handled as one 64-bit word, and bit
+ * 8*i+7 of a mask is set for slot i of the group. */
+#define GROUP_WIDTH 8
+#define GROUP_SHIFT 3
+typedef guint64 flat_group_t;
+typedef guint64 flat_mask_t;
+
+#define FLAT_LSBS G_GUINT64_CONSTANT(0x0101010101010101)
+#define FLAT_MSBS G_GUINT64_CONSTANT(0x8080808080808080)
+
+static inline flat_group_t
+flat_group_load(const guint8 *ctrl)
+{
+    guint64 group;
+
+    memcpy(&group, ctrl, sizeof(group));
+    return GUINT64_FROM_LE(group);
+}
+
+/* This can also match a slot just after a matching one, but only a slot
+ * with an item in it, so comparing the keys sorts that out. */
+static inline flat_mask_t
+flat_group_match(flat_group_t group, guint8 h2)
+{
+    guint64 cmp = group ^ (FLAT_LSBS * h2);
+
+    return (cmp - FLAT_LSBS) & ~cmp & FLAT_MSBS;
+}
+
+/* EMPTY is the only control byte with both the top bit set and bit 1 clear. */
+static inline flat_mask_t
+flat_group_match_empty(flat_group_t group)
+{
+    return group & (~group << 6) & FLAT_MSBS;
+}
+
+static inline flat_mask_t
+flat_group_match_free(flat_group_t group)
+{
+    return group & FLAT_MSBS;
+}
+#endif
+
+/* Index in its group of the lowest slot set in a non-zero mask. */
+static inline size_t
+flat_mask_lowest(flat_mask_t mask)
+{
+#if defined(__GNUC__)
+    return (size_t)__builtin_ctzll(mask) >> GROUP_SHIFT;
+#else
+    size_t idx = 0;
+
+    while (!(mask & 1)) {
+        mask >>= 1;
+        idx++;
+    }
+    return idx >> GROUP_SHIFT;
+#endif
+}
+
+/* The low bits of the hash choose the slot to start probing at, and the top
+ * 7 bits go in the control byte. Keys are often pointers or small integers
+ * whose hash differs only in a few bits, so mix them all together first
+ * (with the finalizer of MurmurHash3). */
+static inline guint32
+flat_hash(const wmem_map_t *map, const void *key)
+{
+    guint32 h = map->hash_func(key) ^ x;
+
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+#define FLAT_H2(HASH) ((guint8)((HASH) >> 25))
+
+static inline void
+flat_set_ctrl(wmem_map_t *map, size_t idx, guint8 ctrl)
+{
+    map->ctrl[idx] = ctrl;
+    /* the mirror of the first GROUP_WIDTH - 1 bytes, or idx itself again */
+    map->ctrl[((idx - (GROUP_WIDTH - 1)) & (CAPACITY(map) - 1)) + (GROUP_WIDTH - 1)] = ctrl;
+}
+
+static void
+flat_init_table(wmem_map_t *map, size_t capacity)
+{
+    map->count    = 0;
+    map->deleted  = 0;
+    map->capacity = capacity;
+    map->ctrl     = (guint8 *)wmem_alloc(map->allocator, CAPACITY(map) + GROUP_WIDTH - 1);
+    memset(map->ctrl, FLAT_EMPTY, CAPACITY(map) + GROUP_WIDTH - 1);
+    map->slots    = wmem_alloc_array(map->allocator, wmem_map_slot_t, CAPACITY(map));
+}
+
+/* Probe sequences move on by one group, then two, then three and so on,
+ * which visits every group of a table whose size is a power of two. */
+static wmem_map_slot_t *
+flat_find(wmem_map_t *map, const void *key, guint32 hash)
+{
+    size_t       mask = CAPACITY(map) - 1;
+    size_t       pos  = hash & mask;
+    size_t       step = 0;
+    guint8       h2   = FLAT_H2(hash);
+    flat_group_t group;
+    flat_mask_t  match;
+
+    for (;;) {
+        group = flat_group_load(&map->ctrl[pos]);
+
+        for (match = flat_group_match(group, h2); match; match &= match - 1) {
+            size_t idx = (pos + flat_mask_lowest(match)) & mask;
+
+            if (map->eql_func(key, map->slots[idx].key)) {
+                return &map->slots[idx];
+            }
+        }
+
+        if (flat_group_match_empty(group)) {
+            return NULL;
+        }
+
+        step += GROUP_WIDTH;
+        pos = (pos + step) & mask;
+    }
+}
+
+/* The first EMPTY or DELETED slot of the probe sequence of a hash */
+static size_t
+flat_find_free(wmem_map_t *map, guint32 hash)
+{
+    size_t      mask = CAPACITY(map) - 1;
+    size_t      pos  = hash & mask;
+    size_t      step = 0;
+    flat_mask_t match;
+
+    for (;;) {
+        match = flat_group_match_free(flat_group_load(&map->ctrl[pos]));
+        if (match) {
+            return (pos + flat_mask_lowest(match)) & mask;
+        }
+
+        step += GROUP_WIDTH;
+        pos = (pos + step) & mask;
+    }
+}
+
+/* Rebuild the table, twice as large unless it's mostly tombstones. */
+static void
+flat_rehash(wmem_map_t *map)
+{
+    guint8          *old_ctrl  = map->ctrl;
+    wmem_map_slot_t *old_slots = map->slots;
+    size_t           old_cap   = CAPACITY(map);
+    size_t           i, idx;
+    guint32          hash;
+
+    if ((map->count + 1) * 16 > old_cap * FLAT_MAX_LOAD) {
+        flat_init_table(map, map->capacity + 1);
+    }
+    else {
+        flat_init_table(map, map->capacity);
+    }
+
+    for (i = 0; i < old_cap; i++) {
+        if (FLAT_IS_FULL(old_ctrl[i])) {
+            hash = flat_hash(map, old_slots[i].key);
+            idx  = flat_find_free(map, hash);
+            flat_set_ctrl(map, idx, FLAT_H2(hash));
+            map->slots[idx] = old_slots[i];
+            map->count++;
+        }
+    }
+
+    wmem_free(map->allocator, old_ctrl);
+    wmem_free(map->allocator, old_slots);
+}
+
+static void *
+wmem_map_flat_insert(wmem_map_t *map, const void *key, void *value)
+{
+    wmem_map_slot_t *slot;
+    void            *old_val;
+    guint32          hash;
+    size_t           idx;
+
+    /* Make sure we have a table */
+    if (map->ctrl == NULL) {
+        flat_init_table(map, WMEM_MAP_FLAT_DEFAULT_CAPACITY);
+    }
+
+    hash = flat_hash(map, key);
+
+    slot = flat_find(map, key, hash);
+    if (slot) {
+        /* replace and return old value for this key */
+        old_val = slot->value;
+        slot->value = value;
+        return old_val;
+    }
+
+    /* make room if we are over-full */
+    if ((map->count + map->deleted + 1) * 8 > CAPACITY(map) * FLAT_MAX_LOAD) {
+        flat_rehash(map);
+    }
+
+    idx = flat_find_free(map, hash);
+    if (map->ctrl[idx] == FLAT_DELETED) {
+        map->deleted--;
+    }
+    flat_set_ctrl(map, idx, FLAT_H2(hash));
+    map->slots[idx].key   = key;
+    map->slots[idx].value = value;
+    map->count++;
+
+    /* no previous entry, return NULL */
+    return NULL;
+}
+
+static wmem_map_slot_t *
+wmem_map_flat_lookup(wmem_map_t *map, const void *key)
+{
+    /* Make sure we have a table */
+    if (map->ctrl == NULL) {
+        return NULL;
+    }
+
+    return flat_find(map, key, flat_hash(map, key));
+}
+
+static wmem_map_slot_t *
+wmem_map_flat_remove(wmem_map_t *map, const void *key)
+{
+    wmem_map_slot_t *slot;
+
+    slot = wmem_map_flat_lookup(map, key);
+    if (slot) {
+        flat_set_ctrl(map, (size_t)(slot - map->slots), FLAT_DELETED);
+        map->count--;
+        map->deleted++;
+    }
+
+    /* still valid until the next insert */
+    return slot;
+}
+
+wmem_map_t *
+wmem_map_new_flat(wmem_allocator_t *allocator,
+        GHashFunc hash_func, GEqualFunc eql_func)
+{
+    wmem_map_t *map;
+
+    map = wmem_map_new(allocator, hash_func, eql_func);
+    map->flat = TRUE;
+
+    return map;
+}
+
+wmem_map_t *
+wmem_map_new_flat_autoreset(wmem_allocator_t *master, wmem_allocator_t *slave,
+        GHashFunc hash_func, GEqualFunc eql_func)
+{
+    wmem_map_t *map;
+
+    map = wmem_map_new_autoreset(master, slave, hash_func, eql_func);
+    map->flat = TRUE;
+
+    return map;
+}
+
 void *
 wmem_map_insert(wmem_map_t *map, const void *key, void *value)
 {
     wmem_map_item_t **item;
     void *old_val;
 
+    if (map->flat) {
+        return wmem_map_flat_insert(map, key, value);
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         wmem_map_init_table(map);
@@ -231,6 +593,10 @@ wmem_map_contains(wmem_map_t *map, const void *key)
 {
     wmem_map_item_t *item;
 
+    if (map->flat) {
+        return wmem_map_flat_lookup(map, key) != NULL;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return FALSE;
@@ -255,6 +621,12 @@ wmem_map_lookup(wmem_map_t *map, const void *key)
 {
     wmem_map_item_t *item;
 
+    if (map->flat) {
+        wmem_map_slot_t *slot = wmem_map_flat_lookup(map, key);
+
+        return slot ? slot->value : NULL;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return NULL;
@@ -279,6 +651,21 @@ wmem_map_lookup_extended(wmem_map_t *map, const void *key, const void **orig_key
 {
     wmem_map_item_t *item;
 
+    if (map->flat) {
+        wmem_map_slot_t *slot = wmem_map_flat_lookup(map, key);
+
+        if (!slot) {
+            return FALSE;
+        }
+        if (orig_key) {
+            *orig_key = slot->key;
+        }
+        if (value) {
+            *value = slot->value;
+        }
+        return TRUE;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return FALSE;
@@ -310,6 +697,12 @@ wmem_map_remove(wmem_map_t *map, const void *key)
     wmem_map_item_t **item, *tmp;
     void *value;
 
+    if (map->flat) {
+        wmem_map_slot_t *slot = wmem_map_flat_remove(map, key);
+
+        return slot ? slot->value : NULL;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return NULL;
@@ -341,6 +734,10 @@ wmem_map_steal(wmem_map_t *map, const void *key)
 {
     wmem_map_item_t **item, *tmp;
 
+    if (map->flat) {
+        return wmem_map_flat_remove(map, key) != NULL;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return FALSE;
@@ -372,6 +769,19 @@ wmem_map_get_keys(wmem_allocator_t *list_allocator, wmem_map_t *map)
     wmem_map_item_t *cur;
     wmem_list_t* list = wmem_list_new(list_allocator);
 
+    if (map->flat) {
+        if (map->ctrl != NULL) {
+            capacity = CAPACITY(map);
+
+            for (i=0; i<capacity; i++) {
+                if (FLAT_IS_FULL(map->ctrl[i])) {
+                    wmem_list_prepend(list, (void*)map->slots[i].key);
+                }
+            }
+        }
+        return list;
+    }
+
     if (map->table != NULL) {
         capacity = CAPACITY(map);
 
@@ -394,6 +804,19 @@ wmem_map_foreach(wmem_map_t *map, GHFunc foreach_func, gpointer user_data)
     wmem_map_item_t *cur;
     unsigned i;
 
+    if (map->flat) {
+        if (map->ctrl == NULL) {
+            return;
+        }
+
+        for (i = 0; i < CAPACITY(map); i++) {
+            if (FLAT_IS_FULL(map->ctrl[i])) {
+                foreach_func((gpointer)map->slots[i].key, map->slots[i].value, user_data);
+            }
+        }
+        return;
+    }
+
     /* Make sure we have a table */
     if (map->table == NULL) {
         return;
@@ -76,6 +76,33 @@ wmem_map_new_autoreset(wmem_allocator_t *master, wmem_allocator_t *slave,
         GHashFunc hash_func, GEqualFunc eql_func)
 G_GNUC_MALLOC;
 
+/** Creates a map like wmem_map_new(), but stored in a flat, open-addressing
+ * table rather than in buckets of separately allocated items. The items live
+ * in a single array, with one byte of metadata each that lets a lookup check
+ * a group of 8 or 16 of them at once, so it uses much less memory per item
+ * and takes fewer cache misses to search, especially for large maps. All the
+ * other wmem_map functions work the same way on either kind of map.
+ *
+ * @param allocator The allocator scope with which to create the map.
+ * @param hash_func The hash function used to place inserted keys.
+ * @param eql_func  The equality function used to compare inserted keys.
+ * @return The newly-allocated map.
+ */
+WS_DLL_PUBLIC
+wmem_map_t *
+wmem_map_new_flat(wmem_allocator_t *allocator,
+        GHashFunc hash_func, GEqualFunc eql_func)
+G_GNUC_MALLOC;
+
+/** Creates a map like wmem_map_new_autoreset(), but stored in a flat table
+ * as with wmem_map_new_flat().
+ */
+WS_DLL_PUBLIC
+wmem_map_t *
+wmem_map_new_flat_autoreset(wmem_allocator_t *master, wmem_allocator_t *slave,
+        GHashFunc hash_func, GEqualFunc eql_func)
+G_GNUC_MALLOC;
+
 /** Inserts a value into the map.
  *
  * @param map The map to insert into.
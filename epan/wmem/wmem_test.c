@@ -19,6 +19,7 @@
 #include "wmem_allocator.h"
 #include "wmem_allocator_block.h"
 #include "wmem_allocator_block_fast.h"
+#include "wmem_allocator_concurrent.h"
 #include "wmem_allocator_simple.h"
 #include "wmem_allocator_strict.h"
 
@@ -57,6 +58,9 @@ wmem_allocator_force_new(const wmem_allocator_type_t type)
         case WMEM_ALLOCATOR_STRICT:
             wmem_strict_allocator_init(allocator);
             break;
+        case WMEM_ALLOCATOR_CONCURRENT:
+            wmem_concurrent_allocator_init(allocator);
+            break;
         default:
             g_assert_not_reached();
             /* This is necessary to squelch MSVC errors; is there
@@ -369,6 +373,168 @@ wmem_test_allocator_strict(void)
     wmem_test_allocator_jumbo(WMEM_ALLOCATOR_STRICT, &wmem_strict_check_canaries);
 }
 
+#define CONCURRENT_THREADS      16
+#define CONCURRENT_ALLOCS       256
+
+typedef struct {
+    wmem_allocator_t *allocator;
+    GMutex           *lock;         /* for allocators that need one */
+    guint             id;
+    guint             iterations;
+    char             *ptrs[CONCURRENT_ALLOCS];
+} wmem_test_thread_t;
+
+/* Allocate, reallocate and free at random, filling each allocation with a
+ * byte of our own so that allocations overlapping those of another thread
+ * can be spotted. The allocations still live at the end are left for
+ * another thread to check and free. */
+static gpointer
+wmem_test_concurrent_worker(gpointer data)
+{
+    wmem_test_thread_t *thread = (wmem_test_thread_t *)data;
+    GRand              *rand = g_rand_new_with_seed(thread->id);
+    guint               i;
+
+    for (i = 0; i < thread->iterations; i++) {
+        gint  idx = g_rand_int_range(rand, 0, CONCURRENT_ALLOCS);
+        gint  size = g_rand_int_range(rand, 1, g_rand_boolean(rand) ? 128 : 2048);
+        char *ptr = thread->ptrs[idx];
+
+        if (thread->lock) g_mutex_lock(thread->lock);
+        if (ptr == NULL) {
+            ptr = (char *)wmem_alloc(thread->allocator, size);
+        }
+        else if (g_rand_boolean(rand)) {
+            ptr = (char *)wmem_realloc(thread->allocator, ptr, size);
+        }
+        else {
+            wmem_free(thread->allocator, ptr);
+            ptr = NULL;
+        }
+        if (thread->lock) g_mutex_unlock(thread->lock);
+
+        if (ptr) {
+            memset(ptr, (char)thread->id, size);
+        }
+        thread->ptrs[idx] = ptr;
+    }
+
+    g_rand_free(rand);
+    return NULL;
+}
+
+static gpointer
+wmem_test_concurrent_freer(gpointer data)
+{
+    wmem_test_thread_t *thread = (wmem_test_thread_t *)data;
+    guint               i;
+
+    for (i = 0; i < CONCURRENT_ALLOCS; i++) {
+        if (thread->ptrs[i]) {
+            g_assert(thread->ptrs[i][0] == (char)thread->id);
+            if (thread->lock) g_mutex_lock(thread->lock);
+            wmem_free(thread->allocator, thread->ptrs[i]);
+            if (thread->lock) g_mutex_unlock(thread->lock);
+            thread->ptrs[i] = NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/* Runs wmem_test_concurrent_worker() on num_threads threads, each doing
+ * iterations operations, then has each thread free what another thread
+ * allocated. Returns the wall-clock time this took, in microseconds. */
+static gint64
+wmem_test_concurrent_run(wmem_allocator_t *allocator, GMutex *lock,
+        guint num_threads, guint iterations)
+{
+    wmem_test_thread_t *threads = g_new0(wmem_test_thread_t, num_threads);
+    GThread           **ids = g_new(GThread *, num_threads);
+    gint64              start;
+    guint               i;
+
+    for (i = 0; i < num_threads; i++) {
+        threads[i].allocator  = allocator;
+        threads[i].lock       = lock;
+        threads[i].id         = i + 1;
+        threads[i].iterations = iterations;
+    }
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < num_threads; i++) {
+        ids[i] = g_thread_new("wmem_test", wmem_test_concurrent_worker, &threads[i]);
+    }
+    for (i = 0; i < num_threads; i++) {
+        g_thread_join(ids[i]);
+    }
+    for (i = 0; i < num_threads; i++) {
+        /* hand each thread's leftovers to the next thread to free */
+        ids[i] = g_thread_new("wmem_test", wmem_test_concurrent_freer,
+                &threads[(i + 1) % num_threads]);
+    }
+    for (i = 0; i < num_threads; i++) {
+        g_thread_join(ids[i]);
+    }
+
+    g_free(ids);
+    g_free(threads);
+    return g_get_monotonic_time() - start;
+}
+
+static void
+wmem_test_allocator_concurrent(void)
+{
+    wmem_allocator_t *allocator;
+
+    wmem_test_allocator(WMEM_ALLOCATOR_CONCURRENT, NULL,
+            MAX_SIMULTANEOUS_ALLOCS*64);
+    wmem_test_allocator_jumbo(WMEM_ALLOCATOR_CONCURRENT, NULL);
+
+    allocator = wmem_allocator_force_new(WMEM_ALLOCATOR_CONCURRENT);
+    wmem_test_concurrent_run(allocator, NULL, CONCURRENT_THREADS, 10000);
+    /* the arenas and whatever they have left are reused */
+    wmem_test_concurrent_run(allocator, NULL, CONCURRENT_THREADS, 10000);
+    wmem_free_all(allocator);
+    wmem_test_concurrent_run(allocator, NULL, CONCURRENT_THREADS, 10000);
+    wmem_destroy_allocator(allocator);
+}
+
+/* NOTE: You have to run "wmem_test --verbose" to see results. */
+static void
+wmem_test_concurrentperf(void)
+{
+#define CONCURRENT_PERF_OPS (4 * 1000 * 1000)
+    static const guint  thread_counts[] = { 1, 4, 16, 64 };
+    wmem_allocator_t   *allocator;
+    GMutex              lock;
+    gint64              block_us, concurrent_us;
+    guint               i;
+
+    g_mutex_init(&lock);
+
+    for (i = 0; i < G_N_ELEMENTS(thread_counts); i++) {
+        guint num_threads = thread_counts[i];
+
+        /* The block allocator isn't thread-safe, so it needs a lock. */
+        allocator = wmem_allocator_force_new(WMEM_ALLOCATOR_BLOCK);
+        block_us = wmem_test_concurrent_run(allocator, &lock, num_threads,
+                CONCURRENT_PERF_OPS / num_threads);
+        wmem_destroy_allocator(allocator);
+
+        allocator = wmem_allocator_force_new(WMEM_ALLOCATOR_CONCURRENT);
+        concurrent_us = wmem_test_concurrent_run(allocator, NULL, num_threads,
+                CONCURRENT_PERF_OPS / num_threads);
+        wmem_destroy_allocator(allocator);
+
+        g_test_minimized_result(concurrent_us / 1000.0,
+            "%2u threads, %d operations: block with lock %.3f ms, concurrent %.3f ms",
+            num_threads, CONCURRENT_PERF_OPS, block_us / 1000.0, concurrent_us / 1000.0);
+    }
+
+    g_mutex_clear(&lock);
+}
+
 /* UTILITY TESTING FUNCTIONS (/wmem/utils/) */
 
 static void
@@ -869,10 +1035,19 @@ check_val_map(gpointer key _U_, gpointer val, gpointer user_data)
     g_assert(val == user_data);
 }
 
+typedef wmem_map_t *(*wmem_test_map_new_func)(wmem_allocator_t *,
+        GHashFunc, GEqualFunc);
+typedef wmem_map_t *(*wmem_test_map_new_autoreset_func)(wmem_allocator_t *,
+        wmem_allocator_t *, GHashFunc, GEqualFunc);
+
 static void
-wmem_test_map(void)
+wmem_test_map_common(wmem_test_map_new_func map_new,
+        wmem_test_map_new_autoreset_func map_new_autoreset)
 {
     wmem_allocator_t   *allocator, *extra_allocator;
+    GHashTable       *ref;
+    guint32           rand_key;
+    gboolean          present;
     wmem_map_t       *map;
     gchar            *str_key;
     const void       *str_key_ret;
@@ -885,7 +1060,7 @@ wmem_test_map(void)
     extra_allocator = wmem_allocator_new(WMEM_ALLOCATOR_STRICT);
 
     /* insertion, lookup and removal of simple integer keys */
-    map = wmem_map_new(allocator, g_direct_hash, g_direct_equal);
+    map = map_new(allocator, g_direct_hash, g_direct_equal);
     g_assert(map);
 
     for (i=0; i<CONTAINER_ITERS; i++) {
@@ -923,7 +1098,7 @@ wmem_test_map(void)
     wmem_free_all(allocator);
 
     /* test auto-reset functionality */
-    map = wmem_map_new_autoreset(allocator, extra_allocator, g_direct_hash, g_direct_equal);
+    map = map_new_autoreset(allocator, extra_allocator, g_direct_hash, g_direct_equal);
     g_assert(map);
     for (i=0; i<CONTAINER_ITERS; i++) {
         ret = wmem_map_insert(map, GINT_TO_POINTER(i), GINT_TO_POINTER(777777));
@@ -939,7 +1114,7 @@ wmem_test_map(void)
     }
     wmem_free_all(allocator);
 
-    map = wmem_map_new(allocator, wmem_str_hash, g_str_equal);
+    map = map_new(allocator, wmem_str_hash, g_str_equal);
     g_assert(map);
 
     /* string keys and for-each */
@@ -957,7 +1132,7 @@ wmem_test_map(void)
     }
 
     /* test foreach */
-    map = wmem_map_new(allocator, wmem_str_hash, g_str_equal);
+    map = map_new(allocator, wmem_str_hash, g_str_equal);
     g_assert(map);
     for (i=0; i<CONTAINER_ITERS; i++) {
         str_key = wmem_test_rand_string(allocator, 1, 64);
@@ -966,17 +1141,123 @@ wmem_test_map(void)
     wmem_map_foreach(map, check_val_map, GINT_TO_POINTER(2));
 
     /* test size */
-    map = wmem_map_new(allocator, g_direct_hash, g_direct_equal);
+    map = map_new(allocator, g_direct_hash, g_direct_equal);
     g_assert(map);
     for (i=0; i<CONTAINER_ITERS; i++) {
         wmem_map_insert(map, GINT_TO_POINTER(i), GINT_TO_POINTER(i));
     }
     g_assert(wmem_map_size(map) == CONTAINER_ITERS);
 
+    /* interleaved insertions and removals of random keys, checked
+     * against a GHashTable */
+    wmem_free_all(allocator);
+    map = map_new(allocator, g_direct_hash, g_direct_equal);
+    ref = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (i=0; i<CONTAINER_ITERS*10; i++) {
+        rand_key = g_test_rand_int_range(1, CONTAINER_ITERS);
+        present = g_hash_table_contains(ref, GUINT_TO_POINTER(rand_key));
+        g_assert(wmem_map_contains(map, GUINT_TO_POINTER(rand_key)) == present);
+        if (g_test_rand_bit()) {
+            ret = wmem_map_insert(map, GUINT_TO_POINTER(rand_key), GUINT_TO_POINTER(i));
+            g_assert((ret != NULL) == present);
+            g_hash_table_insert(ref, GUINT_TO_POINTER(rand_key), GUINT_TO_POINTER(i));
+        }
+        else {
+            ret = wmem_map_remove(map, GUINT_TO_POINTER(rand_key));
+            g_assert(ret == g_hash_table_lookup(ref, GUINT_TO_POINTER(rand_key)));
+            g_hash_table_remove(ref, GUINT_TO_POINTER(rand_key));
+        }
+        g_assert(wmem_map_size(map) == g_hash_table_size(ref));
+    }
+    g_assert(wmem_list_count(wmem_map_get_keys(allocator, map)) == g_hash_table_size(ref));
+    g_hash_table_destroy(ref);
+
     wmem_destroy_allocator(extra_allocator);
     wmem_destroy_allocator(allocator);
 }
 
+static void
+wmem_test_map(void)
+{
+    wmem_test_map_common(wmem_map_new, wmem_map_new_autoreset);
+}
+
+static void
+wmem_test_map_flat(void)
+{
+    wmem_test_map_common(wmem_map_new_flat, wmem_map_new_flat_autoreset);
+}
+
+/* NOTE: You have to run "wmem_test --verbose" to see results. */
+static void
+wmem_test_mapperf(void)
+{
+    wmem_allocator_t   *allocator;
+    wmem_map_t         *map;
+    guint32            *keys;
+    guint               num_keys, i, found;
+    int                 flat;
+    gint64              start_us, insert_us, lookup_us, remove_us;
+
+    for (num_keys = 1000; num_keys <= 100 * 1000 * 1000; num_keys *= 10) {
+        /* the largest maps take a lot of time and memory */
+        if (num_keys > 1000 * 1000 && !g_test_slow()) {
+            break;
+        }
+
+        /* even keys, so that odd ones can be looked up and missed */
+        keys = g_new(guint32, num_keys);
+        for (i = 0; i < num_keys; i++) {
+            keys[i] = g_test_rand_int() & ~1U;
+        }
+
+        for (flat = 0; flat <= 1; flat++) {
+            allocator = wmem_allocator_force_new(WMEM_ALLOCATOR_BLOCK);
+            if (flat) {
+                map = wmem_map_new_flat(allocator, g_direct_hash, g_direct_equal);
+            }
+            else {
+                map = wmem_map_new(allocator, g_direct_hash, g_direct_equal);
+            }
+
+            start_us = g_get_monotonic_time();
+            for (i = 0; i < num_keys; i++) {
+                wmem_map_insert(map, GUINT_TO_POINTER(keys[i]), GUINT_TO_POINTER(i));
+            }
+            insert_us = g_get_monotonic_time() - start_us;
+
+            found = 0;
+            start_us = g_get_monotonic_time();
+            for (i = 0; i < num_keys; i++) {
+                if (wmem_map_contains(map, GUINT_TO_POINTER(keys[i]))) {
+                    found++;
+                }
+                if (wmem_map_contains(map, GUINT_TO_POINTER(keys[i] | 1))) {
+                    found++;
+                }
+            }
+            lookup_us = g_get_monotonic_time() - start_us;
+            g_assert(found == num_keys);
+
+            start_us = g_get_monotonic_time();
+            for (i = 0; i < num_keys; i++) {
+                wmem_map_remove(map, GUINT_TO_POINTER(keys[i]));
+            }
+            remove_us = g_get_monotonic_time() - start_us;
+            g_assert(wmem_map_size(map) == 0);
+
+            wmem_destroy_allocator(allocator);
+
+            g_test_minimized_result((insert_us + lookup_us + remove_us) / 1000.0,
+                "%-7s %9u keys: insert %.3f ms, lookup (half missing) %.3f ms, remove %.3f ms",
+                flat ? "flat" : "chained", num_keys,
+                insert_us / 1000.0, lookup_us / 1000.0, remove_us / 1000.0);
+        }
+
+        g_free(keys);
+    }
+}
+
 static void
 wmem_test_queue(void)
 {
@@ -1408,6 +1689,7 @@ main(int argc, char **argv)
     g_test_add_func("/wmem/allocator/blk_fast",  wmem_test_allocator_block_fast);
     g_test_add_func("/wmem/allocator/simple",    wmem_test_allocator_simple);
     g_test_add_func("/wmem/allocator/strict",    wmem_test_allocator_strict);
+    g_test_add_func("/wmem/allocator/concurrent", wmem_test_allocator_concurrent);
     g_test_add_func("/wmem/allocator/callbacks", wmem_test_allocator_callbacks);
 
     g_test_add_func("/wmem/utils/misc",    wmem_test_miscutls);
@@ -1417,9 +1699,15 @@ main(int argc, char **argv)
         g_test_add_func("/wmem/utils/stringperf", wmem_test_stringperf);
     }
 
+    if (g_test_perf()) {
+        g_test_add_func("/wmem/allocator/concurrentperf", wmem_test_concurrentperf);
+        g_test_add_func("/wmem/datastruct/mapperf", wmem_test_mapperf);
+    }
+
     g_test_add_func("/wmem/datastruct/array",  wmem_test_array);
     g_test_add_func("/wmem/datastruct/list",   wmem_test_list);
     g_test_add_func("/wmem/datastruct/map",    wmem_test_map);
+    g_test_add_func("/wmem/datastruct/map_flat", wmem_test_map_flat);
     g_test_add_func("/wmem/datastruct/queue",  wmem_test_queue);
     g_test_add_func("/wmem/datastruct/stack",  wmem_test_stack);
     g_test_add_func("/wmem/datastruct/strbuf", wmem_test_strbuf);
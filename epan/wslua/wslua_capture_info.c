@@ -338,7 +338,7 @@ WSLUA_METAMETHOD CaptureInfoConst__tostring(lua_State* L) {
     } else {
         wtap_dumper *wdh = fi->wdh;
         lua_pushfstring(L, "CaptureInfoConst: file_type_subtype=%d, snaplen=%d, encap=%d, compressed=%d",
-            wdh->file_type_subtype, wdh->snaplen, wdh->encap, wdh->compressed);
+            wdh->file_type_subtype, wdh->snaplen, wdh->encap, wdh->compression_type != WTAP_UNCOMPRESSED);
     }
 
     WSLUA_RETURN(1); /* String of debug information. */
@@ -21,9 +21,11 @@
 #include <wsutil/tempfile.h>
 #include <wsutil/file_util.h>
 #include <wsutil/filesystem.h>
+#include <wsutil/ws_memmem.h>
 #include <version_info.h>
 
 #include <wiretap/merge.h>
+#include <wiretap/wtap_index.h>
 
 #include <epan/exceptions.h>
 #include <epan/epan.h>
@@ -71,6 +73,8 @@
 
 static gboolean read_record(capture_file *cf, dfilter_t *dfcode,
     epan_dissect_t *edt, column_info *cinfo, gint64 offset);
+static void read_index_records(capture_file *cf, wtap_index_t *rec_index,
+    column_info *cinfo);
 
 static void rescan_packets(capture_file *cf, const char *action, const char *action_item, gboolean redissect);
 
@@ -84,13 +88,7 @@ static match_result match_protocol_tree(capture_file *cf, frame_data *fdata,
 static void match_subtree_text(proto_node *node, gpointer data);
 static match_result match_summary_line(capture_file *cf, frame_data *fdata,
     void *criterion);
-static match_result match_narrow_and_wide(capture_file *cf, frame_data *fdata,
-    void *criterion);
-static match_result match_narrow(capture_file *cf, frame_data *fdata,
-    void *criterion);
-static match_result match_wide(capture_file *cf, frame_data *fdata,
-    void *criterion);
-static match_result match_binary(capture_file *cf, frame_data *fdata,
+static match_result match_data(capture_file *cf, frame_data *fdata,
     void *criterion);
 static match_result match_regex(capture_file *cf, frame_data *fdata,
     void *criterion);
@@ -240,7 +238,8 @@ ws_epan_new(capture_file *cf)
     ws_get_frame_ts,
     cap_file_provider_get_interface_name,
     cap_file_provider_get_interface_description,
-    cap_file_provider_get_user_comment
+    cap_file_provider_get_user_comment,
+    cap_file_provider_get_shift_offset
   };
 
   return epan_new(&cf->provider, &funcs);
@@ -498,6 +497,8 @@ cf_read(capture_file *cf, gboolean reloading)
   guint                tap_flags;
   gboolean             compiled;
   volatile gboolean    is_read_aborted = FALSE;
+  wtap_index_t        *rec_index = NULL;
+  wtap_index_t        *new_rec_index = NULL;
 
   /* Compile the current display filter.
    * We assume this will not fail since cf->dfilter is only set in
@@ -539,6 +540,23 @@ cf_read(capture_file *cf, gboolean reloading)
      XXX - do we know this at open time? */
   cf->iscompressed = wtap_iscompressed(cf->provider.wth);
 
+  /* Decompress on another thread while we dissect. */
+  if (cf->iscompressed)
+    wtap_set_read_ahead(cf->provider.wth);
+
+  /*
+   * If nothing needs the records dissected as they're read, and the file
+   * has a valid index, add the records from the index and leave their
+   * dissection until they're displayed.  Otherwise, if the file is large,
+   * build an index while reading it, so that it opens quickly next time.
+   */
+  if (!create_proto_tree && cf->rfcode == NULL && !cf->redissecting &&
+      !tap_listeners_require_dissection())
+    rec_index = wtap_index_read(cf->provider.wth, cf->filename);
+  if (rec_index == NULL &&
+      wtap_file_size(cf->provider.wth, NULL) >= WTAP_INDEX_MIN_FILE_SIZE)
+    new_rec_index = wtap_index_new(cf->provider.wth);
+
   /* The packet list window will be empty until the file is completly loaded */
   packet_list_freeze();
 
@@ -567,7 +585,10 @@ cf_read(capture_file *cf, gboolean reloading)
 
     g_timer_start(prog_timer);
 
-    while ((wtap_read(cf->provider.wth, &err, &err_info, &data_offset))) {
+    if (rec_index != NULL)
+      read_index_records(cf, rec_index, cinfo);
+
+    while (rec_index == NULL && (wtap_read(cf->provider.wth, &err, &err_info, &data_offset))) {
       if (size >= 0) {
         count++;
         file_pos = wtap_read_so_far(cf->provider.wth);
@@ -616,6 +637,8 @@ cf_read(capture_file *cf, gboolean reloading)
            hours even on fast machines) just to see that it was the wrong file. */
         break;
       }
+      if (new_rec_index != NULL)
+        wtap_index_append(new_rec_index, data_offset, wtap_get_rec(cf->provider.wth));
       read_record(cf, dfcode, &edt, cinfo, data_offset);
     }
   }
@@ -649,6 +672,16 @@ cf_read(capture_file *cf, gboolean reloading)
   /* We're done reading sequentially through the file. */
   cf->state = FILE_READ_DONE;
 
+  /* If we read the whole file, save its index; failing to is harmless. */
+  if (new_rec_index != NULL) {
+    if (err == 0 && !is_read_aborted && !cf->stop_flag) {
+      int index_err;
+
+      wtap_index_write(new_rec_index, cf->provider.wth, cf->filename, &index_err);
+    }
+    wtap_index_free(new_rec_index);
+  }
+
   /* Close the sequential I/O side, to free up memory it requires. */
   wtap_sequential_close(cf->provider.wth);
 
@@ -663,7 +696,11 @@ cf_read(capture_file *cf, gboolean reloading)
      we've looked at all the packets, as we don't know until then whether
      there's more than one type (and thus whether it's
      WTAP_ENCAP_PER_PACKET). */
-  cf->lnk_t = wtap_file_encap(cf->provider.wth);
+  if (rec_index != NULL) {
+    cf->lnk_t = wtap_index_file_encap(rec_index);
+    wtap_index_free(rec_index);
+  } else
+    cf->lnk_t = wtap_file_encap(cf->provider.wth);
 
   cf->current_frame = frame_data_sequence_find(cf->provider.frames, cf->first_displayed);
   cf->current_row = 0;
@@ -1195,6 +1232,57 @@ read_record(capture_file *cf, dfilter_t *dfcode, epan_dissect_t *edt,
   return added;
 }
 
+/*
+ * Add the records listed in a file's index to the set of frames and to
+ * the packet list without reading or dissecting them; they're read and
+ * dissected when they're displayed.
+ */
+static void
+read_index_records(capture_file *cf, wtap_index_t *rec_index, column_info *cinfo)
+{
+  wtap_rec    rec;
+  frame_data  fdlocal;
+  frame_data *fdata;
+  gint64      offset;
+  gboolean    has_comment;
+  guint32     i, count;
+
+  wtap_rec_init(&rec);
+  count = wtap_index_count(rec_index);
+  for (i = 0; i < count; i++) {
+    offset = wtap_index_get_rec(rec_index, i, &rec, &has_comment);
+    if (rec.rec_type == REC_TYPE_PACKET) {
+      cf_add_encapsulation_type(cf, rec.rec_header.packet_header.pkt_encap);
+    }
+
+    frame_data_init(&fdlocal, cf->count + 1, &rec, offset, cf->cum_bytes);
+    fdlocal.flags.has_phdr_comment = has_comment;
+
+    /* This does a shallow copy of fdlocal, which is good enough. */
+    fdata = frame_data_sequence_add(cf->provider.frames, &fdlocal);
+
+    cf->count++;
+    if (has_comment)
+      cf->packet_comment_count++;
+    cf->f_datalen = offset + fdlocal.cap_len;
+
+    /* There's no display filter, so every frame is displayed. */
+    frame_data_set_before_dissect(fdata, &cf->elapsed_time,
+                                  &cf->provider.ref, cf->provider.prev_dis);
+    cf->provider.prev_cap = fdata;
+    fdata->flags.passed_dfilter = 1;
+    cf->displayed_count++;
+
+    packet_list_append(cinfo, fdata);
+
+    frame_data_set_after_dissect(fdata, &cf->cum_bytes);
+    cf->provider.prev_dis = fdata;
+    if (cf->first_displayed == 0)
+      cf->first_displayed = fdata->num;
+    cf->last_displayed = fdata->num;
+  }
+  wtap_rec_cleanup(&rec);
+}
 
 typedef struct _callback_data_t {
   gpointer         pd_window;
@@ -1321,6 +1409,7 @@ cf_merge_files_to_tempfile(gpointer pd_window, char **out_filenamep,
                                    (const char *const *) in_filenames,
                                    in_file_count, do_append,
                                    IDB_MERGE_MODE_ALL_SAME, 0 /* snaplen */,
+                                   0 /* max_open_files */,
                                    "Wireshark", &cb, &err, &err_info,
                                    &err_fileno, &err_framenum);
 
@@ -3054,8 +3143,9 @@ match_summary_line(capture_file *cf, frame_data *fdata, void *criterion)
 }
 
 typedef struct {
-    const guint8 *data;
-    size_t        data_len;
+    const guint8     *data;
+    size_t            data_len;
+    ws_memmem_pattern pattern;  /* data, compiled for ws_memmem_exec() */
 } cbs_t;    /* "Counted byte string" */
 
 
@@ -3073,7 +3163,10 @@ gboolean
 cf_find_packet_data(capture_file *cf, const guint8 *string, size_t string_size,
                     search_direction dir)
 {
-  cbs_t info;
+  cbs_t        info;
+  guint8      *wide_text;
+  size_t       i;
+  gboolean     result;
 
   info.data = string;
   info.data_len = string_size;
@@ -3083,182 +3176,71 @@ cf_find_packet_data(capture_file *cf, const guint8 *string, size_t string_size,
     /* Regular Expression search */
     return find_packet(cf, match_regex, NULL, dir);
   } else if (cf->string) {
-    /* String search - what type of string? */
+    /*
+     * String search - what type of string?  The search string is
+     * compiled once here, rather than once per packet.
+     */
+    ws_memmem_pattern_init(&info.pattern, cf->case_type);
     switch (cf->scs_type) {
 
     case SCS_NARROW_AND_WIDE:
-      return find_packet(cf, match_narrow_and_wide, &info, dir);
+      /*
+       * Look for the text both as is and with a NUL after each
+       * character but the last, which matches it in both UTF-16LE
+       * and UTF-16BE.
+       */
+      ws_memmem_pattern_add(&info.pattern, string, string_size, 1);
+      if (string_size > 1) {
+        wide_text = (guint8 *)g_malloc(string_size * 2 - 1);
+        for (i = 0; i < string_size; i++) {
+          wide_text[i * 2] = string[i];
+          if (i + 1 < string_size)
+            wide_text[i * 2 + 1] = '\0';
+        }
+        ws_memmem_pattern_add(&info.pattern, wide_text, string_size * 2 - 1, 1);
+        g_free(wide_text);
+      }
+      result = find_packet(cf, match_data, &info, dir);
+      break;
 
     case SCS_NARROW:
-      return find_packet(cf, match_narrow, &info, dir);
+      ws_memmem_pattern_add(&info.pattern, string, string_size, 1);
+      result = find_packet(cf, match_data, &info, dir);
+      break;
 
     case SCS_WIDE:
-      return find_packet(cf, match_wide, &info, dir);
+      /* Skip the other byte of each UTF-16 character. */
+      ws_memmem_pattern_add(&info.pattern, string, string_size, 2);
+      result = find_packet(cf, match_data, &info, dir);
+      break;
 
     default:
       g_assert_not_reached();
-      return FALSE;
-    }
-  } else
-    return find_packet(cf, match_binary, &info, dir);
-}
-
-static match_result
-match_narrow_and_wide(capture_file *cf, frame_data *fdata, void *criterion)
-{
-  cbs_t        *info       = (cbs_t *)criterion;
-  const guint8 *ascii_text = info->data;
-  size_t        textlen    = info->data_len;
-  match_result  result;
-  guint32       buf_len;
-  guint8       *pd;
-  guint32       i;
-  guint8        c_char;
-  size_t        c_match    = 0;
-
-  /* Load the frame's data. */
-  if (!cf_read_record(cf, fdata)) {
-    /* Attempt to get the packet failed. */
-    return MR_ERROR;
-  }
-
-  result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
-  pd = ws_buffer_start_ptr(&cf->buf);
-  i = 0;
-  while (i < buf_len) {
-    c_char = pd[i];
-    if (cf->case_type)
-      c_char = g_ascii_toupper(c_char);
-    if (c_char != '\0') {
-      if (c_char == ascii_text[c_match]) {
-        c_match += 1;
-        if (c_match == textlen) {
-          result = MR_MATCHED;
-          cf->search_pos = i; /* Save the position of the last character
-                                 for highlighting the field. */
-          cf->search_len = (guint32)textlen;
-          break;
-        }
-      }
-      else {
-        g_assert(i>=c_match);
-        i -= (guint32)c_match;
-        c_match = 0;
-      }
-    }
-    i += 1;
-  }
-  return result;
-}
-
-static match_result
-match_narrow(capture_file *cf, frame_data *fdata, void *criterion)
-{
-  guint8       *pd;
-  cbs_t        *info       = (cbs_t *)criterion;
-  const guint8 *ascii_text = info->data;
-  size_t        textlen    = info->data_len;
-  match_result  result;
-  guint32       buf_len;
-  guint32       i;
-  guint8        c_char;
-  size_t        c_match    = 0;
-
-  /* Load the frame's data. */
-  if (!cf_read_record(cf, fdata)) {
-    /* Attempt to get the packet failed. */
-    return MR_ERROR;
-  }
-
-  result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
-  pd = ws_buffer_start_ptr(&cf->buf);
-  i = 0;
-  while (i < buf_len) {
-    c_char = pd[i];
-    if (cf->case_type)
-      c_char = g_ascii_toupper(c_char);
-    if (c_char == ascii_text[c_match]) {
-      c_match += 1;
-      if (c_match == textlen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
-        cf->search_len = (guint32)textlen;
-        break;
-      }
-    }
-    else {
-      g_assert(i>=c_match);
-      i -= (guint32)c_match;
-      c_match = 0;
-    }
-    i += 1;
-  }
-
-  return result;
-}
-
-static match_result
-match_wide(capture_file *cf, frame_data *fdata, void *criterion)
-{
-  cbs_t        *info       = (cbs_t *)criterion;
-  const guint8 *ascii_text = info->data;
-  size_t        textlen    = info->data_len;
-  match_result  result;
-  guint32       buf_len;
-  guint8       *pd;
-  guint32       i;
-  guint8        c_char;
-  size_t        c_match    = 0;
-
-  /* Load the frame's data. */
-  if (!cf_read_record(cf, fdata)) {
-    /* Attempt to get the packet failed. */
-    return MR_ERROR;
-  }
-
-  result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
-  pd = ws_buffer_start_ptr(&cf->buf);
-  i = 0;
-  while (i < buf_len) {
-    c_char = pd[i];
-    if (cf->case_type)
-      c_char = g_ascii_toupper(c_char);
-    if (c_char == ascii_text[c_match]) {
-      c_match += 1;
-      if (c_match == textlen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
-        cf->search_len = (guint32)textlen;
-        break;
-      }
-      i += 1;
-    }
-    else {
-      g_assert(i>=(c_match*2));
-      i -= (guint32)c_match*2;
-      c_match = 0;
+      result = FALSE;
+      break;
     }
-    i += 1;
+    ws_memmem_pattern_cleanup(&info.pattern);
+    return result;
+  } else {
+    ws_memmem_pattern_init(&info.pattern, FALSE);
+    ws_memmem_pattern_add(&info.pattern, string, string_size, 1);
+    result = find_packet(cf, match_data, &info, dir);
+    ws_memmem_pattern_cleanup(&info.pattern);
+    return result;
   }
-  return result;
 }
 
+/*
+ * Look for the search string, compiled by cf_find_packet_data(), in the
+ * frame's data.
+ */
 static match_result
-match_binary(capture_file *cf, frame_data *fdata, void *criterion)
+match_data(capture_file *cf, frame_data *fdata, void *criterion)
 {
-  cbs_t        *info        = (cbs_t *)criterion;
-  const guint8 *binary_data = info->data;
-  size_t        datalen     = info->data_len;
-  match_result  result;
-  guint32       buf_len;
-  guint8       *pd;
-  guint32       i;
-  size_t        c_match     = 0;
+  cbs_t        *info = (cbs_t *)criterion;
+  const guint8 *pd;
+  const guint8 *match;
+  size_t        match_span;
 
   /* Load the frame's data. */
   if (!cf_read_record(cf, fdata)) {
@@ -3266,29 +3248,15 @@ match_binary(capture_file *cf, frame_data *fdata, void *criterion)
     return MR_ERROR;
   }
 
-  result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
   pd = ws_buffer_start_ptr(&cf->buf);
-  i = 0;
-  while (i < buf_len) {
-    if (pd[i] == binary_data[c_match]) {
-      c_match += 1;
-      if (c_match == datalen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
-        cf->search_len = (guint32)datalen;
-        break;
-      }
-    }
-    else {
-      g_assert(i>=c_match);
-      i -= (guint32)c_match;
-      c_match = 0;
-    }
-    i += 1;
-  }
-  return result;
+  match = ws_memmem_exec(pd, fdata->cap_len, &info->pattern, &match_span);
+  if (match == NULL)
+    return MR_NOTMATCHED;
+
+  /* Save the position of the last character for highlighting the field. */
+  cf->search_pos = (guint32)(match - pd + match_span - 1);
+  cf->search_len = (guint32)info->data_len;
+  return MR_MATCHED;
 }
 
 static match_result
@@ -4201,6 +4169,7 @@ cf_save_records(capture_file *cf, const char *fname, guint save_format,
   gchar           *err_info;
   gchar           *fname_new = NULL;
   wtap_dumper     *pdh;
+  wtap_compression_type compression_type = compressed ? WTAP_GZIP_COMPRESSED : WTAP_UNCOMPRESSED;
   frame_data      *fdata;
   addrinfo_lists_t *addr_lists;
   guint            framenum;
@@ -4327,10 +4296,10 @@ cf_save_records(capture_file *cf, const char *fname, guint save_format,
          from which we're reading the packets that we're writing!) */
       fname_new = g_strdup_printf("%s~", fname);
       pdh = wtap_dump_open_ng(fname_new, save_format, encap, cf->snap,
-                              compressed, shb_hdrs, idb_inf, nrb_hdrs, &err);
+                              compression_type, shb_hdrs, idb_inf, nrb_hdrs, &err);
     } else {
       pdh = wtap_dump_open_ng(fname, save_format, encap, cf->snap,
-                              compressed, shb_hdrs, idb_inf, nrb_hdrs, &err);
+                              compression_type, shb_hdrs, idb_inf, nrb_hdrs, &err);
     }
     g_free(idb_inf);
     idb_inf = NULL;
@@ -4553,6 +4522,7 @@ cf_export_specified_packets(capture_file *cf, const char *fname,
   gchar                       *fname_new = NULL;
   int                          err;
   wtap_dumper                 *pdh;
+  wtap_compression_type        compression_type = compressed ? WTAP_GZIP_COMPRESSED : WTAP_UNCOMPRESSED;
   save_callback_args_t         callback_args;
   GArray                      *shb_hdrs = NULL;
   wtapng_iface_descriptions_t *idb_inf = NULL;
@@ -4584,10 +4554,10 @@ cf_export_specified_packets(capture_file *cf, const char *fname,
        from which we're reading the packets that we're writing!) */
     fname_new = g_strdup_printf("%s~", fname);
     pdh = wtap_dump_open_ng(fname_new, save_format, encap, cf->snap,
-                            compressed, shb_hdrs, idb_inf, nrb_hdrs, &err);
+                            compression_type, shb_hdrs, idb_inf, nrb_hdrs, &err);
   } else {
     pdh = wtap_dump_open_ng(fname, save_format, encap, cf->snap,
-                            compressed, shb_hdrs, idb_inf, nrb_hdrs, &err);
+                            compression_type, shb_hdrs, idb_inf, nrb_hdrs, &err);
   }
   g_free(idb_inf);
   idb_inf = NULL;
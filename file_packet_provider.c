@@ -77,6 +77,12 @@ cap_file_provider_get_user_comment(struct packet_provider_data *prov, const fram
   return NULL;
 }
 
+const nstime_t *
+cap_file_provider_get_shift_offset(struct packet_provider_data *prov, const frame_data *fd)
+{
+  return frame_data_sequence_get_shift_offset(prov->frames, fd->num);
+}
+
 void
 cap_file_provider_set_user_comment(struct packet_provider_data *prov, frame_data *fd, const char *new_comment)
 {
@@ -53,6 +53,9 @@
 
 #include "ui/failure_message.h"
 
+#define LONGOPT_MAX_OPEN_FILES  (65536+1)
+#define LONGOPT_COMPRESS        (65536+2)
+
 /*
  * Show the usage
  */
@@ -71,6 +74,10 @@ print_usage(FILE *output)
   fprintf(output, "                    an empty \"-F\" option will list the file types.\n");
   fprintf(output, "  -I <IDB merge mode> set the merge mode for Interface Description Blocks; default is 'all'.\n");
   fprintf(output, "                    an empty \"-I\" option will list the merge modes.\n");
+  fprintf(output, "  --max-open-files <count>\n");
+  fprintf(output, "                    keep at most <count> input files open at a time.\n");
+  fprintf(output, "  --compress <type> compress the output file using <type> compression;\n");
+  fprintf(output, "                    an invalid type will list the compression types.\n");
   fprintf(output, "\n");
   fprintf(output, "Miscellaneous:\n");
   fprintf(output, "  -h                display this help and exit.\n");
@@ -160,6 +167,18 @@ list_idb_merge_modes(void) {
   }
 }
 
+static void
+list_output_compression_types(void) {
+  GSList *compression_types, *type;
+
+  fprintf(stderr, "mergecap: The available output compression types for the \"--compress\" flag are:\n");
+  compression_types = wtap_get_all_compression_type_names_list();
+  for (type = compression_types; type != NULL; type = g_slist_next(type)) {
+    fprintf(stderr, "    %s\n", (const char *)type->data);
+  }
+  g_slist_free(compression_types);
+}
+
 static gboolean
 merge_callback(merge_event event, int num,
                const merge_in_file_t in_files[], const guint in_file_count,
@@ -236,12 +255,16 @@ main(int argc, char *argv[])
   static const struct option long_options[] = {
       {"help", no_argument, NULL, 'h'},
       {"version", no_argument, NULL, 'V'},
+      {"max-open-files", required_argument, NULL, LONGOPT_MAX_OPEN_FILES},
+      {"compress", required_argument, NULL, LONGOPT_COMPRESS},
       {0, 0, 0, 0 }
   };
   gboolean            do_append          = FALSE;
   gboolean            verbose            = FALSE;
   int                 in_file_count      = 0;
   guint32             snaplen            = 0;
+  guint               max_open_files     = 0;
+  wtap_compression_type compression_type = WTAP_UNCOMPRESSED;
 #ifdef PCAP_NG_DEFAULT
   int                 file_type          = WTAP_FILE_TYPE_SUBTYPE_PCAPNG; /* default to pcap format */
 #else
@@ -361,6 +384,21 @@ main(int argc, char *argv[])
       out_filename = optarg;
       break;
 
+    case LONGOPT_MAX_OPEN_FILES:
+      max_open_files = get_nonzero_guint32(optarg, "maximum number of open files");
+      break;
+
+    case LONGOPT_COMPRESS:
+      compression_type = wtap_name_to_compression_type(optarg);
+      if (!wtap_can_write_compression_type(compression_type)) {
+        fprintf(stderr, "mergecap: \"%s\" isn't a valid output compression type\n",
+                optarg);
+        list_output_compression_types();
+        status = MERGE_ERR_INVALID_OPTION;
+        goto clean_exit;
+      }
+      break;
+
     case '?':              /* Bad options if GNU getopt */
       switch(optopt) {
       case'F':
@@ -414,13 +452,17 @@ main(int argc, char *argv[])
     status = merge_files_to_stdout(file_type,
                                    (const char *const *) &argv[optind],
                                    in_file_count, do_append, mode, snaplen,
-                                   "mergecap", verbose ? &cb : NULL,
+                                   max_open_files, compression_type,
+                                   "mergecap",
+                                   verbose ? &cb : NULL,
                                    &err, &err_info, &err_fileno, &err_framenum);
   } else {
     /* merge the files to the outfile */
     status = merge_files(out_filename, file_type,
                          (const char *const *) &argv[optind], in_file_count,
-                         do_append, mode, snaplen, "mergecap", verbose ? &cb : NULL,
+                         do_append, mode, snaplen, max_open_files,
+                         compression_type, "mergecap",
+                         verbose ? &cb : NULL,
                          &err, &err_info, &err_fileno, &err_framenum);
   }
 
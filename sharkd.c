@@ -33,6 +33,7 @@
 #include <version_info.h>
 #include <wiretap/wtap_opttypes.h>
 #include <wiretap/pcapng.h>
+#include <wiretap/wtap_index.h>
 
 #include <epan/decode_as.h>
 #include <epan/timestamp.h>
@@ -329,13 +330,56 @@ process_packet(capture_file *cf, epan_dissect_t *edt,
 }
 
 
+/*
+ * Add the records listed in a file's index to the set of frames without
+ * reading or dissecting them; they're dissected when they're requested.
+ */
+static void
+load_index_records(capture_file *cf, wtap_index_t *rec_index,
+                   int max_packet_count, gint64 max_byte_count)
+{
+  wtap_rec    rec;
+  frame_data  fdlocal;
+  gint64      offset;
+  gboolean    has_comment;
+  guint32     i, count;
+
+  wtap_rec_init(&rec);
+  count = wtap_index_count(rec_index);
+  for (i = 0; i < count; i++) {
+    offset = wtap_index_get_rec(rec_index, i, &rec, &has_comment);
+    if (max_byte_count != 0 && offset >= max_byte_count)
+      break;
+
+    frame_data_init(&fdlocal, cf->count + 1, &rec, offset, cum_bytes);
+    fdlocal.flags.has_phdr_comment = has_comment;
+
+    frame_data_set_before_dissect(&fdlocal, &cf->elapsed_time,
+                                  &cf->provider.ref, cf->provider.prev_dis);
+    if (cf->provider.ref == &fdlocal) {
+      ref_frame = fdlocal;
+      cf->provider.ref = &ref_frame;
+    }
+
+    frame_data_set_after_dissect(&fdlocal, &cum_bytes);
+    cf->provider.prev_cap = cf->provider.prev_dis = frame_data_sequence_add(cf->provider.frames, &fdlocal);
+    cf->count++;
+
+    if (--max_packet_count == 0)
+      break;
+  }
+  wtap_rec_cleanup(&rec);
+}
+
 static int
 load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
 {
-  int          err;
+  int          err = 0;
   gchar       *err_info = NULL;
   gint64       data_offset;
   epan_dissect_t *edt = NULL;
+  wtap_index_t *rec_index = NULL;
+  wtap_index_t *new_rec_index = NULL;
 
   {
     /* Allocate a frame_data_sequence for all the frames. */
@@ -361,9 +405,28 @@ load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
       /* We're not going to display the protocol tree on this pass,
          so it's not going to be "visible". */
       edt = epan_dissect_new(cf->epan, create_proto_tree, FALSE);
+
+      /*
+       * If nothing needs the records dissected as they're read, and
+       * the file has a valid index, add the records from the index.
+       * Otherwise, if the file is large, build an index while reading
+       * it, so that it loads quickly next time.
+       */
+      if (!create_proto_tree)
+        rec_index = wtap_index_read(cf->provider.wth, cf->filename);
+      if (rec_index == NULL && max_packet_count == 0 && max_byte_count == 0 &&
+          wtap_file_size(cf->provider.wth, NULL) >= WTAP_INDEX_MIN_FILE_SIZE)
+        new_rec_index = wtap_index_new(cf->provider.wth);
+    }
+
+    if (rec_index != NULL) {
+      load_index_records(cf, rec_index, max_packet_count, max_byte_count);
+      wtap_index_free(rec_index);
     }
 
-    while (wtap_read(cf->provider.wth, &err, &err_info, &data_offset)) {
+    while (rec_index == NULL && wtap_read(cf->provider.wth, &err, &err_info, &data_offset)) {
+      if (new_rec_index != NULL)
+        wtap_index_append(new_rec_index, data_offset, wtap_get_rec(cf->provider.wth));
       if (process_packet(cf, edt, data_offset, wtap_get_rec(cf->provider.wth),
                          wtap_get_buf_ptr(cf->provider.wth))) {
         /* Stop reading if we have the maximum number of packets;
@@ -383,6 +446,16 @@ load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
       edt = NULL;
     }
 
+    /* If we read the whole file, save its index; failing to is harmless. */
+    if (new_rec_index != NULL) {
+      if (err == 0) {
+        int index_err;
+
+        wtap_index_write(new_rec_index, cf->provider.wth, cf->filename, &index_err);
+      }
+      wtap_index_free(new_rec_index);
+    }
+
     /* Close the sequential I/O side, to free up memory it requires. */
     wtap_sequential_close(cf->provider.wth);
 
@@ -78,6 +78,10 @@ struct sharkd_filter_item
 
 static GHashTable *filter_table = NULL;
 
+/* io_graph_pyramid_t of tapped graphs, keyed by graph request and filter, so that
+ * asking for the same graphs with another interval doesn't need a retap. */
+static GHashTable *iograph_cache = NULL;
+
 static gboolean
 json_unescape_str(char *input)
 {
@@ -542,6 +546,8 @@ sharkd_session_process_load(const char *buf, const jsmntok_t *tokens, int count)
 	if (!tok_file)
 		return;
 
+	g_hash_table_remove_all(iograph_cache);
+
 	if (sharkd_cf_open(tok_file, WTAP_TYPE_AUTO, FALSE, &err) != CF_OK)
 	{
 		printf("{\"err\":%d}\n", err);
@@ -2870,7 +2876,13 @@ sharkd_session_process_frame_cb(epan_dissect_t *edt, proto_tree *tree, struct ep
 	printf("}\n");
 }
 
-#define SHARKD_IOGRAPH_MAX_ITEMS 250000 /* 250k limit of items is taken from wireshark-qt, on x86_64 sizeof(io_graph_item_t) is 152, so single graph can take max 36 MB */
+/*
+ * 250k limit of items is taken from wireshark-qt, on x86_64 sizeof(io_graph_item_t) is 152, so a single interval can take 36 MB.
+ * A pyramid keeps the requested interval, the coarser ones, and the finer ones which haven't outgrown the limit.
+ * Each is at least twice the one before it, so with the items merged for another interval, a graph can take up to 4 * 36 MB.
+ */
+#define SHARKD_IOGRAPH_MAX_ITEMS 250000
+#define SHARKD_IOGRAPH_MAX_CACHED_SIZE (256 * 1024 * 1024) /* total size of the cached graphs, in bytes */
 
 struct sharkd_iograph
 {
@@ -2878,45 +2890,75 @@ struct sharkd_iograph
 	int hf_index;
 	io_graph_item_unit_t calc_type;
 	guint32 interval;
+	char *key;
 
 	/* result */
-	int space_items;
-	int num_items;
-	io_graph_item_t *items;
+	io_graph_pyramid_t *pyramid;
+	gboolean cached;
 	GString *error;
 };
 
-static gboolean
-sharkd_iograph_packet(void *g, packet_info *pinfo, epan_dissect_t *edt, const void *dummy _U_)
+static io_graph_pyramid_t *
+sharkd_iograph_pyramid_new(guint32 interval)
 {
-	struct sharkd_iograph *graph = (struct sharkd_iograph *) g;
-	int idx;
-
-	idx = get_io_graph_index(pinfo, graph->interval);
-	if (idx < 0 || idx >= SHARKD_IOGRAPH_MAX_ITEMS)
-		return FALSE;
+	static const int default_intervals[] = IO_GRAPH_PYRAMID_INTERVALS;
+	int intervals[IO_GRAPH_PYRAMID_MAX_LEVELS];
+	int num_intervals = 0;
+	gboolean added = FALSE;
+	int i;
 
-	if (idx + 1 > graph->num_items)
+	/* Keep the default intervals which fit in a chain of multiples with the requested one. */
+	for (i = 0; i < (int) G_N_ELEMENTS(default_intervals); i++)
 	{
-		if (idx + 1 > graph->space_items)
-		{
-			int new_size = idx + 1024;
-
-			graph->items = (io_graph_item_t *) g_realloc(graph->items, sizeof(io_graph_item_t) * new_size);
-			reset_io_graph_items(&graph->items[graph->space_items], new_size - graph->space_items);
+		guint32 d = (guint32) default_intervals[i];
 
-			graph->space_items = new_size;
-		}
-		else if (graph->items == NULL)
+		if (d > interval && !added)
 		{
-			graph->items = (io_graph_item_t *) g_malloc(sizeof(io_graph_item_t) * graph->space_items);
-			reset_io_graph_items(graph->items, graph->space_items);
+			intervals[num_intervals++] = (int) interval;
+			added = TRUE;
 		}
 
-		graph->num_items = idx + 1;
+		if ((d <= interval && interval % d == 0) || (d > interval && d % interval == 0))
+		{
+			if (d == interval)
+				added = TRUE;
+			intervals[num_intervals++] = (int) d;
+		}
 	}
 
-	return update_io_graph_item(graph->items, idx, pinfo, edt, graph->hf_index, graph->calc_type, graph->interval);
+	if (!added)
+		intervals[num_intervals++] = (int) interval;
+
+	return io_graph_pyramid_new(intervals, num_intervals, SHARKD_IOGRAPH_MAX_ITEMS);
+}
+
+static void
+sharkd_session_iograph_free(gpointer data)
+{
+	io_graph_pyramid_free((io_graph_pyramid_t *) data);
+}
+
+static gsize
+sharkd_iograph_cache_size(void)
+{
+	GHashTableIter iter;
+	gpointer value;
+	gsize size = 0;
+
+	/* Merging items for another interval can grow a cached pyramid, so don't keep a running total. */
+	g_hash_table_iter_init(&iter, iograph_cache);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		size += io_graph_pyramid_get_size((const io_graph_pyramid_t *) value);
+
+	return size;
+}
+
+static gboolean
+sharkd_iograph_packet(void *g, packet_info *pinfo, epan_dissect_t *edt, const void *dummy _U_)
+{
+	struct sharkd_iograph *graph = (struct sharkd_iograph *) g;
+
+	return io_graph_pyramid_add(graph->pyramid, pinfo, edt);
 }
 
 /**
@@ -2944,7 +2986,7 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 {
 	const char *tok_interval = json_find_attr(buf, tokens, count, "interval");
 	struct sharkd_iograph graphs[10];
-	gboolean is_any_ok = FALSE;
+	gboolean is_any_tapped = FALSE;
 	int graph_count;
 
 	guint32 interval_ms = 1000; /* default: one per second */
@@ -2952,7 +2994,7 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 
 	if (tok_interval)
 	{
-		if (!ws_strtou32(tok_interval, NULL, &interval_ms) || interval_ms == 0)
+		if (!ws_strtou32(tok_interval, NULL, &interval_ms) || interval_ms == 0 || interval_ms > G_MAXINT32)
 		{
 			fprintf(stderr, "Invalid interval parameter: %s.\n", tok_interval);
 			return;
@@ -3008,21 +3050,43 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 		graph->hf_index = -1;
 		graph->error = check_field_unit(field_name, &graph->hf_index, graph->calc_type);
 
-		graph->space_items = 0; /* TODO, can avoid realloc()s in sharkd_iograph_packet() by calculating: capture_time / interval */
-		graph->num_items = 0;
-		graph->items = NULL;
+		graph->key = NULL;
+		graph->pyramid = NULL;
+		graph->cached = FALSE;
 
 		if (!graph->error)
-			graph->error = register_tap_listener("frame", graph, tok_filter, TL_REQUIRES_PROTO_TREE, NULL, sharkd_iograph_packet, NULL);
+		{
+			int num_items;
+
+			graph->key = g_strdup_printf("%s\n%s", tok_graph, tok_filter ? tok_filter : "");
+			graph->pyramid = (io_graph_pyramid_t *) g_hash_table_lookup(iograph_cache, graph->key);
+
+			/* LOAD keeps only the intervals at least as coarse as the one it was tapped with. */
+			if (graph->pyramid && io_graph_pyramid_get_items(graph->pyramid, (int) interval_ms, &num_items))
+			{
+				graph->cached = TRUE;
+			}
+			else
+			{
+				graph->pyramid = sharkd_iograph_pyramid_new(interval_ms);
+				io_graph_pyramid_reset(graph->pyramid, graph->hf_index, graph->calc_type, (int) interval_ms);
+				graph->error = register_tap_listener("frame", graph, tok_filter, TL_REQUIRES_PROTO_TREE, NULL, sharkd_iograph_packet, NULL);
+				if (graph->error)
+				{
+					io_graph_pyramid_free(graph->pyramid);
+					graph->pyramid = NULL;
+				}
+			}
+		}
 
 		graph_count++;
 
-		if (graph->error == NULL)
-			is_any_ok = TRUE;
+		if (graph->error == NULL && !graph->cached)
+			is_any_tapped = TRUE;
 	}
 
-	/* retap only if we have at least one ok */
-	if (is_any_ok)
+	/* retap only if we have at least one ok, which isn't in the cache */
+	if (is_any_tapped)
 		sharkd_retap();
 
 	printf("{\"iograph\":[");
@@ -3043,16 +3107,20 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 		}
 		else
 		{
+			const io_graph_item_t *items;
+			int num_items = 0;
 			int idx;
 			int next_idx = 0;
 			const char *sepa = "";
 
+			items = io_graph_pyramid_get_items(graph->pyramid, (int) graph->interval, &num_items);
+
 			printf("\"items\":[");
-			for (idx = 0; idx < graph->num_items; idx++)
+			for (idx = 0; items && idx < num_items; idx++)
 			{
 				double val;
 
-				val = get_io_graph_item(graph->items, graph->calc_type, idx, graph->hf_index, &cfile, graph->interval, graph->num_items);
+				val = get_io_graph_item(items, graph->calc_type, idx, graph->hf_index, &cfile, graph->interval, num_items);
 
 				/* if it's zero, don't display */
 				if (val == 0.0)
@@ -3071,12 +3139,38 @@ sharkd_session_process_iograph(char *buf, const jsmntok_t *tokens, int count)
 			printf("]");
 		}
 		printf("}");
-
-		remove_tap_listener(graph);
-		g_free(graph->items);
 	}
 
 	printf("]}\n");
+
+	/* Cache the graphs just tapped, only now, as clearing the cache frees the graphs which came from it. */
+	for (i = 0; i < graph_count; i++)
+	{
+		struct sharkd_iograph *graph = &graphs[i];
+
+		if (graph->pyramid && !graph->cached)
+		{
+			gsize size = io_graph_pyramid_get_size(graph->pyramid);
+
+			remove_tap_listener(graph);
+
+			/* an older entry for the same graph, if any, didn't have this interval */
+			g_hash_table_remove(iograph_cache, graph->key);
+
+			if (size > SHARKD_IOGRAPH_MAX_CACHED_SIZE)
+			{
+				io_graph_pyramid_free(graph->pyramid);
+			}
+			else
+			{
+				if (sharkd_iograph_cache_size() + size > SHARKD_IOGRAPH_MAX_CACHED_SIZE)
+					g_hash_table_remove_all(iograph_cache);
+				g_hash_table_insert(iograph_cache, graph->key, graph->pyramid);
+				graph->key = NULL;
+			}
+		}
+		g_free(graph->key);
+	}
 }
 
 /**
@@ -3537,6 +3631,8 @@ sharkd_session_process_setconf(char *buf, const jsmntok_t *tokens, int count)
 	ws_snprintf(pref, sizeof(pref), "%s:%s", tok_name, tok_value);
 
 	ret = prefs_set_pref(pref, &errmsg);
+	/* preferences can change how packets are dissected */
+	g_hash_table_remove_all(iograph_cache);
 	printf("{\"err\":%d", ret);
 	if (errmsg)
 	{
@@ -4187,6 +4283,7 @@ sharkd_session_main(void)
 	fprintf(stderr, "Hello in child.\n");
 
 	filter_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, sharkd_session_filter_free);
+	iograph_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, sharkd_session_iograph_free);
 
 #ifdef HAVE_MAXMINDDB
 	/* mmdbresolve was stopped before fork(), force starting it */
@@ -4231,6 +4328,7 @@ sharkd_session_main(void)
 	}
 
 	g_hash_table_destroy(filter_table);
+	g_hash_table_destroy(iograph_cache);
 	g_free(tokens);
 
 	return 0;
@@ -20,6 +20,7 @@ import tempfile
 commands = (
     'capinfos',
     'dumpcap',
+    'editcap',
     'mergecap',
     'rawshark',
     'sharkd',
@@ -36,6 +37,7 @@ program_path = None
 # Strings
 cmd_capinfos = None
 cmd_dumpcap = None
+cmd_editcap = None
 cmd_mergecap = None
 cmd_rawshark = None
 cmd_tshark = None
@@ -47,6 +49,7 @@ args_ping = None
 have_lua = False
 have_nghttp2 = False
 have_kerberos = False
+have_maxminddb = False
 have_libgcrypt16 = False
 have_libgcrypt17 = False
 
@@ -63,6 +66,7 @@ capture_dir = os.path.join(this_dir, 'captures')
 config_dir = os.path.join(this_dir, 'config')
 key_dir = os.path.join(this_dir, 'keys')
 lua_dir = os.path.join(this_dir, 'lua')
+maxmind_dir = os.path.join(this_dir, 'maxmind')
 tools_dir = os.path.join(this_dir, '..', 'tools')
 
 all_groups = []
@@ -93,11 +97,13 @@ def getTsharkInfo():
     global have_lua
     global have_nghttp2
     global have_kerberos
+    global have_maxminddb
     global have_libgcrypt16
     global have_libgcrypt17
     have_lua = False
     have_nghttp2 = False
     have_kerberos = False
+    have_maxminddb = False
     have_libgcrypt16 = False
     have_libgcrypt17 = False
     try:
@@ -109,6 +115,8 @@ def getTsharkInfo():
             have_nghttp2 = True
         if re.search('(with +MIT +Kerberos|with +Heimdal +Kerberos)', tshark_v):
             have_kerberos = True
+        if re.search('with +MaxMind +DB +resolver', tshark_v):
+            have_maxminddb = True
         gcry_m = re.search('with +Gcrypt +([0-9]+\.[0-9]+)', tshark_v)
         have_libgcrypt16 = gcry_m and float(gcry_m.group(1)) >= 1.6
         have_libgcrypt17 = gcry_m and float(gcry_m.group(1)) >= 1.7
@@ -249,6 +257,7 @@ def setUpHostFiles():
     shutil.copyfile(hosts_path_pfx + 'global', os.path.join(global_path, 'hosts'))
     shutil.copyfile(hosts_path_pfx + 'personal', os.path.join(conf_path, 'hosts'))
     shutil.copyfile(hosts_path_pfx + 'custom', os.path.join(custom_profile_path, 'hosts'))
+    shutil.copyfile(os.path.join(this_dir, 'subnets.personal'), os.path.join(conf_path, 'subnets'))
 
 if sys.platform.startswith('win32') or sys.platform.startswith('darwin'):
     can_capture = True
@@ -11,6 +11,7 @@
 
 import config
 import os.path
+import re
 import subprocess
 import subprocesstest
 import unittest
@@ -192,6 +193,47 @@ class case_tshark_dump_glossaries(subprocesstest.SubprocessTestCase):
         self.runProcess((config.cmd_tshark, '-G', 'plugins'), env=os.environ.copy())
         self.assertGreaterEqual(self.countOutput('dissector'), 10, 'Fewer than 10 dissector plugins found')
 
+class case_tshark_tap_timing(subprocesstest.SubprocessTestCase):
+    # Two tap listeners on the "ip" tap with the same filter.
+    tap_args = (('-z', 'conv,ip,udp'), ('-z', 'endpoints,ip,udp'))
+
+    def runTaps(self, *tap_args):
+        cap_file = os.path.join(config.capture_dir, 'dns+icmp.pcapng.gz')
+        args = (config.cmd_tshark, '-n', '-q', '-r', cap_file, '--tap-timing')
+        for tap_arg in tap_args:
+            args += tap_arg
+        return self.assertRun(args)
+
+    def tapTimings(self, tshark_proc):
+        '''Returns (tap name, packets, filter evaluations) for each tap listener
+        in the timing section of the output'''
+        self.assertIn('Tap listener timing', tshark_proc.stderr_str)
+        return re.findall(r'^ +(\S+) +(\d+) +\d+; +(\d+) +\d+ "udp"$', tshark_proc.stderr_str, re.MULTILINE)
+
+    def test_tshark_tap_timing_shared_filter(self):
+        '''Tap listeners with the same filter, together and separately'''
+        separate_procs = [self.runTaps(tap_arg) for tap_arg in self.tap_args]
+        together_proc = self.runTaps(*self.tap_args)
+
+        # Each tap prints the same statistics as when run on its own.
+        for separate_proc in separate_procs:
+            self.assertIn(separate_proc.stdout_str, together_proc.stdout_str)
+        self.assertEqual(len(together_proc.stdout_str),
+            sum(len(separate_proc.stdout_str) for separate_proc in separate_procs))
+
+        separate_timings = [self.tapTimings(separate_proc) for separate_proc in separate_procs]
+        together_timings = self.tapTimings(together_proc)
+        self.assertEqual(len(together_timings), 2)
+        for separate_timing in separate_timings:
+            self.assertEqual(len(separate_timing), 1)
+            (tap_name, packets, filter_evals) = separate_timing[0]
+            self.assertEqual(tap_name, 'ip')
+            self.assertTrue(int(packets) > 0)
+            self.assertTrue(int(filter_evals) >= int(packets))
+        # The shared filter is evaluated once per packet, not once per listener.
+        self.assertEqual(sorted(together_timings),
+            sorted(separate_timing[0] for separate_timing in separate_timings))
+
 
 # Purposefully fail a test. Used for testing the test framework.
 # class case_fail_on_purpose(subprocesstest.SubprocessTestCase):
@@ -11,8 +11,48 @@
 
 import config
 import os.path
+import struct
 import subprocesstest
+import sys
 import unittest
+import zlib
+
+def rc4(key, data):
+    '''Returns data encrypted or decrypted with RC4'''
+    s = list(range(256))
+    j = 0
+    for i in range(256):
+        j = (j + s[i] + key[i % len(key)]) & 0xff
+        s[i], s[j] = s[j], s[i]
+    out = bytearray()
+    i = j = 0
+    for byte in data:
+        i = (i + 1) & 0xff
+        j = (j + s[i]) & 0xff
+        s[i], s[j] = s[j], s[i]
+        out.append(byte ^ s[(s[i] + s[j]) & 0xff])
+    return bytes(out)
+
+def wep_pcap(wep_key, num_stations, rounds):
+    '''Returns an 802.11 pcap file with a WEP encrypted UDP packet to the
+    AP from each of num_stations stations, rounds times'''
+    ap_mac = b'\x00\x00\x5e\x00\x53\x00'
+    data = struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 105)
+    for rnd in range(rounds):
+        for sta in range(num_stations):
+            sta_mac = b'\x02\x00\x00\x00' + struct.pack('!H', sta)
+            udp_payload = 'station {}'.format(sta).encode('ascii')
+            udp = struct.pack('!HHHH', 12345, 9, 8 + len(udp_payload), 0) + udp_payload
+            ip = struct.pack('!BBHHHBBH4s4s', 0x45, 0, 20 + len(udp), sta, 0, 64, 17, 0,
+                struct.pack('!I', 0x0a010000 + sta), struct.pack('!I', 0xc0000201))
+            plaintext = b'\xaa\xaa\x03\x00\x00\x00\x08\x00' + ip + udp
+            plaintext += struct.pack('<I', zlib.crc32(plaintext) & 0xffffffff)
+            iv = struct.pack('!BH', rnd + 1, sta)
+            # Data, To DS, Protected; BSSID, SA, DA
+            frame = b'\x08\x41\x00\x00' + ap_mac + sta_mac + ap_mac + struct.pack('<H', (rnd << 4) & 0xfff0)
+            frame += iv + b'\x00' + rc4(bytearray(iv + wep_key), bytearray(plaintext))
+            data += struct.pack('<IIII', 1500000000 + rnd, sta, len(frame), len(frame)) + frame
+    return data
 
 class case_decrypt_80211(subprocesstest.SubprocessTestCase):
     def test_80211_wpa_psk(self):
@@ -81,6 +121,58 @@ class case_decrypt_80211(subprocesstest.SubprocessTestCase):
             env=config.test_env)
         self.assertEqual(self.countOutput('ICMP.*Echo .ping'), 2)
 
+    def count_wpa_pwd_requests(self, capture_file, key):
+        # The custom profile has no keys of its own.
+        self.assertRun((config.cmd_tshark,
+                '-C', config.custom_profile_name,
+                '-o', 'wlan.enable_decryption: TRUE',
+                '-o', 'uat:80211_keys:"wpa-pwd","{}"'.format(key),
+                '-Tfields',
+                '-e', 'http.request.uri',
+                '-r', capture_file,
+                '-Y', 'http',
+            ),
+            env=config.test_env)
+        return self.countOutput('favicon.ico')
+
+    def check_80211_wpa_pwd_twice(self, key):
+        capture_file = os.path.join(config.capture_dir, 'wpa-Induction.pcap.gz')
+        twice_file = self.filename_from_id('wpa-Induction-twice.pcap')
+        self.assertRun((config.cmd_mergecap, '-a', '-F', 'pcap', '-w', twice_file, capture_file, capture_file))
+
+        requests = self.count_wpa_pwd_requests(capture_file, key)
+        self.assertTrue(requests > 0, 'Nothing decrypted with the passphrase')
+        # The second handshake uses the PSK derived for the first one.
+        self.assertEqual(self.count_wpa_pwd_requests(twice_file, key), requests * 2)
+
+    def test_80211_wpa_pwd(self):
+        '''IEEE 802.11 WPA passphrase and SSID, with two handshakes'''
+        self.check_80211_wpa_pwd_twice('Induction:Coherer')
+
+    def test_80211_wpa_pwd_any_ssid(self):
+        '''IEEE 802.11 WPA passphrase for any SSID, with two handshakes'''
+        self.check_80211_wpa_pwd_twice('Induction')
+
+    def test_80211_wep_many_stations(self):
+        '''IEEE 802.11 WEP with more stations than there used to be security associations'''
+        num_stations = 300
+        capture_file = self.filename_from_id('wep-stations.pcap')
+        with open(capture_file, 'wb') as capture_fd:
+            capture_fd.write(wep_pcap(b'\x01\x02\x03\x04\x05', num_stations, 2))
+        self.assertRun((config.cmd_tshark,
+                '-C', config.custom_profile_name,
+                '-o', 'wlan.enable_decryption: TRUE',
+                '-o', 'uat:80211_keys:"wep","0102030405"',
+                '-Tfields',
+                '-e', 'data.data',
+                '-r', capture_file,
+                '-Y', 'udp.dstport == 9',
+            ),
+            env=config.test_env)
+        # Every station is looked up again in the second round.
+        self.assertEqual(self.countOutput('.'), num_stations * 2)
+        self.assertEqual(self.countOutput('^73:74:61:74:69:6f:6e:20:32:39:39$'), 2)
+
 class case_decrypt_dtls(subprocesstest.SubprocessTestCase):
     def test_dtls(self):
         '''DTLS'''
@@ -177,6 +269,71 @@ class case_decrypt_tls(subprocesstest.SubprocessTestCase):
             env=config.test_env)
         self.assertTrue(self.grepOutput('test'))
 
+    def test_ssl_master_secret_keylog_index(self):
+        '''SSL using the master secret from a key log index'''
+        capture_file = os.path.join(config.capture_dir, 'dhe1.pcapng.gz')
+        key_file = os.path.join(config.key_dir, 'dhe1_keylog.dat')
+        index_file = self.filename_from_id('keylog.idx')
+        self.assertRun((sys.executable,
+                os.path.join(config.tools_dir, 'make-tls-keylog-index.py'),
+                key_file, index_file,
+            ))
+        self.runProcess((config.cmd_tshark,
+                '-r', capture_file,
+                '-o', 'ssl.keylog_file: {}'.format(index_file),
+                '-o', 'ssl.desegment_ssl_application_data: FALSE',
+                '-o', 'http.ssl.port: 443',
+                '-Tfields',
+                '-e', 'http.request.uri',
+                '-Y', 'http',
+            ),
+            env=config.test_env)
+        self.assertTrue(self.grepOutput('test'))
+
+    def test_ssl_master_secret_partial_keylog(self):
+        '''SSL using the master secret, key log ending with a partial line'''
+        capture_file = os.path.join(config.capture_dir, 'dhe1.pcapng.gz')
+        key_file = os.path.join(config.key_dir, 'dhe1_keylog.dat')
+        partial_file = self.filename_from_id('keylog.dat')
+        with open(key_file) as key_fd:
+            key_lines = key_fd.read()
+        with open(partial_file, 'w') as partial_fd:
+            partial_fd.write(key_lines)
+            # A line still being written when the file is read.
+            partial_fd.write('CLIENT_RANDOM 531f88d114fcf9ce9729b5458f73e180')
+        self.runProcess((config.cmd_tshark,
+                '-r', capture_file,
+                '-o', 'ssl.keylog_file: {}'.format(partial_file),
+                '-o', 'ssl.desegment_ssl_application_data: FALSE',
+                '-o', 'http.ssl.port: 443',
+                '-Tfields',
+                '-e', 'http.request.uri',
+                '-Y', 'http',
+            ),
+            env=config.test_env)
+        self.assertTrue(self.grepOutput('test'))
+
+    def test_ssl_master_secret_unterminated_keylog(self):
+        '''SSL using the master secret, key log without a final newline'''
+        capture_file = os.path.join(config.capture_dir, 'dhe1.pcapng.gz')
+        key_file = os.path.join(config.key_dir, 'dhe1_keylog.dat')
+        unterminated_file = self.filename_from_id('keylog.dat')
+        with open(key_file) as key_fd:
+            key_lines = key_fd.read()
+        with open(unterminated_file, 'w') as unterminated_fd:
+            unterminated_fd.write(key_lines.rstrip('\n'))
+        self.runProcess((config.cmd_tshark,
+                '-r', capture_file,
+                '-o', 'ssl.keylog_file: {}'.format(unterminated_file),
+                '-o', 'ssl.desegment_ssl_application_data: FALSE',
+                '-o', 'http.ssl.port: 443',
+                '-Tfields',
+                '-e', 'http.request.uri',
+                '-Y', 'http',
+            ),
+            env=config.test_env)
+        self.assertTrue(self.grepOutput('test'))
+
     def test_tls12_renegotiation(self):
         '''TLS 1.2 with renegotiation'''
         capture_file = os.path.join(config.capture_dir, 'tls-renegotiation.pcap')
@@ -0,0 +1,113 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import config
+import os.path
+from suite_dfilter import dfiltertest
+
+# The operands of "and" and "or" are evaluated cheapest first, whatever
+# order they are written in. Each filter is tested written both ways.
+
+class case_logical(dfiltertest.DFTestCase):
+    trace_file = "http.pcap"
+
+    def assertDFilterCountBothWays(self, dfilter1, op, dfilter2, expected_count):
+        self.assertDFilterCount('{} {} {}'.format(dfilter1, op, dfilter2), expected_count)
+        self.assertDFilterCount('{} {} {}'.format(dfilter2, op, dfilter1), expected_count)
+
+    def test_and_1(self):
+        self.assertDFilterCountBothWays('http', 'and', 'tcp.port == 80', 1)
+
+    def test_and_2(self):
+        self.assertDFilterCountBothWays('http', 'and', 'tcp.port == 81', 0)
+
+    def test_and_3_matches(self):
+        self.assertDFilterCountBothWays('tcp.port == 80', 'and', 'http.request.method matches "^HE"', 1)
+
+    def test_and_4_matches(self):
+        self.assertDFilterCountBothWays('tcp.port == 81', 'and', 'http.request.method matches "^HE"', 0)
+
+    def test_or_1(self):
+        self.assertDFilterCountBothWays('http', 'or', 'tcp.port == 81', 1)
+
+    def test_or_2(self):
+        self.assertDFilterCountBothWays('tcp.port == 81', 'or', 'http.request.method matches "^HE"', 1)
+
+    def test_or_3(self):
+        self.assertDFilterCountBothWays('tcp.port == 81', 'or', 'http.request.method matches "^GE"', 0)
+
+    def test_absent_1(self):
+        self.assertDFilterCountBothWays('udp.port == 53', 'and', 'tcp.port == 80', 0)
+
+    def test_absent_2(self):
+        self.assertDFilterCountBothWays('udp.port == 53', 'or', 'tcp.port == 80', 1)
+
+    def test_absent_3(self):
+        # A comparison with an absent field is false, and so is its negation.
+        self.assertDFilterCountBothWays('udp.port != 53', 'or', 'tcp.port == 81', 0)
+
+    def test_absent_4(self):
+        self.assertDFilterCountBothWays('!(udp.port == 53)', 'and', 'tcp.port == 80', 1)
+
+    def test_absent_5(self):
+        self.assertDFilterCountBothWays('!udp', 'and', 'http.request.method in {"GET" "HEAD"}', 1)
+
+    def test_function_1(self):
+        self.assertDFilterCountBothWays('len(http.request.method) == 4', 'and', 'tcp', 1)
+
+    def test_function_2(self):
+        self.assertDFilterCountBothWays('upper(http.request.method) == "GET"', 'or', 'udp', 0)
+
+    def test_function_3(self):
+        self.assertDFilterCountBothWays('lower(http.request.method) == "head"', 'or', 'udp', 1)
+
+    def test_slice_1(self):
+        self.assertDFilterCountBothWays('ip[0:2] == 45:00', 'and', 'http.request.method[0] == "H"', 1)
+
+    def test_slice_2(self):
+        self.assertDFilterCountBothWays('ip[0:2] == 00:00', 'or', 'http.request.method[0] == "P"', 0)
+
+    def test_nested_1(self):
+        self.assertDFilterCountBothWays('(udp or http.request.method contains "EA")', 'and',
+            '!(tcp.port == 81 or len(http.request.method) == 3)', 1)
+
+    def test_nested_2(self):
+        self.assertDFilterCountBothWays('(udp and http.request.method contains "EA")', 'or',
+            '(tcp.port == 81 and len(http.request.method) == 4)', 0)
+
+class case_logical_packets(dfiltertest.DFTestCase):
+    trace_file = "dns+icmp.pcapng.gz"
+
+    def matchingFrames(self, dfilter):
+        tshark_proc = self.assertRun((config.cmd_tshark,
+            '-n',
+            '-r', os.path.join(config.capture_dir, self.trace_file),
+            '-Tfields',
+            '-e', 'frame.number',
+            '-Y', dfilter,
+        ))
+        return set(tshark_proc.stdout_str.split())
+
+    def assertSameFrames(self, dfilter1, op, dfilter2):
+        '''Check that both ways of writing the filter match the frames that
+        each operand does on its own.'''
+        frames1 = self.matchingFrames(dfilter1)
+        frames2 = self.matchingFrames(dfilter2)
+        if op == 'and':
+            expected = frames1 & frames2
+        else:
+            expected = frames1 | frames2
+        for dfilter in ('({}) {} ({})'.format(dfilter1, op, dfilter2),
+                '({}) {} ({})'.format(dfilter2, op, dfilter1)):
+            self.assertEqual(self.matchingFrames(dfilter), expected, dfilter)
+
+    def test_and_absent(self):
+        self.assertSameFrames('icmp.type == 8', 'and', 'dns')
+
+    def test_or_absent(self):
+        self.assertSameFrames('icmp.type == 8', 'or', 'dns.qry.name matches "\\\\.org$"')
+
+    def test_and_function(self):
+        self.assertSameFrames('len(dns.qry.name) > 10', 'and', 'udp.srcport == 53')
+
+    def test_or_slice(self):
+        self.assertSameFrames('ip.dst[0] == 8', 'or', 'frame.len > 100')
@@ -44,3 +44,31 @@ class case_membership(dfiltertest.DFTestCase):
         # expression should be parsed as "0.1 .. .7"
         dfilter = 'frame.time_delta in {0.1...7}'
         self.assertDFilterCount(dfilter, 0)
+
+    def test_membership_10_ip_cidr(self):
+        dfilter = 'ip.addr in { 192.168.0.0/16 10.0.0.0/24 }'
+        self.assertDFilterCount(dfilter, 1)
+
+    def test_membership_11_ip_cidr_no_match(self):
+        dfilter = 'ip.addr in { 192.168.0.0/16 10.0.1.0/24 207.46.134.95 }'
+        self.assertDFilterCount(dfilter, 0)
+
+    def test_membership_12_overlapping_ranges(self):
+        dfilter = 'tcp.srcport in { 3000..3266 3100..3200 3266 3268..4000 }'
+        self.assertDFilterCount(dfilter, 0)
+
+    def test_membership_13_adjacent_ranges(self):
+        dfilter = 'tcp.srcport in { 3000..3266 3267..3267 }'
+        self.assertDFilterCount(dfilter, 1)
+
+    def test_membership_14_or_chain(self):
+        dfilter = 'tcp.port == 1 || tcp.port == 2 || tcp.port == 3 || tcp.port == 80'
+        self.assertDFilterCount(dfilter, 1)
+
+    def test_membership_15_or_chain_no_match(self):
+        dfilter = 'tcp.dstport == 1 || 2 == tcp.dstport || tcp.dstport == 3267'
+        self.assertDFilterCount(dfilter, 0)
+
+    def test_membership_16_or_chain_mixed_fields(self):
+        dfilter = 'tcp.dstport == 1 || tcp.srcport == 3267 || tcp.dstport == 3'
+        self.assertDFilterCount(dfilter, 1)
@@ -29,3 +29,107 @@ class case_dissect_http2(subprocesstest.SubprocessTestCase):
             ),
             env=config.test_env)
         self.assertTrue(self.grepOutput('DATA'))
+
+class case_dissect_tcp(subprocesstest.SubprocessTestCase):
+    # The analysis fields checked, and their values in each frame of the
+    # connection written by util_make_tcp_pcap.py.
+    analysis_fields = (
+        'tcp.analysis.acks_frame',
+        'tcp.analysis.bytes_in_flight',
+        'tcp.analysis.duplicate_ack_num',
+        'tcp.analysis.duplicate_ack_frame',
+        'tcp.analysis.retransmission',
+        'tcp.analysis.fast_retransmission',
+        'tcp.analysis.spurious_retransmission',
+        'tcp.analysis.rto_frame',
+        'tcp.analysis.out_of_order',
+        'tcp.analysis.lost_segment',
+        'tcp.analysis.window_update',
+        'tcp.reassembled_in',
+    )
+    expected_analysis = {
+        2: { 'tcp.analysis.acks_frame': '1' },
+        3: { 'tcp.analysis.acks_frame': '2' },
+        4: { 'tcp.analysis.bytes_in_flight': '20', 'tcp.reassembled_in': '5' },
+        5: { 'tcp.analysis.bytes_in_flight': '37' },
+        6: { 'tcp.analysis.acks_frame': '4' },
+        7: { 'tcp.analysis.acks_frame': '5', 'tcp.analysis.bytes_in_flight': '100' },
+        8: { 'tcp.analysis.bytes_in_flight': '200' },
+        9: { 'tcp.analysis.bytes_in_flight': '300' },
+        10: { 'tcp.analysis.bytes_in_flight': '400' },
+        11: { 'tcp.analysis.acks_frame': '7' },
+        12: { 'tcp.analysis.duplicate_ack_num': '1', 'tcp.analysis.duplicate_ack_frame': '11' },
+        13: { 'tcp.analysis.duplicate_ack_num': '2', 'tcp.analysis.duplicate_ack_frame': '11' },
+        14: { 'tcp.analysis.bytes_in_flight': '300', 'tcp.analysis.retransmission': '1',
+            'tcp.analysis.fast_retransmission': '1' },
+        15: { 'tcp.analysis.acks_frame': '10' },
+        16: { 'tcp.analysis.bytes_in_flight': '50' },
+        17: { 'tcp.analysis.bytes_in_flight': '50', 'tcp.analysis.retransmission': '1',
+            'tcp.analysis.rto_frame': '16' },
+        18: { 'tcp.analysis.acks_frame': '16' },
+        19: { 'tcp.analysis.bytes_in_flight': '50', 'tcp.analysis.retransmission': '1',
+            'tcp.analysis.spurious_retransmission': '1' },
+        20: { 'tcp.analysis.lost_segment': '1' },
+        21: { 'tcp.analysis.out_of_order': '1' },
+        22: { 'tcp.analysis.acks_frame': '20' },
+        23: { 'tcp.analysis.window_update': '1' },
+    }
+    expected_expert = '''
+Warns (2)
+=============
+   Frequency      Group           Protocol  Summary
+           1   Sequence                TCP  Previous segment(s) not captured (common at capture start)
+           1   Sequence                TCP  This frame is a (suspected) out-of-order segment
+
+Notes (7)
+=============
+   Frequency      Group           Protocol  Summary
+           1   Sequence                TCP  Duplicate ACK (#1)
+           1   Sequence                TCP  Duplicate ACK (#2)
+           1   Sequence                TCP  This frame is a (suspected) fast retransmission
+           3   Sequence                TCP  This frame is a (suspected) retransmission
+           1   Sequence                TCP  This frame is a (suspected) spurious retransmission
+'''
+
+    def write_tcp_pcap(self):
+        import util_make_tcp_pcap
+        tcp_pcap = self.filename_from_id('tcp-analysis.pcap')
+        with open(tcp_pcap, 'wb') as tcp_fd:
+            util_make_tcp_pcap.write_pcap(tcp_fd)
+        return tcp_pcap
+
+    def check_analysis_fields(self, tcp_pcap, two_pass):
+        tshark_cmd = [config.cmd_tshark, '-n', '-r', tcp_pcap, '-T', 'fields', '-E', 'separator=;', '-e', 'frame.number']
+        if two_pass:
+            tshark_cmd.append('-2')
+        for field in self.analysis_fields:
+            tshark_cmd += ['-e', field]
+        tshark_proc = self.assertRun(tshark_cmd, env=config.test_env)
+
+        lines = tshark_proc.stdout_str.splitlines()
+        self.assertEqual(len(lines), 23, 'Wrong number of frames')
+        for line in lines:
+            values = line.split(';')
+            frame_num = int(values[0])
+            expected = self.expected_analysis.get(frame_num, {})
+            for field, value in zip(self.analysis_fields, values[1:]):
+                if field == 'tcp.reassembled_in' and not two_pass:
+                    # Not known yet when the segment is dissected.
+                    continue
+                self.assertEqual(value, expected.get(field, ''),
+                    'Frame {} {}: {!r}'.format(frame_num, field, value))
+
+    def test_tcp_analysis_fields(self):
+        '''TCP sequence analysis, when the frames are dissected in order'''
+        self.check_analysis_fields(self.write_tcp_pcap(), False)
+
+    def test_tcp_analysis_fields_two_pass(self):
+        '''TCP sequence analysis, from the results kept for each frame'''
+        self.check_analysis_fields(self.write_tcp_pcap(), True)
+
+    def test_tcp_analysis_expert(self):
+        '''TCP sequence analysis expert info'''
+        tcp_pcap = self.write_tcp_pcap()
+        tshark_proc = self.assertRun((config.cmd_tshark, '-n', '-q', '-r', tcp_pcap, '-z', 'expert,note'),
+            env=config.test_env)
+        self.assertEqual(tshark_proc.stdout_str.replace('\r\n', '\n'), self.expected_expert)
@@ -15,6 +15,7 @@ import os.path
 import subprocesstest
 import sys
 import unittest
+import util_make_tcp_pcap
 
 # XXX Currently unused. It would be nice to be able to use this below.
 time_output_args = ('-Tfields', '-e', 'frame.number', '-e', 'frame.time_epoch', '-e', 'frame.time_delta')
@@ -110,3 +111,76 @@ class case_fileformat_pcapng(subprocesstest.SubprocessTestCase):
             )
         self.assertTrue(self.diffOutput(capture_proc.stdout_str, baseline_str, 'tshark', baseline_file))
 
+def check_compressed_roundtrip(self, compression_type, magic):
+    '''Write dhcp.pcap compressed with editcap, then read it back'''
+    capture_file = os.path.join(config.capture_dir, 'dhcp.pcap')
+    testout_file = self.filename_from_id('testout.pcap')
+    editcap_proc = self.runProcess((config.cmd_editcap,
+            '--compress', compression_type,
+            capture_file, testout_file,
+        ))
+    if editcap_proc.returncode != 0 and "isn't a valid output compression type" in editcap_proc.stderr_str:
+        self.skipTest('Requires {} support.'.format(compression_type))
+    self.assertEqual(editcap_proc.returncode, 0)
+    with open(testout_file, 'rb') as testout_fd:
+        self.assertEqual(testout_fd.read(len(magic)), magic)
+    capture_proc = self.runProcess(subprocesstest.capture_command(config.cmd_tshark,
+            '-r', testout_file,
+            '-Tfields',
+            '-e', 'frame.number', '-e', 'frame.time_epoch', '-e', 'frame.time_delta',
+        ))
+    self.assertEqual(capture_proc.returncode, 0)
+    self.assertTrue(self.diffOutput(capture_proc.stdout_str, baseline_str, 'tshark', baseline_file))
+    self.checkPacketCount(4)
+
+class case_fileformat_compressed(subprocesstest.SubprocessTestCase):
+    def test_compressed_gzip(self):
+        '''Microsecond pcap direct vs gzip-compressed pcap written by editcap'''
+        check_compressed_roundtrip(self, 'gzip', b'\x1f\x8b')
+
+    def test_compressed_zstd(self):
+        '''Microsecond pcap direct vs zstd-compressed pcap written by editcap'''
+        check_compressed_roundtrip(self, 'zstd', b'\x28\xb5\x2f\xfd')
+
+    def test_compressed_lz4(self):
+        '''Microsecond pcap direct vs LZ4-compressed pcap written by editcap'''
+        check_compressed_roundtrip(self, 'lz4', b'\x04\x22\x4d\x18')
+
+def check_compressed_read_ahead(self, compression_type):
+    '''Read a compressed file of several compression frames with and
+    without --read-ahead, and compare the output'''
+    capture_file = self.filename_from_id('tcp.pcap')
+    with open(capture_file, 'wb') as capture_fd:
+        util_make_tcp_pcap.write_pcap(capture_fd, connections=1000)
+    testout_file = self.filename_from_id('testout.pcap')
+    editcap_proc = self.runProcess((config.cmd_editcap,
+            '--compress', compression_type,
+            capture_file, testout_file,
+        ))
+    if editcap_proc.returncode != 0 and "isn't a valid output compression type" in editcap_proc.stderr_str:
+        self.skipTest('Requires {} support.'.format(compression_type))
+    self.assertEqual(editcap_proc.returncode, 0)
+
+    outputs = []
+    for read_args in (('-r', capture_file), ('-r', testout_file), ('--read-ahead', '-r', testout_file)):
+        rewritten_file = self.filename_from_id('rewritten{}.pcap'.format(len(outputs)))
+        tshark_proc = self.assertRun((config.cmd_tshark, '-n') + read_args + ('-P', '-F', 'pcap', '-w', rewritten_file))
+        with open(rewritten_file, 'rb') as rewritten_fd:
+            outputs.append((tshark_proc.stdout_str, rewritten_fd.read()))
+    uncompressed, compressed, read_ahead = outputs
+    self.assertEqual(len(uncompressed[0].splitlines()), 1000 * len(util_make_tcp_pcap.connection_segments()))
+    self.assertTrue(compressed == uncompressed, 'Compressed file read differently')
+    self.assertTrue(read_ahead == uncompressed, 'Compressed file read differently with --read-ahead')
+
+class case_fileformat_read_ahead(subprocesstest.SubprocessTestCase):
+    def test_read_ahead_gzip(self):
+        '''gzip-compressed pcap read with and without --read-ahead'''
+        check_compressed_read_ahead(self, 'gzip')
+
+    def test_read_ahead_zstd(self):
+        '''zstd-compressed pcap read with and without --read-ahead'''
+        check_compressed_read_ahead(self, 'zstd')
+
+    def test_read_ahead_lz4(self):
+        '''LZ4-compressed pcap read with and without --read-ahead'''
+        check_compressed_read_ahead(self, 'lz4')
@@ -223,6 +223,19 @@ class case_mergecap_pcapng(subprocesstest.SubprocessTestCase):
         ))
         check_mergecap(self, mergecap_proc, 'pcapng', 'Per packet', 88, 11, 86)
 
+    def test_mergecap_3_pcapng_max_open_files_pcapng(self):
+        '''Merge multiple pcapng files with many interfaces to pcapng, one file open at a time'''
+        testout_file = self.filename_from_id(testout_pcapng)
+        mergecap_proc = self.runProcess((config.cmd_mergecap,
+            '-v',
+            '--max-open-files', '1',
+            '-w', testout_file,
+            many_interfaces_pcapng_1,
+            many_interfaces_pcapng_2,
+            many_interfaces_pcapng_3,
+        ))
+        check_mergecap(self, mergecap_proc, 'pcapng', 'Per packet', 88, 11, 86)
+
     def test_mergecap_3_pcapng_none_pcapng(self):
         '''Merge multiple pcapng files with many interfaces to pcapng, "none" merge mode'''
         # $MERGECAP -vI 'none' -w testout.pcap "${CAPTURE_DIR}"many_interfaces.pcapng* > testout.txt 2>&1
@@ -110,3 +110,96 @@ class case_name_resolution(subprocesstest.SubprocessTestCase):
             env=config.test_env)
         self.assertTrue(self.grepOutput('fe80::6233:4bff:fe13:c558\tCrunch.local'))
         self.assertFalse(self.grepOutput('174.137.42.65\twww.wireshark.org'))
+
+
+def maxmind_db_uat():
+    # UAT strings escape backslashes.
+    maxmind_dir = config.maxmind_dir.replace('\\', '\\x5c')
+    return 'uat:maxmind_db_paths:"{}"'.format(maxmind_dir)
+
+class case_maxmind_db(subprocesstest.SubprocessTestCase):
+    # maxmind/wireshark-test.mmdb is written by util_make_mmdb.py. The
+    # databases in the system paths are read first, so only check the
+    # fields that the test database sets.
+
+    def test_maxmind_db_in_process_ipv4(self):
+        '''GeoIP lookups in process, IPv4.'''
+        if not config.have_maxminddb:
+            self.skipTest('Requires MaxMind DB support.')
+        self.assertRun((config.cmd_tshark,
+                '-r', dns_icmp_pcapng,
+                '-o', 'nameres.maxmind_db_in_process:TRUE',
+                '-o', maxmind_db_uat(),
+                '-Tfields',
+                '-e', 'ip.src',
+                '-e', 'ip.geoip.src_country',
+                '-e', 'ip.geoip.src_asnum',
+                ),
+            env=config.test_env)
+        # 8.8.8.0/24 is nested in 8.0.0.0/8.
+        self.assertTrue(self.grepOutput('^8.8.8.8\tTest Country Eight\t64497$'))
+        self.assertTrue(self.grepOutput('^8.8.4.4\tTest Country Eight\t64496$'))
+        self.assertTrue(self.grepOutput('^174.137.42.65\tTest Country Wireshark\t'))
+
+    def test_maxmind_db_in_process_city(self):
+        '''GeoIP lookups in process, preference set after the paths.'''
+        if not config.have_maxminddb:
+            self.skipTest('Requires MaxMind DB support.')
+        self.assertRun((config.cmd_tshark,
+                '-r', dns_icmp_pcapng,
+                '-o', maxmind_db_uat(),
+                '-o', 'nameres.maxmind_db_in_process:TRUE',
+                '-Tfields',
+                '-e', 'ip.src',
+                '-e', 'ip.geoip.src_city',
+                '-e', 'ip.geoip.src_org',
+                '-e', 'ip.geoip.src_lat',
+                ),
+            env=config.test_env)
+        self.assertTrue(self.grepOutput('^8.8.8.8\tTest City Eight\tTest AS Eight Eight\t37.5'))
+        self.assertTrue(self.grepOutput('^174.137.42.65\tTest City Wireshark\t'))
+
+    def test_maxmind_db_in_process_ipv6(self):
+        '''GeoIP lookups in process, IPv6.'''
+        if not config.have_maxminddb:
+            self.skipTest('Requires MaxMind DB support.')
+        self.assertRun((config.cmd_tshark,
+                '-r', os.path.join(config.capture_dir, 'ipv6.pcap'),
+                '-o', 'nameres.maxmind_db_in_process:TRUE',
+                '-o', maxmind_db_uat(),
+                '-Tfields',
+                '-e', 'ipv6.src',
+                '-e', 'ipv6.geoip.src_country',
+                '-e', 'ipv6.geoip.src_asnum',
+                ),
+            env=config.test_env)
+        self.assertTrue(self.grepOutput('^fe80::200:86ff:fe05:80fa\tTest Country Link-Local\t64498$'))
+
+
+def check_subnets(self, capture_file, fields):
+    self.assertRun((config.cmd_tshark,
+            '-r', os.path.join(config.capture_dir, capture_file),
+            '-o', 'nameres.network_name: TRUE',
+            '-o', 'nameres.use_external_name_resolver: FALSE',
+            '-Tfields',
+            ) + fields,
+        env=config.test_env)
+
+class case_subnets(subprocesstest.SubprocessTestCase):
+    # The subnets are in subnets.personal.
+
+    def test_subnets_ipv4(self):
+        '''Nested IPv4 subnets, longest prefix wins.'''
+        check_subnets(self, 'dns+icmp.pcapng.gz', ('-e', 'ip.src_host', '-e', 'ip.dst_host'))
+        self.assertTrue(self.grepOutput(r'^subnet-192-168-43-8\.9\tsubnet-192-168-43\.1$'))
+        self.assertTrue(self.grepOutput(r'^subnet-192-168-43\.1\tsubnet-192-168-43-8\.9$'))
+        self.assertFalse(self.grepOutput('duplicate-192-168-43'))
+        # A personal hosts file entry takes precedence.
+        self.assertTrue(self.grepOutput(r'^personal-4-2-2-2\tsubnet-192-168-43-8\.9$'))
+        self.assertFalse(self.grepOutput(r'subnet-4\.'))
+
+    def test_subnets_ipv6(self):
+        '''Nested IPv6 subnets, longest prefix wins.'''
+        check_subnets(self, 'ipv6.pcap', ('-e', 'ipv6.src_host', '-e', 'ipv6.dst_host'))
+        self.assertTrue(self.grepOutput(r'^subnet-fe80-64:200:86ff:fe05:80fa\tsubnet-ff05:0:0:0:0:0:0:9999$'))
+        self.assertFalse(self.grepOutput('duplicate-fe80-64'))
@@ -10,6 +10,8 @@
 import config
 import json
 import os.path
+import shutil
+import struct
 import subprocess
 import subprocesstest
 import sys
@@ -17,6 +19,39 @@ import unittest
 
 dhcp_pcap = os.path.join(config.capture_dir, 'dhcp.pcap')
 
+# Record index layout, see wiretap/wtap_index.c.
+index_header_size = 40
+index_entry_size = 34
+
+def pcapng_block(block_type, body):
+    '''Returns a little-endian pcapng block'''
+    body += b'\0' * (-len(body) % 4)
+    total_len = len(body) + 12
+    return struct.pack('<II', block_type, total_len) + body + struct.pack('<I', total_len)
+
+def pcapng_with_late_nrb():
+    '''Returns a pcapng file with a name resolution block after the first packet'''
+    frame = b'\xff' * 6 + b'\x00\x11\x22\x33\x44\x55' + b'\x08\x00' + b'\0' * 46
+    epb = struct.pack('<IIIII', 0, 0, 0, len(frame), len(frame)) + frame
+    nrb_value = b'\xc0\x00\x02\x01' + b'late-nrb.example\0'
+    nrb = struct.pack('<HH', 1, len(nrb_value)) + nrb_value
+    nrb += b'\0' * (-len(nrb) % 4) + struct.pack('<HH', 0, 0)
+    return (pcapng_block(0x0A0D0D0A, struct.pack('<IHHq', 0x1A2B3C4D, 1, 0, -1))
+        + pcapng_block(1, struct.pack('<HHI', 1, 0, 0))
+        + pcapng_block(6, epb)
+        + pcapng_block(4, nrb)
+        + pcapng_block(6, epb))
+
+def pcap_over_ten_minutes():
+    '''Returns a pcap file whose packets span about ten minutes, more 1 ms
+    and 2 ms intervals than an I/O graph keeps'''
+    data = struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1)
+    for i in range(500):
+        ts_usec = (i * i * 2399) % 600000000 if i % 7 else i * 1200000
+        frame = b'\xff' * 6 + b'\x00\x11\x22\x33\x44\x55' + b'\x88\xb5' + b'\0' * (46 + i % 50)
+        data += struct.pack('<IIII', ts_usec // 1000000, ts_usec % 1000000, len(frame), len(frame)) + frame
+    return data
+
 class case_sharkd(subprocesstest.SubprocessTestCase):
     def test_sharkd_hello_no_pcap(self):
         '''sharkd hello message, no capture file'''
@@ -70,3 +105,119 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
                 pass
 
         self.assertTrue(has_dhcp, 'Failed to find DHCP in JSON output')
+
+    def test_sharkd_load_indexed_pcap(self):
+        '''sharkd loads frames from a record index written by capinfos'''
+        indexed_pcap = self.filename_from_id('dhcp.pcap')
+        shutil.copyfile(dhcp_pcap, indexed_pcap)
+        self.assertRun((config.cmd_capinfos, '--write-index', indexed_pcap))
+        index_file = indexed_pcap + '.wsidx'
+        self.assertTrue(os.path.isfile(index_file), 'No index file written.')
+
+        # Drop the last record from the index, so that we can tell that
+        # sharkd listed the frames from it rather than reading the file.
+        with open(index_file, 'rb') as index_fd:
+            index_data = index_fd.read()
+        (count,) = struct.unpack_from('<I', index_data, index_header_size - 4)
+        self.assertEqual(count, 4, 'Wrong number of records in index')
+        index_data = index_data[:index_header_size - 4] + struct.pack('<I', count - 1) \
+            + index_data[index_header_size:index_header_size + (count - 1) * index_entry_size]
+        with open(index_file, 'wb') as index_fd:
+            index_fd.write(index_data)
+
+        sharkd_proc = self.startProcess((config.cmd_sharkd, '-'),
+            stdin=subprocess.PIPE
+        )
+
+        sharkd_commands = '{"req":"load","file":' + json.JSONEncoder().encode(indexed_pcap) + '}\n'
+        sharkd_commands += '{"req":"frames"}\n'
+        if sys.version_info[0] >= 3:
+            sharkd_commands = sharkd_commands.encode('UTF-8')
+
+        sharkd_proc.stdin.write(sharkd_commands)
+        self.waitProcess(sharkd_proc)
+
+        frames = None
+        for line in sharkd_proc.stdout_str.splitlines():
+            line = line.strip()
+            if not line: continue
+            try:
+                jdata = json.loads(line)
+            except:
+                self.fail('Invalid JSON for "{}"'.format(line))
+            if isinstance(jdata, list):
+                frames = jdata
+
+        self.assertTrue(frames is not None, 'No frames in JSON output')
+        self.assertEqual(len(frames), 3, 'Frames weren\'t loaded from the index')
+        self.assertTrue('DHCP' in frames[0]['c'], 'Failed to find DHCP in JSON output')
+
+    def test_sharkd_no_index_with_late_nrb(self):
+        '''No record index is written for a pcapng file with an NRB after the first packet'''
+        nrb_pcapng = self.filename_from_id('late-nrb.pcapng')
+        with open(nrb_pcapng, 'wb') as nrb_fd:
+            nrb_fd.write(pcapng_with_late_nrb())
+        self.assertRun((config.cmd_capinfos, '-c', '--write-index', nrb_pcapng))
+        self.assertTrue(self.grepOutput('Number of packets:\s+2'), 'Test file wasn\'t read.')
+        self.assertFalse(os.path.isfile(nrb_pcapng + '.wsidx'), 'Index written despite a late NRB.')
+
+    def test_sharkd_iograph_intervals(self):
+        '''I/O graphs for other intervals from the cache match those tapped with them'''
+        long_pcap = self.filename_from_id('ten-minutes.pcap')
+        with open(long_pcap, 'wb') as long_fd:
+            long_fd.write(pcap_over_ten_minutes())
+
+        graphs = (
+            ('packets', ''),
+            ('bytes', 'eth'),
+            ('max:frame.len', 'frame.len'),
+            ('avg:frame.len', 'frame.len'),
+        )
+        def iograph_req(interval, direct):
+            req = {'req': 'iograph', 'interval': interval}
+            for i, (graph, graph_filter) in enumerate(graphs):
+                req['graph{}'.format(i)] = graph
+                # A filter matching the same packets, which isn't in the
+                # cache for any other interval.
+                if direct:
+                    direct_filter = 'frame.number < {}'.format(1000000 + interval)
+                    graph_filter = graph_filter + ' && ' + direct_filter if graph_filter else direct_filter
+                if graph_filter:
+                    req['filter{}'.format(i)] = graph_filter
+            return json.dumps(req) + '\n'
+
+        # Tapped at 1 s, which drops the 1 ms level, then merged from
+        # the 1 s, 10 s and 1 min levels, then retapped at 2 ms, which is
+        # kept even though it's truncated.
+        intervals = (1000, 3000, 20000, 120000, 2)
+        sharkd_commands = '{"req":"load","file":' + json.JSONEncoder().encode(long_pcap) + '}\n'
+        for interval in intervals:
+            sharkd_commands += iograph_req(interval, False)
+            sharkd_commands += iograph_req(interval, True)
+        if sys.version_info[0] >= 3:
+            sharkd_commands = sharkd_commands.encode('UTF-8')
+
+        sharkd_proc = self.startProcess((config.cmd_sharkd, '-'),
+            stdin=subprocess.PIPE
+        )
+        sharkd_proc.stdin.write(sharkd_commands)
+        self.waitProcess(sharkd_proc)
+
+        results = []
+        for line in sharkd_proc.stdout_str.splitlines():
+            line = line.strip()
+            if not line: continue
+            try:
+                jdata = json.loads(line)
+            except:
+                self.fail('Invalid JSON for "{}"'.format(line))
+            if 'iograph' in jdata:
+                results.append(jdata['iograph'])
+
+        self.assertEqual(len(results), len(intervals) * 2, 'Wrong number of I/O graph results')
+        for n, interval in enumerate(intervals):
+            cached, direct = results[n * 2], results[n * 2 + 1]
+            for graph_n, graph in enumerate(graphs):
+                self.assertTrue('items' in direct[graph_n], 'No items for {} at {} ms'.format(graph[0], interval))
+                self.assertTrue(len(direct[graph_n]['items']) > 0, 'Empty graph for {} at {} ms'.format(graph[0], interval))
+                self.assertEqual(cached[graph_n], direct[graph_n], 'Different {} at {} ms'.format(graph[0], interval))
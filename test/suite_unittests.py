@@ -20,6 +20,10 @@ import subprocesstest
 import unittest
 
 class case_unittests(subprocesstest.SubprocessTestCase):
+    def test_unit_conversation_test(self):
+        '''conversation_test'''
+        self.assertRun(os.path.join(config.program_path, 'conversation_test'))
+
     def test_unit_exntest(self):
         '''exntest'''
         self.assertRun(os.path.join(config.program_path, 'exntest'))
@@ -36,6 +40,10 @@ class case_unittests(subprocesstest.SubprocessTestCase):
         '''tvbtest'''
         self.assertRun(os.path.join(config.program_path, 'tvbtest'))
 
+    def test_unit_value_string_test(self):
+        '''value_string_test'''
+        self.assertRun(os.path.join(config.program_path, 'value_string_test'))
+
     def test_unit_wmem_test(self):
         '''wmem_test'''
         self.assertRun((os.path.join(config.program_path, 'wmem_test'),
@@ -48,6 +56,10 @@ class case_unittests(subprocesstest.SubprocessTestCase):
             '--verbose'
         ))
 
+    def test_unit_ws_memmem_test(self):
+        '''ws_memmem_test'''
+        self.assertRun(os.path.join(config.program_path, 'ws_memmem_test'))
+
     def test_unit_fieldcount(self):
         '''fieldcount'''
         self.assertRun((config.cmd_tshark, '-G', 'fieldcount'))
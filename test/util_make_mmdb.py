@@ -0,0 +1,181 @@
+#!/usr/bin/env python
+#
+# Wireshark tests
+# By Gerald Combs <gerald@wireshark.org>
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+'''Write a small MaxMind DB with made-up GeoIP data for the test captures.
+
+The file is committed as maxmind/wireshark-test.mmdb, run this script to
+regenerate it after changing the networks below. The format is described
+at https://maxmind.github.io/MaxMind-DB/.'''
+
+import argparse
+import ipaddress
+import os.path
+import struct
+import sys
+
+# Networks and their data, matching addresses in dns+icmp.pcapng.gz and
+# ipv6.pcap. 8.8.8.0/24 is nested in 8.0.0.0/8 to test that the longest
+# prefix wins.
+NETWORKS = (
+    ('8.0.0.0/8', {
+        'country': {'iso_code': 'US', 'names': {'en': 'Test Country Eight'}},
+        'autonomous_system_number': 64496,
+        'autonomous_system_organization': 'Test AS Eight',
+    }),
+    ('8.8.8.0/24', {
+        'city': {'names': {'en': 'Test City Eight'}},
+        'country': {'iso_code': 'US', 'names': {'en': 'Test Country Eight'}},
+        'autonomous_system_number': 64497,
+        'autonomous_system_organization': 'Test AS Eight Eight',
+        'location': {'latitude': 37.5, 'longitude': -122.25},
+    }),
+    ('174.137.42.0/24', {
+        'city': {'names': {'en': 'Test City Wireshark'}},
+        'country': {'iso_code': 'CA', 'names': {'en': 'Test Country Wireshark'}},
+    }),
+    ('fe80::/10', {
+        'country': {'iso_code': 'ZZ', 'names': {'en': 'Test Country Link-Local'}},
+        'autonomous_system_number': 64498,
+    }),
+)
+
+DATA_SEPARATOR = b'\0' * 16
+METADATA_MARKER = b'\xab\xcd\xefMaxMind.com'
+
+def encode_size(type_num, size):
+    if type_num > 7:
+        ctrl, ext = 0, struct.pack('B', type_num - 7)
+    else:
+        ctrl, ext = type_num << 5, b''
+    if size < 29:
+        return struct.pack('B', ctrl | size) + ext
+    if size < 285:
+        return struct.pack('B', ctrl | 29) + ext + struct.pack('B', size - 29)
+    if size < 65821:
+        return struct.pack('B', ctrl | 30) + ext + struct.pack('>H', size - 285)
+    return struct.pack('B', ctrl | 31) + ext + struct.pack('>I', size - 65821)[1:]
+
+def encode_uint(type_num, value):
+    data = b''
+    while value:
+        data = struct.pack('B', value & 0xff) + data
+        value >>= 8
+    return encode_size(type_num, len(data)) + data
+
+class uint16(int):
+    pass
+
+class uint64(int):
+    pass
+
+def encode(value):
+    if isinstance(value, dict):
+        data = encode_size(7, len(value))
+        for key in sorted(value):
+            data += encode(key) + encode(value[key])
+        return data
+    if isinstance(value, (list, tuple)):
+        return encode_size(11, len(value)) + b''.join(encode(v) for v in value)
+    if isinstance(value, float):
+        return encode_size(3, 8) + struct.pack('>d', value)
+    if isinstance(value, uint16):
+        return encode_uint(5, value)
+    if isinstance(value, uint64):
+        return encode_uint(9, value)
+    if isinstance(value, int):
+        return encode_uint(6, value)
+    data = value.encode('utf-8')
+    return encode_size(2, len(data)) + data
+
+class Node(object):
+    def __init__(self):
+        self.records = [None, None]
+
+def build_tree(networks):
+    '''Returns the root of a binary tree of Nodes. Records are a Node, an
+    offset into the data section or None.'''
+    root = Node()
+    # Insert shorter prefixes first, longer ones split their records.
+    for net, offset in sorted(networks, key=lambda n: n[0].prefixlen):
+        # IPv4 networks are in ::/96.
+        bits = int(net.network_address)
+        prefixlen = net.prefixlen + (96 if net.version == 4 else 0)
+        node = root
+        for depth in range(prefixlen - 1):
+            bit = (bits >> (127 - depth)) & 1
+            record = node.records[bit]
+            if not isinstance(record, Node):
+                child = Node()
+                child.records = [record, record]
+                node.records[bit] = child
+            node = node.records[bit]
+        node.records[(bits >> (128 - prefixlen)) & 1] = offset
+    return root
+
+def write_mmdb(out_file, record_size):
+    data = b''
+    networks = []
+    for net, value in NETWORKS:
+        networks.append((ipaddress.ip_network(net), len(data)))
+        data += encode(value)
+
+    # Number the nodes breadth first, the root is node 0.
+    nodes = [build_tree(networks)]
+    index = {id(nodes[0]): 0}
+    for node in nodes:
+        for record in node.records:
+            if isinstance(record, Node):
+                index[id(record)] = len(nodes)
+                nodes.append(record)
+    node_count = len(nodes)
+
+    def record_value(record):
+        if isinstance(record, Node):
+            return index[id(record)]
+        if record is None:
+            return node_count
+        return node_count + len(DATA_SEPARATOR) + record
+
+    tree = b''
+    for node in nodes:
+        left, right = (record_value(r) for r in node.records)
+        if record_size == 24:
+            tree += struct.pack('>I', left)[1:] + struct.pack('>I', right)[1:]
+        elif record_size == 28:
+            tree += struct.pack('>I', left)[1:] + struct.pack('B', (left >> 20 & 0xf0) | (right >> 24 & 0x0f)) + struct.pack('>I', right)[1:]
+        else:
+            tree += struct.pack('>II', left, right)
+
+    metadata = {
+        'binary_format_major_version': uint16(2),
+        'binary_format_minor_version': uint16(0),
+        'build_epoch': uint64(1546300800),
+        'database_type': 'Wireshark-Test',
+        'description': {'en': 'Wireshark test database, the data is made up'},
+        'ip_version': uint16(6),
+        'languages': ['en'],
+        'node_count': node_count,
+        'record_size': uint16(record_size),
+    }
+
+    out_file.write(tree + DATA_SEPARATOR + data + METADATA_MARKER + encode(metadata))
+
+def main():
+    parser = argparse.ArgumentParser(description='Write a MaxMind DB for the tests')
+    parser.add_argument('-r', '--record-size', type=int, choices=(24, 28, 32), default=28,
+        help='search tree record size in bits (default 28)')
+    parser.add_argument('out_file', nargs='?',
+        default=os.path.join(os.path.dirname(__file__), 'maxmind', 'wireshark-test.mmdb'),
+        help='output file (default maxmind/wireshark-test.mmdb)')
+    args = parser.parse_args()
+
+    with open(args.out_file, 'wb') as out_file:
+        write_mmdb(out_file, args.record_size)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,148 @@
+#!/usr/bin/env python
+#
+# Wireshark tests
+# By Gerald Combs <gerald@wireshark.org>
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+'''Write a pcap file of TCP connections with retransmissions, duplicate
+ACKs and a request split across two segments, for the TCP sequence
+analysis tests, and optionally time TShark reading it.
+
+suite_dissection checks the analysis of a single connection. With many
+connections the file is a benchmark of the analysis, for example:
+
+    util_make_tcp_pcap.py -c 20000 --tshark run/tshark tcp-analysis.pcap'''
+
+import argparse
+import os.path
+import struct
+import subprocess
+import sys
+import time
+
+CLIENT_ISN = 1000
+SERVER_ISN = 5000
+
+TH_SYN = 0x02
+TH_PSH = 0x08
+TH_ACK = 0x10
+
+REQUEST = b'GET / HTTP/1.1\r\nHost: example.com\r\n\r\n'
+# The first segment of the request ends in the middle of the headers.
+REQUEST_SPLIT = 20
+
+# The segments of a connection, as (ms, from client, relative seq,
+# relative ack, flags, window, payload). The expected analysis of each
+# frame is in suite_dissection.
+def connection_segments():
+    c_data = len(REQUEST) + 1
+    data = b'\x00' * 100
+    return (
+        (0, True, 0, 0, TH_SYN, 65535, b''),
+        (10, False, 0, 1, TH_SYN | TH_ACK, 65535, b''),
+        (20, True, 1, 1, TH_ACK, 65535, b''),
+        # The request, in two segments
+        (30, True, 1, 1, TH_PSH | TH_ACK, 65535, REQUEST[:REQUEST_SPLIT]),
+        (31, True, 1 + REQUEST_SPLIT, 1, TH_PSH | TH_ACK, 65535, REQUEST[REQUEST_SPLIT:]),
+        (40, False, 1, 1 + REQUEST_SPLIT, TH_ACK, 65535, b''),
+        # Four segments, the second of which doesn't arrive
+        (50, False, 1, c_data, TH_PSH | TH_ACK, 65535, data),
+        (51, False, 101, c_data, TH_ACK, 65535, data),
+        (52, False, 201, c_data, TH_ACK, 65535, data),
+        (53, False, 301, c_data, TH_ACK, 65535, data),
+        # Two duplicate ACKs and a fast retransmission
+        (60, True, c_data, 101, TH_ACK, 65535, b''),
+        (61, True, c_data, 101, TH_ACK, 65535, b''),
+        (62, True, c_data, 101, TH_ACK, 65535, b''),
+        (65, False, 101, c_data, TH_ACK, 65535, data),
+        (70, True, c_data, 401, TH_ACK, 65535, b''),
+        # A retransmission after a timeout, and a spurious one
+        (80, False, 401, c_data, TH_PSH | TH_ACK, 65535, data[:50]),
+        (400, False, 401, c_data, TH_PSH | TH_ACK, 65535, data[:50]),
+        (410, True, c_data, 451, TH_ACK, 65535, b''),
+        (420, False, 401, c_data, TH_PSH | TH_ACK, 65535, data[:50]),
+        # A segment that isn't captured, and arrives out of order
+        (430, False, 501, c_data, TH_PSH | TH_ACK, 65535, data[:50]),
+        (431, False, 451, c_data, TH_PSH | TH_ACK, 65535, data[:50]),
+        (440, True, c_data, 551, TH_ACK, 65535, b''),
+        # A window update
+        (450, True, c_data, 551, TH_ACK, 32768, b''),
+    )
+
+def checksum(data):
+    if len(data) % 2:
+        data += b'\0'
+    total = sum(struct.unpack('!{}H'.format(len(data) // 2), data))
+    while total > 0xffff:
+        total = (total & 0xffff) + (total >> 16)
+    return ~total & 0xffff
+
+def tcp_frame(from_client, src, dst, sport, dport, seq, ack, flags, window, payload):
+    tcp_header = struct.pack('!HHIIBBHHH', sport, dport, seq, ack, 5 << 4, flags, window, 0, 0)
+    pseudo_header = src + dst + struct.pack('!BBH', 0, 6, len(tcp_header) + len(payload))
+    tcp_sum = checksum(pseudo_header + tcp_header + payload)
+    tcp_header = tcp_header[:16] + struct.pack('!H', tcp_sum) + tcp_header[18:]
+
+    ip_header = struct.pack('!BBHHHBBH4s4s', 0x45, 0, 20 + len(tcp_header) + len(payload),
+        0, 0x4000, 64, 6, 0, src, dst)
+    ip_header = ip_header[:10] + struct.pack('!H', checksum(ip_header)) + ip_header[12:]
+
+    client_mac = b'\x00\x00\x5e\x00\x53\x01'
+    server_mac = b'\x00\x00\x5e\x00\x53\x02'
+    if from_client:
+        eth_header = server_mac + client_mac + b'\x08\x00'
+    else:
+        eth_header = client_mac + server_mac + b'\x08\x00'
+    return eth_header + ip_header + tcp_header + payload
+
+def write_pcap(out_file, connections=1):
+    '''Write connections connections, one after the other, to out_file.'''
+    server = struct.pack('!I', 0xc0000201) # 192.0.2.1
+    segments = connection_segments()
+    base_secs = 1500000000
+
+    out_file.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+    for conn in range(connections):
+        # Each from another address, so that ports aren't reused.
+        client = struct.pack('!I', 0x0a000001 + conn) # 10.0.0.1 on
+        cport = 40000
+        start_ms = conn * 500
+        for (ms, from_client, seq, ack, flags, window, payload) in segments:
+            if from_client:
+                frame = tcp_frame(True, client, server, cport, 80,
+                    CLIENT_ISN + seq, SERVER_ISN + ack if flags & TH_ACK else 0,
+                    flags, window, payload)
+            else:
+                frame = tcp_frame(False, server, client, 80, cport,
+                    SERVER_ISN + seq, CLIENT_ISN + ack, flags, window, payload)
+            ts_ms = start_ms + ms
+            out_file.write(struct.pack('<IIII', base_secs + ts_ms // 1000, (ts_ms % 1000) * 1000,
+                len(frame), len(frame)))
+            out_file.write(frame)
+
+def main():
+    parser = argparse.ArgumentParser(description='Write a pcap file of TCP connections for the TCP analysis tests')
+    parser.add_argument('-c', '--connections', type=int, default=1,
+        help='number of connections (default 1)')
+    parser.add_argument('--tshark',
+        help='time TShark running the expert info tap on the file')
+    parser.add_argument('--runs', type=int, default=3,
+        help='number of timed runs (default 3)')
+    parser.add_argument('out_file', help='output file')
+    args = parser.parse_args()
+
+    with open(args.out_file, 'wb') as out_file:
+        write_pcap(out_file, args.connections)
+    if not args.tshark:
+        return 0
+
+    for run in range(args.runs):
+        start = time.time()
+        subprocess.check_call((args.tshark, '-n', '-q', '-r', args.out_file, '-z', 'expert,note'),
+            stdout=open(os.devnull, 'w'))
+        print('Run {}: {:.3f} s'.format(run + 1, time.time() - start))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+# Generate a binary index from a TLS key log file (SSLKEYLOGFILE) that the
+# TLS and DTLS dissectors can use in place of the key log file. The index is
+# looked up on demand rather than loaded, which keeps startup time independent
+# of the number of secrets.
+#
+# Only secrets that are keyed by the Client Random are indexed. Lines in other
+# formats (RSA, RSA Session-ID) are skipped.
+#
+#   python tools/make-tls-keylog-index.py keylog.txt keylog.idx
+#
+# The format is described in epan/dissectors/packet-ssl-utils.c.
+#
+# Wireshark - Network traffic analyzer
+# By Gerald Combs <gerald@wireshark.org>
+# Copyright 1998 Gerald Combs
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import argparse
+import binascii
+import struct
+import sys
+
+MAGIC = b'\x89WSKLIX\n'
+VERSION = 1
+HEADER_FORMAT = '>8sII'
+ENTRY_FORMAT = '>32sBBHQ'
+
+TYPES = {
+    'CLIENT_RANDOM': 1,
+    'PMS_CLIENT_RANDOM': 2,
+    'CLIENT_EARLY_TRAFFIC_SECRET': 3,
+    'CLIENT_HANDSHAKE_TRAFFIC_SECRET': 4,
+    'SERVER_HANDSHAKE_TRAFFIC_SECRET': 5,
+    'CLIENT_TRAFFIC_SECRET_0': 6,
+    'SERVER_TRAFFIC_SECRET_0': 7,
+    'EARLY_EXPORTER_SECRET': 8,
+    'EXPORTER_SECRET': 9,
+}
+
+def parse_keylog(f):
+    '''Returns a dict from (client_random, type) to secret. Later lines
+    override earlier ones, as when the dissector loads the key log.'''
+    secrets = {}
+    skipped = 0
+    for line in f:
+        fields = line.split()
+        if len(fields) != 3 or fields[0] not in TYPES:
+            skipped += 1
+            continue
+        try:
+            client_random = binascii.unhexlify(fields[1])
+            secret = binascii.unhexlify(fields[2])
+        except (TypeError, ValueError):
+            skipped += 1
+            continue
+        if len(client_random) != 32 or not secret or len(secret) > 0xffff:
+            skipped += 1
+            continue
+        secrets[(client_random, TYPES[fields[0]])] = secret
+    return secrets, skipped
+
+def write_index(f, secrets):
+    keys = sorted(secrets)
+    offset = struct.calcsize(HEADER_FORMAT) + len(keys) * struct.calcsize(ENTRY_FORMAT)
+    f.write(struct.pack(HEADER_FORMAT, MAGIC, VERSION, len(keys)))
+    for key in keys:
+        secret = secrets[key]
+        f.write(struct.pack(ENTRY_FORMAT, key[0], key[1], 0, len(secret), offset))
+        offset += len(secret)
+    for key in keys:
+        f.write(secrets[key])
+
+def main():
+    parser = argparse.ArgumentParser(description='Create a TLS key log index')
+    parser.add_argument('keylog', help='key log file (SSLKEYLOGFILE format)')
+    parser.add_argument('index', help='index file to write')
+    args = parser.parse_args()
+
+    with open(args.keylog, 'r') as f:
+        secrets, skipped = parse_keylog(f)
+    with open(args.index, 'wb') as f:
+        write_index(f, secrets)
+    sys.stderr.write('Indexed %d secrets, skipped %d lines\n' % (len(secrets), skipped))
+
+if __name__ == '__main__':
+    main()
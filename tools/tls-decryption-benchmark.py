@@ -0,0 +1,94 @@
+#!/usr/bin/env python
+# Time TLS and DTLS decryption with tshark over the captures in test/captures.
+#
+# Each capture is read with and without its keys, and the fastest of several
+# runs of each is reported; the difference is the time spent on deriving keys
+# and decrypting records. The test captures are small, so use a number of
+# repeats that makes the difference stand out from tshark's start-up time.
+#
+#   python tools/tls-decryption-benchmark.py -b build/run -n 20
+#
+# Wireshark - Network traffic analyzer
+# By Gerald Combs <gerald@wireshark.org>
+# Copyright 1998 Gerald Combs
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import argparse
+import os
+import subprocess
+import sys
+import time
+
+this_dir = os.path.dirname(os.path.abspath(__file__))
+capture_dir = os.path.join(this_dir, '..', 'test', 'captures')
+key_dir = os.path.join(this_dir, '..', 'test', 'keys')
+
+PSK = 'ca19e028a8a372ad2d325f950fcaceed'
+
+# Capture file and the tshark options that decrypt it, as in
+# test/suite_decryption.py.
+CAPTURES = (
+    ('rsasnakeoil2.pcap',
+        ('-o', 'ssl.keys_list:0.0.0.0,443,http,' + os.path.join(key_dir, 'rsasnakeoil2.key'))),
+    ('tls-renegotiation.pcap',
+        ('-o', 'ssl.keys_list:0.0.0.0,4433,http,' + os.path.join(key_dir, 'rsasnakeoil2.key'))),
+    ('dhe1.pcapng.gz',
+        ('-o', 'ssl.keylog_file:' + os.path.join(key_dir, 'dhe1_keylog.dat'),
+         '-o', 'http.ssl.port:443')),
+    ('http2-data-reassembly.pcap',
+        ('-o', 'ssl.keylog_file:' + os.path.join(key_dir, 'http2-data-reassembly.keys'),
+         '-d', 'tcp.port==8443,ssl')),
+    ('tls12-aes128ccm.pcap', ('-o', 'ssl.psk:' + PSK)),
+    ('tls12-aes256gcm.pcap', ('-o', 'ssl.psk:' + PSK)),
+    ('tls12-chacha20poly1305.pcap',
+        ('-o', 'ssl.keylog_file:' + os.path.join(key_dir, 'tls12-chacha20poly1305.keys'))),
+    ('tls13-20-chacha20poly1305.pcap',
+        ('-o', 'ssl.keylog_file:' + os.path.join(key_dir, 'tls13-20-chacha20poly1305.keys'))),
+    ('dtls12-aes128ccm8.pcap', ('-o', 'dtls.psk:' + PSK)),
+    ('udt-dtls.pcapng.gz',
+        ('-o', 'dtls.keys_list:0.0.0.0,0,data,' + os.path.join(key_dir, 'udt-dtls.key'))),
+)
+
+def run_tshark(tshark, capture, options, repeat):
+    '''Returns the fastest of repeat runs of tshark, in seconds.'''
+    # -V makes the decrypted records get dissected, as they would be shown.
+    args = [tshark, '-n', '-V', '-r', os.path.join(capture_dir, capture)] + list(options)
+    best = None
+    with open(os.devnull, 'w') as devnull:
+        for _ in range(repeat):
+            start = time.time()
+            subprocess.check_call(args, stdout=devnull, stderr=devnull)
+            elapsed = time.time() - start
+            if best is None or elapsed < best:
+                best = elapsed
+    return best
+
+def main():
+    parser = argparse.ArgumentParser(description='Time TLS decryption over the test captures')
+    parser.add_argument('-b', '--bin-dir', default='.', help='directory containing tshark')
+    parser.add_argument('-n', '--repeat', type=int, default=10, help='runs per capture (default 10)')
+    args = parser.parse_args()
+
+    tshark = os.path.join(args.bin_dir, 'tshark')
+    if sys.platform.startswith('win32'):
+        tshark += '.exe'
+    if not os.path.isfile(tshark):
+        sys.stderr.write('%s not found\n' % tshark)
+        return 1
+
+    sys.stdout.write('%-34s %10s %10s %10s\n' % ('capture', 'keys (ms)', 'none (ms)', 'diff (ms)'))
+    total_keys = total_none = 0.0
+    for capture, options in CAPTURES:
+        with_keys = run_tshark(tshark, capture, options, args.repeat)
+        without_keys = run_tshark(tshark, capture, (), args.repeat)
+        total_keys += with_keys
+        total_none += without_keys
+        sys.stdout.write('%-34s %10.1f %10.1f %10.1f\n' % (capture,
+            with_keys * 1000, without_keys * 1000, (with_keys - without_keys) * 1000))
+    sys.stdout.write('%-34s %10.1f %10.1f %10.1f\n' % ('total',
+        total_keys * 1000, total_none * 1000, (total_keys - total_none) * 1000))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -145,6 +145,8 @@
 #ifdef HAVE_JSONGLIB
 #define LONGOPT_ELASTIC_MAPPING_FILTER (65536+1002)
 #endif
+#define LONGOPT_READ_AHEAD (65536+1003)
+#define LONGOPT_TAP_TIMING (65536+1004)
 
 #if 0
 #define tshark_debug(...) g_warning(__VA_ARGS__)
@@ -160,6 +162,8 @@ static frame_data prev_dis_frame;
 static frame_data prev_cap_frame;
 
 static gboolean perform_two_pass_analysis;
+static gboolean read_ahead = FALSE;
+static gboolean print_tap_timing = FALSE;
 static guint32 epan_auto_reset_count = 0;
 static gboolean epan_auto_reset = FALSE;
 
@@ -441,6 +445,10 @@ print_usage(FILE *output)
   fprintf(output, "  --no-duplicate-keys      If -T json is specified, merge duplicate keys in an object\n");
   fprintf(output, "                           into a single key with as value a json array containing all\n");
   fprintf(output, "                           values\n");
+  fprintf(output, "  --read-ahead             read and decode records from the input file on a\n");
+  fprintf(output, "                           separate thread while dissecting\n");
+  fprintf(output, "  --tap-timing             print the time spent in each tap listener and its\n");
+  fprintf(output, "                           filter to stderr when done\n");
 #ifdef HAVE_JSONGLIB
   fprintf(output, "  --elastic-mapping-filter <protocols> If -G elastic-mapping is specified, put only the\n");
   fprintf(output, "                           specified protocols within the mapping file\n");
@@ -542,6 +550,26 @@ print_current_user(void) {
   }
 }
 
+static void
+print_tap_listener_timing(void)
+{
+  GArray *timings = tap_listeners_get_timing();
+  guint i;
+
+  fprintf(stderr, "Tap listener timing (packets, microseconds; filter evaluations, microseconds):\n");
+  for (i = 0; i < timings->len; i++) {
+    tap_listener_timing_t *timing = &g_array_index(timings, tap_listener_timing_t, i);
+
+    fprintf(stderr, "  %-20s %10" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT,
+            timing->tapname ? timing->tapname : "?", timing->packets, timing->packet_us);
+    if (timing->fstring)
+      fprintf(stderr, "; %10" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT " \"%s\"",
+              timing->filter_evals, timing->filter_us, timing->fstring);
+    fprintf(stderr, "\n");
+  }
+  g_array_free(timings, TRUE);
+}
+
 static void
 get_tshark_compiled_version_info(GString *str)
 {
@@ -685,6 +713,8 @@ main(int argc, char *argv[])
     {"export-objects", required_argument, NULL, LONGOPT_EXPORT_OBJECTS},
     {"color", no_argument, NULL, LONGOPT_COLOR},
     {"no-duplicate-keys", no_argument, NULL, LONGOPT_NO_DUPLICATE_KEYS},
+    {"read-ahead", no_argument, NULL, LONGOPT_READ_AHEAD},
+    {"tap-timing", no_argument, NULL, LONGOPT_TAP_TIMING},
 #ifdef HAVE_JSONGLIB
     {"elastic-mapping-filter", required_argument, NULL, LONGOPT_ELASTIC_MAPPING_FILTER},
 #endif
@@ -1468,6 +1498,13 @@ main(int argc, char *argv[])
       no_duplicate_keys = TRUE;
       node_children_grouper = proto_node_group_children_by_json_key;
       break;
+    case LONGOPT_READ_AHEAD:
+      read_ahead = TRUE;
+      break;
+    case LONGOPT_TAP_TIMING:
+      print_tap_timing = TRUE;
+      tap_listeners_set_timing(TRUE);
+      break;
     default:
     case '?':        /* Bad flag - print usage message */
       switch(optopt) {
@@ -2229,6 +2266,8 @@ main(int argc, char *argv[])
   }
 
   draw_tap_listeners(TRUE);
+  if (print_tap_timing)
+    print_tap_listener_timing();
   /* Memory cleanup */
   reset_tap_listeners();
   funnel_dump_all_text_windows();
@@ -2360,6 +2399,412 @@ pipe_input_set_handler(gint source, gpointer user_data, ws_process_id *child_pro
 #endif
 }
 
+/*
+ * Read-ahead support (--read-ahead).
+ *
+ * Dissection has to stay on the main thread: dissectors keep
+ * conversation, reassembly and file-scope state that isn't safe to
+ * share between threads.  What can run concurrently is everything
+ * wiretap does to produce a record - I/O, decompression and parsing
+ * of the file format - so a reader thread owns the wtap while it's
+ * running and hands copies of the records to the main thread through
+ * a bounded queue.  Records are dissected in the order they were read,
+ * so the output is the same as without read-ahead.
+ *
+ * Anything that the main thread would otherwise fetch from the wtap
+ * while the reader thread is using it (interface descriptions and
+ * name resolution records) is passed through the same queue, ahead of
+ * the first record that needs it.
+ */
+#define READ_AHEAD_QUEUE_DEPTH  256
+
+typedef enum {
+  READ_AHEAD_RECORD,    /* a record read from the file */
+  READ_AHEAD_IDB,       /* a new interface description */
+  READ_AHEAD_IPV4_NAME, /* an IPv4 name resolution entry */
+  READ_AHEAD_IPV6_NAME, /* an IPv6 name resolution entry */
+  READ_AHEAD_END        /* end of file, or a read error */
+} read_ahead_item_type_e;
+
+typedef struct {
+  read_ahead_item_type_e type;
+  /* READ_AHEAD_RECORD */
+  wtap_rec      rec;
+  Buffer        buf;
+  gint64        data_offset;
+  /* READ_AHEAD_IDB */
+  wtap_block_t  idb;
+  /* READ_AHEAD_IPV4_NAME and READ_AHEAD_IPV6_NAME */
+  guint         ipv4_addr;
+  ws_in6_addr   ipv6_addr;
+  gchar        *name;
+  /* READ_AHEAD_END */
+  int           err;
+  gchar        *err_info;
+} read_ahead_item_t;
+
+typedef struct {
+  wtap               *wth;
+  GThread            *thread;
+  GAsyncQueue        *free_items;     /* record items available to the reader */
+  GAsyncQueue        *read_items;     /* items waiting to be dissected */
+  read_ahead_item_t  *items;          /* READ_AHEAD_QUEUE_DEPTH record items */
+  read_ahead_item_t  *current;        /* item being dissected */
+  gint                stop;           /* set by the main thread to stop the reader */
+  gboolean            done;           /* TRUE once READ_AHEAD_END has been seen */
+  guint               idbs_sent;      /* interface descriptions passed on so far */
+  GPtrArray          *idbs;           /* interface descriptions seen by the main thread */
+} read_ahead_t;
+
+static read_ahead_t *cur_read_ahead = NULL;
+
+static void
+read_ahead_queue_name(read_ahead_item_type_e type, guint ipv4_addr,
+                      const ws_in6_addr *ipv6_addr, const gchar *name)
+{
+  read_ahead_item_t *item = g_new0(read_ahead_item_t, 1);
+
+  item->type = type;
+  item->ipv4_addr = ipv4_addr;
+  if (ipv6_addr)
+    item->ipv6_addr = *ipv6_addr;
+  item->name = g_strdup(name);
+  g_async_queue_push(cur_read_ahead->read_items, item);
+}
+
+/* Called on the reader thread, from within wtap_read(). */
+static void
+read_ahead_new_ipv4(const guint addr, const gchar *name)
+{
+  read_ahead_queue_name(READ_AHEAD_IPV4_NAME, addr, NULL, name);
+}
+
+/* Called on the reader thread, from within wtap_read(). */
+static void
+read_ahead_new_ipv6(const void *addrp, const gchar *name)
+{
+  read_ahead_queue_name(READ_AHEAD_IPV6_NAME, 0, (const ws_in6_addr *)addrp, name);
+}
+
+/*
+ * Copy a record out of the wtap, so that the reader thread can
+ * carry on reading into the wtap's own buffers.
+ */
+static void
+read_ahead_copy_rec(read_ahead_item_t *item, const wtap_rec *rec, const guint8 *pd)
+{
+  Buffer options_buf = item->rec.options_buf;
+  guint32 len;
+
+  g_free(item->rec.opt_comment);
+  item->rec = *rec;
+  item->rec.opt_comment = g_strdup(rec->opt_comment);
+  item->rec.options_buf = options_buf;
+  ws_buffer_clean(&item->rec.options_buf);
+  ws_buffer_append_buffer(&item->rec.options_buf, (Buffer *)&rec->options_buf);
+
+  switch (rec->rec_type) {
+
+  case REC_TYPE_PACKET:
+    len = rec->rec_header.packet_header.caplen;
+    break;
+
+  case REC_TYPE_FT_SPECIFIC_EVENT:
+  case REC_TYPE_FT_SPECIFIC_REPORT:
+    len = rec->rec_header.ft_specific_header.record_len;
+    break;
+
+  case REC_TYPE_SYSCALL:
+    len = rec->rec_header.syscall_header.event_filelen;
+    break;
+
+  default:
+    /* frame_data_init() gives these a captured length of 0. */
+    len = 0;
+    break;
+  }
+  ws_buffer_clean(&item->buf);
+  ws_buffer_append(&item->buf, (guint8 *)pd, len);
+}
+
+/*
+ * Pass on any interface descriptions that the main thread hasn't
+ * seen yet.  A record can only refer to an interface whose
+ * description has already been read, so this only has to be done
+ * when a record refers to an interface we haven't passed on.
+ */
+static void
+read_ahead_queue_idbs(read_ahead_t *ra, const wtap_rec *rec)
+{
+  wtapng_iface_descriptions_t *idb_info;
+
+  if (rec->rec_type == REC_TYPE_PACKET &&
+      (rec->presence_flags & WTAP_HAS_INTERFACE_ID) &&
+      rec->rec_header.packet_header.interface_id < ra->idbs_sent)
+    return;
+
+  idb_info = wtap_file_get_idb_info(ra->wth);
+  for (; ra->idbs_sent < idb_info->interface_data->len; ra->idbs_sent++) {
+    read_ahead_item_t *item = g_new0(read_ahead_item_t, 1);
+
+    item->type = READ_AHEAD_IDB;
+    item->idb = g_array_index(idb_info->interface_data, wtap_block_t, ra->idbs_sent);
+    g_async_queue_push(ra->read_items, item);
+  }
+  g_free(idb_info);
+}
+
+static gpointer
+read_ahead_worker(gpointer data)
+{
+  read_ahead_t *ra = (read_ahead_t *)data;
+  read_ahead_item_t *item;
+  read_ahead_item_t *end_item;
+  int err = 0;
+  gchar *err_info = NULL;
+  gint64 data_offset;
+
+  for (;;) {
+    item = (read_ahead_item_t *)g_async_queue_pop(ra->free_items);
+    if (g_atomic_int_get(&ra->stop))
+      break;
+    if (!wtap_read(ra->wth, &err, &err_info, &data_offset))
+      break;
+    read_ahead_queue_idbs(ra, wtap_get_rec(ra->wth));
+    item->type = READ_AHEAD_RECORD;
+    item->data_offset = data_offset;
+    read_ahead_copy_rec(item, wtap_get_rec(ra->wth), wtap_get_buf_ptr(ra->wth));
+    g_async_queue_push(ra->read_items, item);
+  }
+
+  end_item = g_new0(read_ahead_item_t, 1);
+  end_item->type = READ_AHEAD_END;
+  end_item->err = err;
+  end_item->err_info = err_info;
+  g_async_queue_push(ra->read_items, end_item);
+  return NULL;
+}
+
+static read_ahead_t *
+read_ahead_start(wtap *wth)
+{
+  read_ahead_t *ra = g_new0(read_ahead_t, 1);
+  wtapng_iface_descriptions_t *idb_info;
+  guint i;
+
+  ra->wth = wth;
+  ra->free_items = g_async_queue_new();
+  ra->read_items = g_async_queue_new();
+  ra->items = g_new0(read_ahead_item_t, READ_AHEAD_QUEUE_DEPTH);
+  for (i = 0; i < READ_AHEAD_QUEUE_DEPTH; i++) {
+    wtap_rec_init(&ra->items[i].rec);
+    ws_buffer_init(&ra->items[i].buf, 1500);
+    g_async_queue_push(ra->free_items, &ra->items[i]);
+  }
+
+  /* The interfaces described in the file header are known already. */
+  ra->idbs = g_ptr_array_new();
+  idb_info = wtap_file_get_idb_info(wth);
+  for (ra->idbs_sent = 0; ra->idbs_sent < idb_info->interface_data->len; ra->idbs_sent++)
+    g_ptr_array_add(ra->idbs, g_array_index(idb_info->interface_data, wtap_block_t, ra->idbs_sent));
+  g_free(idb_info);
+
+  cur_read_ahead = ra;
+  wtap_set_cb_new_ipv4(wth, read_ahead_new_ipv4);
+  wtap_set_cb_new_ipv6(wth, read_ahead_new_ipv6);
+
+  ra->thread = g_thread_new("tshark read-ahead", read_ahead_worker, ra);
+  return ra;
+}
+
+static void
+read_ahead_free_item(read_ahead_item_t *item)
+{
+  g_free(item->name);
+  g_free(item);
+}
+
+/*
+ * Get the next record, in file order.  Returns FALSE at the end of
+ * the file or on a read error, with *err and *err_info set as
+ * wtap_read() would set them.  The record stays valid until the
+ * next call.
+ */
+static gboolean
+read_ahead_next(read_ahead_t *ra, int *err, gchar **err_info,
+                gint64 *data_offset, wtap_rec **rec, const guint8 **pd)
+{
+  read_ahead_item_t *item;
+
+  if (ra->current) {
+    g_async_queue_push(ra->free_items, ra->current);
+    ra->current = NULL;
+  }
+  if (ra->done) {
+    *err = 0;
+    *err_info = NULL;
+    return FALSE;
+  }
+
+  for (;;) {
+    item = (read_ahead_item_t *)g_async_queue_pop(ra->read_items);
+    switch (item->type) {
+
+    case READ_AHEAD_RECORD:
+      ra->current = item;
+      *data_offset = item->data_offset;
+      *rec = &item->rec;
+      *pd = ws_buffer_start_ptr(&item->buf);
+      return TRUE;
+
+    case READ_AHEAD_IDB:
+      g_ptr_array_add(ra->idbs, item->idb);
+      break;
+
+    case READ_AHEAD_IPV4_NAME:
+      add_ipv4_name(item->ipv4_addr, item->name);
+      break;
+
+    case READ_AHEAD_IPV6_NAME:
+      add_ipv6_name(&item->ipv6_addr, item->name);
+      break;
+
+    case READ_AHEAD_END:
+      ra->done = TRUE;
+      *err = item->err;
+      *err_info = item->err_info;
+      item->err_info = NULL;
+      break;
+    }
+    read_ahead_free_item(item);
+    if (ra->done)
+      return FALSE;
+  }
+}
+
+/*
+ * Stop the reader thread, if it's still running, and hand the wtap
+ * back to the main thread.
+ */
+static void
+read_ahead_stop(read_ahead_t *ra)
+{
+  read_ahead_item_t *item;
+  guint i;
+
+  g_atomic_int_set(&ra->stop, 1);
+  if (ra->current) {
+    g_async_queue_push(ra->free_items, ra->current);
+    ra->current = NULL;
+  }
+  /* Drain the queue, so that the reader isn't blocked waiting for a free item. */
+  while (!ra->done) {
+    item = (read_ahead_item_t *)g_async_queue_pop(ra->read_items);
+    switch (item->type) {
+
+    case READ_AHEAD_RECORD:
+      g_async_queue_push(ra->free_items, item);
+      continue;
+
+    case READ_AHEAD_IPV4_NAME:
+      add_ipv4_name(item->ipv4_addr, item->name);
+      break;
+
+    case READ_AHEAD_IPV6_NAME:
+      add_ipv6_name(&item->ipv6_addr, item->name);
+      break;
+
+    case READ_AHEAD_END:
+      ra->done = TRUE;
+      g_free(item->err_info);
+      break;
+
+    default:
+      break;
+    }
+    read_ahead_free_item(item);
+  }
+  g_thread_join(ra->thread);
+
+  wtap_set_cb_new_ipv4(ra->wth, add_ipv4_name);
+  wtap_set_cb_new_ipv6(ra->wth, (wtap_new_ipv6_callback_t) add_ipv6_name);
+  cur_read_ahead = NULL;
+
+  for (i = 0; i < READ_AHEAD_QUEUE_DEPTH; i++) {
+    wtap_rec_cleanup(&ra->items[i].rec);
+    g_free(ra->items[i].rec.opt_comment);
+    ws_buffer_free(&ra->items[i].buf);
+  }
+  g_free(ra->items);
+  g_async_queue_unref(ra->free_items);
+  g_async_queue_unref(ra->read_items);
+  g_ptr_array_free(ra->idbs, TRUE);
+  g_free(ra);
+}
+
+/*
+ * Get the next record, either directly from the wtap or from the
+ * read-ahead thread if there is one.
+ */
+static gboolean
+tshark_read_record(capture_file *cf, read_ahead_t *ra, int *err,
+                   gchar **err_info, gint64 *data_offset, wtap_rec **rec,
+                   const guint8 **pd)
+{
+  if (ra)
+    return read_ahead_next(ra, err, err_info, data_offset, rec, pd);
+
+  if (!wtap_read(cf->provider.wth, err, err_info, data_offset))
+    return FALSE;
+  *rec = wtap_get_rec(cf->provider.wth);
+  *pd = wtap_get_buf_ptr(cf->provider.wth);
+  return TRUE;
+}
+
+static wtap_block_t
+read_ahead_get_idb(guint32 interface_id)
+{
+  if (interface_id < cur_read_ahead->idbs->len)
+    return (wtap_block_t)g_ptr_array_index(cur_read_ahead->idbs, interface_id);
+  return NULL;
+}
+
+static const char *
+tshark_get_interface_name(struct packet_provider_data *prov, guint32 interface_id)
+{
+  wtap_block_t wtapng_if_descr;
+  char* interface_name;
+
+  if (cur_read_ahead == NULL)
+    return cap_file_provider_get_interface_name(prov, interface_id);
+
+  wtapng_if_descr = read_ahead_get_idb(interface_id);
+  if (wtapng_if_descr) {
+    if (wtap_block_get_string_option_value(wtapng_if_descr, OPT_IDB_NAME, &interface_name) == WTAP_OPTTYPE_SUCCESS)
+      return interface_name;
+    if (wtap_block_get_string_option_value(wtapng_if_descr, OPT_IDB_DESCR, &interface_name) == WTAP_OPTTYPE_SUCCESS)
+      return interface_name;
+  }
+  return "unknown";
+}
+
+static const char *
+tshark_get_interface_description(struct packet_provider_data *prov, guint32 interface_id)
+{
+  wtap_block_t wtapng_if_descr;
+  char* interface_name;
+
+  if (cur_read_ahead == NULL)
+    return cap_file_provider_get_interface_description(prov, interface_id);
+
+  wtapng_if_descr = read_ahead_get_idb(interface_id);
+  if (wtapng_if_descr) {
+    if (wtap_block_get_string_option_value(wtapng_if_descr, OPT_IDB_DESCR, &interface_name) == WTAP_OPTTYPE_SUCCESS)
+      return interface_name;
+  }
+  return NULL;
+}
+
 static const nstime_t *
 tshark_get_frame_ts(struct packet_provider_data *prov, guint32 frame_num)
 {
@@ -2386,8 +2831,8 @@ tshark_epan_new(capture_file *cf)
 {
   static const struct packet_provider_funcs funcs = {
     tshark_get_frame_ts,
-    cap_file_provider_get_interface_name,
-    cap_file_provider_get_interface_description,
+    tshark_get_interface_name,
+    tshark_get_interface_description,
     NULL,
   };
 
@@ -3079,6 +3524,9 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
   Buffer       buf;
   epan_dissect_t *edt = NULL;
   char                        *shb_user_appl;
+  read_ahead_t *ra = NULL;
+  wtap_rec     *read_rec;
+  const guint8 *read_pd;
 
   wtap_rec_init(&rec);
 
@@ -3116,10 +3564,10 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
         if (strcmp(save_file, "-") == 0) {
           /* Write to the standard output. */
           pdh = wtap_dump_open_stdout(out_file_type, linktype,
-              snapshot_length, FALSE /* compressed */, &err);
+              snapshot_length, WTAP_UNCOMPRESSED, &err);
         } else {
           pdh = wtap_dump_open(save_file, out_file_type, linktype,
-              snapshot_length, FALSE /* compressed */, &err);
+              snapshot_length, WTAP_UNCOMPRESSED, &err);
         }
     }
     else {
@@ -3127,10 +3575,10 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
         if (strcmp(save_file, "-") == 0) {
           /* Write to the standard output. */
           pdh = wtap_dump_open_stdout_ng(out_file_type, linktype,
-              snapshot_length, FALSE /* compressed */, shb_hdrs, idb_inf, nrb_hdrs, &err);
+              snapshot_length, WTAP_UNCOMPRESSED, shb_hdrs, idb_inf, nrb_hdrs, &err);
         } else {
           pdh = wtap_dump_open_ng(save_file, out_file_type, linktype,
-              snapshot_length, FALSE /* compressed */, shb_hdrs, idb_inf, nrb_hdrs, &err);
+              snapshot_length, WTAP_UNCOMPRESSED, shb_hdrs, idb_inf, nrb_hdrs, &err);
         }
     }
 
@@ -3196,9 +3644,10 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
     }
 
     tshark_debug("tshark: reading records for first pass");
-    while (wtap_read(cf->provider.wth, &err, &err_info, &data_offset)) {
-      if (process_packet_first_pass(cf, edt, data_offset, wtap_get_rec(cf->provider.wth),
-                                    wtap_get_buf_ptr(cf->provider.wth))) {
+    if (read_ahead)
+      ra = read_ahead_start(cf->provider.wth);
+    while (tshark_read_record(cf, ra, &err, &err_info, &data_offset, &read_rec, &read_pd)) {
+      if (process_packet_first_pass(cf, edt, data_offset, read_rec, read_pd)) {
         /* Stop reading if we have the maximum number of packets;
          * When the -c option has not been used, max_packet_count
          * starts at 0, which practically means, never stop reading.
@@ -3213,6 +3662,11 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
       }
     }
 
+    if (ra) {
+      read_ahead_stop(ra);
+      ra = NULL;
+    }
+
     /*
      * If we got a read error on the first pass, remember the error, so
      * but do the second pass, so we can at least process the packets we
@@ -3369,21 +3823,23 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
      */
     set_resolution_synchrony(TRUE);
 
-    while (wtap_read(cf->provider.wth, &err, &err_info, &data_offset)) {
+    if (read_ahead)
+      ra = read_ahead_start(cf->provider.wth);
+    while (tshark_read_record(cf, ra, &err, &err_info, &data_offset, &read_rec, &read_pd)) {
       framenum++;
 
       tshark_debug("tshark: processing packet #%d", framenum);
 
       reset_epan_mem(cf, edt, create_proto_tree, print_packet_info && print_details);
 
-      if (process_packet_single_pass(cf, edt, data_offset, wtap_get_rec(cf->provider.wth),
-                                     wtap_get_buf_ptr(cf->provider.wth), tap_flags)) {
+      if (process_packet_single_pass(cf, edt, data_offset, read_rec, read_pd,
+                                     tap_flags)) {
         /* Either there's no read filtering or this packet passed the
            filter, so, if we're writing to a capture file, write
            this packet out. */
         if (pdh != NULL) {
           tshark_debug("tshark: writing packet #%d to outfile", framenum);
-          if (!wtap_dump(pdh, wtap_get_rec(cf->provider.wth), wtap_get_buf_ptr(cf->provider.wth), &err, &err_info)) {
+          if (!wtap_dump(pdh, read_rec, read_pd, &err, &err_info)) {
             /* Error writing to a capture file */
             tshark_debug("tshark: error writing to a capture file (%d)", err);
             cfile_write_failure_message("TShark", cf->filename, save_file,
@@ -3408,6 +3864,11 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
       }
     }
 
+    if (ra) {
+      read_ahead_stop(ra);
+      ra = NULL;
+    }
+
     if (edt) {
       epan_dissect_free(edt);
       edt = NULL;
@@ -4053,6 +4514,10 @@ cf_open(capture_file *cf, const char *fname, unsigned int type, gboolean is_temp
   if (wth == NULL)
     goto fail;
 
+  /* Decompress the file on its own thread, ahead of the record reader. */
+  if (read_ahead && wtap_iscompressed(wth))
+    wtap_set_read_ahead(wth);
+
   /* The open succeeded.  Fill in the information for this file. */
 
   /* Create new epan session for dissection. */
@@ -275,6 +275,327 @@ double get_io_graph_item(const io_graph_item_t *items_, io_graph_item_unit_t val
     return value;
 }
 
+void merge_io_graph_item(io_graph_item_t *dst, const io_graph_item_t *src, int hf_index, io_graph_item_unit_t item_unit)
+{
+    gboolean src_has_max = FALSE;
+    gboolean src_has_min = FALSE;
+
+    /* Taps see packets in frame number order. */
+    if (src->first_frame_in_invl != 0 &&
+        (dst->first_frame_in_invl == 0 || src->first_frame_in_invl < dst->first_frame_in_invl)) {
+        dst->first_frame_in_invl = src->first_frame_in_invl;
+    }
+    if (src->last_frame_in_invl > dst->last_frame_in_invl) {
+        dst->last_frame_in_invl = src->last_frame_in_invl;
+    }
+
+    if (hf_index >= 0 && src->fields != 0) {
+        switch (proto_registrar_get_ftype(hf_index)) {
+        case FT_UINT8:
+        case FT_UINT16:
+        case FT_UINT24:
+        case FT_UINT32:
+        case FT_UINT40:
+        case FT_UINT48:
+        case FT_UINT56:
+        case FT_UINT64:
+        case FT_INT8:
+        case FT_INT16:
+        case FT_INT24:
+        case FT_INT32:
+        case FT_INT40:
+        case FT_INT48:
+        case FT_INT56:
+        case FT_INT64:
+            if ((src->int_max > dst->int_max) || (dst->fields == 0)) {
+                dst->int_max = src->int_max;
+                src_has_max = TRUE;
+            }
+            if ((src->int_min < dst->int_min) || (dst->fields == 0)) {
+                dst->int_min = src->int_min;
+                src_has_min = TRUE;
+            }
+            dst->int_tot += src->int_tot;
+            break;
+        case FT_FLOAT:
+            if ((src->float_max > dst->float_max) || (dst->fields == 0)) {
+                dst->float_max = src->float_max;
+                src_has_max = TRUE;
+            }
+            if ((src->float_min < dst->float_min) || (dst->fields == 0)) {
+                dst->float_min = src->float_min;
+                src_has_min = TRUE;
+            }
+            dst->float_tot += src->float_tot;
+            break;
+        case FT_DOUBLE:
+            if ((src->double_max > dst->double_max) || (dst->fields == 0)) {
+                dst->double_max = src->double_max;
+                src_has_max = TRUE;
+            }
+            if ((src->double_min < dst->double_min) || (dst->fields == 0)) {
+                dst->double_min = src->double_min;
+                src_has_min = TRUE;
+            }
+            dst->double_tot += src->double_tot;
+            break;
+        case FT_RELATIVE_TIME:
+            if ((nstime_cmp(&src->time_max, &dst->time_max) > 0) || (dst->fields == 0)) {
+                dst->time_max = src->time_max;
+                src_has_max = TRUE;
+            }
+            if ((nstime_cmp(&src->time_min, &dst->time_min) < 0) || (dst->fields == 0)) {
+                dst->time_min = src->time_min;
+                src_has_min = TRUE;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if ((item_unit == IOG_ITEM_UNIT_CALC_MAX && src_has_max) ||
+            (item_unit == IOG_ITEM_UNIT_CALC_MIN && src_has_min)) {
+            dst->extreme_frame_in_invl = src->extreme_frame_in_invl;
+        }
+    }
+
+    /*
+     * LOAD adds to the time of earlier intervals without counting a
+     * field in them, but the time a call spent in an interval is the sum
+     * of the times it spent in each of its parts, so it merges the same
+     * way as the other totals.
+     */
+    nstime_add(&dst->time_tot, &src->time_tot);
+    dst->fields += src->fields;
+    dst->frames += src->frames;
+    dst->bytes += src->bytes;
+}
+
+typedef struct {
+    int interval;
+    gboolean active;            /* Are packets being added to this level? */
+    gboolean truncated;         /* Did packets fall past max_items? */
+    int num_items;
+    int space_items;
+    io_graph_item_t *items;
+} io_graph_level_t;
+
+struct _io_graph_pyramid_t {
+    int max_items;
+    int hf_index;
+    io_graph_item_unit_t item_unit;
+    int interval;               /* The interval wanted at the last reset */
+    int num_levels;
+    io_graph_level_t levels[IO_GRAPH_PYRAMID_MAX_LEVELS];
+
+    /* The last interval built by merging the items of a level */
+    int merged_interval;        /* 0 if there isn't one */
+    int merged_num_items;
+    int merged_space_items;
+    io_graph_item_t *merged_items;
+};
+
+static void
+io_graph_level_reserve(io_graph_level_t *level, int space_items, int max_items)
+{
+    int new_space;
+
+    if (space_items <= level->space_items) {
+        return;
+    }
+
+    /* Grow geometrically so that long captures don't realloc() all the time. */
+    new_space = MAX(space_items + 1024, level->space_items * 2);
+    new_space = MIN(new_space, max_items);
+    level->items = g_renew(io_graph_item_t, level->items, new_space);
+    reset_io_graph_items(&level->items[level->space_items], new_space - level->space_items);
+    level->space_items = new_space;
+}
+
+io_graph_pyramid_t *io_graph_pyramid_new(const int *intervals, int num_intervals, int max_items)
+{
+    static const int default_intervals[] = IO_GRAPH_PYRAMID_INTERVALS;
+    io_graph_pyramid_t *pyramid = g_new0(io_graph_pyramid_t, 1);
+    int i;
+
+    if (intervals == NULL) {
+        intervals = default_intervals;
+        num_intervals = (int) G_N_ELEMENTS(default_intervals);
+    }
+    g_assert(num_intervals > 0 && num_intervals <= IO_GRAPH_PYRAMID_MAX_LEVELS);
+
+    pyramid->max_items = max_items;
+    pyramid->hf_index = -1;
+    pyramid->item_unit = IOG_ITEM_UNIT_PACKETS;
+    pyramid->num_levels = num_intervals;
+    for (i = 0; i < num_intervals; i++) {
+        g_assert(intervals[i] > 0);
+        g_assert(i == 0 || intervals[i] % intervals[i - 1] == 0);
+        pyramid->levels[i].interval = intervals[i];
+        pyramid->levels[i].active = TRUE;
+    }
+
+    return pyramid;
+}
+
+void io_graph_pyramid_reset(io_graph_pyramid_t *pyramid, int hf_index, io_graph_item_unit_t item_unit, int interval)
+{
+    int i;
+
+    pyramid->hf_index = hf_index;
+    pyramid->item_unit = item_unit;
+    pyramid->interval = interval;
+    pyramid->merged_interval = 0;
+    pyramid->merged_num_items = 0;
+
+    for (i = 0; i < pyramid->num_levels; i++) {
+        io_graph_level_t *level = &pyramid->levels[i];
+
+        /* Only the items up to num_items can have been touched. */
+        reset_io_graph_items(level->items, level->num_items);
+        level->num_items = 0;
+        level->truncated = FALSE;
+        level->active = (item_unit != IOG_ITEM_UNIT_CALC_LOAD) || (level->interval >= interval);
+    }
+}
+
+gboolean io_graph_pyramid_add(io_graph_pyramid_t *pyramid, packet_info *pinfo, epan_dissect_t *edt)
+{
+    gboolean counted = FALSE;
+    int i;
+
+    pyramid->merged_interval = 0;
+
+    for (i = 0; i < pyramid->num_levels; i++) {
+        io_graph_level_t *level = &pyramid->levels[i];
+        int idx;
+
+        if (!level->active) {
+            continue;
+        }
+
+        idx = get_io_graph_index(pinfo, level->interval);
+        if (idx < 0) {
+            continue;
+        }
+        if (idx >= pyramid->max_items) {
+            if (level->interval != pyramid->interval) {
+                /*
+                 * Nothing can be merged from a level that stops short, so
+                 * rather than keep max_items of it, drop it. Asking for
+                 * it again means a retap.
+                 */
+                g_free(level->items);
+                level->items = NULL;
+                level->num_items = 0;
+                level->space_items = 0;
+                level->active = FALSE;
+                continue;
+            }
+            /* Show as much as we have, as the single-interval taps did. */
+            io_graph_level_reserve(level, pyramid->max_items, pyramid->max_items);
+            level->num_items = pyramid->max_items;
+            level->truncated = TRUE;
+            continue;
+        }
+
+        io_graph_level_reserve(level, idx + 1, pyramid->max_items);
+        if (idx + 1 > level->num_items) {
+            level->num_items = idx + 1;
+        }
+
+        if (update_io_graph_item(level->items, idx, pinfo, edt, pyramid->hf_index, pyramid->item_unit, level->interval)) {
+            counted = TRUE;
+        }
+    }
+
+    return counted;
+}
+
+const io_graph_item_t *io_graph_pyramid_get_items(io_graph_pyramid_t *pyramid, int interval, int *num_items)
+{
+    io_graph_level_t *level = NULL;
+    int ratio;
+    int i;
+
+    *num_items = 0;
+    if (interval <= 0) {
+        return NULL;
+    }
+
+    /* Prefer an exact match, then the coarsest level we can merge. */
+    for (i = pyramid->num_levels - 1; i >= 0; i--) {
+        if (pyramid->levels[i].active && pyramid->levels[i].interval == interval) {
+            level = &pyramid->levels[i];
+            io_graph_level_reserve(level, 1, pyramid->max_items);
+            *num_items = level->num_items;
+            return level->items;
+        }
+    }
+    for (i = pyramid->num_levels - 1; i >= 0; i--) {
+        if (pyramid->levels[i].active && interval % pyramid->levels[i].interval == 0) {
+            level = &pyramid->levels[i];
+            break;
+        }
+    }
+
+    /*
+     * Only the level of the interval wanted at the reset is kept when it
+     * truncates. Merged items from it would stop short of where a tap
+     * with this interval would.
+     */
+    if (level == NULL || level->truncated) {
+        return NULL;
+    }
+
+    if (pyramid->merged_interval != interval) {
+        ratio = interval / level->interval;
+        pyramid->merged_num_items = (level->num_items + ratio - 1) / ratio;
+        /* Always have an array to return, even if it's empty. */
+        if (pyramid->merged_num_items >= pyramid->merged_space_items) {
+            pyramid->merged_space_items = pyramid->merged_num_items + 1;
+            pyramid->merged_items = g_renew(io_graph_item_t, pyramid->merged_items, pyramid->merged_space_items);
+        }
+        reset_io_graph_items(pyramid->merged_items, pyramid->merged_num_items);
+        for (i = 0; i < level->num_items; i++) {
+            merge_io_graph_item(&pyramid->merged_items[i / ratio], &level->items[i],
+                                pyramid->hf_index, pyramid->item_unit);
+        }
+        pyramid->merged_interval = interval;
+    }
+
+    *num_items = pyramid->merged_num_items;
+    return pyramid->merged_items;
+}
+
+gsize io_graph_pyramid_get_size(const io_graph_pyramid_t *pyramid)
+{
+    gsize size = sizeof(*pyramid);
+    int i;
+
+    for (i = 0; i < pyramid->num_levels; i++) {
+        size += (gsize) pyramid->levels[i].space_items * sizeof(io_graph_item_t);
+    }
+    size += (gsize) pyramid->merged_space_items * sizeof(io_graph_item_t);
+
+    return size;
+}
+
+void io_graph_pyramid_free(io_graph_pyramid_t *pyramid)
+{
+    int i;
+
+    if (!pyramid) {
+        return;
+    }
+
+    for (i = 0; i < pyramid->num_levels; i++) {
+        g_free(pyramid->levels[i].items);
+    }
+    g_free(pyramid->merged_items);
+    g_free(pyramid);
+}
+
 /*
  * Editor modelines
  *
@@ -382,6 +382,86 @@ update_io_graph_item(io_graph_item_t *items, int idx, packet_info *pinfo, epan_d
     return TRUE;
 }
 
+/** Merge the values of one interval into those of the enclosing, coarser
+ * interval, as if the packets of both had been added to the latter.
+ *
+ * @param dst [in,out] The coarser interval.
+ * @param src [in] The interval to add to it.
+ * @param hf_index [in] Header field index for advanced statistics.
+ * @param item_unit [in] The type of unit to calculate. From IOG_ITEM_UNITS.
+ */
+void merge_io_graph_item(io_graph_item_t *dst, const io_graph_item_t *src, int hf_index, io_graph_item_unit_t item_unit);
+
+/** Intervals, in milliseconds, kept by an io_graph_pyramid_t unless
+ * others are given. Each is a multiple of the one before it. */
+#define IO_GRAPH_PYRAMID_INTERVALS { 1, 10, 100, 1000, 10000, 60000, 600000 }
+#define IO_GRAPH_PYRAMID_MAX_LEVELS 8
+
+/** Items for several intervals at once, so that the interval can be
+ * changed without retapping.
+ *
+ * Every packet is added to the items of each interval ("level"), so the
+ * values of any level are exactly those a tap with that interval would
+ * have produced. Intervals that aren't levels but are a multiple of one
+ * are built on request by merging the items of the level.
+ */
+typedef struct _io_graph_pyramid_t io_graph_pyramid_t;
+
+/** Create a pyramid.
+ *
+ * @param intervals [in] Ascending intervals to keep, in ms, each a multiple
+ *        of the one before it, or NULL for IO_GRAPH_PYRAMID_INTERVALS.
+ * @param num_intervals [in] Number of intervals, at most
+ *        IO_GRAPH_PYRAMID_MAX_LEVELS.
+ * @param max_items [in] Maximum number of items per interval. Packets
+ *        past the last item of the interval wanted at the last reset
+ *        aren't counted in it; any other interval which would need more
+ *        items is dropped, and its items freed, until the next reset.
+ * @return The new pyramid. Free it with io_graph_pyramid_free().
+ */
+io_graph_pyramid_t *io_graph_pyramid_new(const int *intervals, int num_intervals, int max_items);
+
+/** Discard all items and set what to calculate for the packets added next.
+ *
+ * @param pyramid [in,out] The pyramid to reset.
+ * @param hf_index [in] Header field index for advanced statistics.
+ * @param item_unit [in] The type of unit to calculate. From IOG_ITEM_UNITS.
+ * @param interval [in] The interval wanted now. LOAD is expensive to
+ *        calculate at fine intervals, so for it, only levels at least this
+ *        coarse are kept.
+ */
+void io_graph_pyramid_reset(io_graph_pyramid_t *pyramid, int hf_index, io_graph_item_unit_t item_unit, int interval);
+
+/** Add a packet to every level.
+ *
+ * @param pyramid [in,out] The pyramid to update.
+ * @param pinfo [in] Packet containing update information.
+ * @param edt [in] Dissection information for advanced statistics. May be NULL.
+ * @return TRUE if the packet was counted in at least one level.
+ */
+gboolean io_graph_pyramid_add(io_graph_pyramid_t *pyramid, packet_info *pinfo, epan_dissect_t *edt);
+
+/** Get the items for an interval.
+ *
+ * @param pyramid [in] The pyramid.
+ * @param interval [in] Interval in ms.
+ * @param num_items [out] Set to the number of items, that is, the index of
+ *        the last interval that has packets plus one.
+ * @return The items, which remain valid until the pyramid is next changed
+ *         or asked for another interval, or NULL if the interval can't be
+ *         had without retapping with it as one of the levels.
+ */
+const io_graph_item_t *io_graph_pyramid_get_items(io_graph_pyramid_t *pyramid, int interval, int *num_items);
+
+/** Get the memory used by a pyramid, in bytes.
+ *
+ * @param pyramid [in] The pyramid.
+ * @return The size of the pyramid and of the items allocated for it.
+ */
+gsize io_graph_pyramid_get_size(const io_graph_pyramid_t *pyramid);
+
+/** Free a pyramid and its items. */
+void io_graph_pyramid_free(io_graph_pyramid_t *pyramid);
 
 #ifdef __cplusplus
 }
@@ -16,6 +16,9 @@
 
 #include <epan/conversation.h>
 #include <epan/conversation_debug.h>
+#include <epan/reassemble.h>
+
+#include <wsutil/str_util.h>
 
 #include <ui/qt/utils/qt_ui_utils.h>
 #include "wireshark_application.h"
@@ -38,6 +41,10 @@ ConversationHashTablesDialog::ConversationHashTablesDialog(QWidget *parent) :
     html += hashTableToHtmlTable("conversation_hashtable_no_port2", get_conversation_hashtable_no_port2());
     html += hashTableToHtmlTable("conversation_hashtable_no_addr2_or_port2", get_conversation_hashtable_no_addr2_or_port2());
 
+    html += "<h3>Reassembly Tables</h3>\n";
+
+    html += reassemblyTablesToHtmlTable();
+
     ui->conversationTextEdit->setHtml(html);
 }
 
@@ -84,6 +91,50 @@ const QString ConversationHashTablesDialog::hashTableToHtmlTable(const QString t
     return html_table;
 }
 
+static const QString
+bytes_to_qstring(guint64 bytes)
+{
+    return gchar_free_to_qstring(format_size(bytes, format_size_unit_bytes|format_size_prefix_iec));
+}
+
+static void
+populate_reassembly_row(const reassembly_table_stats_t *stats, gpointer user_data)
+{
+    QString* html_table = (QString*)user_data;
+
+    (*html_table) += QString("<tr><td>%1</td><td align=\"right\">%2</td><td align=\"right\">%3</td>"
+                             "<td align=\"right\">%4</td><td align=\"right\">%5</td><td align=\"right\">%6</td>"
+                             "<td align=\"right\">%7</td><td align=\"right\">%8</td><td align=\"right\">%9</td></tr>\n")
+            .arg(stats->name)
+            .arg(stats->in_progress)
+            .arg(bytes_to_qstring(stats->in_progress_bytes))
+            .arg(stats->reassembled)
+            .arg(bytes_to_qstring(stats->reassembled_bytes))
+            .arg(stats->evicted)
+            .arg(stats->spilled)
+            .arg(bytes_to_qstring(stats->spilled_bytes))
+            .arg(stats->reloaded);
+}
+
+const QString ConversationHashTablesDialog::reassemblyTablesToHtmlTable()
+{
+    QString rows;
+
+    reassembly_tables_foreach_stats(populate_reassembly_row, (void*)&rows);
+    if (rows.isEmpty())
+        return "<p>No reassemblies</p>\n";
+
+    int one_em = fontMetrics().height();
+    QString html_table = QString("<table cellpadding=\"%1\">\n").arg(one_em / 4);
+
+    html_table += "<tr><th align=\"left\">Table</th><th>In Progress</th><th>Memory</th>"
+                  "<th>Reassembled</th><th>Memory</th><th>Discarded</th>"
+                  "<th>Spilled</th><th>Spill File</th><th>Read Back</th></tr>\n";
+    html_table += rows;
+    html_table += "</table>\n";
+    return html_table;
+}
+
 /*
  * Editor modelines
  *
@@ -29,6 +29,7 @@ private:
     Ui::ConversationHashTablesDialog *ui;
 
     const QString hashTableToHtmlTable(const QString table_name, wmem_map_t *hash_table);
+    const QString reassemblyTablesToHtmlTable();
 };
 
 #endif // CONVERSATION_HASH_TABLES_DIALOG_H
@@ -1160,17 +1160,16 @@ void IOGraphDialog::on_intervalComboBox_currentIndexChanged(int)
     if (uat_model_ != NULL) {
         for (int row = 0; row < uat_model_->rowCount(); row++) {
             IOGraph *iog = ioGraphs_.value(row, NULL);
-            if (iog) {
-                iog->setInterval(interval);
-                if (iog->visible()) {
-                    need_retap = true;
-                }
+            if (iog && iog->setInterval(interval) && iog->visible()) {
+                need_retap = true;
             }
         }
     }
 
     if (need_retap) {
         scheduleRetap(true);
+    } else {
+        scheduleRecalc(true);
     }
 
     updateLegend();
@@ -1493,6 +1492,11 @@ IOGraph::IOGraph(QCustomPlot *parent) :
     bars_(NULL),
     val_units_(IOG_ITEM_UNIT_FIRST),
     hf_index_(-1),
+    interval_(1000),
+    pyramid_(io_graph_pyramid_new(NULL, 0, max_io_items_)),
+    tap_hf_index_(-1),
+    tap_val_units_(IOG_ITEM_UNIT_FIRST),
+    items_(NULL),
     cur_idx_(-1)
 {
     Q_ASSERT(parent_ != NULL);
@@ -1517,6 +1521,7 @@ IOGraph::IOGraph(QCustomPlot *parent) :
 
 IOGraph::~IOGraph() {
     remove_tap_listener(this);
+    io_graph_pyramid_free(pyramid_);
     if (graph_) {
         parent_->removeGraph(graph_);
     }
@@ -1778,8 +1783,10 @@ int IOGraph::packetFromTime(double ts)
 
 void IOGraph::clearAllData()
 {
-    cur_idx_ = -1;
-    reset_io_graph_items(items_, max_io_items_);
+    tap_hf_index_ = hf_index_;
+    tap_val_units_ = val_units_;
+    io_graph_pyramid_reset(pyramid_, hf_index_, val_units_, interval_);
+    updateItems();
     if (graph_) {
         graph_->clearData();
     }
@@ -1977,9 +1984,30 @@ void IOGraph::reloadValueUnitField()
     }
 }
 
-void IOGraph::setInterval(int interval)
+// Returns true if we have to retap to show the new interval.
+bool IOGraph::setInterval(int interval)
 {
     interval_ = interval;
+
+    // Packets and bytes are always counted, but the advanced units are
+    // only calculated for the field and unit we last tapped with.
+    if (val_units_ >= IOG_ITEM_UNIT_CALC_SUM &&
+            (hf_index_ != tap_hf_index_ || val_units_ != tap_val_units_)) {
+        updateItems();
+        return true;
+    }
+    return !updateItems();
+}
+
+// Point items_ at the pyramid's items for the current interval. Returns
+// false if it doesn't have them.
+bool IOGraph::updateItems()
+{
+    int num_items;
+
+    items_ = io_graph_pyramid_get_items(pyramid_, interval_, &num_items);
+    cur_idx_ = num_items - 1;
+    return items_ != NULL;
 }
 
 // Get the value at the given interval (idx) for the current value unit.
@@ -1987,6 +2015,10 @@ double IOGraph::getItemValue(int idx, const capture_file *cap_file) const
 {
     g_assert(idx < max_io_items_);
 
+    if (!items_) {
+        return 0;
+    }
+
     return get_io_graph_item(items_, val_units_, idx, hf_index_, cap_file, interval_, cur_idx_);
 }
 
@@ -2008,21 +2040,13 @@ gboolean IOGraph::tapPacket(void *iog_ptr, packet_info *pinfo, epan_dissect_t *e
         return FALSE;
     }
 
-    int idx = get_io_graph_index(pinfo, iog->interval_);
-    bool recalc = false;
+    int old_cur_idx = iog->cur_idx_;
 
     /* some sanity checks */
-    if ((idx < 0) || (idx >= max_io_items_)) {
-        iog->cur_idx_ = max_io_items_ - 1;
+    if (get_io_graph_index(pinfo, iog->interval_) < 0) {
         return FALSE;
     }
 
-    /* update num_items */
-    if (idx > iog->cur_idx_) {
-        iog->cur_idx_ = (guint32) idx;
-        recalc = true;
-    }
-
     /* set start time */
     if (iog->start_time_ == 0.0) {
         nstime_t start_nstime;
@@ -2037,16 +2061,17 @@ gboolean IOGraph::tapPacket(void *iog_ptr, packet_info *pinfo, epan_dissect_t *e
         adv_edt = edt;
     }
 
-    if (!update_io_graph_item(iog->items_, idx, pinfo, adv_edt, iog->hf_index_, iog->val_units_, iog->interval_)) {
-        return FALSE;
-    }
+    gboolean counted = io_graph_pyramid_add(iog->pyramid_, pinfo, adv_edt);
 
-//    qDebug() << "=tapPacket" << iog->name_ << idx << iog->hf_index_ << iog->val_units_ << iog->num_items_;
+    // Adding the packet might have moved the items.
+    iog->updateItems();
 
-    if (recalc) {
+//    qDebug() << "=tapPacket" << iog->name_ << iog->hf_index_ << iog->val_units_ << iog->cur_idx_;
+
+    if (iog->cur_idx_ > old_cur_idx) {
         emit iog->requestRecalc();
     }
-    return TRUE;
+    return counted;
 }
 
 // "tap_draw" callback for register_tap_listener
@@ -63,7 +63,7 @@ public:
     const QString valueUnitField() { return vu_field_; }
     void setValueUnitField(const QString &vu_field);
     unsigned int movingAveragePeriod() { return moving_avg_period_; }
-    void setInterval(int interval);
+    bool setInterval(int interval);
     bool addToLegend();
     bool removeFromLegend();
     QCPGraph *graph() { return graph_; }
@@ -114,9 +114,16 @@ private:
     QString scaled_value_unit_;
 
     // Cached data. We should be able to change the Y axis without retapping as
-    // much as is feasible.
-    io_graph_item_t items_[max_io_items_];
+    // much as is feasible. The pyramid keeps items for all of the intervals
+    // in the interval combo box so that changing the interval doesn't need
+    // a retap either.
+    io_graph_pyramid_t *pyramid_;
+    int tap_hf_index_;
+    io_graph_item_unit_t tap_val_units_;
+    const io_graph_item_t *items_; // For interval_, from pyramid_
     int cur_idx_;
+
+    bool updateItems();
 };
 
 namespace Ui {
@@ -15,7 +15,9 @@
 
 #include <wsutil/nstime.h>
 #include <epan/column.h>
+#include <epan/frame_data.h>
 #include <epan/prefs.h>
+#include <epan/timestamp.h>
 
 #include "ui/packet_list_utils.h"
 #include "ui/recent.h"
@@ -30,7 +32,8 @@
 #include <QElapsedTimer>
 #include <QFontMetrics>
 #include <QModelIndex>
-#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QRunnable>
 
 // Print timing information
 //#define DEBUG_PACKET_LIST_MODEL 1
@@ -46,6 +49,7 @@ PacketListModel::PacketListModel(QObject *parent, capture_file *cf) :
     number_to_row_(QVector<int>()),
     max_row_height_(0),
     max_line_count_(1),
+    sort_in_progress_(false),
     idle_dissection_row_(0)
 {
     setCaptureFile(cf);
@@ -124,6 +128,9 @@ guint PacketListModel::recreateVisibleRows()
 }
 
 void PacketListModel::clear() {
+    // A sort might be comparing strings in the pool that we're about to
+    // free. Let it finish; it'll notice that the rows have changed.
+    sort_pool_.waitForDone();
     beginResetModel();
     qDeleteAll(physical_rows_);
     physical_rows_.resize(0);
@@ -289,60 +296,206 @@ void PacketListModel::setMaximiumRowHeight(int height)
 // and filtering. That seems like overkill but it might be something we want
 // to do in the future.
 
-int PacketListModel::sort_column_;
-int PacketListModel::sort_column_is_numeric_;
-int PacketListModel::text_sort_column_;
-Qt::SortOrder PacketListModel::sort_order_;
-capture_file *PacketListModel::sort_cap_file_;
+// A row of the packet list as it's being sorted. Computing the keys needs
+// dissection, or for time deltas other frames' time stamps, and so has to
+// happen on the GUI thread, but comparing them only looks at the values
+// here, which lets us sort them in parallel.
+struct PacketListSortKey {
+    PacketListRecord *record;
+    guint32 num;        // Frame number, which breaks ties
+    const char *str;    // Column text, or NULL if the column comes from frame data
+    PacketListSortValue value;  // Typed value, for columns that have one
+    // Value of a column that comes from frame data. Times are in
+    // frame_val and frame_nsecs, with reference frames sorting first
+    // as in frame_data_compare().
+    bool ref_time;
+    gint64 frame_val;
+    int frame_nsecs;
+};
+
+class PacketListSortKeyLessThan
+{
+public:
+    PacketListSortKeyLessThan(bool typed, Qt::SortOrder order) :
+        typed_(typed),
+        ascending_(order == Qt::AscendingOrder)
+    {}
+
+    bool operator()(const PacketListSortKey &k1, const PacketListSortKey &k2) const
+    {
+        int cmp_val = compare(k1, k2);
+
+        if (cmp_val == 0) {
+            // All else being equal, compare frame numbers.
+            cmp_val = k1.num < k2.num ? -1 : k1.num > k2.num ? 1 : 0;
+        }
+        return ascending_ ? cmp_val < 0 : cmp_val > 0;
+    }
+
+private:
+    bool typed_;
+    bool ascending_;
+
+    // Wherein we try to cram the logic of packet_list_compare_records,
+    // _packet_list_compare_records, and packet_list_compare_custom from
+    // gtk/packet_list_store.c into one function
+    int compare(const PacketListSortKey &k1, const PacketListSortKey &k2) const
+    {
+        if (!k1.str) {
+            // Column comes directly from frame data
+            if (k1.ref_time != k2.ref_time) {
+                return k1.ref_time ? -1 : 1;
+            }
+            if (k1.frame_val != k2.frame_val) {
+                return k1.frame_val < k2.frame_val ? -1 : 1;
+            }
+            return k1.frame_nsecs < k2.frame_nsecs ? -1 : k1.frame_nsecs > k2.frame_nsecs ? 1 : 0;
+        }
+        if (k1.str == k2.str) {
+            // Strings in the pool are unique.
+            return 0;
+        }
+        if (typed_) {
+            // Rows without a value ("Unknown") sort before the others.
+            int cmp_val = k1.value.compare(k2.value);
+            if (cmp_val != 0 || k1.value.isValid()) {
+                return cmp_val;
+            }
+        }
+        return strcmp(k1.str, k2.str);
+    }
+};
+
+// Fill in the key of a column that comes from frame data, as compared by
+// frame_data_compare().
+static void setFrameSortKey(capture_file *cf, int col_fmt, PacketListSortKey &key)
+{
+    frame_data *fdata = key.record->frameData();
+    nstime_t ts;
+
+    key.ref_time = false;
+    key.frame_val = 0;
+    key.frame_nsecs = 0;
+
+    switch (col_fmt) {
+    case COL_NUMBER:
+        key.frame_val = fdata->num;
+        return;
+
+    case COL_PACKET_LENGTH:
+        key.frame_val = fdata->pkt_len;
+        return;
+
+    case COL_CUMULATIVE_BYTES:
+        key.frame_val = fdata->cum_bytes;
+        return;
+
+    case COL_CLS_TIME:
+        switch (timestamp_get_type()) {
+        case TS_RELATIVE:
+            col_fmt = COL_REL_TIME;
+            break;
+        case TS_DELTA:
+            col_fmt = COL_DELTA_TIME;
+            break;
+        case TS_DELTA_DIS:
+            col_fmt = COL_DELTA_TIME_DIS;
+            break;
+        case TS_NOT_SET:
+            return;
+        default:
+            col_fmt = COL_ABS_TIME;
+            break;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    switch (col_fmt) {
+    case COL_ABS_TIME:
+    case COL_ABS_YMD_TIME:
+    case COL_ABS_YDOY_TIME:
+    case COL_UTC_TIME:
+    case COL_UTC_YMD_TIME:
+    case COL_UTC_YDOY_TIME:
+        ts = fdata->abs_ts;
+        break;
+    case COL_REL_TIME:
+        frame_delta_abs_time(cf->epan, fdata, fdata->frame_ref_num, &ts);
+        break;
+    case COL_DELTA_TIME:
+        frame_delta_abs_time(cf->epan, fdata, fdata->num - 1, &ts);
+        break;
+    case COL_DELTA_TIME_DIS:
+        frame_delta_abs_time(cf->epan, fdata, fdata->prev_dis_num, &ts);
+        break;
+    default:
+        return;
+    }
+    key.ref_time = fdata->flags.ref_time;
+    key.frame_val = ts.secs;
+    key.frame_nsecs = ts.nsecs;
+}
+
+// Sorts a run of keys or merges two adjacent sorted runs.
+class PacketListSortTask : public QRunnable
+{
+public:
+    PacketListSortTask(PacketListSortKey *first, PacketListSortKey *middle, PacketListSortKey *last,
+                       const PacketListSortKeyLessThan &less_than, QAtomicInt *done) :
+        first_(first),
+        middle_(middle),
+        last_(last),
+        less_than_(less_than),
+        done_(done)
+    {}
+
+    void run()
+    {
+        if (middle_ == first_) {
+            std::sort(first_, last_, less_than_);
+        } else {
+            std::inplace_merge(first_, middle_, last_, less_than_);
+        }
+        done_->ref();
+    }
+
+private:
+    PacketListSortKey *first_;
+    PacketListSortKey *middle_;
+    PacketListSortKey *last_;
+    PacketListSortKeyLessThan less_than_;
+    QAtomicInt *done_;
+};
 
 QElapsedTimer busy_timer_;
 const int busy_timeout_ = 65; // ms, approximately 15 fps
+// Runs smaller than this aren't worth handing to another thread.
+const int min_sort_run_ = 16384;
 void PacketListModel::sort(int column, Qt::SortOrder order)
 {
     // packet_list_store.c:packet_list_dissect_and_cache_all
     if (!cap_file_ || visible_rows_.count() < 1) return;
     if (column < 0) return;
-
-    sort_column_ = column;
-    text_sort_column_ = PacketListRecord::textColumn(column);
-    sort_order_ = order;
-    sort_cap_file_ = cap_file_;
+    if (sort_in_progress_) return;
 
     gboolean stop_flag = FALSE;
-    QString col_title = get_column_title(column);
+    QVector<PacketListSortKey> keys;
 
-    busy_timer_.start();
-    emit pushProgressStatus(tr("Dissecting"), true, true, &stop_flag);
-    int row_num = 0;
-    foreach (PacketListRecord *row, physical_rows_) {
-        row->columnString(sort_cap_file_, column);
-        row_num++;
-        if (busy_timer_.elapsed() > busy_timeout_) {
-            if (stop_flag) {
-                emit popProgressStatus();
-                return;
-            }
-            emit updateProgressStatus(row_num * 100 / physical_rows_.count());
-            // What's the least amount of processing that we can do which will draw
-            // the progress indicator?
-            wsApp->processEvents(QEventLoop::AllEvents, 1);
-            busy_timer_.restart();
-        }
-    }
-    emit popProgressStatus();
-
-    // XXX Use updateProgress instead. We'd have to switch from std::sort to
-    // something we can interrupt.
-    if (!col_title.isEmpty()) {
-        QString busy_msg = tr("Sorting \"%1\"").arg(col_title);
-        emit pushBusyStatus(busy_msg);
+    sort_in_progress_ = true;
+    bool sorted = fillSortKeys(column, keys, &stop_flag) &&
+                  sortKeys(keys, column, order, &stop_flag);
+    sort_in_progress_ = false;
+    if (!sorted) {
+        return;
     }
 
-    busy_timer_.restart();
-    sort_column_is_numeric_ = isNumericColumn(sort_column_);
-    std::sort(physical_rows_.begin(), physical_rows_.end(), recordLessThan);
-
     beginResetModel();
+    for (int row_num = 0; row_num < keys.count(); row_num++) {
+        physical_rows_[row_num] = keys[row_num].record;
+    }
     visible_rows_.resize(0);
     number_to_row_.fill(0);
     foreach (PacketListRecord *record, physical_rows_) {
@@ -358,122 +511,131 @@ void PacketListModel::sort(int column, Qt::SortOrder order)
     }
     endResetModel();
 
-    if (!col_title.isEmpty()) {
-        emit popBusyStatus();
-    }
-
     if (cap_file_->current_frame) {
         emit goToPacket(cap_file_->current_frame->num);
     }
 }
 
-bool PacketListModel::isNumericColumn(int column)
-{
-    if (column < 0 || sort_cap_file_->cinfo.columns[column].col_fmt != COL_CUSTOM) {
-        return false;
-    }
-
-    guint num_fields = g_slist_length(sort_cap_file_->cinfo.columns[column].col_custom_fields_ids);
-    for (guint i = 0; i < num_fields; i++) {
-        guint *field_idx = (guint *) g_slist_nth_data(sort_cap_file_->cinfo.columns[column].col_custom_fields_ids, i);
-        header_field_info *hfi = proto_registrar_get_nth(*field_idx);
-
-        /*
-         * Reject a field when there is no numeric field type or when:
-         * - there are (value_string) "strings"
-         *   (but do accept fields which have a unit suffix).
-         * - BASE_HEX or BASE_HEX_DEC (these have a constant width, string
-         *   comparison is faster than conversion to double).
-         * - BASE_CUSTOM (these can be formatted in any way).
-         */
-        if (!hfi ||
-              (hfi->strings != NULL && !(hfi->display & BASE_UNIT_STRING)) ||
-              !(((IS_FT_INT(hfi->type) || IS_FT_UINT(hfi->type)) &&
-                 ((FIELD_DISPLAY(hfi->display) == BASE_DEC) ||
-                  (FIELD_DISPLAY(hfi->display) == BASE_OCT) ||
-                  (FIELD_DISPLAY(hfi->display) == BASE_DEC_HEX))) ||
-                (hfi->type == FT_DOUBLE) || (hfi->type == FT_FLOAT) ||
-                (hfi->type == FT_BOOLEAN) || (hfi->type == FT_FRAMENUM) ||
-                (hfi->type == FT_RELATIVE_TIME))) {
-            return false;
+// Dissect each row if needed and fetch its key for the column. Returns false
+// if the user stopped us or our rows changed while we processed events.
+bool PacketListModel::fillSortKeys(int column, QVector<PacketListSortKey> &keys, gboolean *stop_flag)
+{
+    int row_count = physical_rows_.count();
+    bool from_frame_data = PacketListRecord::textColumn(column) < 0;
+    bool typed = !from_frame_data && PacketListRecord::hasSortValue(column);
+    int col_fmt = cap_file_->cinfo.columns[column].col_fmt;
+
+    bool filled = true;
+
+    keys.resize(row_count);
+    // Frame data keys don't need dissection and have no progress of their own.
+    if (!from_frame_data) {
+        emit pushProgressStatus(tr("Dissecting"), true, true, stop_flag);
+    }
+    busy_timer_.start();
+    for (int row_num = 0; row_num < row_count; row_num++) {
+        PacketListSortKey &key = keys[row_num];
+
+        key.record = physical_rows_[row_num];
+        key.num = key.record->frameData()->num;
+        key.str = NULL;
+        key.value = PacketListSortValue();
+        if (from_frame_data) {
+            setFrameSortKey(cap_file_, col_fmt, key);
+        } else {
+            key.str = key.record->columnText(cap_file_, column);
+            if (typed) {
+                key.value = key.record->sortValue(column);
+            }
+        }
+        if (busy_timer_.elapsed() > busy_timeout_) {
+            if (*stop_flag) {
+                filled = false;
+                break;
+            }
+            if (!from_frame_data) {
+                emit updateProgressStatus(row_num * 100 / row_count);
+            }
+            // What's the least amount of processing that we can do which will draw
+            // the progress indicator?
+            wsApp->processEvents(QEventLoop::AllEvents, 1);
+            if (!cap_file_ || physical_rows_.count() != row_count) {
+                filled = false;
+                break;
+            }
+            busy_timer_.restart();
         }
     }
-
-    return true;
+    if (!from_frame_data) {
+        emit popProgressStatus();
+    }
+    return filled;
 }
 
-bool PacketListModel::recordLessThan(PacketListRecord *r1, PacketListRecord *r2)
+// Sort the keys with a merge sort whose runs and merges are spread across
+// sort_pool_, processing events in between so that the user can stop us.
+bool PacketListModel::sortKeys(QVector<PacketListSortKey> &keys, int column, Qt::SortOrder order, gboolean *stop_flag)
 {
-    int cmp_val = 0;
+    int row_count = keys.count();
+    bool typed = PacketListRecord::textColumn(column) >= 0 && PacketListRecord::hasSortValue(column);
+    PacketListSortKeyLessThan less_than(typed, order);
+    PacketListSortKey *base = keys.data();
 
-    // Wherein we try to cram the logic of packet_list_compare_records,
-    // _packet_list_compare_records, and packet_list_compare_custom from
-    // gtk/packet_list_store.c into one function
+    if (row_count <= min_sort_run_) {
+        std::sort(base, base + row_count, less_than);
+        return true;
+    }
+
+    // Use a few more runs than threads so that a slow one doesn't hold up
+    // the others.
+    int run_len = qMax(min_sort_run_, row_count / (sort_pool_.maxThreadCount() * 4) + 1);
+    int passes = 1;
+    for (int width = run_len; width < row_count; width *= 2) {
+        passes++;
+    }
 
-    if (busy_timer_.elapsed() > busy_timeout_) {
-        // What's the least amount of processing that we can do which will draw
-        // the busy indicator?
-        wsApp->processEvents(QEventLoop::ExcludeUserInputEvents | QEventLoop::ExcludeSocketNotifiers, 1);
-        busy_timer_.restart();
-    }
-    if (sort_column_ < 0) {
-        // No column.
-        cmp_val = frame_data_compare(sort_cap_file_->epan, r1->frameData(), r2->frameData(), COL_NUMBER);
-    } else if (text_sort_column_ < 0) {
-        // Column comes directly from frame data
-        cmp_val = frame_data_compare(sort_cap_file_->epan, r1->frameData(), r2->frameData(), sort_cap_file_->cinfo.columns[sort_column_].col_fmt);
-    } else  {
-        if (r1->columnString(sort_cap_file_, sort_column_).constData() == r2->columnString(sort_cap_file_, sort_column_).constData()) {
-            cmp_val = 0;
-        } else if (sort_cap_file_->cinfo.columns[sort_column_].col_fmt == COL_CUSTOM) {
-            // Column comes from custom data
-            if (sort_column_is_numeric_) {
-                // Attempt to convert to numbers.
-                // XXX This is slow. Can we avoid doing this?
-                bool ok_r1, ok_r2;
-                double num_r1 = parseNumericColumn(r1->columnString(sort_cap_file_, sort_column_), &ok_r1);
-                double num_r2 = parseNumericColumn(r2->columnString(sort_cap_file_, sort_column_), &ok_r2);
-
-                if (!ok_r1 && !ok_r2) {
-                    cmp_val = 0;
-                } else if (!ok_r1 || (ok_r2 && num_r1 < num_r2)) {
-                    // either r1 is invalid (and sort it before others) or both
-                    // r1 and r2 are valid (sort normally)
-                    cmp_val = -1;
-                } else if (!ok_r2 || (ok_r1 && num_r1 > num_r2)) {
-                    cmp_val = 1;
-                }
-            } else {
-                cmp_val = strcmp(r1->columnString(sort_cap_file_, sort_column_).constData(), r2->columnString(sort_cap_file_, sort_column_).constData());
+    QString col_title = get_column_title(column);
+    emit pushProgressStatus(tr("Sorting \"%1\"").arg(col_title), true, true, stop_flag);
+    bool stopped = false;
+    for (int pass = 0, width = run_len; pass < passes; pass++) {
+        QAtomicInt done(0);
+        int tasks = 0;
+
+        if (pass == 0) {
+            for (int start = 0; start < row_count; start += run_len) {
+                sort_pool_.start(new PacketListSortTask(base + start, base + start,
+                                                        base + qMin(start + run_len, row_count),
+                                                        less_than, &done));
+                tasks++;
             }
         } else {
-            cmp_val = strcmp(r1->columnString(sort_cap_file_, sort_column_).constData(), r2->columnString(sort_cap_file_, sort_column_).constData());
+            for (int start = 0; start + width < row_count; start += width * 2) {
+                sort_pool_.start(new PacketListSortTask(base + start, base + start + width,
+                                                        base + qMin(start + width * 2, row_count),
+                                                        less_than, &done));
+                tasks++;
+            }
+            width *= 2;
         }
 
-        if (cmp_val == 0) {
-            // All else being equal, compare column numbers.
-            cmp_val = frame_data_compare(sort_cap_file_->epan, r1->frameData(), r2->frameData(), COL_NUMBER);
+        // The tasks reference done and the keys, so we always wait for
+        // them, even if we've been told to stop.
+        while (!sort_pool_.waitForDone(busy_timeout_)) {
+            if (stopped) {
+                continue;
+            }
+            emit updateProgressStatus((pass * 100 + done.loadAcquire() * 100 / tasks) / passes);
+            wsApp->processEvents(QEventLoop::AllEvents, 1);
+            stopped = *stop_flag || !cap_file_ || physical_rows_.count() != row_count;
+        }
+        stopped = stopped || *stop_flag || !cap_file_ || physical_rows_.count() != row_count;
+        if (stopped) {
+            break;
         }
     }
+    emit popProgressStatus();
 
-    if (sort_order_ == Qt::AscendingOrder) {
-        return cmp_val < 0;
-    } else {
-        return cmp_val > 0;
-    }
-}
-
-// Parses a field as a double. Handle values with suffixes ("12ms"), negative
-// values ("-1.23") and fields with multiple occurrences ("1,2"). Marks values
-// that do not contain any numeric value ("Unknown") as invalid.
-double PacketListModel::parseNumericColumn(const QString &val, bool *ok)
-{
-    QByteArray ba = val.toUtf8();
-    const char *strval = ba.constData();
-    gchar *end = NULL;
-    double num = g_ascii_strtod(strval, &end);
-    *ok = strval != end;
-    return num;
+    return !stopped;
 }
 
 // ::data is const so we have to make changes here.
@@ -20,6 +20,7 @@
 
 #include <QAbstractItemModel>
 #include <QFont>
+#include <QThreadPool>
 #include <QVector>
 
 #include "packet_list_record.h"
@@ -28,6 +29,8 @@
 
 class QElapsedTimer;
 
+struct PacketListSortKey;
+
 class PacketListModel : public QAbstractItemModel
 {
     Q_OBJECT
@@ -100,19 +103,18 @@ private:
     int max_row_height_; // px
     int max_line_count_;
 
-    static int sort_column_;
-    static int sort_column_is_numeric_;
-    static int text_sort_column_;
-    static Qt::SortOrder sort_order_;
-    static capture_file *sort_cap_file_;
-    static bool recordLessThan(PacketListRecord *r1, PacketListRecord *r2);
-    static double parseNumericColumn(const QString &val, bool *ok);
+    // Sorting runs the event loop, so we have to guard against being
+    // asked to sort again or to clear our rows while we're at it.
+    bool sort_in_progress_;
+    // Sorts keys precomputed on the GUI thread in parallel. The workers
+    // only compare the keys' values and never call into epan.
+    QThreadPool sort_pool_;
+    bool fillSortKeys(int column, QVector<PacketListSortKey> &keys, gboolean *stop_flag);
+    bool sortKeys(QVector<PacketListSortKey> &keys, int column, Qt::SortOrder order, gboolean *stop_flag);
 
     QElapsedTimer *idle_dissection_timer_;
     int idle_dissection_row_;
 
-    bool isNumericColumn(int column);
-
 private slots:
     void emitItemHeightChanged(const QModelIndex &ih_index);
 };
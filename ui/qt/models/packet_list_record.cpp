@@ -34,13 +34,132 @@ public:
 };
 
 QMap<int, int> PacketListRecord::cinfo_column_;
+QMap<int, int> PacketListRecord::sort_value_column_;
 unsigned PacketListRecord::col_data_ver_ = 1;
 
+enum { sort_num_unsigned_, sort_num_signed_, sort_num_double_ };
+
+void PacketListSortValue::setField(field_info *finfo)
+{
+    type_ = NumericValue;
+    switch (finfo->hfinfo->type) {
+    case FT_CHAR:
+    case FT_UINT8:
+    case FT_UINT16:
+    case FT_UINT24:
+    case FT_UINT32:
+    case FT_FRAMENUM:
+        num_type_ = sort_num_unsigned_;
+        v_.u = fvalue_get_uinteger(&finfo->value);
+        break;
+    case FT_UINT40:
+    case FT_UINT48:
+    case FT_UINT56:
+    case FT_UINT64:
+    case FT_BOOLEAN:
+        num_type_ = sort_num_unsigned_;
+        v_.u = fvalue_get_uinteger64(&finfo->value);
+        break;
+    case FT_INT8:
+    case FT_INT16:
+    case FT_INT24:
+    case FT_INT32:
+        num_type_ = sort_num_signed_;
+        v_.s = fvalue_get_sinteger(&finfo->value);
+        break;
+    case FT_INT40:
+    case FT_INT48:
+    case FT_INT56:
+    case FT_INT64:
+        num_type_ = sort_num_signed_;
+        v_.s = fvalue_get_sinteger64(&finfo->value);
+        break;
+    case FT_FLOAT:
+    case FT_DOUBLE:
+        num_type_ = sort_num_double_;
+        v_.d = fvalue_get_floating(&finfo->value);
+        break;
+    case FT_ABSOLUTE_TIME:
+    case FT_RELATIVE_TIME:
+        type_ = TimeValue;
+        v_.t = *(const nstime_t *)fvalue_get(&finfo->value);
+        break;
+    default:
+        type_ = NoValue;
+        break;
+    }
+}
+
+void PacketListSortValue::setAddress(const address *addr)
+{
+    type_ = NoValue;
+    switch (addr->type) {
+    case AT_ETHER:
+    case AT_IPv4:
+    case AT_IPv6:
+        if (addr->len > 0 && addr->len <= (int) sizeof v_.addr) {
+            type_ = AddressValue;
+            addr_type_ = (guint8) addr->type;
+            addr_len_ = (guint8) addr->len;
+            memcpy(v_.addr, addr->data, addr->len);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+double PacketListSortValue::toDouble() const
+{
+    switch (num_type_) {
+    case sort_num_unsigned_:
+        return (double) v_.u;
+    case sort_num_signed_:
+        return (double) v_.s;
+    default:
+        return v_.d;
+    }
+}
+
+int PacketListSortValue::compare(const PacketListSortValue &other) const
+{
+    if (type_ != other.type_) {
+        return type_ < other.type_ ? -1 : 1;
+    }
+
+    switch (type_) {
+    case NumericValue:
+        if (num_type_ == other.num_type_ && num_type_ == sort_num_unsigned_) {
+            return v_.u < other.v_.u ? -1 : v_.u > other.v_.u;
+        }
+        if (num_type_ == other.num_type_ && num_type_ == sort_num_signed_) {
+            return v_.s < other.v_.s ? -1 : v_.s > other.v_.s;
+        }
+        // Different integer types, e.g. from "a.x or b.y", or floating point.
+        return toDouble() < other.toDouble() ? -1 : toDouble() > other.toDouble();
+    case TimeValue:
+        return nstime_cmp(&v_.t, &other.v_.t);
+    case AddressValue:
+        // The same order as cmp_address().
+        if (addr_type_ != other.addr_type_) {
+            return addr_type_ < other.addr_type_ ? -1 : 1;
+        }
+        if (addr_len_ != other.addr_len_) {
+            return addr_len_ < other.addr_len_ ? -1 : 1;
+        }
+        return memcmp(v_.addr, other.v_.addr, addr_len_);
+    default:
+        return 0;
+    }
+}
+
 PacketListRecord::PacketListRecord(frame_data *frameData) :
     col_text_(0),
     fdata_(frameData),
     lines_(1),
     line_count_changed_(false),
+    sort_values_(NULL),
+    num_sort_values_(0),
     data_ver_(0),
     colorized_(false),
     conv_(NULL)
@@ -52,8 +171,6 @@ void *PacketListRecord::operator new(size_t size)
     return wmem_alloc(wmem_file_scope(), size);
 }
 
-// We might want to return a const char * instead. This would keep us from
-// creating excessive QByteArrays, e.g. in PacketListModel::recordLessThan.
 const QByteArray PacketListRecord::columnString(capture_file *cap_file, int column, bool colorized)
 {
     // packet_list_store.c:packet_list_get_value
@@ -71,6 +188,94 @@ const QByteArray PacketListRecord::columnString(capture_file *cap_file, int colu
     return col_text_->value(column, QByteArray());
 }
 
+const char *PacketListRecord::columnText(capture_file *cap_file, int column)
+{
+    g_assert(fdata_);
+
+    if (!cap_file || column < 0 || column > cap_file->cinfo.num_cols) {
+        return "";
+    }
+
+    if (!col_text_ || column >= col_text_->size() || !col_text_->at(column) || data_ver_ != col_data_ver_) {
+        dissect(cap_file);
+    }
+
+    return col_text_->value(column, "");
+}
+
+PacketListSortValue PacketListRecord::sortValue(int column) const
+{
+    int idx = sort_value_column_.value(column, -1);
+
+    if (idx < 0 || idx >= num_sort_values_ || data_ver_ != col_data_ver_) {
+        return PacketListSortValue();
+    }
+    return sort_values_[idx];
+}
+
+// Can we capture a typed value for this column that sorts the same way
+// as its text would if the text were parsed?
+static bool columnHasSortValue(column_info *cinfo, int column)
+{
+    switch (cinfo->columns[column].col_fmt) {
+    case COL_CUSTOM:
+        break;
+
+    case COL_UNRES_SRC:
+    case COL_UNRES_DL_SRC:
+    case COL_UNRES_NET_SRC:
+    case COL_UNRES_DST:
+    case COL_UNRES_DL_DST:
+    case COL_UNRES_NET_DST:
+        return true;
+
+    case COL_DEF_SRC:
+    case COL_RES_SRC:
+    case COL_DEF_DL_SRC:
+    case COL_RES_DL_SRC:
+    case COL_DEF_NET_SRC:
+    case COL_RES_NET_SRC:
+    case COL_DEF_DST:
+    case COL_RES_DST:
+    case COL_DEF_DL_DST:
+    case COL_RES_DL_DST:
+    case COL_DEF_NET_DST:
+    case COL_RES_NET_DST:
+        // Sort resolved names by name.
+        return !get_column_resolved(column);
+
+    default:
+        return false;
+    }
+
+    GSList *field_ids = cinfo->columns[column].col_custom_fields_ids;
+    if (!field_ids) {
+        return false;
+    }
+
+    for (; field_ids; field_ids = g_slist_next(field_ids)) {
+        header_field_info *hfi = proto_registrar_get_nth(*(guint *) field_ids->data);
+
+        /*
+         * Reject a field when there is no numeric or time field type or when:
+         * - there are (value_string) "strings"
+         *   (but do accept fields which have a unit suffix).
+         * - BASE_CUSTOM (these can be formatted in any way).
+         */
+        if (!hfi ||
+              (hfi->strings != NULL && !(hfi->display & BASE_UNIT_STRING)) ||
+              !(((IS_FT_INT(hfi->type) || IS_FT_UINT(hfi->type)) &&
+                 (FIELD_DISPLAY(hfi->display) != BASE_CUSTOM)) ||
+                (hfi->type == FT_DOUBLE) || (hfi->type == FT_FLOAT) ||
+                (hfi->type == FT_BOOLEAN) ||
+                (hfi->type == FT_ABSOLUTE_TIME) || (hfi->type == FT_RELATIVE_TIME))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void PacketListRecord::resetColumns(column_info *cinfo)
 {
     invalidateAllRecords();
@@ -80,11 +285,16 @@ void PacketListRecord::resetColumns(column_info *cinfo)
     }
 
     cinfo_column_.clear();
-    int i, j;
-    for (i = 0, j = 0; i < cinfo->num_cols; i++) {
+    sort_value_column_.clear();
+    int i, j, k;
+    for (i = 0, j = 0, k = 0; i < cinfo->num_cols; i++) {
         if (!col_based_on_frame_data(cinfo, i)) {
             cinfo_column_[i] = j;
             j++;
+            if (columnHasSortValue(cinfo, i)) {
+                sort_value_column_[i] = k;
+                k++;
+            }
         }
     }
 }
@@ -132,6 +342,7 @@ void PacketListRecord::dissect(capture_file *cap_file, bool dissect_color)
             col_fill_in_error(cinfo, fdata_, FALSE, FALSE /* fill_fd_columns */);
 
             cacheColumnStrings(cinfo);
+            cacheSortValues(cinfo, NULL, NULL);
         }
         if (dissect_color) {
             fdata_->color_filter = NULL;
@@ -181,6 +392,7 @@ void PacketListRecord::dissect(capture_file *cap_file, bool dissect_color)
         /* "Stringify" non frame_data vals */
         epan_dissect_fill_in_columns(&edt, FALSE, FALSE /* fill_fd_columns */);
         cacheColumnStrings(cinfo);
+        cacheSortValues(cinfo, &edt.pi, edt.tree);
     }
 
     if (dissect_color) {
@@ -308,6 +520,77 @@ void PacketListRecord::cacheColumnStrings(column_info *cinfo)
     }
 }
 
+// Capture the typed values of the columns in sort_value_column_. pinfo is
+// NULL if the record couldn't be read.
+void PacketListRecord::cacheSortValues(column_info *cinfo, packet_info *pinfo, proto_tree *tree)
+{
+    if (sort_value_column_.isEmpty()) {
+        return;
+    }
+
+    if (num_sort_values_ != sort_value_column_.size()) {
+        // Resize in place so that changing the columns doesn't leave the
+        // old array behind for the life of the file.
+        num_sort_values_ = sort_value_column_.size();
+        sort_values_ = (PacketListSortValue *) wmem_realloc(wmem_file_scope(), sort_values_, num_sort_values_ * sizeof(PacketListSortValue));
+    }
+
+    QMap<int, int>::const_iterator it;
+    for (it = sort_value_column_.constBegin(); it != sort_value_column_.constEnd(); ++it) {
+        int column = it.key();
+        PacketListSortValue &value = sort_values_[it.value()];
+
+        value = PacketListSortValue();
+        if (!pinfo) {
+            continue;
+        }
+
+        switch (cinfo->columns[column].col_fmt) {
+        case COL_CUSTOM:
+        {
+            field_info *finfo = proto_custom_get_finfo(tree, cinfo->columns[column].col_custom_fields_ids,
+                                                       cinfo->columns[column].col_custom_occurrence);
+            if (finfo) {
+                value.setField(finfo);
+            }
+            break;
+        }
+        case COL_DEF_SRC:
+        case COL_RES_SRC:
+        case COL_UNRES_SRC:
+            value.setAddress(&pinfo->src);
+            break;
+        case COL_DEF_DL_SRC:
+        case COL_RES_DL_SRC:
+        case COL_UNRES_DL_SRC:
+            value.setAddress(&pinfo->dl_src);
+            break;
+        case COL_DEF_NET_SRC:
+        case COL_RES_NET_SRC:
+        case COL_UNRES_NET_SRC:
+            value.setAddress(&pinfo->net_src);
+            break;
+        case COL_DEF_DST:
+        case COL_RES_DST:
+        case COL_UNRES_DST:
+            value.setAddress(&pinfo->dst);
+            break;
+        case COL_DEF_DL_DST:
+        case COL_RES_DL_DST:
+        case COL_UNRES_DL_DST:
+            value.setAddress(&pinfo->dl_dst);
+            break;
+        case COL_DEF_NET_DST:
+        case COL_RES_NET_DST:
+        case COL_UNRES_NET_DST:
+            value.setAddress(&pinfo->net_dst);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 /*
  * Editor modelines
  *
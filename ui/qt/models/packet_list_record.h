@@ -18,6 +18,9 @@
 
 #include <epan/column-info.h>
 #include <epan/packet.h>
+#include <epan/proto.h>
+
+#include <wsutil/nstime.h>
 
 #include <QByteArray>
 #include <QList>
@@ -28,6 +31,37 @@ struct _GStringChunk;
 
 class ColumnTextList;
 
+// The value underlying a column, captured when the record is dissected so
+// that sorting can compare it directly instead of parsing the column text.
+class PacketListSortValue
+{
+public:
+    // Values of different types sort in this order.
+    enum ValueType { NoValue, NumericValue, TimeValue, AddressValue };
+
+    PacketListSortValue() : type_(NoValue), num_type_(0), addr_type_(0), addr_len_(0) {}
+
+    void setField(field_info *finfo);
+    void setAddress(const address *addr);
+    bool isValid() const { return type_ != NoValue; }
+    int compare(const PacketListSortValue &other) const;
+
+private:
+    union {
+        guint64 u;
+        gint64 s;
+        double d;
+        nstime_t t;
+        guint8 addr[16];
+    } v_;
+    guint8 type_;
+    guint8 num_type_;   // Which of u, s and d holds a NumericValue
+    guint8 addr_type_;
+    guint8 addr_len_;
+
+    double toDouble() const;
+};
+
 class PacketListRecord
 {
 public:
@@ -39,6 +73,15 @@ public:
 
     // Return the string value for a column. Data is cached if possible.
     const QByteArray columnString(capture_file *cap_file, int column, bool colorized = false);
+    // Return the cached string for a column without copying it, dissecting
+    // the record first if needed. The string remains valid until the string
+    // pool is cleared.
+    const char *columnText(capture_file *cap_file, int column);
+    // Return the typed value of a column as of the last time the record was
+    // dissected, which is invalid if the column doesn't have one.
+    PacketListSortValue sortValue(int column) const;
+    // Does this column have typed values?
+    static bool hasSortValue(int column) { return sort_value_column_.contains(column); }
     frame_data *frameData() const { return fdata_; }
     // packet_list->col_to_text in gtk/packet_list_store.c
     static int textColumn(int column) { return cinfo_column_.value(column, -1); }
@@ -63,6 +106,12 @@ private:
     bool line_count_changed_;
     static QMap<int, int> cinfo_column_;
 
+    /** Typed values of the columns in sort_value_column_ */
+    PacketListSortValue *sort_values_;
+    int num_sort_values_;
+    /** Maps columns that have typed values to their index in sort_values_ */
+    static QMap<int, int> sort_value_column_;
+
     /** Data versions. Used to invalidate col_text_ */
     static unsigned col_data_ver_;
     unsigned data_ver_;
@@ -74,6 +123,7 @@ private:
 
     void dissect(capture_file *cap_file, bool dissect_color = false);
     void cacheColumnStrings(column_info *cinfo);
+    void cacheSortValues(column_info *cinfo, packet_info *pinfo, proto_tree *tree);
 
     static struct _GStringChunk *string_pool_;
 
@@ -1133,19 +1133,11 @@ success:
 }
 
 /*
- * Given the pathname of the file we just closed with wtap_fdclose(), attempt
- * to reopen that file and assign the new file descriptor(s) to the sequential
- * stream and, if do_random is TRUE, to the random stream.  Used on Windows
- * after the rename of a file we had open was done or if the rename of a
- * file on top of a file we had open failed.
- *
- * This is only required by Wireshark, not TShark, and, at the point that
- * Wireshark is doing this, the sequential stream is closed, and the
- * random stream is open, so this refuses to open pipes, and only
- * reopens the random stream.
+ * Check that a file we closed with wtap_fdclose() is a regular file that
+ * can be opened again.
  */
-gboolean
-wtap_fdreopen(wtap *wth, const char *filename, int *err)
+static gboolean
+wtap_fdreopen_check(const char *filename, int *err)
 {
 	ws_statb64 statb;
 
@@ -1184,6 +1176,26 @@ wtap_fdreopen(wtap *wth, const char *filename, int *err)
 		*err = WTAP_ERR_NOT_REGULAR_FILE;
 		return FALSE;
 	}
+	return TRUE;
+}
+
+/*
+ * Given the pathname of the file we just closed with wtap_fdclose(), attempt
+ * to reopen that file and assign the new file descriptor(s) to the sequential
+ * stream and, if do_random is TRUE, to the random stream.  Used on Windows
+ * after the rename of a file we had open was done or if the rename of a
+ * file on top of a file we had open failed.
+ *
+ * This is only required by Wireshark, not TShark, and, at the point that
+ * Wireshark is doing this, the sequential stream is closed, and the
+ * random stream is open, so this refuses to open pipes, and only
+ * reopens the random stream.
+ */
+gboolean
+wtap_fdreopen(wtap *wth, const char *filename, int *err)
+{
+	if (!wtap_fdreopen_check(filename, err))
+		return FALSE;
 
 	/* Open the file */
 	errno = WTAP_ERR_CANT_OPEN;
@@ -1194,6 +1206,29 @@ wtap_fdreopen(wtap *wth, const char *filename, int *err)
 	return TRUE;
 }
 
+/*
+ * Given the pathname of the file we closed with wtap_fdclose(), reopen it
+ * for the sequential stream, positioned where the old descriptor was.
+ * Used by mergecap to limit the number of input files it keeps open.
+ */
+gboolean
+wtap_sequential_fdreopen(wtap *wth, const char *filename, int *err)
+{
+	if (wth->fh == NULL) {
+		*err = WTAP_ERR_CANT_OPEN;
+		return FALSE;
+	}
+	if (!wtap_fdreopen_check(filename, err))
+		return FALSE;
+
+	errno = WTAP_ERR_CANT_OPEN;
+	if (!file_fdreopen(wth->fh, filename)) {
+		*err = errno;
+		return FALSE;
+	}
+	return TRUE;
+}
+
 /* Table of the file types and subtypes for which we have built-in support.
    Entries must be sorted by WTAP_FILE_TYPE_SUBTYPE_xxx values in ascending
    order.
@@ -2133,7 +2168,7 @@ wtap_dump_can_open(int file_type_subtype)
 	return TRUE;
 }
 
-#ifdef HAVE_ZLIB
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD) || defined(USE_LZ4)
 gboolean
 wtap_dump_can_compress(int file_type_subtype)
 {
@@ -2181,17 +2216,17 @@ wtap_dump_supports_comment_types(int file_type_subtype, guint32 comment_types)
 	return FALSE;
 }
 
-static gboolean wtap_dump_open_check(int file_type_subtype, int encap, gboolean comressed, int *err);
+static gboolean wtap_dump_open_check(int file_type_subtype, int encap, wtap_compression_type compression_type, int *err);
 static wtap_dumper* wtap_dump_alloc_wdh(int file_type_subtype, int encap, int snaplen,
-					gboolean compressed, int *err);
-static gboolean wtap_dump_open_finish(wtap_dumper *wdh, int file_type_subtype, gboolean compressed, int *err);
+					wtap_compression_type compression_type, int *err);
+static gboolean wtap_dump_open_finish(wtap_dumper *wdh, int file_type_subtype, wtap_compression_type compression_type, int *err);
 
 static WFILE_T wtap_dump_file_open(wtap_dumper *wdh, const char *filename);
 static WFILE_T wtap_dump_file_fdopen(wtap_dumper *wdh, int fd);
 static int wtap_dump_file_close(wtap_dumper *wdh);
 
 static wtap_dumper *
-wtap_dump_init_dumper(int file_type_subtype, int encap, int snaplen, gboolean compressed,
+wtap_dump_init_dumper(int file_type_subtype, int encap, int snaplen, wtap_compression_type compression_type,
                       GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
                       GArray* nrb_hdrs, int *err)
 {
@@ -2201,11 +2236,11 @@ wtap_dump_init_dumper(int file_type_subtype, int encap, int snaplen, gboolean co
 
 	/* Check whether we can open a capture file with that file type
 	   and that encapsulation. */
-	if (!wtap_dump_open_check(file_type_subtype, encap, compressed, err))
+	if (!wtap_dump_open_check(file_type_subtype, encap, compression_type, err))
 		return NULL;
 
 	/* Allocate a data structure for the output stream. */
-	wdh = wtap_dump_alloc_wdh(file_type_subtype, encap, snaplen, compressed, err);
+	wdh = wtap_dump_alloc_wdh(file_type_subtype, encap, snaplen, compression_type, err);
 	if (wdh == NULL)
 		return NULL;	/* couldn't allocate it */
 
@@ -2266,21 +2301,21 @@ wtap_dump_init_dumper(int file_type_subtype, int encap, int snaplen, gboolean co
 
 wtap_dumper *
 wtap_dump_open(const char *filename, int file_type_subtype, int encap,
-	       int snaplen, gboolean compressed, int *err)
+	       int snaplen, wtap_compression_type compression_type, int *err)
 {
-	return wtap_dump_open_ng(filename, file_type_subtype, encap,snaplen, compressed, NULL, NULL, NULL, err);
+	return wtap_dump_open_ng(filename, file_type_subtype, encap,snaplen, compression_type, NULL, NULL, NULL, err);
 }
 
 wtap_dumper *
 wtap_dump_open_ng(const char *filename, int file_type_subtype, int encap,
-		  int snaplen, gboolean compressed, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
+		  int snaplen, wtap_compression_type compression_type, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
 		  GArray* nrb_hdrs, int *err)
 {
 	wtap_dumper *wdh;
 	WFILE_T fh;
 
 	/* Allocate and initialize a data structure for the output stream. */
-	wdh = wtap_dump_init_dumper(file_type_subtype, encap, snaplen, compressed,
+	wdh = wtap_dump_init_dumper(file_type_subtype, encap, snaplen, compression_type,
 	    shb_hdrs, idb_inf, nrb_hdrs, err);
 	if (wdh == NULL)
 		return NULL;
@@ -2296,7 +2331,7 @@ wtap_dump_open_ng(const char *filename, int file_type_subtype, int encap,
 	}
 	wdh->fh = fh;
 
-	if (!wtap_dump_open_finish(wdh, file_type_subtype, compressed, err)) {
+	if (!wtap_dump_open_finish(wdh, file_type_subtype, compression_type, err)) {
 		/* Get rid of the file we created; we couldn't finish
 		   opening it. */
 		wtap_dump_file_close(wdh);
@@ -2310,15 +2345,15 @@ wtap_dump_open_ng(const char *filename, int file_type_subtype, int encap,
 wtap_dumper *
 wtap_dump_open_tempfile(char **filenamep, const char *pfx,
 			int file_type_subtype, int encap,
-			int snaplen, gboolean compressed, int *err)
+			int snaplen, wtap_compression_type compression_type, int *err)
 {
-	return wtap_dump_open_tempfile_ng(filenamep, pfx, file_type_subtype, encap,snaplen, compressed, NULL, NULL, NULL, err);
+	return wtap_dump_open_tempfile_ng(filenamep, pfx, file_type_subtype, encap,snaplen, compression_type, NULL, NULL, NULL, err);
 }
 
 wtap_dumper *
 wtap_dump_open_tempfile_ng(char **filenamep, const char *pfx,
 			   int file_type_subtype, int encap,
-			   int snaplen, gboolean compressed,
+			   int snaplen, wtap_compression_type compression_type,
 			   GArray* shb_hdrs,
 			   wtapng_iface_descriptions_t *idb_inf,
 			   GArray* nrb_hdrs, int *err)
@@ -2332,7 +2367,7 @@ wtap_dump_open_tempfile_ng(char **filenamep, const char *pfx,
 	*filenamep = NULL;
 
 	/* Allocate and initialize a data structure for the output stream. */
-	wdh = wtap_dump_init_dumper(file_type_subtype, encap, snaplen, compressed,
+	wdh = wtap_dump_init_dumper(file_type_subtype, encap, snaplen, compression_type,
 	    shb_hdrs, idb_inf, nrb_hdrs, err);
 	if (wdh == NULL)
 		return NULL;
@@ -2358,7 +2393,7 @@ wtap_dump_open_tempfile_ng(char **filenamep, const char *pfx,
 	}
 	wdh->fh = fh;
 
-	if (!wtap_dump_open_finish(wdh, file_type_subtype, compressed, err)) {
+	if (!wtap_dump_open_finish(wdh, file_type_subtype, compression_type, err)) {
 		/* Get rid of the file we created; we couldn't finish
 		   opening it. */
 		wtap_dump_file_close(wdh);
@@ -2371,21 +2406,21 @@ wtap_dump_open_tempfile_ng(char **filenamep, const char *pfx,
 
 wtap_dumper *
 wtap_dump_fdopen(int fd, int file_type_subtype, int encap, int snaplen,
-		 gboolean compressed, int *err)
+		 wtap_compression_type compression_type, int *err)
 {
-	return wtap_dump_fdopen_ng(fd, file_type_subtype, encap, snaplen, compressed, NULL, NULL, NULL, err);
+	return wtap_dump_fdopen_ng(fd, file_type_subtype, encap, snaplen, compression_type, NULL, NULL, NULL, err);
 }
 
 wtap_dumper *
 wtap_dump_fdopen_ng(int fd, int file_type_subtype, int encap, int snaplen,
-		    gboolean compressed, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
+		    wtap_compression_type compression_type, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
 		    GArray* nrb_hdrs, int *err)
 {
 	wtap_dumper *wdh;
 	WFILE_T fh;
 
 	/* Allocate and initialize a data structure for the output stream. */
-	wdh = wtap_dump_init_dumper(file_type_subtype, encap, snaplen, compressed,
+	wdh = wtap_dump_init_dumper(file_type_subtype, encap, snaplen, compression_type,
 	    shb_hdrs, idb_inf, nrb_hdrs, err);
 	if (wdh == NULL)
 		return NULL;
@@ -2401,7 +2436,7 @@ wtap_dump_fdopen_ng(int fd, int file_type_subtype, int encap, int snaplen,
 	}
 	wdh->fh = fh;
 
-	if (!wtap_dump_open_finish(wdh, file_type_subtype, compressed, err)) {
+	if (!wtap_dump_open_finish(wdh, file_type_subtype, compression_type, err)) {
 		wtap_dump_file_close(wdh);
 		g_free(wdh);
 		return NULL;
@@ -2411,14 +2446,14 @@ wtap_dump_fdopen_ng(int fd, int file_type_subtype, int encap, int snaplen,
 
 wtap_dumper *
 wtap_dump_open_stdout(int file_type_subtype, int encap, int snaplen,
-		      gboolean compressed, int *err)
+		      wtap_compression_type compression_type, int *err)
 {
-	return wtap_dump_open_stdout_ng(file_type_subtype, encap, snaplen, compressed, NULL, NULL, NULL, err);
+	return wtap_dump_open_stdout_ng(file_type_subtype, encap, snaplen, compression_type, NULL, NULL, NULL, err);
 }
 
 wtap_dumper *
 wtap_dump_open_stdout_ng(int file_type_subtype, int encap, int snaplen,
-			 gboolean compressed, GArray* shb_hdrs,
+			 wtap_compression_type compression_type, GArray* shb_hdrs,
 			 wtapng_iface_descriptions_t *idb_inf,
 			 GArray* nrb_hdrs, int *err)
 {
@@ -2452,7 +2487,7 @@ wtap_dump_open_stdout_ng(int file_type_subtype, int encap, int snaplen,
 #endif
 
 	wdh = wtap_dump_fdopen_ng(new_fd, file_type_subtype, encap, snaplen,
-	    compressed, shb_hdrs, idb_inf, nrb_hdrs, err);
+	    compression_type, shb_hdrs, idb_inf, nrb_hdrs, err);
 	if (wdh == NULL) {
 		/* Failed; close the new FD */
 		ws_close(new_fd);
@@ -2462,7 +2497,7 @@ wtap_dump_open_stdout_ng(int file_type_subtype, int encap, int snaplen,
 }
 
 static gboolean
-wtap_dump_open_check(int file_type_subtype, int encap, gboolean compressed, int *err)
+wtap_dump_open_check(int file_type_subtype, int encap, wtap_compression_type compression_type, int *err)
 {
 	if (!wtap_dump_can_open(file_type_subtype)) {
 		/* Invalid type, or type we don't know how to write. */
@@ -2485,8 +2520,11 @@ wtap_dump_open_check(int file_type_subtype, int encap, gboolean compressed, int
 	if (*err != 0)
 		return FALSE;
 
-	/* if compression is wanted, do we support this for this file_type_subtype? */
-	if(compressed && !wtap_dump_can_compress(file_type_subtype)) {
+	/* if compression is wanted, do we support this for this file_type_subtype,
+	   and can we write that type of compression? */
+	if(compression_type != WTAP_UNCOMPRESSED &&
+	   (!wtap_dump_can_compress(file_type_subtype) ||
+	    !wtap_can_write_compression_type(compression_type))) {
 		*err = WTAP_ERR_COMPRESSION_NOT_SUPPORTED;
 		return FALSE;
 	}
@@ -2496,7 +2534,7 @@ wtap_dump_open_check(int file_type_subtype, int encap, gboolean compressed, int
 }
 
 static wtap_dumper *
-wtap_dump_alloc_wdh(int file_type_subtype, int encap, int snaplen, gboolean compressed, int *err)
+wtap_dump_alloc_wdh(int file_type_subtype, int encap, int snaplen, wtap_compression_type compression_type, int *err)
 {
 	wtap_dumper *wdh;
 
@@ -2509,20 +2547,20 @@ wtap_dump_alloc_wdh(int file_type_subtype, int encap, int snaplen, gboolean comp
 	wdh->file_type_subtype = file_type_subtype;
 	wdh->snaplen = snaplen;
 	wdh->encap = encap;
-	wdh->compressed = compressed;
+	wdh->compression_type = compression_type;
 	wdh->wslua_data = NULL;
 	return wdh;
 }
 
 static gboolean
-wtap_dump_open_finish(wtap_dumper *wdh, int file_type_subtype, gboolean compressed, int *err)
+wtap_dump_open_finish(wtap_dumper *wdh, int file_type_subtype, wtap_compression_type compression_type, int *err)
 {
 	int fd;
 	gboolean cant_seek;
 
 	/* Can we do a seek on the file descriptor?
 	   If not, note that fact. */
-	if(compressed) {
+	if(compression_type != WTAP_UNCOMPRESSED) {
 		cant_seek = TRUE;
 	} else {
 		fd = ws_fileno((FILE *)wdh->fh);
@@ -2567,13 +2605,21 @@ wtap_dump(wtap_dumper *wdh, const wtap_rec *rec,
 void
 wtap_dump_flush(wtap_dumper *wdh)
 {
+	switch (wdh->compression_type) {
 #ifdef HAVE_ZLIB
-	if(wdh->compressed) {
+	case WTAP_GZIP_COMPRESSED:
 		gzwfile_flush((GZWFILE_T)wdh->fh);
-	} else
+		break;
 #endif
-	{
+#if defined(HAVE_ZSTD) || defined(USE_LZ4)
+	case WTAP_ZSTD_COMPRESSED:
+	case WTAP_LZ4_COMPRESSED:
+		framewfile_flush((FRAMEWFILE_T)wdh->fh);
+		break;
+#endif
+	default:
 		fflush((FILE *)wdh->fh);
+		break;
 	}
 }
 
@@ -2639,42 +2685,42 @@ gboolean wtap_dump_get_needs_reload(wtap_dumper *wdh) {
 }
 
 /* internally open a file for writing (compressed or not) */
-#ifdef HAVE_ZLIB
 static WFILE_T
 wtap_dump_file_open(wtap_dumper *wdh, const char *filename)
 {
-	if(wdh->compressed) {
+	switch (wdh->compression_type) {
+#ifdef HAVE_ZLIB
+	case WTAP_GZIP_COMPRESSED:
 		return gzwfile_open(filename);
-	} else {
+#endif
+#if defined(HAVE_ZSTD) || defined(USE_LZ4)
+	case WTAP_ZSTD_COMPRESSED:
+	case WTAP_LZ4_COMPRESSED:
+		return framewfile_open(filename, wdh->compression_type);
+#endif
+	default:
 		return ws_fopen(filename, "wb");
 	}
 }
-#else
-static WFILE_T
-wtap_dump_file_open(wtap_dumper *wdh _U_, const char *filename)
-{
-	return ws_fopen(filename, "wb");
-}
-#endif
 
 /* internally open a file for writing (compressed or not) */
-#ifdef HAVE_ZLIB
 static WFILE_T
 wtap_dump_file_fdopen(wtap_dumper *wdh, int fd)
 {
-	if(wdh->compressed) {
+	switch (wdh->compression_type) {
+#ifdef HAVE_ZLIB
+	case WTAP_GZIP_COMPRESSED:
 		return gzwfile_fdopen(fd);
-	} else {
+#endif
+#if defined(HAVE_ZSTD) || defined(USE_LZ4)
+	case WTAP_ZSTD_COMPRESSED:
+	case WTAP_LZ4_COMPRESSED:
+		return framewfile_fdopen(fd, wdh->compression_type);
+#endif
+	default:
 		return ws_fdopen(fd, "wb");
 	}
 }
-#else
-static WFILE_T
-wtap_dump_file_fdopen(wtap_dumper *wdh _U_, int fd)
-{
-	return ws_fdopen(fd, "wb");
-}
-#endif
 
 /* internally writing raw bytes (compressed or not) */
 gboolean
@@ -2683,7 +2729,7 @@ wtap_dump_file_write(wtap_dumper *wdh, const void *buf, size_t bufsize, int *err
 	size_t nwritten;
 
 #ifdef HAVE_ZLIB
-	if (wdh->compressed) {
+	if (wdh->compression_type == WTAP_GZIP_COMPRESSED) {
 		nwritten = gzwfile_write((GZWFILE_T)wdh->fh, buf, (unsigned int) bufsize);
 		/*
 		 * gzwfile_write() returns 0 on error.
@@ -2693,6 +2739,19 @@ wtap_dump_file_write(wtap_dumper *wdh, const void *buf, size_t bufsize, int *err
 			return FALSE;
 		}
 	} else
+#endif
+#if defined(HAVE_ZSTD) || defined(USE_LZ4)
+	if (wdh->compression_type == WTAP_ZSTD_COMPRESSED ||
+	    wdh->compression_type == WTAP_LZ4_COMPRESSED) {
+		nwritten = framewfile_write((FRAMEWFILE_T)wdh->fh, buf, (unsigned int) bufsize);
+		/*
+		 * framewfile_write() returns 0 on error.
+		 */
+		if (nwritten == 0) {
+			*err = framewfile_geterr((FRAMEWFILE_T)wdh->fh);
+			return FALSE;
+		}
+	} else
 #endif
 	{
 		errno = WTAP_ERR_CANT_WRITE;
@@ -2716,23 +2775,28 @@ wtap_dump_file_write(wtap_dumper *wdh, const void *buf, size_t bufsize, int *err
 static int
 wtap_dump_file_close(wtap_dumper *wdh)
 {
+	switch (wdh->compression_type) {
 #ifdef HAVE_ZLIB
-	if(wdh->compressed)
+	case WTAP_GZIP_COMPRESSED:
 		return gzwfile_close((GZWFILE_T)wdh->fh);
-	else
 #endif
+#if defined(HAVE_ZSTD) || defined(USE_LZ4)
+	case WTAP_ZSTD_COMPRESSED:
+	case WTAP_LZ4_COMPRESSED:
+		return framewfile_close((FRAMEWFILE_T)wdh->fh);
+#endif
+	default:
 		return fclose((FILE *)wdh->fh);
+	}
 }
 
 gint64
 wtap_dump_file_seek(wtap_dumper *wdh, gint64 offset, int whence, int *err)
 {
-#ifdef HAVE_ZLIB
-	if(wdh->compressed) {
+	if(wdh->compression_type != WTAP_UNCOMPRESSED) {
 		*err = WTAP_ERR_CANT_SEEK_COMPRESSED;
 		return -1;
 	} else
-#endif
 	{
 		if (-1 == fseek((FILE *)wdh->fh, (long)offset, whence)) {
 			*err = errno;
@@ -2748,12 +2812,10 @@ gint64
 wtap_dump_file_tell(wtap_dumper *wdh, int *err)
 {
 	gint64 rval;
-#ifdef HAVE_ZLIB
-	if(wdh->compressed) {
+	if(wdh->compression_type != WTAP_UNCOMPRESSED) {
 		*err = WTAP_ERR_CANT_SEEK_COMPRESSED;
 		return -1;
 	} else
-#endif
 	{
 		if (-1 == (rval = ftell((FILE *)wdh->fh))) {
 			*err = errno;
@@ -21,12 +21,21 @@
 #include "wtap-int.h"
 #include "file_wrappers.h"
 #include <wsutil/file_util.h>
+#include <wsutil/pint.h>
 
 #ifdef HAVE_ZLIB
 #define ZLIB_CONST
 #include <zlib.h>
 #endif /* HAVE_ZLIB */
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif /* HAVE_ZSTD */
+
+#ifdef USE_LZ4
+#include <lz4frame.h>
+#endif /* USE_LZ4 */
+
 /*
  * See RFC 1952:
  *
@@ -34,6 +43,14 @@
  *
  * for a description of the gzip file format.
  *
+ * See
+ *
+ *      https://github.com/facebook/zstd/blob/dev/doc/zstd_compression_format.md
+ *      https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md
+ *      https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+ *
+ * for descriptions of the Zstandard and LZ4 frame formats.
+ *
  * Some other compressed file formats we might want to support:
  *
  *      XZ format: http://tukaani.org/xz/
@@ -52,10 +69,101 @@
 const char *compressed_file_extension_table[] = {
 #ifdef HAVE_ZLIB
     "gz",
+#endif
+#ifdef HAVE_ZSTD
+    "zst",
+#endif
+#ifdef USE_LZ4
+    "lz4",
 #endif
     NULL
 };
 
+/*
+ * Compression types we can write, with their names and the extension
+ * for files compressed that way.
+ */
+static const struct compression_type {
+    wtap_compression_type type;
+    const char *extension;
+    const char *name;
+} compression_types[] = {
+#ifdef HAVE_ZLIB
+    { WTAP_GZIP_COMPRESSED, "gz", "gzip" },
+#endif
+#ifdef HAVE_ZSTD
+    { WTAP_ZSTD_COMPRESSED, "zst", "zstd" },
+#endif
+#ifdef USE_LZ4
+    { WTAP_LZ4_COMPRESSED, "lz4", "lz4" },
+#endif
+    { WTAP_UNKNOWN_COMPRESSION, NULL, NULL }
+};
+
+static const struct compression_type *
+compression_type_lookup(wtap_compression_type compression_type)
+{
+    const struct compression_type *p;
+
+    for (p = compression_types; p->type != WTAP_UNKNOWN_COMPRESSION; p++) {
+        if (p->type == compression_type)
+            return p;
+    }
+    return NULL;
+}
+
+wtap_compression_type
+wtap_name_to_compression_type(const char *name)
+{
+    const struct compression_type *p;
+
+    if (g_ascii_strcasecmp(name, "none") == 0)
+        return WTAP_UNCOMPRESSED;
+    for (p = compression_types; p->type != WTAP_UNKNOWN_COMPRESSION; p++) {
+        if (g_ascii_strcasecmp(name, p->name) == 0)
+            return p->type;
+    }
+    return WTAP_UNKNOWN_COMPRESSION;
+}
+
+const char *
+wtap_compression_type_name(wtap_compression_type compression_type)
+{
+    const struct compression_type *p;
+
+    if (compression_type == WTAP_UNCOMPRESSED)
+        return "none";
+    p = compression_type_lookup(compression_type);
+    return p != NULL ? p->name : NULL;
+}
+
+const char *
+wtap_compression_type_extension(wtap_compression_type compression_type)
+{
+    const struct compression_type *p;
+
+    p = compression_type_lookup(compression_type);
+    return p != NULL ? p->extension : NULL;
+}
+
+gboolean
+wtap_can_write_compression_type(wtap_compression_type compression_type)
+{
+    return compression_type == WTAP_UNCOMPRESSED ||
+           compression_type_lookup(compression_type) != NULL;
+}
+
+GSList *
+wtap_get_all_compression_type_names_list(void)
+{
+    const struct compression_type *p;
+    GSList *names = NULL;
+
+    for (p = compression_types; p->type != WTAP_UNKNOWN_COMPRESSION; p++)
+        names = g_slist_append(names, (gpointer)p->name);
+    return names;
+}
+
 /* #define GZBUFSIZE 8192 */
 #define GZBUFSIZE 4096
 
@@ -65,8 +173,10 @@ typedef enum {
     UNCOMPRESSED,  /* uncompressed - copy input directly */
 #ifdef HAVE_ZLIB
     ZLIB,          /* decompress a zlib stream */
-    GZIP_AFTER_HEADER
+    GZIP_AFTER_HEADER,
 #endif
+    ZSTD,          /* decompress a Zstandard frame */
+    LZ4            /* decompress an LZ4 frame */
 } compression_t;
 
 struct wtap_reader_buf {
@@ -102,10 +212,19 @@ struct wtap_reader {
     /* zlib inflate stream */
     z_stream strm;              /* stream structure in-place (not a pointer) */
     gboolean dont_check_crc;    /* TRUE if we aren't supposed to check the CRC */
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zstd;         /* zstd decompression context, NULL until needed */
+#endif
+#ifdef USE_LZ4
+    LZ4F_dctx *lz4;             /* LZ4 decompression context, NULL until needed */
 #endif
     /* fast seeking */
     GPtrArray *fast_seek;
     void *fast_seek_cur;
+
+    /* background read-ahead, if enabled */
+    struct read_ahead *read_ahead;
 };
 
 /* Current read offset within a buffer. */
@@ -194,6 +313,27 @@ fill_in_buffer(FILE_T state)
     return 0;
 }
 
+/* Make sure there are at least n bytes in the input buffer, unless we
+   reach the end of the file first.  n must be less than the buffer size. */
+static int
+fill_in_buffer_n(FILE_T state, guint n)
+{
+    if (state->in.avail >= n)
+        return 0;
+
+    /* Move what we have to the beginning, so that we read after it
+       rather than starting over at the beginning of the buffer. */
+    if (state->in.next != state->in.buf) {
+        memmove(state->in.buf, state->in.next, state->in.avail);
+        state->in.next = state->in.buf;
+    }
+    while (state->in.avail < n && !state->eof) {
+        if (fill_in_buffer(state) == -1)
+            return -1;
+    }
+    return 0;
+}
+
 #define ZLIB_WINSIZE 32768
 
 struct fast_seek_point {
@@ -596,6 +736,169 @@ DIAG_ON(cast-qual)
 }
 #endif
 
+/*
+ * Zstandard and LZ4 frames start with a 4-byte little-endian magic
+ * number.  Both formats also have "skippable" frames, with magic
+ * numbers 0x184D2A50 through 0x184D2A5F; the zstd seekable format
+ * puts its seek table in one of those at the end of the file.
+ */
+#define ZSTD_MAGIC          G_GUINT32_CONSTANT(0xFD2FB528)
+#define LZ4_MAGIC           G_GUINT32_CONSTANT(0x184D2204)
+#define SKIPPABLE_MAGIC     G_GUINT32_CONSTANT(0x184D2A50)
+#define SKIPPABLE_MASK      G_GUINT32_CONSTANT(0xFFFFFFF0)
+
+#ifdef HAVE_ZSTD
+static void
+zstd_read(FILE_T state, unsigned char *buf, unsigned int count)
+{
+    ZSTD_outBuffer output;
+    ZSTD_inBuffer input;
+    size_t ret, before;
+
+    output.dst = buf;
+    output.size = count;
+    output.pos = 0;
+
+    /* fill output buffer up to end of frame or error */
+    while (output.pos < output.size) {
+        /* get more input for the decoder; at the end of the file,
+           call it anyway, to flush whatever it still has */
+        if (state->in.avail == 0 && fill_in_buffer(state) == -1)
+            break;
+
+        input.src = state->in.next;
+        input.size = state->in.avail;
+        input.pos = 0;
+        before = output.pos;
+        ret = ZSTD_decompressStream(state->zstd, &output, &input);
+        state->in.next += input.pos;
+        state->in.avail -= (guint)input.pos;
+        if (ZSTD_isError(ret)) {
+            state->err = WTAP_ERR_DECOMPRESS;
+            state->err_info = ZSTD_getErrorName(ret);
+            break;
+        }
+        if (ret == 0) {
+            /* end of frame; the next one might be something else */
+            state->compression = UNKNOWN;
+            break;
+        }
+        if (input.size == 0 && output.pos == before) {
+            /* EOF in the middle of a frame */
+            state->err = WTAP_ERR_SHORT_READ;
+            state->err_info = NULL;
+            break;
+        }
+    }
+
+    state->out.next = buf;
+    state->out.avail = (guint)output.pos;
+}
+#endif /* HAVE_ZSTD */
+
+#ifdef USE_LZ4
+static void
+lz4_read(FILE_T state, unsigned char *buf, unsigned int count)
+{
+    size_t out_pos = 0;
+    size_t dst_size, src_size, ret;
+
+    /* fill output buffer up to end of frame or error */
+    while (out_pos < count) {
+        /* get more input for the decoder; at the end of the file,
+           call it anyway, to flush whatever it still has */
+        if (state->in.avail == 0 && fill_in_buffer(state) == -1)
+            break;
+
+        dst_size = count - out_pos;
+        src_size = state->in.avail;
+        ret = LZ4F_decompress(state->lz4, buf + out_pos, &dst_size,
+                              state->in.next, &src_size, NULL);
+        state->in.next += src_size;
+        state->in.avail -= (guint)src_size;
+        out_pos += dst_size;
+        if (LZ4F_isError(ret)) {
+            state->err = WTAP_ERR_DECOMPRESS;
+            state->err_info = LZ4F_getErrorName(ret);
+            break;
+        }
+        if (ret == 0) {
+            /* end of frame; the next one might be something else */
+            state->compression = UNKNOWN;
+            break;
+        }
+        if (src_size == 0 && dst_size == 0) {
+            /* EOF in the middle of a frame */
+            state->err = WTAP_ERR_SHORT_READ;
+            state->err_info = NULL;
+            break;
+        }
+    }
+
+    state->out.next = buf;
+    state->out.avail = (guint)out_pos;
+}
+#endif /* USE_LZ4 */
+
+/* Set up to decompress the zstd or LZ4 frame at the beginning of the
+   input buffer. */
+static int
+frame_head(FILE_T state, compression_t compression)
+{
+    /* A frame can be decoded without anything that precedes it, so its
+       beginning is a good place to start when seeking; as with zlib,
+       don't bother with one less than SPAN bytes after the last one. */
+    if (state->fast_seek) {
+        struct fast_seek_point *item = NULL;
+
+        if (state->fast_seek->len != 0)
+            item = (struct fast_seek_point *)state->fast_seek->pdata[state->fast_seek->len - 1];
+        if (!item || item->out + SPAN < state->pos)
+            fast_seek_header(state, state->raw_pos - state->in.avail, state->pos, compression);
+    }
+
+    if (compression == ZSTD) {
+#ifdef HAVE_ZSTD
+        if (state->zstd == NULL) {
+            state->zstd = ZSTD_createDStream();
+            if (state->zstd == NULL) {
+                state->err = ENOMEM;
+                state->err_info = NULL;
+                return -1;
+            }
+        }
+        if (ZSTD_isError(ZSTD_initDStream(state->zstd))) {
+            state->err = WTAP_ERR_INTERNAL;
+            state->err_info = "ZSTD_initDStream failed";
+            return -1;
+        }
+#else
+        state->err = WTAP_ERR_DECOMPRESSION_NOT_SUPPORTED;
+        state->err_info = "reading zstd-compressed files isn't supported";
+        return -1;
+#endif
+    } else {
+#ifdef USE_LZ4
+        if (state->lz4 == NULL) {
+            if (LZ4F_isError(LZ4F_createDecompressionContext(&state->lz4, LZ4F_VERSION))) {
+                state->lz4 = NULL;
+                state->err = ENOMEM;
+                state->err_info = NULL;
+                return -1;
+            }
+        } else
+            LZ4F_resetDecompressionContext(state->lz4);
+#else
+        state->err = WTAP_ERR_DECOMPRESSION_NOT_SUPPORTED;
+        state->err_info = "reading lz4-compressed files isn't supported";
+        return -1;
+#endif
+    }
+    state->compression = compression;
+    state->is_compressed = TRUE;
+    return 0;
+}
+
 static int
 gz_head(FILE_T state)
 {
@@ -609,6 +912,30 @@ gz_head(FILE_T state)
             return 0;
     }
 
+    /* look for a zstd, LZ4 or skippable frame magic number */
+    if (state->in.next[0] == 0x28 || state->in.next[0] == 0x04 ||
+        (state->in.next[0] & 0xF0) == 0x50) {
+        guint32 magic;
+
+        if (fill_in_buffer_n(state, 4) == -1)
+            return -1;
+        if (state->in.avail >= 4) {
+            magic = pletoh32(state->in.next);
+            if (magic == ZSTD_MAGIC)
+                return frame_head(state, ZSTD);
+            if (magic == LZ4_MAGIC)
+                return frame_head(state, LZ4);
+            if ((magic & SKIPPABLE_MASK) == SKIPPABLE_MAGIC) {
+                /* either decoder can skip it */
+#if !defined(HAVE_ZSTD) && defined(USE_LZ4)
+                return frame_head(state, LZ4);
+#else
+                return frame_head(state, ZSTD);
+#endif
+            }
+        }
+    }
+
     /* look for the gzip magic header bytes 31 and 139 */
     if (state->in.next[0] == 31) {
         state->in.avail--;
@@ -734,9 +1061,13 @@ gz_head(FILE_T state)
     return 0;
 }
 
+static int read_ahead_fill(FILE_T file);
+
 static int /* gz_make */
 fill_out_buffer(FILE_T state)
 {
+    if (state->read_ahead != NULL)              /* read by another thread */
+        return read_ahead_fill(state);
     if (state->compression == UNKNOWN) {           /* look for gzip header */
         if (gz_head(state) == -1)
             return -1;
@@ -751,6 +1082,16 @@ fill_out_buffer(FILE_T state)
     else if (state->compression == ZLIB) {      /* decompress */
         zlib_read(state, state->out.buf, state->size << 1);
     }
+#endif
+#ifdef HAVE_ZSTD
+    else if (state->compression == ZSTD) {
+        zstd_read(state, state->out.buf, state->size << 1);
+    }
+#endif
+#ifdef USE_LZ4
+    else if (state->compression == LZ4) {
+        lz4_read(state, state->out.buf, state->size << 1);
+    }
 #endif
     return 0;
 }
@@ -805,6 +1146,419 @@ gz_reset(FILE_T state)
     buf_reset(&state->in);        /* no input data yet */
 }
 
+/*
+ * Background read-ahead.
+ *
+ * Once file_set_read_ahead() has been called on a stream, reading and
+ * decompressing it is done on a separate thread, so that, for example,
+ * inflating a gzipped file overlaps with dissecting what has already
+ * been read.
+ *
+ * The stream the caller uses becomes a pure consumer of uncompressed
+ * data.  Everything else - the file descriptor, the input buffer, the
+ * inflate state and the fast seek bookkeeping - moves to a private
+ * "producer" wtap_reader, which the thread drives with the same
+ * fill_out_buffer() used in the single-threaded case, writing directly
+ * into a ring of chunk buffers handed back and forth through two
+ * GAsyncQueues.
+ *
+ * Fast seek points the producer creates are collected in a private array
+ * and passed along with the chunk they were created for; they are added
+ * to the stream's (shared) fast seek array by the consumer, so that
+ * array is only ever touched by the thread that owns the wtap.
+ *
+ * Seeks within the current chunk and short forward seeks are handled by
+ * the consumer.  Anything else stops the thread, seeks the producer and
+ * lets the thread start again on the next read.
+ */
+#define READ_AHEAD_BUFSIZE  65536
+#define READ_AHEAD_CHUNKS   8
+
+typedef struct read_ahead_chunk {
+    guint8 *buf;                /* READ_AHEAD_BUFSIZE * 2 bytes */
+    guint8 *data;               /* first byte of data in buf */
+    guint avail;                /* number of bytes of data */
+    gint64 raw_pos;             /* producer's position in the file afterwards */
+    gboolean is_compressed;
+    gboolean eof;               /* no more data in the file, for now */
+    int err;                    /* error after this data, if any */
+    const char *err_info;
+    gboolean last;              /* thread exits after this chunk */
+    GPtrArray *seek_points;     /* fast seek points created for this data */
+} read_ahead_chunk_t;
+
+struct read_ahead {
+    FILE_T producer;
+    GThread *thread;            /* NULL if not running */
+    volatile gint stop;
+    GAsyncQueue *free_chunks;
+    GAsyncQueue *full_chunks;
+    read_ahead_chunk_t *chunks[READ_AHEAD_CHUNKS];
+    read_ahead_chunk_t *cur;    /* chunk the consumer is reading from */
+    guint8 *orig_out_buf;       /* consumer's own output buffer */
+    GPtrArray *fast_seek;       /* producer's private fast seek array */
+    guint fast_seek_sent;       /* entries already passed to the consumer */
+};
+
+/* Free fast seek points that never made it to the shared array. */
+static void
+read_ahead_drop_seek_points(read_ahead_chunk_t *chunk)
+{
+    guint i;
+
+    if (chunk->seek_points == NULL)
+        return;
+    for (i = 0; i < chunk->seek_points->len; i++)
+        g_free(chunk->seek_points->pdata[i]);
+    g_ptr_array_set_size(chunk->seek_points, 0);
+}
+
+static gpointer
+read_ahead_worker(gpointer data)
+{
+    struct read_ahead *ra = (struct read_ahead *)data;
+    FILE_T state = ra->producer;
+    read_ahead_chunk_t *chunk;
+
+    for (;;) {
+        chunk = (read_ahead_chunk_t *)g_async_queue_pop(ra->free_chunks);
+        chunk->avail = 0;
+        chunk->eof = FALSE;
+        chunk->err = 0;
+        chunk->err_info = NULL;
+        chunk->last = FALSE;
+
+        if (g_atomic_int_get(&ra->stop)) {
+            chunk->last = TRUE;
+            g_async_queue_push(ra->full_chunks, chunk);
+            break;
+        }
+
+        /* Produce into this chunk's buffer. */
+        state->out.buf = chunk->buf;
+        buf_reset(&state->out);
+
+        if (state->seek_pending) {
+            state->seek_pending = FALSE;
+            gz_skip(state, state->skip);
+        }
+        while (state->out.avail == 0 && state->err == 0 &&
+               !(state->eof && state->in.avail == 0)) {
+            if (fill_out_buffer(state) == -1)
+                break;
+        }
+
+        /* Hand the data over; it's no longer in the producer's buffer. */
+        chunk->data = state->out.next;
+        chunk->avail = state->out.avail;
+        state->pos += state->out.avail;
+        state->out.next += state->out.avail;
+        state->out.avail = 0;
+
+        chunk->raw_pos = state->raw_pos;
+        chunk->is_compressed = state->is_compressed;
+        if (state->err != 0) {
+            chunk->err = state->err;
+            chunk->err_info = state->err_info;
+            chunk->last = TRUE;
+        } else if (state->eof && state->in.avail == 0) {
+            chunk->eof = TRUE;
+            chunk->last = TRUE;
+        }
+
+        if (ra->fast_seek != NULL && ra->fast_seek->len > ra->fast_seek_sent) {
+            guint i;
+
+            for (i = ra->fast_seek_sent; i < ra->fast_seek->len; i++)
+                g_ptr_array_add(chunk->seek_points, ra->fast_seek->pdata[i]);
+            /* Keep only the newest point, the producer compares against it. */
+            g_ptr_array_remove_range(ra->fast_seek, 0, ra->fast_seek->len - 1);
+            ra->fast_seek_sent = 1;
+        }
+
+        g_async_queue_push(ra->full_chunks, chunk);
+        if (chunk->last)
+            break;
+    }
+    return NULL;
+}
+
+/* Start the thread, producing from where the producer is now. */
+static void
+read_ahead_run(FILE_T file)
+{
+    struct read_ahead *ra = file->read_ahead;
+    FILE_T producer = ra->producer;
+
+    /* Clear whatever made the thread stop the last time. */
+    producer->err = 0;
+    producer->err_info = NULL;
+    producer->eof = FALSE;
+
+    ra->fast_seek_sent = 0;
+    producer->fast_seek = NULL;
+    if (file->fast_seek != NULL) {
+        g_ptr_array_set_size(ra->fast_seek, 0);
+        if (file->fast_seek->len != 0) {
+            g_ptr_array_add(ra->fast_seek, file->fast_seek->pdata[file->fast_seek->len - 1]);
+            ra->fast_seek_sent = 1;
+        }
+        producer->fast_seek = ra->fast_seek;
+    }
+
+    g_atomic_int_set(&ra->stop, 0);
+    ra->thread = g_thread_new("read-ahead", read_ahead_worker, ra);
+}
+
+/* Stop the thread and throw away whatever it read ahead. */
+static void
+read_ahead_halt(FILE_T file)
+{
+    struct read_ahead *ra = file->read_ahead;
+    read_ahead_chunk_t *chunk;
+
+    if (ra->thread == NULL)
+        return;
+
+    g_atomic_int_set(&ra->stop, 1);
+    do {
+        chunk = (read_ahead_chunk_t *)g_async_queue_pop(ra->full_chunks);
+        read_ahead_drop_seek_points(chunk);
+        g_async_queue_push(ra->free_chunks, chunk);
+    } while (!chunk->last);
+    g_thread_join(ra->thread);
+    ra->thread = NULL;
+
+    /* The producer works on the shared fast seek array while stopped. */
+    ra->producer->fast_seek = file->fast_seek;
+    buf_reset(&ra->producer->out);
+}
+
+/*
+ * Stop the thread and put the producer back at the end of the data the
+ * consumer has.
+ */
+static gboolean
+read_ahead_resync(FILE_T file, int *err)
+{
+    FILE_T producer = file->read_ahead->producer;
+    gint64 pos = file->pos + file->out.avail;
+
+    read_ahead_halt(file);
+    if (file_tell(producer) != pos &&
+        file_seek(producer, pos, SEEK_SET, err) == -1)
+        return FALSE;
+    return TRUE;
+}
+
+/* fill_out_buffer() for a stream with read-ahead. */
+static int
+read_ahead_fill(FILE_T file)
+{
+    struct read_ahead *ra = file->read_ahead;
+    read_ahead_chunk_t *chunk;
+    guint i;
+
+    if (ra->thread == NULL)
+        read_ahead_run(file);
+
+    chunk = (read_ahead_chunk_t *)g_async_queue_pop(ra->full_chunks);
+    if (chunk->last) {
+        g_thread_join(ra->thread);
+        ra->thread = NULL;
+        ra->producer->fast_seek = file->fast_seek;
+    }
+
+    if (ra->cur != NULL)
+        g_async_queue_push(ra->free_chunks, ra->cur);
+    ra->cur = chunk;
+
+    if (chunk->seek_points->len != 0) {
+        for (i = 0; i < chunk->seek_points->len; i++)
+            g_ptr_array_add(file->fast_seek, chunk->seek_points->pdata[i]);
+        g_ptr_array_set_size(chunk->seek_points, 0);
+    }
+
+    file->out.buf = chunk->data;
+    file->out.next = chunk->data;
+    file->out.avail = chunk->avail;
+    file->raw_pos = chunk->raw_pos;
+    file->is_compressed = chunk->is_compressed;
+    if (chunk->err != 0) {
+        file->err = chunk->err;
+        file->err_info = chunk->err_info;
+    }
+    if (chunk->eof)
+        file->eof = TRUE;
+    return 0;
+}
+
+/*
+ * file_seek() for a stream with read-ahead, for an offset that isn't
+ * within the current chunk.
+ */
+static gint64
+read_ahead_seek(FILE_T file, gint64 offset, int *err)
+{
+    FILE_T producer = file->read_ahead->producer;
+    gint64 target = file->pos + offset;
+    guint n;
+
+    if (offset > 0 && (offset <= SPAN || file->fast_seek == NULL)) {
+        /*
+         * Short forward seek; skip what's in the output buffer and
+         * leave the rest to be skipped over when we next read.
+         */
+        n = file->out.avail;
+        file->out.avail = 0;
+        file->out.next += n;
+        file->pos += n;
+        offset -= n;
+        if (offset) {
+            file->seek_pending = TRUE;
+            file->skip = offset;
+        }
+        return file->pos + offset;
+    }
+
+    if (target < 0) {
+        *err = EINVAL;
+        return -1;
+    }
+
+    read_ahead_halt(file);
+    if (file_seek(producer, target, SEEK_SET, err) == -1)
+        return -1;
+
+    buf_reset(&file->out);
+    file->pos = target;
+    file->eof = FALSE;
+    file->seek_pending = FALSE;
+    file->err = 0;
+    file->err_info = NULL;
+    return target;
+}
+
+static void
+read_ahead_free(FILE_T file)
+{
+    struct read_ahead *ra = file->read_ahead;
+    FILE_T producer = ra->producer;
+    guint i;
+
+    read_ahead_halt(file);
+
+    for (i = 0; i < READ_AHEAD_CHUNKS; i++) {
+        read_ahead_drop_seek_points(ra->chunks[i]);
+        g_ptr_array_free(ra->chunks[i]->seek_points, TRUE);
+        g_free(ra->chunks[i]->buf);
+        g_free(ra->chunks[i]);
+    }
+    g_async_queue_unref(ra->free_chunks);
+    g_async_queue_unref(ra->full_chunks);
+    g_ptr_array_free(ra->fast_seek, TRUE);
+
+    /* The descriptor belongs to the consumer; the output buffer to a chunk. */
+    producer->fd = -1;
+    producer->out.buf = NULL;
+    file_close(producer);
+
+    file->out.buf = ra->orig_out_buf;
+    buf_reset(&file->out);
+    g_free(ra);
+    file->read_ahead = NULL;
+}
+
+gboolean
+file_set_read_ahead(FILE_T file)
+{
+    struct read_ahead *ra;
+    FILE_T producer;
+    guint size, i;
+
+    if (file->read_ahead != NULL)
+        return TRUE;
+
+    /* Process a skip request; the producer starts after it. */
+    if (file->seek_pending) {
+        file->seek_pending = FALSE;
+        if (gz_skip(file, file->skip) == -1)
+            return FALSE;
+    }
+    if (file->err != 0)
+        return FALSE;
+
+    size = file->size > READ_AHEAD_BUFSIZE ? file->size : READ_AHEAD_BUFSIZE;
+
+    producer = (FILE_T)g_try_malloc0(sizeof *producer);
+    if (producer == NULL)
+        return FALSE;
+    producer->in.buf = (unsigned char *)g_try_malloc(size);
+    if (producer->in.buf == NULL) {
+        g_free(producer);
+        return FALSE;
+    }
+#ifdef HAVE_ZLIB
+    if (inflateCopy(&producer->strm, &file->strm) != Z_OK) {
+        g_free(producer->in.buf);
+        g_free(producer);
+        return FALSE;
+    }
+    producer->dont_check_crc = file->dont_check_crc;
+#endif
+#ifdef HAVE_ZSTD
+    producer->zstd = file->zstd;
+    file->zstd = NULL;
+#endif
+#ifdef USE_LZ4
+    producer->lz4 = file->lz4;
+    file->lz4 = NULL;
+#endif
+
+    /*
+     * The producer carries on from the end of what's in our output
+     * buffer, with whatever input we've read but not yet used.
+     */
+    producer->fd = file->fd;
+    producer->raw_pos = file->raw_pos;
+    producer->pos = file->pos + file->out.avail;
+    producer->size = size;
+    memcpy(producer->in.buf, file->in.next, file->in.avail);
+    producer->in.next = producer->in.buf;
+    producer->in.avail = file->in.avail;
+    producer->eof = file->eof;
+    producer->start = file->start;
+    producer->raw = file->raw;
+    producer->compression = file->compression;
+    producer->is_compressed = file->is_compressed;
+    producer->fast_seek_cur = file->fast_seek_cur;
+    file->fast_seek_cur = NULL;
+    buf_reset(&file->in);
+    file->eof = FALSE;
+
+    ra = g_new0(struct read_ahead, 1);
+    ra->producer = producer;
+    ra->free_chunks = g_async_queue_new();
+    ra->full_chunks = g_async_queue_new();
+    for (i = 0; i < READ_AHEAD_CHUNKS; i++) {
+        read_ahead_chunk_t *chunk = g_new0(read_ahead_chunk_t, 1);
+
+        chunk->buf = (guint8 *)g_malloc((gsize)size << 1);
+        chunk->seek_points = g_ptr_array_new();
+        ra->chunks[i] = chunk;
+        g_async_queue_push(ra->free_chunks, chunk);
+    }
+    ra->orig_out_buf = file->out.buf;
+    ra->fast_seek = g_ptr_array_new();
+    producer->fast_seek = file->fast_seek;
+    producer->out.buf = ra->chunks[0]->buf;
+    buf_reset(&producer->out);
+
+    /* The thread is started by the first read that needs more data. */
+    file->read_ahead = ra;
+    return TRUE;
+}
+
 FILE_T
 file_fdopen(int fd)
 {
@@ -1054,6 +1808,12 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
         }
     }
 
+    /*
+     * If another thread is doing the reading, it has to do the seeking.
+     */
+    if (file->read_ahead != NULL)
+        return read_ahead_seek(file, offset, err);
+
     /*
      * We're not seeking within the buffer.  Do we have "fast seek" data
      * for the location to which we will be seeking, and is the offset
@@ -1085,6 +1845,10 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             off2 = here->out;
         } else
 #endif
+        if (here->compression == ZSTD || here->compression == LZ4) {
+            off = here->in;
+            off2 = here->out;
+        } else
         {
             off2 = (file->pos + offset);
             off = here->in + (off2 - here->out);
@@ -1137,6 +1901,10 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             file->compression = ZLIB;
         } else
 #endif
+        if (here->compression == ZSTD || here->compression == LZ4) {
+            /* let gz_head() set up the decoder for the frame */
+            file->compression = UNKNOWN;
+        } else
             file->compression = here->compression;
 
         offset = (file->pos + offset) - off2;
@@ -1509,6 +2277,16 @@ file_clearerr(FILE_T stream)
 void
 file_fdclose(FILE_T file)
 {
+    int err;
+
+    if (file->read_ahead != NULL) {
+        /* The thread must not read from the descriptor any more. */
+        if (!read_ahead_resync(file, &err)) {
+            file->err = err;
+            file->err_info = NULL;
+        }
+        file->read_ahead->producer->fd = -1;
+    }
     ws_close(file->fd);
     file->fd = -1;
 }
@@ -1516,11 +2294,25 @@ file_fdclose(FILE_T file)
 gboolean
 file_fdreopen(FILE_T file, const char *path)
 {
+    FILE_T reader = file->read_ahead != NULL ? file->read_ahead->producer : file;
     int fd;
+    int err;
 
     if ((fd = ws_open(path, O_RDONLY|O_BINARY, 0000)) == -1)
         return FALSE;
+
+    /*
+     * Put the new descriptor where the old one was, so that the
+     * next read continues from where the buffered data ends.
+     */
+    if (reader->raw_pos != 0 && ws_lseek64(fd, reader->raw_pos, SEEK_SET) == -1) {
+        err = errno;
+        ws_close(fd);
+        errno = err;
+        return FALSE;
+    }
     file->fd = fd;
+    reader->fd = fd;
     return TRUE;
 }
 
@@ -1529,6 +2321,9 @@ file_close(FILE_T file)
 {
     int fd = file->fd;
 
+    if (file->read_ahead != NULL)
+        read_ahead_free(file);
+
     /* free memory and close file */
     if (file->size) {
 #ifdef HAVE_ZLIB
@@ -1537,6 +2332,14 @@ file_close(FILE_T file)
         g_free(file->out.buf);
         g_free(file->in.buf);
     }
+#ifdef HAVE_ZSTD
+    if (file->zstd != NULL)
+        ZSTD_freeDStream(file->zstd);
+#endif
+#ifdef USE_LZ4
+    if (file->lz4 != NULL)
+        LZ4F_freeDecompressionContext(file->lz4);
+#endif
     g_free(file->fast_seek_cur);
     file->err = 0;
     file->err_info = NULL;
@@ -1835,6 +2638,288 @@ gzwfile_geterr(GZWFILE_T state)
 }
 #endif
 
+#if defined(HAVE_ZSTD) || defined(USE_LZ4)
+/*
+ * Writing zstd- and LZ4-compressed files.
+ *
+ * The data is cut into frames of FRAME_SIZE bytes of uncompressed data,
+ * each compressed independently, so that a reader can start decoding at
+ * any frame; the reader above remembers where frames start as fast seek
+ * points.  For zstd, a seek table in the zstd seekable format is written
+ * at the end, so other tools that understand that format can get at the
+ * frames without decompressing the whole file.
+ */
+#define FRAME_SIZE          (1024 * 1024)
+#define FRAME_ZSTD_LEVEL    3
+
+#define ZSTD_SEEKABLE_MAGIC G_GUINT32_CONSTANT(0x8F92EAB1)
+#define ZSTD_SEEK_TABLE_MAGIC (SKIPPABLE_MAGIC | 0xE)
+
+struct wtap_frame_writer {
+    int fd;                     /* file descriptor */
+    wtap_compression_type type; /* WTAP_ZSTD_COMPRESSED or WTAP_LZ4_COMPRESSED */
+    unsigned char *in;          /* uncompressed data for the current frame */
+    guint in_len;               /* amount of data in it */
+    unsigned char *out;         /* compressed frame */
+    size_t out_size;            /* size of that buffer */
+    GArray *seek_table;         /* zstd: sizes of the frames written so far */
+    int err;                    /* error code */
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx *zstd;            /* zstd compression context */
+#endif
+};
+
+/* An entry in the zstd seek table, as written to the file. */
+typedef struct {
+    guint32 compressed_size;
+    guint32 decompressed_size;
+} zstd_seek_entry_t;
+
+FRAMEWFILE_T
+framewfile_open(const char *path, wtap_compression_type type)
+{
+    int fd;
+    FRAMEWFILE_T state;
+    int save_errno;
+
+    fd = ws_open(path, O_BINARY|O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd == -1)
+        return NULL;
+    state = framewfile_fdopen(fd, type);
+    if (state == NULL) {
+        save_errno = errno;
+        ws_close(fd);
+        errno = save_errno;
+    }
+    return state;
+}
+
+static void
+framewfile_free(FRAMEWFILE_T state)
+{
+#ifdef HAVE_ZSTD
+    if (state->zstd != NULL)
+        ZSTD_freeCCtx(state->zstd);
+#endif
+    if (state->seek_table != NULL)
+        g_array_free(state->seek_table, TRUE);
+    g_free(state->out);
+    g_free(state->in);
+    g_free(state);
+}
+
+FRAMEWFILE_T
+framewfile_fdopen(int fd, wtap_compression_type type)
+{
+    FRAMEWFILE_T state;
+
+    /* allocate wtap_frame_writer structure to return */
+    state = (FRAMEWFILE_T)g_try_malloc0(sizeof *state);
+    if (state == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    state->fd = fd;
+    state->type = type;
+
+    switch (type) {
+#ifdef HAVE_ZSTD
+    case WTAP_ZSTD_COMPRESSED:
+        state->out_size = ZSTD_compressBound(FRAME_SIZE);
+        state->zstd = ZSTD_createCCtx();
+        state->seek_table = g_array_new(FALSE, FALSE, sizeof (zstd_seek_entry_t));
+        if (state->zstd == NULL) {
+            framewfile_free(state);
+            errno = ENOMEM;
+            return NULL;
+        }
+        break;
+#endif
+#ifdef USE_LZ4
+    case WTAP_LZ4_COMPRESSED:
+        state->out_size = LZ4F_compressFrameBound(FRAME_SIZE, NULL);
+        break;
+#endif
+    default:
+        framewfile_free(state);
+        errno = WTAP_ERR_COMPRESSION_NOT_SUPPORTED;
+        return NULL;
+    }
+
+    state->in = (unsigned char *)g_try_malloc(FRAME_SIZE);
+    state->out = (unsigned char *)g_try_malloc(state->out_size);
+    if (state->in == NULL || state->out == NULL) {
+        framewfile_free(state);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return state;
+}
+
+static int
+frame_write_raw(FRAMEWFILE_T state, const void *buf, size_t len)
+{
+    ssize_t got;
+
+    got = ws_write(state->fd, buf, (unsigned int)len);
+    if (got < 0) {
+        state->err = errno;
+        return -1;
+    }
+    if ((size_t)got != len) {
+        state->err = WTAP_ERR_SHORT_WRITE;
+        return -1;
+    }
+    return 0;
+}
+
+/* Compress whatever is in the input buffer as a frame of its own and
+   write it out.  Return -1, and set state->err, on failure; return 0
+   on success. */
+static int
+frame_comp(FRAMEWFILE_T state)
+{
+    size_t len;
+
+    if (state->in_len == 0)
+        return 0;
+
+    switch (state->type) {
+#ifdef HAVE_ZSTD
+    case WTAP_ZSTD_COMPRESSED:
+        len = ZSTD_compressCCtx(state->zstd, state->out, state->out_size,
+                                state->in, state->in_len, FRAME_ZSTD_LEVEL);
+        if (ZSTD_isError(len)) {
+            /* This "shouldn't happen". */
+            state->err = WTAP_ERR_INTERNAL;
+            return -1;
+        }
+        break;
+#endif
+#ifdef USE_LZ4
+    case WTAP_LZ4_COMPRESSED:
+        len = LZ4F_compressFrame(state->out, state->out_size,
+                                 state->in, state->in_len, NULL);
+        if (LZ4F_isError(len)) {
+            /* This "shouldn't happen". */
+            state->err = WTAP_ERR_INTERNAL;
+            return -1;
+        }
+        break;
+#endif
+    default:
+        state->err = WTAP_ERR_INTERNAL;
+        return -1;
+    }
+
+    if (frame_write_raw(state, state->out, len) == -1)
+        return -1;
+    if (state->seek_table != NULL) {
+        zstd_seek_entry_t entry;
+
+        entry.compressed_size = GUINT32_TO_LE((guint32)len);
+        entry.decompressed_size = GUINT32_TO_LE(state->in_len);
+        g_array_append_val(state->seek_table, entry);
+    }
+    state->in_len = 0;
+    return 0;
+}
+
+/* Write out len bytes from buf.  Return 0, and set state->err, on
+   failure or on an attempt to write 0 bytes (in which case state->err
+   is 0); return the number of bytes written on success. */
+guint
+framewfile_write(FRAMEWFILE_T state, const void *buf, guint len)
+{
+    guint put = len;
+    guint n;
+
+    /* check that there's no error */
+    if (state->err != 0)
+        return 0;
+
+    /* if len is zero, avoid unnecessary operations */
+    if (len == 0)
+        return 0;
+
+    /* copy to input buffer, compress a frame whenever it's full */
+    while (len != 0) {
+        n = FRAME_SIZE - state->in_len;
+        if (n > len)
+            n = len;
+        memcpy(state->in + state->in_len, buf, n);
+        state->in_len += n;
+        buf = (const char *)buf + n;
+        len -= n;
+        if (state->in_len == FRAME_SIZE && frame_comp(state) == -1)
+            return 0;
+    }
+    return put;
+}
+
+/* Flush out what we've written so far, ending the current frame.
+   Returns -1, and sets state->err, on failure; returns 0 on success. */
+int
+framewfile_flush(FRAMEWFILE_T state)
+{
+    /* check that there's no error */
+    if (state->err != 0)
+        return -1;
+
+    return frame_comp(state);
+}
+
+/* Write the seek table of the zstd seekable format, in a skippable frame. */
+static int
+frame_write_seek_table(FRAMEWFILE_T state)
+{
+    GByteArray *table;
+    guint32 val;
+    guint8 descriptor = 0;      /* no checksums */
+    int ret;
+
+    table = g_byte_array_new();
+    val = GUINT32_TO_LE(ZSTD_SEEK_TABLE_MAGIC);
+    g_byte_array_append(table, (const guint8 *)&val, 4);
+    val = GUINT32_TO_LE(state->seek_table->len * (guint32)sizeof (zstd_seek_entry_t) + 9);
+    g_byte_array_append(table, (const guint8 *)&val, 4);
+    g_byte_array_append(table, (const guint8 *)state->seek_table->data,
+                        state->seek_table->len * (guint)sizeof (zstd_seek_entry_t));
+    val = GUINT32_TO_LE(state->seek_table->len);
+    g_byte_array_append(table, (const guint8 *)&val, 4);
+    g_byte_array_append(table, &descriptor, 1);
+    val = GUINT32_TO_LE(ZSTD_SEEKABLE_MAGIC);
+    g_byte_array_append(table, (const guint8 *)&val, 4);
+
+    ret = frame_write_raw(state, table->data, table->len);
+    g_byte_array_free(table, TRUE);
+    return ret;
+}
+
+/* Flush out all data written, and close the file.  Returns a Wiretap
+   error on failure; returns 0 on success. */
+int
+framewfile_close(FRAMEWFILE_T state)
+{
+    int ret = 0;
+
+    /* flush, write the seek table, free memory, and close file */
+    if (state->err == 0 && frame_comp(state) == 0 && state->seek_table != NULL)
+        frame_write_seek_table(state);
+    ret = state->err;
+    if (ws_close(state->fd) == -1 && ret == 0)
+        ret = errno;
+    framewfile_free(state);
+    return ret;
+}
+
+int
+framewfile_geterr(FRAMEWFILE_T state)
+{
+    return state->err;
+}
+#endif /* HAVE_ZSTD || USE_LZ4 */
+
 /*
  * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
  *
@@ -14,9 +14,14 @@
 #include <wsutil/file_util.h>
 #include "ws_symbol_export.h"
 
+#if defined(HAVE_LZ4) && defined(HAVE_LZ4FRAME_H)
+#define USE_LZ4
+#endif
+
 extern FILE_T file_open(const char *path);
 extern FILE_T file_fdopen(int fildes);
 extern void file_set_random_access(FILE_T stream, gboolean random_flag, GPtrArray *seek);
+extern gboolean file_set_read_ahead(FILE_T stream);
 WS_DLL_PUBLIC gint64 file_seek(FILE_T stream, gint64 offset, int whence, int *err);
 WS_DLL_PUBLIC gint64 file_tell(FILE_T stream);
 extern gint64 file_tell_raw(FILE_T stream);
@@ -45,4 +50,15 @@ extern int gzwfile_close(GZWFILE_T state);
 extern int gzwfile_geterr(GZWFILE_T state);
 #endif /* HAVE_ZLIB */
 
+#if defined(HAVE_ZSTD) || defined(USE_LZ4)
+typedef struct wtap_frame_writer *FRAMEWFILE_T;
+
+extern FRAMEWFILE_T framewfile_open(const char *path, wtap_compression_type type);
+extern FRAMEWFILE_T framewfile_fdopen(int fd, wtap_compression_type type);
+extern guint framewfile_write(FRAMEWFILE_T state, const void *buf, guint len);
+extern int framewfile_flush(FRAMEWFILE_T state);
+extern int framewfile_close(FRAMEWFILE_T state);
+extern int framewfile_geterr(FRAMEWFILE_T state);
+#endif /* HAVE_ZSTD || USE_LZ4 */
+
 #endif /* __FILE_H__ */
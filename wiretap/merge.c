@@ -102,6 +102,7 @@ add_idb_index_map(merge_in_file_t *in_file, const guint orig_index, const guint
  *
  * @param in_file_count number of entries in in_file_names
  * @param in_file_names filenames of the input files
+ * @param max_open_files number of files to leave open, or 0 for all of them
  * @param out_files output pointer with filled file array, or NULL
  * @param err wiretap error, if failed
  * @param err_info wiretap error string, if failed
@@ -110,11 +111,13 @@ add_idb_index_map(merge_in_file_t *in_file, const guint orig_index, const guint
  */
 static gboolean
 merge_open_in_files(guint in_file_count, const char *const *in_file_names,
-                    merge_in_file_t **out_files, merge_progress_callback_t* cb,
-                    int *err, gchar **err_info, guint *err_fileno)
+                    guint max_open_files, merge_in_file_t **out_files,
+                    merge_progress_callback_t* cb, int *err, gchar **err_info,
+                    guint *err_fileno)
 {
     guint i;
     guint j;
+    guint open_files = 0;
     size_t files_size = in_file_count * sizeof(merge_in_file_t);
     merge_in_file_t *files;
     gint64 size;
@@ -146,6 +149,19 @@ merge_open_in_files(guint in_file_count, const char *const *in_file_names,
         }
         files[i].size = size;
         files[i].idb_index_map = g_array_new(FALSE, FALSE, sizeof(guint));
+
+        /*
+         * Everything we need from the file headers has been read; if
+         * we're over the limit, close the descriptor until we need
+         * records from the file.
+         */
+        if (max_open_files != 0 && open_files >= max_open_files &&
+            strcmp(in_file_names[i], "-") != 0) {
+            wtap_fdclose(files[i].wth);
+            files[i].fd_closed = TRUE;
+        } else {
+            open_files++;
+        }
     }
 
     if (cb)
@@ -201,24 +217,199 @@ merge_select_frame_type(int in_file_count, merge_in_file_t in_files[])
 }
 
 /*
- * returns TRUE if first argument is earlier than second
+ * State for reading records from the input files.
+ *
+ * For a chronological merge, the files that have a record available are
+ * kept in a binary min-heap ordered by the time stamp of that record, so
+ * picking the next record costs O(log files) rather than a scan of every
+ * file.
+ *
+ * If max_open_files is non-zero, no more than that many input files have
+ * an open file descriptor at a time; the least recently read file gets
+ * its descriptor closed when another one has to be reopened.
+ */
+typedef struct {
+    merge_in_file_t    *in_files;
+    guint               in_file_count;
+    merge_in_file_t   **heap;           /* files with a record present */
+    guint               heap_count;
+    merge_in_file_t    *last;           /* file whose record we returned last */
+    guint               max_open_files; /* 0 for no limit */
+    guint               open_files;
+    guint32             clock;
+} merge_reader_t;
+
+static void
+merge_reader_init(merge_reader_t *reader, merge_in_file_t *in_files,
+                  const guint in_file_count, const guint max_open_files)
+{
+    guint i;
+
+    reader->in_files = in_files;
+    reader->in_file_count = in_file_count;
+    reader->heap = NULL;
+    reader->heap_count = 0;
+    reader->last = NULL;
+    reader->max_open_files = max_open_files;
+    reader->open_files = 0;
+    reader->clock = 0;
+    for (i = 0; i < in_file_count; i++) {
+        if (!in_files[i].fd_closed)
+            reader->open_files++;
+    }
+}
+
+static void
+merge_reader_cleanup(merge_reader_t *reader)
+{
+    g_free(reader->heap);
+    reader->heap = NULL;
+}
+
+/*
+ * Close the descriptor of the input file that was read from least
+ * recently, other than in_file.
+ */
+static void
+merge_close_lru_in_file(merge_reader_t *reader, const merge_in_file_t *in_file)
+{
+    merge_in_file_t *lru = NULL;
+    guint i;
+
+    for (i = 0; i < reader->in_file_count; i++) {
+        merge_in_file_t *cur = &reader->in_files[i];
+
+        if (cur == in_file || cur->fd_closed || strcmp(cur->filename, "-") == 0)
+            continue;
+        if (lru == NULL || cur->last_used < lru->last_used)
+            lru = cur;
+    }
+
+    if (lru != NULL) {
+        wtap_fdclose(lru->wth);
+        lru->fd_closed = TRUE;
+        reader->open_files--;
+    }
+}
+
+/*
+ * Read the next record from an input file, reopening its descriptor
+ * first if it was closed.  Returns FALSE and sets the file's state to
+ * GOT_ERROR on an error; otherwise sets it to RECORD_PRESENT or AT_EOF.
  */
 static gboolean
-is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
+merge_read_in_file(merge_reader_t *reader, merge_in_file_t *in_file,
+                   int *err, gchar **err_info)
 {
-    if (l->secs > r->secs) {  /* left is later */
-        return FALSE;
-    } else if (l->secs < r->secs) { /* left is earlier */
+    gint64 data_offset;
+
+    if (in_file->fd_closed) {
+        if (reader->max_open_files != 0 &&
+            reader->open_files >= reader->max_open_files)
+            merge_close_lru_in_file(reader, in_file);
+        if (!wtap_sequential_fdreopen(in_file->wth, in_file->filename, err)) {
+            *err_info = NULL;
+            in_file->state = GOT_ERROR;
+            return FALSE;
+        }
+        in_file->fd_closed = FALSE;
+        reader->open_files++;
+    }
+
+    in_file->last_used = ++reader->clock;
+
+    if (!wtap_read(in_file->wth, err, err_info, &data_offset)) {
+        if (*err != 0) {
+            in_file->state = GOT_ERROR;
+            return FALSE;
+        }
+        in_file->state = AT_EOF;
+
+        /* We're done with this file; let another one have its descriptor. */
+        if (reader->max_open_files != 0 && strcmp(in_file->filename, "-") != 0) {
+            wtap_fdclose(in_file->wth);
+            in_file->fd_closed = TRUE;
+            reader->open_files--;
+        }
         return TRUE;
-    } else if (l->nsecs > r->nsecs) { /* tv_sec equal, l.usec later */
-        return FALSE;
     }
-    /* either one < two or one == two
-     * either way, return one
-     */
+
+    in_file->state = RECORD_PRESENT;
     return TRUE;
 }
 
+/*
+ * Returns TRUE if the record present in file a goes before the one
+ * present in file b.
+ *
+ * Records with no time stamp are treated as earlier than all other
+ * records.  Yes, this means you won't get a chronological merge of
+ * those records, but you obviously *can't* get that.  Among them, the
+ * one from the first file goes first; among records with the same time
+ * stamp, the one from the last file goes first.
+ */
+static gboolean
+merge_heap_before(const merge_in_file_t *a, const merge_in_file_t *b)
+{
+    const wtap_rec *rec_a = wtap_get_rec(a->wth);
+    const wtap_rec *rec_b = wtap_get_rec(b->wth);
+    gboolean has_ts_a = (rec_a->presence_flags & WTAP_HAS_TS) != 0;
+    gboolean has_ts_b = (rec_b->presence_flags & WTAP_HAS_TS) != 0;
+
+    if (!has_ts_a || !has_ts_b) {
+        if (has_ts_a != has_ts_b)
+            return !has_ts_a;
+        return a < b;
+    }
+    if (rec_a->ts.secs != rec_b->ts.secs)
+        return rec_a->ts.secs < rec_b->ts.secs;
+    if (rec_a->ts.nsecs != rec_b->ts.nsecs)
+        return rec_a->ts.nsecs < rec_b->ts.nsecs;
+    return a > b;
+}
+
+static void
+merge_heap_push(merge_reader_t *reader, merge_in_file_t *in_file)
+{
+    merge_in_file_t **heap = reader->heap;
+    guint i = reader->heap_count++;
+
+    while (i > 0) {
+        guint parent = (i - 1) / 2;
+
+        if (!merge_heap_before(in_file, heap[parent]))
+            break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = in_file;
+}
+
+static merge_in_file_t *
+merge_heap_pop(merge_reader_t *reader)
+{
+    merge_in_file_t **heap = reader->heap;
+    merge_in_file_t *top = heap[0];
+    merge_in_file_t *last = heap[--reader->heap_count];
+    guint count = reader->heap_count;
+    guint i = 0;
+
+    while (2 * i + 1 < count) {
+        guint child = 2 * i + 1;
+
+        if (child + 1 < count && merge_heap_before(heap[child + 1], heap[child]))
+            child++;
+        if (!merge_heap_before(heap[child], last))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (count > 0)
+        heap[i] = last;
+
+    return top;
+}
+
 /** Read the next packet, in chronological order, from the set of files to
  * be merged.
  *
@@ -231,8 +422,7 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * On an EOF (meaning all the files are at EOF), set *err to 0 and return
  * NULL.
  *
- * @param in_file_count number of entries in in_files
- * @param in_files input file array
+ * @param reader state for the input files
  * @param err wiretap error, if failed
  * @param err_info wiretap error string, if failed
  * @return pointer to merge_in_file_t for file from which that packet
@@ -240,78 +430,60 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * all files
  */
 static merge_in_file_t *
-merge_read_packet(int in_file_count, merge_in_file_t in_files[],
-                  int *err, gchar **err_info)
+merge_read_packet(merge_reader_t *reader, int *err, gchar **err_info)
 {
-    int i;
-    int ei = -1;
-    nstime_t tv = { sizeof(time_t) > sizeof(int) ? LONG_MAX : INT_MAX, INT_MAX };
-    wtap_rec *rec;
-
-    /*
-     * Make sure we have a record available from each file that's not at
-     * EOF, and search for the record with the earliest time stamp or
-     * with no time stamp (those records are treated as earlier than
-     * all other records).  Yes, this means you won't get a chronological
-     * merge of those records, but you obviously *can't* get that.
-     */
-    for (i = 0; i < in_file_count; i++) {
-        gint64 data_offset;
-
-        if (in_files[i].state == RECORD_NOT_PRESENT) {
-            /*
-             * No packet available, and we haven't seen an error or EOF yet,
-             * so try to read the next packet.
-             */
-            if (!wtap_read(in_files[i].wth, err, err_info, &data_offset)) {
-                if (*err != 0) {
-                    in_files[i].state = GOT_ERROR;
-                    return &in_files[i];
-                }
-                in_files[i].state = AT_EOF;
-            } else
-                in_files[i].state = RECORD_PRESENT;
-        }
+    merge_in_file_t *in_file;
+    guint i;
 
-        if (in_files[i].state == RECORD_PRESENT) {
-            rec = wtap_get_rec(in_files[i].wth);
-            if (!(rec->presence_flags & WTAP_HAS_TS)) {
-                /*
-                 * No time stamp.  Pick this record, and stop looking.
-                 */
-                ei = i;
-                break;
-            }
-            if (is_earlier(&rec->ts, &tv)) {
-                /*
-                 * This record's time stamp is earlier than any of the
-                 * records we've seen so far.  Pick it, for now, but
-                 * keep looking.
-                 */
-                tv = rec->ts;
-                ei = i;
-            }
+    if (reader->heap == NULL) {
+        /*
+         * First call; get a record from every file and put the files
+         * into the heap.
+         */
+        reader->heap = g_new(merge_in_file_t *, reader->in_file_count);
+        for (i = 0; i < reader->in_file_count; i++) {
+            in_file = &reader->in_files[i];
+            if (in_file->state != RECORD_NOT_PRESENT)
+                continue;
+            if (!merge_read_in_file(reader, in_file, err, err_info))
+                return in_file;
+            if (in_file->state == RECORD_PRESENT)
+                merge_heap_push(reader, in_file);
         }
+    } else if (reader->last != NULL) {
+        /*
+         * Only the file whose record we returned last needs another
+         * record read from it.
+         */
+        in_file = reader->last;
+        reader->last = NULL;
+        if (!merge_read_in_file(reader, in_file, err, err_info))
+            return in_file;
+        if (in_file->state == RECORD_PRESENT)
+            merge_heap_push(reader, in_file);
     }
 
-    if (ei == -1) {
+    if (reader->heap_count == 0) {
         /* All the streams are at EOF.  Return an EOF indication. */
         *err = 0;
         return NULL;
     }
 
+    in_file = merge_heap_pop(reader);
+
     /* We'll need to read another packet from this file. */
-    in_files[ei].state = RECORD_NOT_PRESENT;
+    in_file->state = RECORD_NOT_PRESENT;
+    reader->last = in_file;
 
     /* Count this packet. */
-    in_files[ei].packet_num++;
+    in_file->packet_num++;
 
     /*
      * Return a pointer to the merge_in_file_t of the file from which the
      * packet was read.
      */
     *err = 0;
-    return &in_files[ei];
+    return in_file;
 }
 
 /** Read the next packet, in file sequence order, from the set of files
@@ -326,8 +498,7 @@ merge_read_packet(int in_file_count, merge_in_file_t in_files[],
  * On an EOF (meaning all the files are at EOF), set *err to 0 and return
  * NULL.
  *
- * @param in_file_count number of entries in in_files
- * @param in_files input file array
+ * @param reader state for the input files
  * @param err wiretap error, if failed
  * @param err_info wiretap error string, if failed
  * @return pointer to merge_in_file_t for file from which that packet
@@ -335,29 +506,26 @@ merge_read_packet(int in_file_count, merge_in_file_t in_files[],
  * all files
  */
 static merge_in_file_t *
-merge_append_read_packet(int in_file_count, merge_in_file_t in_files[],
-                         int *err, gchar **err_info)
+merge_append_read_packet(merge_reader_t *reader, int *err, gchar **err_info)
 {
-    int i;
-    gint64 data_offset;
+    merge_in_file_t *in_files = reader->in_files;
+    guint i;
 
     /*
      * Find the first file not at EOF, and read the next packet from it.
      */
-    for (i = 0; i < in_file_count; i++) {
+    for (i = 0; i < reader->in_file_count; i++) {
         if (in_files[i].state == AT_EOF)
             continue; /* This file is already at EOF */
-        if (wtap_read(in_files[i].wth, err, err_info, &data_offset))
-            break; /* We have a packet */
-        if (*err != 0) {
+        if (!merge_read_in_file(reader, &in_files[i], err, err_info)) {
             /* Read error - quit immediately. */
-            in_files[i].state = GOT_ERROR;
             return &in_files[i];
         }
-        /* EOF - flag this file as being at EOF, and try the next one. */
-        in_files[i].state = AT_EOF;
+        if (in_files[i].state == RECORD_PRESENT)
+            break; /* We have a packet */
+        /* EOF - try the next one. */
     }
-    if (i == in_file_count) {
+    if (i == reader->in_file_count) {
         /* All the streams are at EOF.  Return an EOF indication. */
         *err = 0;
         return NULL;
@@ -816,26 +984,28 @@ static merge_result
 merge_process_packets(wtap_dumper *pdh, const int file_type,
                       merge_in_file_t *in_files, const guint in_file_count,
                       const gboolean do_append, guint snaplen,
+                      const guint max_open_files,
                       merge_progress_callback_t* cb,
                       int *err, gchar **err_info, guint *err_fileno,
                       guint32 *err_framenum)
 {
     merge_result        status = MERGE_OK;
     merge_in_file_t    *in_file;
+    merge_reader_t      reader;
     int                 count = 0;
     gboolean            stop_flag = FALSE;
     wtap_rec *rec,      snap_rec;
 
+    merge_reader_init(&reader, in_files, in_file_count, max_open_files);
+
     for (;;) {
         *err = 0;
 
         if (do_append) {
-            in_file = merge_append_read_packet(in_file_count, in_files, err,
-                                               err_info);
+            in_file = merge_append_read_packet(&reader, err, err_info);
         }
         else {
-            in_file = merge_read_packet(in_file_count, in_files, err,
-                                        err_info);
+            in_file = merge_read_packet(&reader, err, err_info);
         }
 
         if (in_file == NULL) {
@@ -906,6 +1076,7 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
     if (cb)
         cb->callback_func(MERGE_EVENT_DONE, count, in_files, in_file_count, cb->data);
 
+    merge_reader_cleanup(&reader);
     merge_close_in_files(in_file_count, in_files);
 
     if (status == MERGE_OK || status == MERGE_USER_ABORTED) {
@@ -942,9 +1113,10 @@ merge_result
 merge_files(const gchar* out_filename, const int file_type,
             const char *const *in_filenames, const guint in_file_count,
             const gboolean do_append, const idb_merge_mode mode,
-            guint snaplen, const gchar *app_name, merge_progress_callback_t* cb,
-            int *err, gchar **err_info, guint *err_fileno,
-            guint32 *err_framenum)
+            guint snaplen, const guint max_open_files,
+            const wtap_compression_type compression_type, const gchar *app_name,
+            merge_progress_callback_t* cb, int *err, gchar **err_info,
+            guint *err_fileno, guint32 *err_framenum)
 {
     merge_in_file_t    *in_files = NULL;
     int                 frame_type = WTAP_ENCAP_PER_PACKET;
@@ -967,8 +1139,8 @@ merge_files(const gchar* out_filename, const int file_type,
     merge_debug("merge_files: begin");
 
     /* open the input files */
-    if (!merge_open_in_files(in_file_count, in_filenames, &in_files, cb,
-                             err, err_info, err_fileno)) {
+    if (!merge_open_in_files(in_file_count, in_filenames, max_open_files,
+                             &in_files, cb, err, err_info, err_fileno)) {
         merge_debug("merge_files: merge_open_in_files() failed with err=%d", *err);
         *err_framenum = 0;
         return MERGE_ERR_CANT_OPEN_INFILE;
@@ -1001,12 +1173,12 @@ merge_files(const gchar* out_filename, const int file_type,
         merge_debug("merge_files: IDB merge operation complete, got %u IDBs", idb_inf ? idb_inf->interface_data->len : 0);
 
         pdh = wtap_dump_open_ng(out_filename, file_type, frame_type, snaplen,
-                                FALSE /* compressed */, shb_hdrs, idb_inf,
+                                compression_type, shb_hdrs, idb_inf,
                                 NULL, err);
     }
     else {
         pdh = wtap_dump_open(out_filename, file_type, frame_type, snaplen,
-                             FALSE /* compressed */, err);
+                             compression_type, err);
     }
 
     if (pdh == NULL) {
@@ -1022,8 +1194,8 @@ merge_files(const gchar* out_filename, const int file_type,
         cb->callback_func(MERGE_EVENT_READY_TO_MERGE, 0, in_files, in_file_count, cb->data);
 
     status = merge_process_packets(pdh, file_type, in_files, in_file_count,
-                                   do_append, snaplen, cb, err, err_info,
-                                   err_fileno, err_framenum);
+                                   do_append, snaplen, max_open_files, cb,
+                                   err, err_info, err_fileno, err_framenum);
 
     g_free(in_files);
     wtap_block_array_free(shb_hdrs);
@@ -1042,8 +1214,9 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
                         const int file_type, const char *const *in_filenames,
                         const guint in_file_count, const gboolean do_append,
                         const idb_merge_mode mode, guint snaplen,
-                        const gchar *app_name, merge_progress_callback_t* cb,
-                        int *err, gchar **err_info, guint *err_fileno,
+                        const guint max_open_files, const gchar *app_name,
+                        merge_progress_callback_t* cb, int *err,
+                        gchar **err_info, guint *err_fileno,
                         guint32 *err_framenum)
 {
     merge_in_file_t    *in_files = NULL;
@@ -1070,8 +1243,8 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
     *out_filenamep = NULL;
 
     /* open the input files */
-    if (!merge_open_in_files(in_file_count, in_filenames, &in_files, cb,
-                             err, err_info, err_fileno)) {
+    if (!merge_open_in_files(in_file_count, in_filenames, max_open_files,
+                             &in_files, cb, err, err_info, err_fileno)) {
         merge_debug("merge_files: merge_open_in_files() failed with err=%d", *err);
         *err_framenum = 0;
         return MERGE_ERR_CANT_OPEN_INFILE;
@@ -1105,12 +1278,12 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
 
         pdh = wtap_dump_open_tempfile_ng(out_filenamep, pfx, file_type,
                                          frame_type, snaplen,
-                                         FALSE /* compressed */,
+                                         WTAP_UNCOMPRESSED,
                                          shb_hdrs, idb_inf, NULL, err);
     }
     else {
         pdh = wtap_dump_open_tempfile(out_filenamep, pfx, file_type, frame_type,
-                                      snaplen, FALSE /* compressed */, err);
+                                      snaplen, WTAP_UNCOMPRESSED, err);
     }
 
     if (pdh == NULL) {
@@ -1126,8 +1299,8 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
         cb->callback_func(MERGE_EVENT_READY_TO_MERGE, 0, in_files, in_file_count, cb->data);
 
     status = merge_process_packets(pdh, file_type, in_files, in_file_count,
-                                   do_append, snaplen, cb, err, err_info,
-                                   err_fileno, err_framenum);
+                                   do_append, snaplen, max_open_files, cb,
+                                   err, err_info, err_fileno, err_framenum);
 
     g_free(in_files);
     wtap_block_array_free(shb_hdrs);
@@ -1145,8 +1318,11 @@ merge_result
 merge_files_to_stdout(const int file_type, const char *const *in_filenames,
                       const guint in_file_count, const gboolean do_append,
                       const idb_merge_mode mode, guint snaplen,
-                      const gchar *app_name, merge_progress_callback_t* cb,
-                      int *err, gchar **err_info, guint *err_fileno,
+                      const guint max_open_files,
+                      const wtap_compression_type compression_type,
+                      const gchar *app_name,
+                      merge_progress_callback_t* cb, int *err,
+                      gchar **err_info, guint *err_fileno,
                       guint32 *err_framenum)
 {
     merge_in_file_t    *in_files = NULL;
@@ -1169,8 +1345,8 @@ merge_files_to_stdout(const int file_type, const char *const *in_filenames,
     merge_debug("merge_files: begin");
 
     /* open the input files */
-    if (!merge_open_in_files(in_file_count, in_filenames, &in_files, cb,
-                             err, err_info, err_fileno)) {
+    if (!merge_open_in_files(in_file_count, in_filenames, max_open_files,
+                             &in_files, cb, err, err_info, err_fileno)) {
         merge_debug("merge_files: merge_open_in_files() failed with err=%d", *err);
         *err_framenum = 0;
         return MERGE_ERR_CANT_OPEN_INFILE;
@@ -1203,12 +1379,12 @@ merge_files_to_stdout(const int file_type, const char *const *in_filenames,
         merge_debug("merge_files: IDB merge operation complete, got %u IDBs", idb_inf ? idb_inf->interface_data->len : 0);
 
         pdh = wtap_dump_open_stdout_ng(file_type, frame_type, snaplen,
-                                       FALSE /* compressed */, shb_hdrs,
+                                       compression_type, shb_hdrs,
                                        idb_inf, NULL, err);
     }
     else {
         pdh = wtap_dump_open_stdout(file_type, frame_type, snaplen,
-                                    FALSE /* compressed */, err);
+                                    compression_type, err);
     }
 
     if (pdh == NULL) {
@@ -1224,8 +1400,8 @@ merge_files_to_stdout(const int file_type, const char *const *in_filenames,
         cb->callback_func(MERGE_EVENT_READY_TO_MERGE, 0, in_files, in_file_count, cb->data);
 
     status = merge_process_packets(pdh, file_type, in_files, in_file_count,
-                                   do_append, snaplen, cb, err, err_info,
-                                   err_fileno, err_framenum);
+                                   do_append, snaplen, max_open_files, cb,
+                                   err, err_info, err_fileno, err_framenum);
 
     g_free(in_files);
     wtap_block_array_free(shb_hdrs);
@@ -34,6 +34,8 @@ typedef struct merge_in_file_s {
     guint32         packet_num;     /* current packet number */
     gint64          size;           /* file size */
     GArray         *idb_index_map;  /* used for mapping the old phdr interface_id values to new during merge */
+    gboolean        fd_closed;      /* file descriptor closed to stay within max_open_files */
+    guint32         last_used;      /* read clock value when last read from */
 } merge_in_file_t;
 
 /** Return values from merge_files(). */
@@ -119,6 +121,9 @@ typedef struct {
  * @param do_append Whether to append by file order instead of chronological order
  * @param mode The IDB_MERGE_MODE_XXX merge mode for interface data
  * @param snaplen The snaplen to limit it to, or 0 to leave as it is in the files
+ * @param max_open_files The maximum number of input files to keep open at
+ *   once, or 0 for no limit
+ * @param compression_type The type of compression for the output file
  * @param app_name The application name performing the merge, used in SHB info
  * @param cb The callback information to use during execution
  * @param[out] err Set to the internal WTAP_ERR_XXX error code if it failed
@@ -135,9 +140,10 @@ WS_DLL_PUBLIC merge_result
 merge_files(const gchar* out_filename, const int file_type,
             const char *const *in_filenames, const guint in_file_count,
             const gboolean do_append, const idb_merge_mode mode,
-            guint snaplen, const gchar *app_name, merge_progress_callback_t* cb,
-            int *err, gchar **err_info, guint *err_fileno,
-            guint32 *err_framenum);
+            guint snaplen, const guint max_open_files,
+            const wtap_compression_type compression_type, const gchar *app_name,
+            merge_progress_callback_t* cb, int *err, gchar **err_info,
+            guint *err_fileno, guint32 *err_framenum);
 
 /** Merge the given input files to a temporary file
  *
@@ -150,6 +156,8 @@ merge_files(const gchar* out_filename, const int file_type,
  * @param do_append Whether to append by file order instead of chronological order
  * @param mode The IDB_MERGE_MODE_XXX merge mode for interface data
  * @param snaplen The snaplen to limit it to, or 0 to leave as it is in the files
+ * @param max_open_files The maximum number of input files to keep open at
+ *   once, or 0 for no limit
  * @param app_name The application name performing the merge, used in SHB info
  * @param cb The callback information to use during execution
  * @param[out] err Set to the internal WTAP_ERR_XXX error code if it failed
@@ -167,8 +175,9 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
                         const int file_type, const char *const *in_filenames,
                         const guint in_file_count, const gboolean do_append,
                         const idb_merge_mode mode, guint snaplen,
-                        const gchar *app_name, merge_progress_callback_t* cb,
-                        int *err, gchar **err_info, guint *err_fileno,
+                        const guint max_open_files, const gchar *app_name,
+                        merge_progress_callback_t* cb, int *err,
+                        gchar **err_info, guint *err_fileno,
                         guint32 *err_framenum);
 
 /** Merge the given input files to the standard output
@@ -179,6 +188,9 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
  * @param do_append Whether to append by file order instead of chronological order
  * @param mode The IDB_MERGE_MODE_XXX merge mode for interface data
  * @param snaplen The snaplen to limit it to, or 0 to leave as it is in the files
+ * @param max_open_files The maximum number of input files to keep open at
+ *   once, or 0 for no limit
+ * @param compression_type The type of compression for the output
  * @param app_name The application name performing the merge, used in SHB info
  * @param cb The callback information to use during execution
  * @param[out] err Set to the internal WTAP_ERR_XXX error code if it failed
@@ -195,8 +207,11 @@ WS_DLL_PUBLIC merge_result
 merge_files_to_stdout(const int file_type, const char *const *in_filenames,
                       const guint in_file_count, const gboolean do_append,
                       const idb_merge_mode mode, guint snaplen,
-                      const gchar *app_name, merge_progress_callback_t* cb,
-                      int *err, gchar **err_info, guint *err_fileno,
+                      const guint max_open_files,
+                      const wtap_compression_type compression_type,
+                      const gchar *app_name,
+                      merge_progress_callback_t* cb, int *err,
+                      gchar **err_info, guint *err_fileno,
                       guint32 *err_framenum);
 
 #ifdef __cplusplus
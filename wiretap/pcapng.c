@@ -2268,6 +2268,11 @@ pcapng_read_unknown_block(FILE_T fh, pcapng_block_header_t *bh,
         if (!handler->reader(fh, block_read, pn->byte_swapped, wblock,
                              err, err_info))
             return FALSE;
+        if (wblock->rec->rec_type == REC_TYPE_FT_SPECIFIC_EVENT ||
+            wblock->rec->rec_type == REC_TYPE_FT_SPECIFIC_REPORT) {
+            wblock->rec->rec_header.ft_specific_header.record_len =
+                (guint32)ws_buffer_length(wblock->frame_buffer);
+        }
     } else
 #endif
     {
@@ -83,6 +83,14 @@ wtap_iscompressed(wtap *wth)
 	return file_iscompressed((wth->fh == NULL) ? wth->random_fh : wth->fh);
 }
 
+gboolean
+wtap_set_read_ahead(wtap *wth)
+{
+	if (wth->fh == NULL)
+		return FALSE;
+	return file_set_read_ahead(wth->fh);
+}
+
 guint
 wtap_snapshot_length(wtap *wth)
 {
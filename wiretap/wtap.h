@@ -1260,6 +1260,7 @@ typedef struct {
 
 typedef struct {
     guint     record_type;      /* the type of record this is - file type-specific value */
+    guint32   record_len;       /* length of the record data */
 } wtap_ft_specific_header;
 
 typedef struct {
@@ -1415,6 +1416,17 @@ typedef struct wtap_dumper wtap_dumper;
 
 typedef struct wtap_reader *FILE_T;
 
+/**
+ * Types of compression for a file being written, including "none".
+ */
+typedef enum {
+    WTAP_UNCOMPRESSED,
+    WTAP_GZIP_COMPRESSED,
+    WTAP_ZSTD_COMPRESSED,
+    WTAP_LZ4_COMPRESSED,
+    WTAP_UNKNOWN_COMPRESSION
+} wtap_compression_type;
+
 /* Similar to the wtap_open_routine_info for open routines, the following
  * wtap_wslua_file_info struct is used by wslua code for Lua-based file writers.
  *
@@ -1664,6 +1676,11 @@ WS_DLL_PUBLIC
 gint64 wtap_file_size(wtap *wth, int *err);
 WS_DLL_PUBLIC
 gboolean wtap_iscompressed(wtap *wth);
+/** Read and decompress the file on a separate thread when reading it
+ * sequentially.  Returns FALSE if that couldn't be set up, in which case
+ * the file is read as before. */
+WS_DLL_PUBLIC
+gboolean wtap_set_read_ahead(wtap *wth);
 WS_DLL_PUBLIC
 guint wtap_snapshot_length(wtap *wth); /* per file */
 WS_DLL_PUBLIC
@@ -1797,6 +1814,11 @@ void wtap_fdclose(wtap *wth);
 WS_DLL_PUBLIC
 gboolean wtap_fdreopen(wtap *wth, const char *filename, int *err);
 
+/*** reopen the sequential file descriptor for the current file, at the
+     position where it was closed ***/
+WS_DLL_PUBLIC
+gboolean wtap_sequential_fdreopen(wtap *wth, const char *filename, int *err);
+
 /** Close only the sequential side, freeing up memory it uses. */
 WS_DLL_PUBLIC
 void wtap_sequential_close(wtap *wth);
@@ -1823,6 +1845,13 @@ int wtap_dump_file_encap_type(const GArray *file_encaps);
 WS_DLL_PUBLIC
 gboolean wtap_dump_can_compress(int filetype);
 
+/**
+ * Return TRUE if this build can write files with this type of
+ * compression, FALSE if not.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_can_write_compression_type(wtap_compression_type compression_type);
+
 /**
  * Return TRUE if this capture file format supports storing name
  * resolution information in it, FALSE if not.
@@ -1839,7 +1868,7 @@ gboolean wtap_dump_supports_comment_types(int filetype, guint32 comment_types);
 
 WS_DLL_PUBLIC
 wtap_dumper* wtap_dump_open(const char *filename, int file_type_subtype, int encap,
-    int snaplen, gboolean compressed, int *err);
+    int snaplen, wtap_compression_type compression_type, int *err);
 
 /**
  * @brief Opens a new capture file for writing.
@@ -1852,7 +1881,7 @@ wtap_dumper* wtap_dump_open(const char *filename, int file_type_subtype, int enc
  * @param file_type_subtype The WTAP_FILE_TYPE_SUBTYPE_XXX file type.
  * @param encap The WTAP_ENCAP_XXX encapsulation type (WTAP_ENCAP_PER_PACKET for multi)
  * @param snaplen The maximum packet capture length.
- * @param compressed True if file should be compressed.
+ * @param compression_type Type of compression to use when writing, if any.
  * @param shb_hdrs The section header block(s) information, or NULL.
  * @param idb_inf The interface description information, or NULL.
  * @param nrb_hdrs The name resolution blocks(s) comment/custom_opts information, or NULL.
@@ -1861,12 +1890,12 @@ wtap_dumper* wtap_dump_open(const char *filename, int file_type_subtype, int enc
  */
 WS_DLL_PUBLIC
 wtap_dumper* wtap_dump_open_ng(const char *filename, int file_type_subtype, int encap,
-    int snaplen, gboolean compressed, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
+    int snaplen, wtap_compression_type compression_type, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
     GArray* nrb_hdrs, int *err);
 
 WS_DLL_PUBLIC
 wtap_dumper* wtap_dump_open_tempfile(char **filenamep, const char *pfx,
-    int file_type_subtype, int encap, int snaplen, gboolean compressed,
+    int file_type_subtype, int encap, int snaplen, wtap_compression_type compression_type,
     int *err);
 
 /**
@@ -1882,7 +1911,7 @@ wtap_dumper* wtap_dump_open_tempfile(char **filenamep, const char *pfx,
  * @param file_type_subtype The WTAP_FILE_TYPE_SUBTYPE_XXX file type.
  * @param encap The WTAP_ENCAP_XXX encapsulation type (WTAP_ENCAP_PER_PACKET for multi)
  * @param snaplen The maximum packet capture length.
- * @param compressed True if file should be compressed.
+ * @param compression_type Type of compression to use when writing, if any.
  * @param shb_hdrs The section header block(s) information, or NULL.
  * @param idb_inf The interface description information, or NULL.
  * @param nrb_hdrs The name resolution blocks(s) comment/custom_opts information, or NULL.
@@ -1891,13 +1920,13 @@ wtap_dumper* wtap_dump_open_tempfile(char **filenamep, const char *pfx,
  */
 WS_DLL_PUBLIC
 wtap_dumper* wtap_dump_open_tempfile_ng(char **filenamep, const char *pfx,
-    int file_type_subtype, int encap, int snaplen, gboolean compressed,
+    int file_type_subtype, int encap, int snaplen, wtap_compression_type compression_type,
     GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
     GArray* nrb_hdrs, int *err);
 
 WS_DLL_PUBLIC
 wtap_dumper* wtap_dump_fdopen(int fd, int file_type_subtype, int encap, int snaplen,
-    gboolean compressed, int *err);
+    wtap_compression_type compression_type, int *err);
 
 /**
  * @brief Creates a dumper for an existing file descriptor.
@@ -1910,7 +1939,7 @@ wtap_dumper* wtap_dump_fdopen(int fd, int file_type_subtype, int encap, int snap
  * @param file_type_subtype The WTAP_FILE_TYPE_SUBTYPE_XXX file type.
  * @param encap The WTAP_ENCAP_XXX encapsulation type (WTAP_ENCAP_PER_PACKET for multi)
  * @param snaplen The maximum packet capture length.
- * @param compressed True if file should be compressed.
+ * @param compression_type Type of compression to use when writing, if any.
  * @param shb_hdrs The section header block(s) information, or NULL.
  * @param idb_inf The interface description information, or NULL.
  * @param nrb_hdrs The name resolution blocks(s) comment/custom_opts information, or NULL.
@@ -1919,12 +1948,12 @@ wtap_dumper* wtap_dump_fdopen(int fd, int file_type_subtype, int encap, int snap
  */
 WS_DLL_PUBLIC
 wtap_dumper* wtap_dump_fdopen_ng(int fd, int file_type_subtype, int encap, int snaplen,
-                gboolean compressed, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
+                wtap_compression_type compression_type, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
                 GArray* nrb_hdrs, int *err);
 
 WS_DLL_PUBLIC
 wtap_dumper* wtap_dump_open_stdout(int file_type_subtype, int encap, int snaplen,
-    gboolean compressed, int *err);
+    wtap_compression_type compression_type, int *err);
 
 /**
  * @brief Creates a dumper for the standard output.
@@ -1936,7 +1965,7 @@ wtap_dumper* wtap_dump_open_stdout(int file_type_subtype, int encap, int snaplen
  * @param file_type_subtype The WTAP_FILE_TYPE_SUBTYPE_XXX file type.
  * @param encap The WTAP_ENCAP_XXX encapsulation type (WTAP_ENCAP_PER_PACKET for multi)
  * @param snaplen The maximum packet capture length.
- * @param compressed True if file should be compressed.
+ * @param compression_type Type of compression to use when writing, if any.
  * @param shb_hdrs The section header block(s) information, or NULL.
  * @param idb_inf The interface description information, or NULL.
  * @param nrb_hdrs The name resolution blocks(s) comment/custom_opts information, or NULL.
@@ -1945,7 +1974,7 @@ wtap_dumper* wtap_dump_open_stdout(int file_type_subtype, int encap, int snaplen
  */
 WS_DLL_PUBLIC
 wtap_dumper* wtap_dump_open_stdout_ng(int file_type_subtype, int encap, int snaplen,
-                gboolean compressed, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
+                wtap_compression_type compression_type, GArray* shb_hdrs, wtapng_iface_descriptions_t *idb_inf,
                 GArray* nrb_hdrs, int *err);
 
 WS_DLL_PUBLIC
@@ -2006,6 +2035,18 @@ GSList *wtap_get_file_extensions_list(int filetype, gboolean include_compressed)
 WS_DLL_PUBLIC
 void wtap_free_extensions_list(GSList *extensions);
 
+/*** compression type functions ***/
+WS_DLL_PUBLIC
+wtap_compression_type wtap_name_to_compression_type(const char *name);
+WS_DLL_PUBLIC
+const char *wtap_compression_type_name(wtap_compression_type compression_type);
+WS_DLL_PUBLIC
+const char *wtap_compression_type_extension(wtap_compression_type compression_type);
+/** Return a list of the names of the compression types this build can
+ * write; free it with g_slist_free(). */
+WS_DLL_PUBLIC
+GSList *wtap_get_all_compression_type_names_list(void);
+
 WS_DLL_PUBLIC
 const char *wtap_encap_string(int encap);
 WS_DLL_PUBLIC
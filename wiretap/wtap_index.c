@@ -0,0 +1,434 @@
+/* wtap_index.c
+ * Routines for reading and writing sidecar record index files
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wtap-int.h"
+#include "wtap_index.h"
+
+#include <wsutil/file_util.h>
+#include <wsutil/pint.h>
+
+/*
+ * Index file layout; all values are little-endian.
+ *
+ * Header:
+ *
+ *    4 bytes  magic, "WSIX"
+ *    4 bytes  version
+ *    8 bytes  size of the capture file
+ *    8 bytes  modification time of the capture file, in seconds
+ *    4 bytes  file type/subtype
+ *    4 bytes  file encapsulation
+ *    4 bytes  number of interface description blocks
+ *    4 bytes  number of records
+ *
+ * followed by one entry per record:
+ *
+ *    8 bytes  file offset
+ *    8 bytes  time stamp, seconds
+ *    4 bytes  time stamp, nanoseconds
+ *    4 bytes  length
+ *    4 bytes  captured length
+ *    2 bytes  encapsulation
+ *    2 bytes  time stamp precision
+ *    1 byte   record type
+ *    1 byte   flags
+ *
+ * The number of interface description blocks is checked because
+ * pcapng files only have the ones before the first packet read when
+ * the file is opened; if there are any after that, the sequential pass
+ * is needed to find them.
+ *
+ * Other pcapng blocks that aren't records - name resolution blocks,
+ * interface statistics blocks and further section headers - are also
+ * only seen by the sequential pass, and name resolution entries are
+ * handed to the caller as they're read, so no index is written for a
+ * file that has any of them.
+ */
+static const guint8 index_magic[4] = { 'W', 'S', 'I', 'X' };
+
+#define INDEX_VERSION           2
+#define INDEX_HEADER_SIZE       40
+#define INDEX_ENTRY_SIZE        34
+
+#define INDEX_FLAG_HAS_TS       0x01
+#define INDEX_FLAG_HAS_COMMENT  0x02
+
+/* Number of entries read or written at a time. */
+#define INDEX_CHUNK_ENTRIES     4096
+
+typedef struct {
+    gint64   offset;
+    nstime_t ts;
+    guint32  len;
+    guint32  caplen;
+    gint16   pkt_encap;
+    gint16   tsprec;
+    guint8   rec_type;
+    guint8   flags;
+} wtap_index_entry_t;
+
+struct wtap_index {
+    int      file_type_subtype;
+    int      file_encap;
+    GArray  *entries;           /* array of wtap_index_entry_t */
+};
+
+#define put_le16(p, v) do { guint16 v16_ = GUINT16_TO_LE(v); memcpy((p), &v16_, 2); } while (0)
+#define put_le32(p, v) do { guint32 v32_ = GUINT32_TO_LE(v); memcpy((p), &v32_, 4); } while (0)
+#define put_le64(p, v) do { guint64 v64_ = GUINT64_TO_LE(v); memcpy((p), &v64_, 8); } while (0)
+
+static guint32
+index_num_idbs(wtap *wth)
+{
+    return wth->interface_data != NULL ? wth->interface_data->len : 0;
+}
+
+/*
+ * Does the file have blocks, other than records, that only a sequential
+ * read delivers?  Only meaningful once the whole file has been read.
+ */
+static gboolean
+index_has_sequential_only_blocks(wtap *wth)
+{
+    guint i;
+
+    if (wth->nrb_hdrs != NULL && wth->nrb_hdrs->len != 0)
+        return TRUE;
+    if (wth->shb_hdrs != NULL && wth->shb_hdrs->len > 1)
+        return TRUE;
+    if (wth->interface_data != NULL) {
+        for (i = 0; i < wth->interface_data->len; i++) {
+            wtapng_if_descr_mandatory_t *if_descr_mand =
+                (wtapng_if_descr_mandatory_t *)wtap_block_get_mandatory_data(g_array_index(wth->interface_data, wtap_block_t, i));
+
+            if (if_descr_mand->num_stat_entries != 0)
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+char *
+wtap_index_filename(const char *filename)
+{
+    return g_strconcat(filename, WTAP_INDEX_SUFFIX, NULL);
+}
+
+wtap_index_t *
+wtap_index_new(wtap *wth)
+{
+    wtap_index_t *idx;
+
+    if (wtap_iscompressed(wth))
+        return NULL;
+
+    idx = g_new(wtap_index_t, 1);
+    idx->file_type_subtype = wtap_file_type_subtype(wth);
+    idx->file_encap = WTAP_ENCAP_UNKNOWN;
+    idx->entries = g_array_new(FALSE, FALSE, sizeof (wtap_index_entry_t));
+    return idx;
+}
+
+void
+wtap_index_append(wtap_index_t *idx, gint64 data_offset, const wtap_rec *rec)
+{
+    wtap_index_entry_t entry;
+
+    entry.offset = data_offset;
+    entry.ts = rec->ts;
+    entry.tsprec = (gint16)rec->tsprec;
+    entry.rec_type = (guint8)rec->rec_type;
+    entry.flags = 0;
+    if (rec->presence_flags & WTAP_HAS_TS)
+        entry.flags |= INDEX_FLAG_HAS_TS;
+    if (rec->opt_comment != NULL)
+        entry.flags |= INDEX_FLAG_HAS_COMMENT;
+
+    switch (rec->rec_type) {
+
+    case REC_TYPE_PACKET:
+        entry.len = rec->rec_header.packet_header.len;
+        entry.caplen = rec->rec_header.packet_header.caplen;
+        entry.pkt_encap = (gint16)rec->rec_header.packet_header.pkt_encap;
+        break;
+
+    case REC_TYPE_SYSCALL:
+        entry.len = rec->rec_header.syscall_header.event_len;
+        entry.caplen = rec->rec_header.syscall_header.event_filelen;
+        entry.pkt_encap = WTAP_ENCAP_UNKNOWN;
+        break;
+
+    default:
+        entry.len = 0;
+        entry.caplen = 0;
+        entry.pkt_encap = WTAP_ENCAP_UNKNOWN;
+        break;
+    }
+
+    g_array_append_val(idx->entries, entry);
+}
+
+gboolean
+wtap_index_write(wtap_index_t *idx, wtap *wth, const char *filename, int *err)
+{
+    ws_statb64 statb;
+    guint8 header[INDEX_HEADER_SIZE];
+    guint8 *buf, *p;
+    char *index_filename, *tmp_filename;
+    FILE *fh;
+    guint i, j, n;
+
+    *err = 0;
+
+    /*
+     * If the file has grown, or been replaced, since we read it, the
+     * index doesn't describe it.
+     */
+    if (ws_stat64(filename, &statb) != 0)
+        return TRUE;
+    if ((gint64)statb.st_size != wtap_read_so_far(wth))
+        return TRUE;
+
+    /*
+     * Opening the file from an index would lose blocks only the
+     * sequential pass sees; make sure no older index is used either.
+     */
+    index_filename = wtap_index_filename(filename);
+    if (index_has_sequential_only_blocks(wth)) {
+        ws_remove(index_filename);
+        g_free(index_filename);
+        return TRUE;
+    }
+
+    idx->file_encap = wtap_file_encap(wth);
+
+    memcpy(header, index_magic, 4);
+    put_le32(header + 4, INDEX_VERSION);
+    put_le64(header + 8, (guint64)statb.st_size);
+    put_le64(header + 16, (guint64)(gint64)statb.st_mtime);
+    put_le32(header + 24, (guint32)idx->file_type_subtype);
+    put_le32(header + 28, (guint32)idx->file_encap);
+    put_le32(header + 32, index_num_idbs(wth));
+    put_le32(header + 36, idx->entries->len);
+
+    /*
+     * Write to a temporary file and rename it, so that a reader never
+     * sees a partly-written index.
+     */
+    tmp_filename = g_strconcat(index_filename, ".tmp", NULL);
+    fh = ws_fopen(tmp_filename, "wb");
+    if (fh == NULL) {
+        *err = errno;
+        g_free(tmp_filename);
+        g_free(index_filename);
+        return FALSE;
+    }
+
+    buf = (guint8 *)g_malloc(INDEX_CHUNK_ENTRIES * INDEX_ENTRY_SIZE);
+    errno = 0;
+    if (fwrite(header, 1, sizeof header, fh) != sizeof header)
+        goto write_failed;
+    for (i = 0; i < idx->entries->len; i += n) {
+        n = MIN(idx->entries->len - i, INDEX_CHUNK_ENTRIES);
+        p = buf;
+        for (j = 0; j < n; j++) {
+            const wtap_index_entry_t *entry = &g_array_index(idx->entries, wtap_index_entry_t, i + j);
+
+            put_le64(p, (guint64)entry->offset);
+            put_le64(p + 8, (guint64)(gint64)entry->ts.secs);
+            put_le32(p + 16, (guint32)entry->ts.nsecs);
+            put_le32(p + 20, entry->len);
+            put_le32(p + 24, entry->caplen);
+            put_le16(p + 28, (guint16)entry->pkt_encap);
+            put_le16(p + 30, (guint16)entry->tsprec);
+            p[32] = entry->rec_type;
+            p[33] = entry->flags;
+            p += INDEX_ENTRY_SIZE;
+        }
+        if (fwrite(buf, INDEX_ENTRY_SIZE, n, fh) != n)
+            goto write_failed;
+    }
+    g_free(buf);
+    buf = NULL;
+
+    if (fclose(fh) == EOF) {
+        fh = NULL;
+        goto write_failed;
+    }
+    fh = NULL;
+#ifdef _WIN32
+    /* rename() doesn't replace an existing file on Windows. */
+    ws_remove(index_filename);
+#endif
+    if (ws_rename(tmp_filename, index_filename) != 0)
+        goto write_failed;
+
+    g_free(tmp_filename);
+    g_free(index_filename);
+    return TRUE;
+
+write_failed:
+    *err = errno != 0 ? errno : EIO;
+    g_free(buf);
+    if (fh != NULL)
+        fclose(fh);
+    ws_remove(tmp_filename);
+    g_free(tmp_filename);
+    g_free(index_filename);
+    return FALSE;
+}
+
+wtap_index_t *
+wtap_index_read(wtap *wth, const char *filename)
+{
+    ws_statb64 statb;
+    guint8 header[INDEX_HEADER_SIZE];
+    guint8 *buf = NULL, *p;
+    char *index_filename;
+    FILE *fh;
+    wtap_index_t *idx = NULL;
+    guint32 count, i, j, n;
+
+    if (wtap_iscompressed(wth))
+        return NULL;
+    if (ws_stat64(filename, &statb) != 0)
+        return NULL;
+
+    index_filename = wtap_index_filename(filename);
+    fh = ws_fopen(index_filename, "rb");
+    g_free(index_filename);
+    if (fh == NULL)
+        return NULL;
+
+    if (fread(header, 1, sizeof header, fh) != sizeof header)
+        goto invalid;
+    if (memcmp(header, index_magic, 4) != 0 ||
+        pletoh32(header + 4) != INDEX_VERSION ||
+        pletoh64(header + 8) != (guint64)statb.st_size ||
+        (gint64)pletoh64(header + 16) != (gint64)statb.st_mtime ||
+        (int)pletoh32(header + 24) != wtap_file_type_subtype(wth) ||
+        pletoh32(header + 32) != index_num_idbs(wth))
+        goto invalid;
+    count = pletoh32(header + 36);
+
+    idx = g_new(wtap_index_t, 1);
+    idx->file_type_subtype = wtap_file_type_subtype(wth);
+    idx->file_encap = (int)pletoh32(header + 28);
+    idx->entries = g_array_sized_new(FALSE, FALSE, sizeof (wtap_index_entry_t), count);
+
+    buf = (guint8 *)g_malloc(INDEX_CHUNK_ENTRIES * INDEX_ENTRY_SIZE);
+    for (i = 0; i < count; i += n) {
+        n = MIN(count - i, INDEX_CHUNK_ENTRIES);
+        if (fread(buf, INDEX_ENTRY_SIZE, n, fh) != n)
+            goto invalid;
+        p = buf;
+        for (j = 0; j < n; j++) {
+            wtap_index_entry_t entry;
+
+            entry.offset = (gint64)pletoh64(p);
+            entry.ts.secs = (time_t)(gint64)pletoh64(p + 8);
+            entry.ts.nsecs = (int)pletoh32(p + 16);
+            entry.len = pletoh32(p + 20);
+            entry.caplen = pletoh32(p + 24);
+            entry.pkt_encap = (gint16)pletoh16(p + 28);
+            entry.tsprec = (gint16)pletoh16(p + 30);
+            entry.rec_type = p[32];
+            entry.flags = p[33];
+            if (entry.offset < 0 || entry.offset >= (gint64)statb.st_size)
+                goto invalid;
+            g_array_append_val(idx->entries, entry);
+            p += INDEX_ENTRY_SIZE;
+        }
+    }
+    /* There shouldn't be anything after the last entry. */
+    if (fgetc(fh) != EOF)
+        goto invalid;
+
+    g_free(buf);
+    fclose(fh);
+    return idx;
+
+invalid:
+    g_free(buf);
+    wtap_index_free(idx);
+    fclose(fh);
+    return NULL;
+}
+
+guint32
+wtap_index_count(const wtap_index_t *idx)
+{
+    return idx->entries->len;
+}
+
+int
+wtap_index_file_encap(const wtap_index_t *idx)
+{
+    return idx->file_encap;
+}
+
+gint64
+wtap_index_get_rec(const wtap_index_t *idx, guint32 n, wtap_rec *rec,
+                   gboolean *has_comment)
+{
+    const wtap_index_entry_t *entry = &g_array_index(idx->entries, wtap_index_entry_t, n);
+
+    rec->rec_type = entry->rec_type;
+    rec->presence_flags = (entry->flags & INDEX_FLAG_HAS_TS) ? WTAP_HAS_TS : 0;
+    rec->ts = entry->ts;
+    rec->tsprec = entry->tsprec;
+    rec->opt_comment = NULL;
+
+    switch (entry->rec_type) {
+
+    case REC_TYPE_PACKET:
+        rec->rec_header.packet_header.len = entry->len;
+        rec->rec_header.packet_header.caplen = entry->caplen;
+        rec->rec_header.packet_header.pkt_encap = entry->pkt_encap;
+        break;
+
+    case REC_TYPE_SYSCALL:
+        rec->rec_header.syscall_header.event_len = entry->len;
+        rec->rec_header.syscall_header.event_filelen = entry->caplen;
+        break;
+    }
+
+    *has_comment = (entry->flags & INDEX_FLAG_HAS_COMMENT) != 0;
+    return entry->offset;
+}
+
+void
+wtap_index_free(wtap_index_t *idx)
+{
+    if (idx == NULL)
+        return;
+
+    g_array_free(idx->entries, TRUE);
+    g_free(idx);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,130 @@
+/* wtap_index.h
+ * Definitions for sidecar record index files
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __WTAP_INDEX_H__
+#define __WTAP_INDEX_H__
+
+#include "wiretap/wtap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * A record index holds, for every record of a capture file, what a
+ * program needs in order to list the record without reading it: its
+ * offset in the file, its time stamp, its lengths and its encapsulation.
+ *
+ * It is kept in a sidecar file next to the capture file, named by
+ * wtap_index_filename(), so that the next time the capture file is
+ * opened the sequential pass over it can be skipped and the records
+ * read with wtap_seek_read() when they're needed.  The index records the
+ * size and modification time of the capture file, and is ignored if
+ * either of them has changed.
+ *
+ * Compressed files aren't indexed, as random access to them depends on
+ * state built up during the sequential pass.
+ */
+typedef struct wtap_index wtap_index_t;
+
+/** Suffix appended to the name of a capture file to get its index file. */
+#define WTAP_INDEX_SUFFIX ".wsidx"
+
+/**
+ * Programs write an index for files at least this large when they read
+ * them; smaller files are read quickly enough without one.
+ */
+#define WTAP_INDEX_MIN_FILE_SIZE (64 * 1024 * 1024)
+
+/**
+ * Return the name of the index file for a capture file; it must be
+ * g_free()d.
+ */
+WS_DLL_PUBLIC
+char *wtap_index_filename(const char *filename);
+
+/**
+ * Start a new, empty index for a capture file that is about to be read
+ * sequentially.  Returns NULL if the file can't be indexed.
+ */
+WS_DLL_PUBLIC
+wtap_index_t *wtap_index_new(wtap *wth);
+
+/** Add the record just read by wtap_read() at data_offset to the index. */
+WS_DLL_PUBLIC
+void wtap_index_append(wtap_index_t *idx, gint64 data_offset, const wtap_rec *rec);
+
+/**
+ * Write the index for a capture file that has been read sequentially to
+ * the end, before wtap_sequential_close() is called.  If the file has
+ * changed while it was being read, nothing is written.
+ *
+ * @param idx The index built while reading the file.
+ * @param wth The wiretap session the file was read with.
+ * @param filename The name of the capture file.
+ * @param[out] err Set to an errno value on failure.
+ * @return TRUE on success or if the index was deliberately not written,
+ * FALSE on failure.
+ */
+WS_DLL_PUBLIC
+gboolean wtap_index_write(wtap_index_t *idx, wtap *wth, const char *filename,
+                          int *err);
+
+/**
+ * Read the index of a capture file that has just been opened.  Returns
+ * NULL if there is no index or if it isn't valid for the file as it
+ * currently is.
+ */
+WS_DLL_PUBLIC
+wtap_index_t *wtap_index_read(wtap *wth, const char *filename);
+
+/** Return the number of records in the index. */
+WS_DLL_PUBLIC
+guint32 wtap_index_count(const wtap_index_t *idx);
+
+/**
+ * Return the encapsulation type of the file as it was after the whole
+ * file had been read, for use in place of wtap_file_encap().
+ */
+WS_DLL_PUBLIC
+int wtap_index_file_encap(const wtap_index_t *idx);
+
+/**
+ * Fill in the parts of rec needed to add record n (0-origin) to the
+ * list of records, and return its offset in the file, as it would have
+ * been returned by wtap_read().  *has_comment is set to TRUE if the
+ * record has a comment, which isn't itself part of the index.
+ */
+WS_DLL_PUBLIC
+gint64 wtap_index_get_rec(const wtap_index_t *idx, guint32 n, wtap_rec *rec,
+                          gboolean *has_comment);
+
+/** Free an index. */
+WS_DLL_PUBLIC
+void wtap_index_free(wtap_index_t *idx);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __WTAP_INDEX_H__ */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -53,7 +53,9 @@ get_cpu_info(GString *str)
 
     g_string_append_printf(str, "%s", CPUBrandString);
 
-    if (ws_cpuid_sse42())
+    if (ws_cpuid_avx2())
+        g_string_append(str, " (with SSE4.2, AVX2)");
+    else if (ws_cpuid_sse42())
         g_string_append(str, " (with SSE4.2)");
 }
 
@@ -106,6 +106,8 @@ WS_DLL_PUBLIC FILE * ws_stdio_freopen (const gchar *filename, const gchar *mode,
 #define ws_dup     _dup
 #define ws_fstat64 _fstati64	/* use _fstati64 for 64-bit size support */
 #define ws_lseek64 _lseeki64	/* use _lseeki64 for 64-bit offset support */
+#define ws_fseek64 _fseeki64	/* use _fseeki64 for 64-bit offset support */
+#define ws_ftell64 _ftelli64	/* use _ftelli64 for 64-bit offset support */
 #define ws_fdopen  _fdopen
 #define ws_fileno  _fileno
 #define ws_isatty  _isatty
@@ -188,6 +190,8 @@ WS_DLL_PUBLIC void close_app_running_mutex();
 #define ws_dup     dup
 #define ws_fstat64 fstat	/* AC_SYS_LARGEFILE should make off_t 64-bit */
 #define ws_lseek64 lseek	/* AC_SYS_LARGEFILE should make off_t 64-bit */
+#define ws_fseek64 fseeko	/* AC_SYS_LARGEFILE should make off_t 64-bit */
+#define ws_ftell64 ftello	/* AC_SYS_LARGEFILE should make off_t 64-bit */
 #define ws_fdopen  fdopen
 #define ws_fileno  fileno
 #define ws_isatty  isatty
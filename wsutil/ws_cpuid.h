@@ -89,7 +89,7 @@ ws_cpuid(guint32 *CPUInfo _U_, int selector _U_)
 }
 #endif
 
-static int
+static inline int
 ws_cpuid_sse42(void)
 {
 	guint32 CPUInfo[4];
@@ -100,3 +100,57 @@ ws_cpuid_sse42(void)
 	/* in ECX bit 20 toggled on */
 	return (CPUInfo[2] & (1 << 20));
 }
+
+/*
+ * Get the contents of extended control register 0, which says which
+ * register states the OS saves on context switches.
+ */
+#if defined(_MSC_VER)     /* MSVC */
+#include <immintrin.h>
+
+static inline guint64
+ws_xgetbv0(void)
+{
+	return _xgetbv(0);
+}
+#elif defined(__GNUC__) && defined(__x86_64__)
+static inline guint64
+ws_xgetbv0(void)
+{
+	guint32 eax, edx;
+
+	/* xgetbv, spelled out for assemblers that don't know it */
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0"
+						: "=a" (eax), "=d" (edx)
+						: "c" (0));
+	return ((guint64)edx << 32) | eax;
+}
+#else
+static inline guint64
+ws_xgetbv0(void)
+{
+	return 0;
+}
+#endif
+
+static inline int
+ws_cpuid_avx2(void)
+{
+	guint32 CPUInfo[4];
+
+	if (!ws_cpuid(CPUInfo, 0) || CPUInfo[0] < 7)
+		return 0;
+
+	/* in ECX of leaf 1 OSXSAVE (bit 27) and AVX (bit 28) toggled on... */
+	ws_cpuid(CPUInfo, 1);
+	if ((CPUInfo[2] & ((1 << 27) | (1 << 28))) != ((1 << 27) | (1 << 28)))
+		return 0;
+
+	/* ...the OS saving the SSE and AVX registers... */
+	if ((ws_xgetbv0() & 0x6) != 0x6)
+		return 0;
+
+	/* ...and in EBX of leaf 7 bit 5 toggled on */
+	ws_cpuid(CPUInfo, 7);
+	return (CPUInfo[1] & (1 << 5));
+}
@@ -0,0 +1,248 @@
+/* ws_memmem.c
+ * Searching memory for one or more byte strings
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include "ws_symbol_export.h"
+#include "ws_memmem.h"
+#include "ws_memmem_int.h"
+
+/*
+ * The vectorized searches compare the first and the last byte of each
+ * needle against a block of 16 or 32 consecutive haystack positions at
+ * once, and only compare the whole needle at the positions where both
+ * of those match; see "SIMD-friendly algorithms for substring searching"
+ * by Wojciech Muła, http://0x80.pl/articles/simd-strfind.html
+ *
+ * SSE2 is always available on x86-64, so it needs neither a compiler
+ * flag nor a run-time check; AVX2 needs both, so it's in a file of its
+ * own.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WS_MEMMEM_SSE2
+#include <emmintrin.h>
+#endif
+
+static void
+ws_memmem_needle_set(ws_memmem_needle *needle, const guint8 *bytes, size_t len,
+        size_t stride, gboolean nocase)
+{
+    needle->bytes = bytes;
+    needle->len = len;
+    needle->stride = stride;
+    needle->span = (len - 1) * stride + 1;
+    needle->first[0] = bytes[0];
+    needle->last[0] = bytes[len - 1];
+    needle->first[1] = nocase ? g_ascii_tolower(bytes[0]) : bytes[0];
+    needle->last[1] = nocase ? g_ascii_tolower(bytes[len - 1]) : bytes[len - 1];
+}
+
+void
+ws_memmem_pattern_init(ws_memmem_pattern *pattern, gboolean nocase)
+{
+    pattern->num_needles = 0;
+    pattern->nocase = nocase;
+    pattern->max_span = 0;
+}
+
+gboolean
+ws_memmem_pattern_add(ws_memmem_pattern *pattern, const guint8 *needle,
+        size_t needle_len, size_t stride)
+{
+    ws_memmem_needle *n;
+    size_t i;
+
+    if (needle_len == 0 || stride == 0 ||
+        pattern->num_needles == WS_MEMMEM_MAX_NEEDLES)
+        return FALSE;
+
+    n = &pattern->needles[pattern->num_needles++];
+    n->copy = (guint8 *)g_memdup(needle, (guint)needle_len);
+    if (pattern->nocase) {
+        for (i = 0; i < needle_len; i++)
+            n->copy[i] = g_ascii_toupper(n->copy[i]);
+    }
+    ws_memmem_needle_set(n, n->copy, needle_len, stride, pattern->nocase);
+
+    if (n->span > pattern->max_span)
+        pattern->max_span = n->span;
+    return TRUE;
+}
+
+void
+ws_memmem_pattern_cleanup(ws_memmem_pattern *pattern)
+{
+    guint i;
+
+    for (i = 0; i < pattern->num_needles; i++)
+        g_free(pattern->needles[i].copy);
+    pattern->num_needles = 0;
+    pattern->max_span = 0;
+}
+
+const guint8 *
+ws_memmem_portable_exec(const guint8 *haystack, size_t haystack_len,
+        const ws_memmem_pattern *pattern, size_t *match_span)
+{
+    const ws_memmem_needle *needle = &pattern->needles[0];
+    size_t pos;
+    guint i;
+
+    if (pattern->num_needles == 0)
+        return NULL;
+
+    /* With a single case-sensitive needle, let memchr() find candidates. */
+    if (pattern->num_needles == 1 && !pattern->nocase) {
+        const guint8 *h = haystack;
+        const guint8 *end;
+
+        if (needle->span > haystack_len)
+            return NULL;
+        end = haystack + (haystack_len - needle->span) + 1;
+        while (h < end && (h = (const guint8 *)memchr(h, needle->first[0], end - h)) != NULL) {
+            if (ws_memmem_needle_matches(h, needle, FALSE)) {
+                if (match_span)
+                    *match_span = needle->span;
+                return h;
+            }
+            h++;
+        }
+        return NULL;
+    }
+
+    for (pos = 0; pos < haystack_len; pos++) {
+        for (i = 0; i < pattern->num_needles; i++) {
+            needle = &pattern->needles[i];
+            if (needle->span <= haystack_len - pos &&
+                ws_memmem_needle_matches(haystack + pos, needle, pattern->nocase)) {
+                if (match_span)
+                    *match_span = needle->span;
+                return haystack + pos;
+            }
+        }
+    }
+    return NULL;
+}
+
+#ifdef WS_MEMMEM_SSE2
+static const guint8 *
+ws_memmem_sse2_exec(const guint8 *haystack, size_t haystack_len,
+        const ws_memmem_pattern *pattern, size_t *match_span)
+{
+    __m128i first[WS_MEMMEM_MAX_NEEDLES][2], last[WS_MEMMEM_MAX_NEEDLES][2];
+    guint32 masks[WS_MEMMEM_MAX_NEEDLES];
+    const ws_memmem_needle *found;
+    size_t pos;
+    guint i;
+
+    for (i = 0; i < pattern->num_needles; i++) {
+        first[i][0] = _mm_set1_epi8((char)pattern->needles[i].first[0]);
+        first[i][1] = _mm_set1_epi8((char)pattern->needles[i].first[1]);
+        last[i][0] = _mm_set1_epi8((char)pattern->needles[i].last[0]);
+        last[i][1] = _mm_set1_epi8((char)pattern->needles[i].last[1]);
+    }
+
+    /* Every needle must fit at each of the 16 positions of a block. */
+    for (pos = 0; pos + 15 + pattern->max_span <= haystack_len; pos += 16) {
+        const __m128i block_first = _mm_loadu_si128((const __m128i *)(const void *)(haystack + pos));
+        guint32 any = 0;
+
+        for (i = 0; i < pattern->num_needles; i++) {
+            const __m128i block_last = _mm_loadu_si128((const __m128i *)(const void *)
+                    (haystack + pos + pattern->needles[i].span - 1));
+            const __m128i eq_first = _mm_or_si128(_mm_cmpeq_epi8(block_first, first[i][0]),
+                    _mm_cmpeq_epi8(block_first, first[i][1]));
+            const __m128i eq_last = _mm_or_si128(_mm_cmpeq_epi8(block_last, last[i][0]),
+                    _mm_cmpeq_epi8(block_last, last[i][1]));
+
+            masks[i] = (guint32)_mm_movemask_epi8(_mm_and_si128(eq_first, eq_last));
+            any |= masks[i];
+        }
+
+        while (any != 0) {
+            guint idx = ws_memmem_ctz(any);
+
+            found = ws_memmem_check_candidates(haystack + pos + idx, pattern, masks, 1U << idx);
+            if (found != NULL) {
+                if (match_span)
+                    *match_span = found->span;
+                return haystack + pos + idx;
+            }
+            any &= any - 1;
+        }
+    }
+
+    return ws_memmem_portable_exec(haystack + pos, haystack_len - pos, pattern, match_span);
+}
+#endif
+
+#ifdef HAVE_AVX2
+#include "ws_cpuid.h"
+
+static gboolean
+ws_memmem_use_avx2(void)
+{
+    /* Checking more than once is harmless, so this needs no lock. */
+    static int use_avx2 = -1;
+
+    if (use_avx2 == -1)
+        use_avx2 = ws_cpuid_avx2() ? 1 : 0;
+    return use_avx2 == 1;
+}
+#endif
+
+const guint8 *
+ws_memmem_exec(const guint8 *haystack, size_t haystack_len,
+        const ws_memmem_pattern *pattern, size_t *match_span)
+{
+#ifdef HAVE_AVX2
+    if (haystack_len >= 32 + pattern->max_span && ws_memmem_use_avx2())
+        return ws_memmem_avx2_exec(haystack, haystack_len, pattern, match_span);
+#endif
+#ifdef WS_MEMMEM_SSE2
+    if (haystack_len >= 16 + pattern->max_span)
+        return ws_memmem_sse2_exec(haystack, haystack_len, pattern, match_span);
+#endif
+    return ws_memmem_portable_exec(haystack, haystack_len, pattern, match_span);
+}
+
+const guint8 *
+ws_memmem(const guint8 *haystack, size_t haystack_len,
+        const guint8 *needle, size_t needle_len)
+{
+    ws_memmem_pattern pattern;
+
+    if (needle_len == 0 || needle_len > haystack_len)
+        return NULL;
+
+    /* The needle is only needed for the duration of the search, so
+       don't bother copying it. */
+    ws_memmem_pattern_init(&pattern, FALSE);
+    ws_memmem_needle_set(&pattern.needles[0], needle, needle_len, 1, FALSE);
+    pattern.needles[0].copy = NULL;
+    pattern.num_needles = 1;
+    pattern.max_span = needle_len;
+
+    return ws_memmem_exec(haystack, haystack_len, &pattern, NULL);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
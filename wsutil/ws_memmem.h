@@ -0,0 +1,90 @@
+/* ws_memmem.h
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __WS_MEMMEM_H__
+#define __WS_MEMMEM_H__
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** Maximum number of needles in a ws_memmem_pattern. */
+#define WS_MEMMEM_MAX_NEEDLES 4
+
+/** A needle in a ws_memmem_pattern.
+ */
+typedef struct {
+    const guint8 *bytes;    /**< The needle; upper-cased if the pattern ignores case */
+    guint8 *copy;           /**< Our copy of the needle, if we made one */
+    size_t len;             /**< Number of bytes in the needle */
+    size_t stride;          /**< Distance in the haystack between needle bytes */
+    size_t span;            /**< Number of haystack bytes a match covers */
+    guint8 first[2];        /**< First byte of the needle, in both cases */
+    guint8 last[2];         /**< Last byte of the needle, in both cases */
+} ws_memmem_needle;
+
+/** The pattern object used for ws_memmem_exec().
+ */
+typedef struct {
+    ws_memmem_needle needles[WS_MEMMEM_MAX_NEEDLES];
+    guint num_needles;
+    gboolean nocase;        /**< ASCII letters match in either case */
+    size_t max_span;        /**< Largest span of the needles */
+} ws_memmem_pattern;
+
+/** Initialize a pattern with no needles.  If nocase is TRUE, ASCII
+ * letters in the needles match either case in the haystack.
+ */
+WS_DLL_PUBLIC void ws_memmem_pattern_init(ws_memmem_pattern *pattern, gboolean nocase);
+
+/** Add a needle to a pattern.  The needle's bytes are looked for stride
+ * bytes apart in the haystack, so that a stride of 2 skips the high bytes
+ * of UTF-16 text.  Returns FALSE if the needle is empty or the pattern
+ * already has WS_MEMMEM_MAX_NEEDLES needles.
+ */
+WS_DLL_PUBLIC gboolean ws_memmem_pattern_add(ws_memmem_pattern *pattern,
+        const guint8 *needle, size_t needle_len, size_t stride);
+
+/** Free the memory used by a pattern's needles.
+ */
+WS_DLL_PUBLIC void ws_memmem_pattern_cleanup(ws_memmem_pattern *pattern);
+
+/** Scan for the first match of any of the needles of the pattern.  Returns
+ * the start of the match, setting *match_span to the number of haystack
+ * bytes it covers if match_span isn't NULL, or NULL if there's no match.
+ */
+WS_DLL_PUBLIC const guint8 *ws_memmem_exec(const guint8 *haystack, size_t haystack_len,
+        const ws_memmem_pattern *pattern, size_t *match_span);
+
+/** Return the first occurrence of needle in haystack, or NULL if there
+ * isn't one or either of them is empty.
+ */
+WS_DLL_PUBLIC const guint8 *ws_memmem(const guint8 *haystack, size_t haystack_len,
+        const guint8 *needle, size_t needle_len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __WS_MEMMEM_H__ */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
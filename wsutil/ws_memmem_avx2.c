@@ -0,0 +1,84 @@
+/* ws_memmem_avx2.c
+ * Searching memory for one or more byte strings with AVX2 intrinsics
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#ifdef HAVE_AVX2
+
+#include <glib.h>
+#include <immintrin.h>
+#include "ws_memmem.h"
+#include "ws_memmem_int.h"
+
+/* Same as ws_memmem_sse2_exec(), 32 haystack positions at a time. */
+const guint8 *
+ws_memmem_avx2_exec(const guint8 *haystack, size_t haystack_len,
+        const ws_memmem_pattern *pattern, size_t *match_span)
+{
+    __m256i first[WS_MEMMEM_MAX_NEEDLES][2], last[WS_MEMMEM_MAX_NEEDLES][2];
+    guint32 masks[WS_MEMMEM_MAX_NEEDLES];
+    const ws_memmem_needle *found;
+    size_t pos;
+    guint i;
+
+    for (i = 0; i < pattern->num_needles; i++) {
+        first[i][0] = _mm256_set1_epi8((char)pattern->needles[i].first[0]);
+        first[i][1] = _mm256_set1_epi8((char)pattern->needles[i].first[1]);
+        last[i][0] = _mm256_set1_epi8((char)pattern->needles[i].last[0]);
+        last[i][1] = _mm256_set1_epi8((char)pattern->needles[i].last[1]);
+    }
+
+    /* Every needle must fit at each of the 32 positions of a block. */
+    for (pos = 0; pos + 31 + pattern->max_span <= haystack_len; pos += 32) {
+        const __m256i block_first = _mm256_loadu_si256((const __m256i *)(const void *)(haystack + pos));
+        guint32 any = 0;
+
+        for (i = 0; i < pattern->num_needles; i++) {
+            const __m256i block_last = _mm256_loadu_si256((const __m256i *)(const void *)
+                    (haystack + pos + pattern->needles[i].span - 1));
+            const __m256i eq_first = _mm256_or_si256(_mm256_cmpeq_epi8(block_first, first[i][0]),
+                    _mm256_cmpeq_epi8(block_first, first[i][1]));
+            const __m256i eq_last = _mm256_or_si256(_mm256_cmpeq_epi8(block_last, last[i][0]),
+                    _mm256_cmpeq_epi8(block_last, last[i][1]));
+
+            masks[i] = (guint32)_mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last));
+            any |= masks[i];
+        }
+
+        while (any != 0) {
+            guint idx = ws_memmem_ctz(any);
+
+            found = ws_memmem_check_candidates(haystack + pos + idx, pattern, masks, 1U << idx);
+            if (found != NULL) {
+                if (match_span)
+                    *match_span = found->span;
+                return haystack + pos + idx;
+            }
+            any &= any - 1;
+        }
+    }
+
+    return ws_memmem_portable_exec(haystack + pos, haystack_len - pos, pattern, match_span);
+}
+
+#endif /* HAVE_AVX2 */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,99 @@
+/* ws_memmem_int.h
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __WS_MEMMEM_INT_H__
+#define __WS_MEMMEM_INT_H__
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* Index of the lowest bit set in a non-zero mask. */
+static inline guint
+ws_memmem_ctz(guint32 mask)
+{
+#if defined(__GNUC__)
+    return (guint)__builtin_ctz(mask);
+#elif defined(_MSC_VER)
+    unsigned long idx;
+
+    _BitScanForward(&idx, mask);
+    return (guint)idx;
+#else
+    guint idx = 0;
+
+    while (!(mask & 1)) {
+        mask >>= 1;
+        idx++;
+    }
+    return idx;
+#endif
+}
+
+/* Does the needle match at h?  The caller has checked that the span of
+   the needle fits in the haystack. */
+static inline gboolean
+ws_memmem_needle_matches(const guint8 *h, const ws_memmem_needle *needle, gboolean nocase)
+{
+    size_t i;
+
+    if (!nocase && needle->stride == 1)
+        return memcmp(h, needle->bytes, needle->len) == 0;
+
+    for (i = 0; i < needle->len; i++) {
+        guint8 c = h[i * needle->stride];
+
+        if (nocase)
+            c = g_ascii_toupper(c);
+        if (c != needle->bytes[i])
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* Of the needles whose anchor bytes matched at h, as given by bit in
+   masks[], return the first one that matches completely, or NULL. */
+static inline const ws_memmem_needle *
+ws_memmem_check_candidates(const guint8 *h, const ws_memmem_pattern *pattern,
+        const guint32 *masks, guint32 bit)
+{
+    guint i;
+
+    for (i = 0; i < pattern->num_needles; i++) {
+        if ((masks[i] & bit) &&
+            ws_memmem_needle_matches(h, &pattern->needles[i], pattern->nocase))
+            return &pattern->needles[i];
+    }
+    return NULL;
+}
+
+const guint8 *ws_memmem_portable_exec(const guint8 *haystack, size_t haystack_len,
+        const ws_memmem_pattern *pattern, size_t *match_span);
+
+#ifdef HAVE_AVX2
+const guint8 *ws_memmem_avx2_exec(const guint8 *haystack, size_t haystack_len,
+        const ws_memmem_pattern *pattern, size_t *match_span);
+#endif
+
+#endif /* __WS_MEMMEM_INT_H__ */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
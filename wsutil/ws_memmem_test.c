@@ -0,0 +1,282 @@
+/* ws_memmem_test.c
+ * Tests for ws_memmem and ws_memmem_exec
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "ws_memmem.h"
+
+/*
+ * The searches work on blocks of 16 (SSE2) or 32 (AVX2) haystack bytes
+ * and finish the remainder with the portable search, and which of them
+ * is used depends on the haystack length, so the lengths here go past
+ * a few blocks, and the needle lengths are on either side of the block
+ * sizes.
+ */
+#define MAX_HAYSTACK_LEN    (3 * 32 + 40)
+
+static const size_t needle_lens[] = { 1, 2, 3, 15, 16, 17, 31, 32, 33 };
+
+static guint32 test_rand_state;
+
+/* A fixed sequence, so that a failure can be reproduced. */
+static guint32
+test_rand(void)
+{
+    test_rand_state = test_rand_state * 1103515245 + 12345;
+    return test_rand_state >> 16;
+}
+
+/* Fill with letters from a small alphabet, so that partial matches are common. */
+static void
+fill_haystack(guint8 *haystack, size_t len, gboolean mixed_case)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        haystack[i] = "abcab"[test_rand() % 5];
+        if (mixed_case && (test_rand() & 1))
+            haystack[i] = g_ascii_toupper(haystack[i]);
+    }
+}
+
+static gboolean
+ref_needle_matches(const guint8 *h, const guint8 *needle, size_t len, size_t stride, gboolean nocase)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        guint8 c = h[i * stride];
+        guint8 n = needle[i];
+
+        if (nocase) {
+            c = g_ascii_toupper(c);
+            n = g_ascii_toupper(n);
+        }
+        if (c != n)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+typedef struct {
+    const guint8 *bytes;
+    size_t len;
+    size_t stride;
+} test_needle;
+
+/* The straightforward search ws_memmem_exec() has to agree with. */
+static const guint8 *
+ref_exec(const guint8 *haystack, size_t haystack_len, const test_needle *needles,
+        guint num_needles, gboolean nocase, size_t *match_span)
+{
+    size_t pos, span;
+    guint i;
+
+    for (pos = 0; pos < haystack_len; pos++) {
+        for (i = 0; i < num_needles; i++) {
+            span = (needles[i].len - 1) * needles[i].stride + 1;
+            if (span <= haystack_len - pos &&
+                ref_needle_matches(haystack + pos, needles[i].bytes, needles[i].len,
+                    needles[i].stride, nocase)) {
+                *match_span = span;
+                return haystack + pos;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void
+check_exec(const guint8 *haystack, size_t haystack_len, const test_needle *needles,
+        guint num_needles, gboolean nocase)
+{
+    ws_memmem_pattern pattern;
+    const guint8 *expected, *found;
+    size_t expected_span = 0, found_span = 0;
+    guint i;
+
+    ws_memmem_pattern_init(&pattern, nocase);
+    for (i = 0; i < num_needles; i++)
+        g_assert(ws_memmem_pattern_add(&pattern, needles[i].bytes, needles[i].len, needles[i].stride));
+
+    expected = ref_exec(haystack, haystack_len, needles, num_needles, nocase, &expected_span);
+    found = ws_memmem_exec(haystack, haystack_len, &pattern, &found_span);
+    g_assert(found == expected);
+    if (expected != NULL)
+        g_assert(found_span == expected_span);
+
+    ws_memmem_pattern_cleanup(&pattern);
+}
+
+/* Put a copy of the needle at every possible position, including the
+   last one, of haystacks of every length. */
+static void
+check_single_needle(gboolean nocase)
+{
+    guint8 haystack[MAX_HAYSTACK_LEN];
+    guint8 needle[33];
+    test_needle tn;
+    size_t haystack_len, needle_len, pos, i;
+    guint n;
+
+    for (n = 0; n < G_N_ELEMENTS(needle_lens); n++) {
+        needle_len = needle_lens[n];
+        for (i = 0; i < needle_len; i++)
+            needle[i] = "abcxyz"[test_rand() % 6];
+        tn.bytes = needle;
+        tn.len = needle_len;
+        tn.stride = 1;
+
+        for (haystack_len = 0; haystack_len <= MAX_HAYSTACK_LEN; haystack_len++) {
+            /* No planted match (there may still be one by chance). */
+            fill_haystack(haystack, haystack_len, nocase);
+            check_exec(haystack, haystack_len, &tn, 1, nocase);
+
+            for (pos = 0; pos + needle_len <= haystack_len; pos++) {
+                fill_haystack(haystack, haystack_len, nocase);
+                for (i = 0; i < needle_len; i++) {
+                    haystack[pos + i] = needle[i];
+                    if (nocase && (test_rand() & 1))
+                        haystack[pos + i] = g_ascii_toupper(needle[i]);
+                }
+                check_exec(haystack, haystack_len, &tn, 1, nocase);
+            }
+        }
+    }
+}
+
+static void
+ws_memmem_test_single(void)
+{
+    test_rand_state = 1;
+    check_single_needle(FALSE);
+}
+
+static void
+ws_memmem_test_single_nocase(void)
+{
+    test_rand_state = 2;
+    check_single_needle(TRUE);
+}
+
+/* Several needles of different lengths and strides, as Find Packet uses
+   for text that may be ASCII or UTF-16. */
+static void
+check_multiple_needles(gboolean nocase)
+{
+    static const guint8 n0[] = "ca";
+    static const guint8 n1[] = "xyzzy";
+    static const guint8 n2[] = "abcabcabcabcabcxy";
+    static const guint8 n3[] = "zyxwvutsrqponmlkjihgfedcbazyxwvut";
+    const test_needle needles[] = {
+        { n3, sizeof n3 - 1, 1 },
+        { n2, sizeof n2 - 1, 1 },
+        { n1, sizeof n1 - 1, 2 },
+        { n0, sizeof n0 - 1, 1 },
+    };
+    guint8 haystack[MAX_HAYSTACK_LEN];
+    size_t haystack_len, pos, i, span;
+    guint n, num_needles;
+
+    for (num_needles = 1; num_needles <= G_N_ELEMENTS(needles); num_needles++) {
+        for (haystack_len = 0; haystack_len <= MAX_HAYSTACK_LEN; haystack_len++) {
+            fill_haystack(haystack, haystack_len, nocase);
+            check_exec(haystack, haystack_len, needles, num_needles, nocase);
+
+            for (n = 0; n < num_needles; n++) {
+                span = (needles[n].len - 1) * needles[n].stride + 1;
+                for (pos = 0; pos + span <= haystack_len; pos++) {
+                    fill_haystack(haystack, haystack_len, nocase);
+                    for (i = 0; i < needles[n].len; i++) {
+                        haystack[pos + i * needles[n].stride] = needles[n].bytes[i];
+                        if (nocase && (test_rand() & 1))
+                            haystack[pos + i * needles[n].stride] = g_ascii_toupper(needles[n].bytes[i]);
+                    }
+                    check_exec(haystack, haystack_len, needles, num_needles, nocase);
+                }
+            }
+        }
+    }
+}
+
+static void
+ws_memmem_test_multiple(void)
+{
+    test_rand_state = 3;
+    check_multiple_needles(FALSE);
+}
+
+static void
+ws_memmem_test_multiple_nocase(void)
+{
+    test_rand_state = 4;
+    check_multiple_needles(TRUE);
+}
+
+static void
+ws_memmem_test_memmem(void)
+{
+    static const guint8 haystack[] = "0123456789abcdef0123456789ABCDEF0123456789abcdefXYZ";
+    const size_t haystack_len = sizeof haystack - 1;
+    ws_memmem_pattern pattern;
+
+    g_assert(ws_memmem(haystack, haystack_len, (const guint8 *)"XYZ", 3) == haystack + 48);
+    g_assert(ws_memmem(haystack, haystack_len, (const guint8 *)"Z", 1) == haystack + haystack_len - 1);
+    g_assert(ws_memmem(haystack, haystack_len, (const guint8 *)"ABCDEF0", 7) == haystack + 26);
+    g_assert(ws_memmem(haystack, haystack_len, (const guint8 *)"xyz", 3) == NULL);
+    g_assert(ws_memmem(haystack, haystack_len, (const guint8 *)"", 0) == NULL);
+    g_assert(ws_memmem(haystack, 2, (const guint8 *)"012", 3) == NULL);
+    g_assert(ws_memmem(haystack, haystack_len, haystack, haystack_len) == haystack);
+
+    /* Empty needles, and more than the maximum, are refused. */
+    ws_memmem_pattern_init(&pattern, FALSE);
+    g_assert(!ws_memmem_pattern_add(&pattern, haystack, 0, 1));
+    g_assert(ws_memmem_pattern_add(&pattern, haystack, 1, 1));
+    g_assert(ws_memmem_pattern_add(&pattern, haystack, 2, 1));
+    g_assert(ws_memmem_pattern_add(&pattern, haystack, 3, 1));
+    g_assert(ws_memmem_pattern_add(&pattern, haystack, 4, 1));
+    g_assert(!ws_memmem_pattern_add(&pattern, haystack, 5, 1));
+    ws_memmem_pattern_cleanup(&pattern);
+
+    /* A pattern with no needles matches nothing. */
+    ws_memmem_pattern_init(&pattern, TRUE);
+    g_assert(ws_memmem_exec(haystack, haystack_len, &pattern, NULL) == NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/ws_memmem/memmem", ws_memmem_test_memmem);
+    g_test_add_func("/ws_memmem/single", ws_memmem_test_single);
+    g_test_add_func("/ws_memmem/single_nocase", ws_memmem_test_single_nocase);
+    g_test_add_func("/ws_memmem/multiple", ws_memmem_test_multiple);
+    g_test_add_func("/ws_memmem/multiple_nocase", ws_memmem_test_multiple_nocase);
+
+    return g_test_run();
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */